@@ -118,5 +118,23 @@ int main (void)
 	}
 	timePrint ("natcmp");
 
+	// keys are compared by their unescaped names
+	Key * key1 = keyNew ("user/some/string to be compared with/some\\/more with a long common part", KEY_END);
+	Key * key2 = keyDup (key1);
+	keyAddBaseName (key2, "X");
+	for (int i = 0; i < nrIterations; ++i)
+	{
+		res ^= keyCmp (key1, key2);
+	}
+	timePrint ("keyCmp");
+	keySetName (key2, "system/some/string to be compared with");
+	for (int i = 0; i < nrIterations; ++i)
+	{
+		res ^= keyCmp (key1, key2);
+	}
+	timePrint ("keyCmp namespace");
+	keyDel (key1);
+	keyDel (key2);
+
 	printf ("%d\n", res);
 }
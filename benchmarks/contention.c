@@ -0,0 +1,149 @@
+/**
+ * @file
+ *
+ * @brief Benchmark for threads committing files with the resolver at the same time
+ *
+ * Like the race tool, all threads start at the same time. Every thread
+ * commits either its own file or, with `same`, all threads commit the
+ * same file. Commits to different files should neither conflict nor
+ * wait for each other.
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ */
+
+#include <benchmarks.h>
+
+#include <kdbmodule.h>
+
+#include <pthread.h>
+
+typedef struct
+{
+	Plugin * plugin;
+	int commits;
+	int done;
+	int conflicts;
+} Writer;
+
+static pthread_barrier_t barrier;
+
+static int commit (Plugin * plugin, KeySet * ks, Key * parentKey)
+{
+	plugin->kdbGet (plugin, ks, parentKey);
+	if (plugin->kdbSet (plugin, ks, parentKey) != 1)
+	{
+		plugin->kdbError (plugin, ks, parentKey);
+		return -1;
+	}
+
+	// write the temporary file as a storage plugin would
+	FILE * f = fopen (keyString (parentKey), "w");
+	if (!f)
+	{
+		plugin->kdbError (plugin, ks, parentKey);
+		return -1;
+	}
+	fprintf (f, "%s\n", keyName (ksTail (ks)));
+	fclose (f);
+
+	return plugin->kdbCommit (plugin, ks, parentKey);
+}
+
+static void * writer (void * data)
+{
+	Writer * w = data;
+	Key * parentKey = keyNew ("system/benchmark/contention", KEY_END);
+	KeySet * ks = ksNew (1, keyNew ("system/benchmark/contention/key", KEY_END), KS_END);
+
+	pthread_barrier_wait (&barrier);
+	for (int i = 0; i < w->commits; ++i)
+	{
+		keySetMeta (parentKey, "error", 0);
+		if (commit (w->plugin, ks, parentKey) == 1)
+		{
+			++w->done;
+		}
+		else
+		{
+			++w->conflicts;
+		}
+	}
+
+	ksDel (ks);
+	keyDel (parentKey);
+	return 0;
+}
+
+int main (int argc, char ** argv)
+{
+	if (argc < 3 || argc > 4 || (argc == 4 && strcmp (argv[3], "same") != 0))
+	{
+		printf ("Usage %s <threads> <commits> [same]\n", argv[0]);
+		printf ("Every thread commits its own file <commits> times,\n");
+		printf ("with same all threads commit the same file\n");
+		return 1;
+	}
+
+	int numThreads = atoi (argv[1]);
+	int numCommits = atoi (argv[2]);
+	int same = argc == 4;
+	if (numThreads <= 0 || numCommits <= 0) return 1;
+
+	char dir[] = "/tmp/elektra-benchmark-contention-XXXXXX";
+	if (!mkdtemp (dir)) return 2;
+
+	KeySet * modules = ksNew (0, KS_END);
+	elektraModulesInit (modules, 0);
+
+	Writer * writers = elektraCalloc (numThreads * sizeof (Writer));
+	pthread_t * threads = elektraMalloc (numThreads * sizeof (pthread_t));
+	char file[1024];
+	for (int i = 0; i < numThreads; ++i)
+	{
+		snprintf (file, sizeof (file), "%s/file%d.ecf", dir, same ? 0 : i);
+		KeySet * conf = ksNew (1, keyNew ("system/path", KEY_VALUE, file, KEY_END), KS_END);
+		writers[i].plugin = elektraPluginOpen ("resolver", modules, conf, 0);
+		writers[i].commits = numCommits;
+		if (!writers[i].plugin) return 3;
+	}
+
+	if (pthread_barrier_init (&barrier, NULL, numThreads + 1) != 0) return 4;
+	for (int i = 0; i < numThreads; ++i)
+	{
+		if (pthread_create (&threads[i], NULL, writer, &writers[i]) != 0) return 5;
+	}
+
+	pthread_barrier_wait (&barrier);
+	timeInit ();
+	for (int i = 0; i < numThreads; ++i)
+	{
+		pthread_join (threads[i], NULL);
+	}
+
+	int done = 0;
+	int conflicts = 0;
+	for (int i = 0; i < numThreads; ++i)
+	{
+		done += writers[i].done;
+		conflicts += writers[i].conflicts;
+	}
+	char msg[256];
+	snprintf (msg, sizeof (msg), "%d threads committing %s: %d commits, %d conflicts", numThreads, same ? "the same file" : "own files",
+		  done, conflicts);
+	timePrint (msg);
+
+	pthread_barrier_destroy (&barrier);
+	for (int i = 0; i < numThreads; ++i)
+	{
+		elektraPluginClose (writers[i].plugin, 0);
+		snprintf (file, sizeof (file), "%s/file%d.ecf", dir, i);
+		unlink (file);
+	}
+	rmdir (dir);
+
+	elektraFree (threads);
+	elektraFree (writers);
+	elektraModulesClose (modules, 0);
+	ksDel (modules);
+	return 0;
+}
@@ -10,7 +10,6 @@
 
 KDB * kdb;
 Key * key;
-KeySet * large;
 
 void benchmarkOpen (void)
 {
@@ -48,6 +47,17 @@ void benchmarkLookupByName (void)
 	}
 }
 
+void benchmarkSort (void)
+{
+	KeySet * sorted = ksNew (ksGetSize (large), KS_END);
+	for (cursor_t i = ksGetSize (large) - 1; i >= 0; --i)
+	{
+		ksBuilderAdd (sorted, ksAtCursor (large, i));
+	}
+	ksBuilderFinish (sorted);
+	ksDel (sorted);
+}
+
 void benchmarkReread (void)
 {
 	kdbGet (kdb, large, key);
@@ -107,6 +117,9 @@ int main (void)
 	benchmarkLookupByName ();
 	timePrint ("Lookup key database");
 
+	benchmarkSort ();
+	timePrint ("Sort key database");
+
 	benchmarkReread ();
 	timePrint ("Re read key database");
 
@@ -0,0 +1,109 @@
+/**
+ * @file
+ *
+ * @brief Benchmark for resolving the backend of keys via the mountpoint trie
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ */
+
+#include <benchmarks.h>
+
+#define NUM_MOUNTPOINTS 500
+#define NUM_KEYS 10000
+#define NUM_ROUNDS 100
+
+static const char * namespaces[] = { "spec", "dir", "user", "system" };
+
+static Trie * insertBackend (Trie * trie, const char * name)
+{
+	Backend * backend = elektraCalloc (sizeof (Backend));
+	backend->mountpoint = keyNew (name, KEY_VALUE, name, KEY_END);
+	backend->refcounter = 1;
+	keyIncRef (backend->mountpoint);
+	return trieInsert (trie, name, backend);
+}
+
+static void mountpointName (char * name, size_t size, int i)
+{
+	const char * ns = namespaces[i % 4];
+	if (i % 5 == 4)
+	{
+		// nested below the previous mountpoint of the same namespace
+		snprintf (name, size, "%s/sw/org%d/app%d/profile%d/", ns, (i - 4) % 23, i - 4, i);
+	}
+	else
+	{
+		snprintf (name, size, "%s/sw/org%d/app%d/", ns, i % 23, i);
+	}
+}
+
+int main (void)
+{
+	char name[KEY_NAME_LENGTH];
+
+	timeInit ();
+	Trie * trie = insertBackend (0, "");
+	for (size_t i = 0; i < sizeof (namespaces) / sizeof (namespaces[0]); ++i)
+	{
+		snprintf (name, sizeof (name), "%s/", namespaces[i]);
+		trie = insertBackend (trie, name);
+	}
+	trie = insertBackend (trie, "system/elektra/");
+	for (int i = 0; i < NUM_MOUNTPOINTS; ++i)
+	{
+		mountpointName (name, sizeof (name), i);
+		trie = insertBackend (trie, name);
+	}
+	timePrint ("Inserted mountpoints");
+
+	Key ** keys = elektraMalloc (NUM_KEYS * sizeof (Key *));
+	for (int i = 0; i < NUM_KEYS; ++i)
+	{
+		// every tenth key is not below any of the mountpoints above
+		if (i % 10 == 9)
+		{
+			snprintf (name, sizeof (name), "%s/sw/other%d/key", namespaces[i % 4], i);
+		}
+		else
+		{
+			mountpointName (name, sizeof (name), (i * 7) % NUM_MOUNTPOINTS);
+			snprintf (name + strlen (name), sizeof (name) - strlen (name), "section%d/key%d", i % 13, i);
+		}
+		keys[i] = keyNew (name, KEY_END);
+	}
+	timePrint ("Created keys");
+
+	size_t found = 0;
+	for (int r = 0; r < NUM_ROUNDS; ++r)
+	{
+		for (int i = 0; i < NUM_KEYS; ++i)
+		{
+			Backend * backend = trieLookup (trie, keys[i]);
+			found += keyGetNameSize (backend->mountpoint);
+		}
+	}
+	timePrint ("Looked up backends");
+
+	// verify the results
+	for (int i = 0; i < NUM_KEYS; ++i)
+	{
+		Backend * backend = trieLookup (trie, keys[i]);
+		const char * mp = keyString (backend->mountpoint);
+		if (strncmp (mp, keyName (keys[i]), strlen (mp)) || (i % 10 != 9 && strlen (mp) < 12))
+		{
+			printf ("Wrong backend %s for %s\n", mp, keyName (keys[i]));
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < NUM_KEYS; ++i)
+	{
+		keyDel (keys[i]);
+	}
+	elektraFree (keys);
+	trieClose (trie, 0);
+	timePrint ("Closed trie");
+
+	printf ("%d keys, %d mountpoints, %d rounds, checksum %zu\n", NUM_KEYS, NUM_MOUNTPOINTS, NUM_ROUNDS, found);
+	return 0;
+}
@@ -21,8 +21,6 @@ KeySet * modules[NUM_PLUGINS];
 Plugin * plugins[NUM_PLUGINS];
 char * pluginNames[NUM_PLUGINS] = { "dump", "mmapstorage_crc", "mmapstorage", "quickdump" };
 
-char * tmpfilename;
-
 static void benchmarkDel (void)
 {
 	ksDel (large);
@@ -104,7 +102,7 @@ int main (int argc, char ** argv)
 		init (argc, argv);
 
 		Plugin * plugin = plugins[i];
-		Key * parentKey = keyNew ("user/benchmarks/storage", KEY_VALUE, tmpfilename, KEY_END);
+		Key * parentKey = keyNew (KEY_ROOT, KEY_VALUE, elektraFilename (), KEY_END);
 
 		for (size_t run = 0; run < NUM_RUNS; ++run)
 		{
@@ -1197,6 +1197,67 @@ __attribute__ ((noinline)) void benchmark_layer_sync (kdb::Environment & s)
 	dump << "layer switch " << x << std::endl;
 }
 
+const int kdbThreads = 4;
+
+const char * kdbParent = "user/benchmark/thread";
+
+// every thread opens its own handle, which is the only way without the concurrent mode
+__attribute__ ((noinline)) void benchmark_kdb_get_handles ()
+{
+	static Timer t ("kdbGet handle per thread");
+	t.start ();
+	std::vector<std::thread> threads;
+	for (int i = 0; i < kdbThreads; ++i)
+	{
+		threads.emplace_back ([] {
+			kdb::KDB kdb;
+			kdb::KeySet ks;
+			for (long long j = 0; j < iterations1; ++j)
+			{
+				kdb.get (ks, kdbParent);
+			}
+		});
+	}
+	for (auto & thread : threads)
+	{
+		thread.join ();
+	}
+	t.stop ();
+	std::cout << t;
+	dump << t.name << kdbThreads << std::endl;
+}
+
+// all threads share one handle in concurrent mode
+__attribute__ ((noinline)) void benchmark_kdb_get_shared ()
+{
+	static Timer t ("kdbGet shared handle");
+	t.start ();
+	kdb::KDB kdb;
+	kdb::KeySet contract;
+	contract.append (kdb::Key ("system/elektra/ensure/get/concurrent", KEY_VALUE, "1", KEY_END));
+	kdb::Key parent (kdbParent, KEY_END);
+	kdb.ensure (contract, parent);
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < kdbThreads; ++i)
+	{
+		threads.emplace_back ([&kdb] {
+			kdb::KeySet ks;
+			for (long long j = 0; j < iterations1; ++j)
+			{
+				kdb.get (ks, kdbParent);
+			}
+		});
+	}
+	for (auto & thread : threads)
+	{
+		thread.join ();
+	}
+	t.stop ();
+	std::cout << t;
+	dump << t.name << kdbThreads << std::endl;
+}
+
 #include <unistd.h>
 #ifdef _WIN32
 #include <winsock2.h>
@@ -1326,6 +1387,9 @@ int main (int argc, char ** argv)
 
 		benchmark_hashmap ();
 		benchmark_hashmap_find ();
+
+		benchmark_kdb_get_handles ();
+		benchmark_kdb_get_shared ();
 	}
 
 	data << "value,benchmark" << std::endl;
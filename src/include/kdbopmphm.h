@@ -83,6 +83,25 @@ typedef enum
 		It prevents erroneous free() calls on these graphs. */
 } opmphmflag_t;
 
+/**
+ * Maximum number of changes tracked by the delta of an OPMPHM.
+ */
+#define OPMPHM_DELTA_MAX 64
+
+/**
+ * The changes of the elements since the OPMPHM was build.
+ *
+ * Orders refer to the elements the OPMPHM was build for.
+ */
+typedef struct
+{
+	size_t n;			   /*!< number of elements the OPMPHM was build for */
+	size_t insertedSize;		   /*!< number of inserted elements */
+	size_t removedSize;		   /*!< number of removed elements */
+	size_t inserted[OPMPHM_DELTA_MAX]; /*!< sorted orders in front of which elements were inserted */
+	size_t removed[OPMPHM_DELTA_MAX];  /*!< sorted orders of removed elements */
+} OpmphmDelta;
+
 /**
  * The opmphm
  */
@@ -94,6 +113,7 @@ typedef struct
 	uint32_t * graph;	    /*!< array containing the final OPMPHM */
 	size_t size;		     /*!< size of g in bytes */
 	opmphmflag_t flags;	  /*!< internal flags */
+	OpmphmDelta * delta;	 /*!< changes since the OPMPHM was build, NULL if none */
 } Opmphm;
 
 /**
@@ -132,6 +152,14 @@ int opmphmAssignment (Opmphm * opmphm, OpmphmGraph * graph, size_t n, int defaul
  */
 size_t opmphmLookup (Opmphm * opmphm, size_t n, const void * name);
 
+/**
+ * Delta functions
+ */
+int opmphmDeltaInsert (Opmphm * opmphm, size_t n, size_t index);
+int opmphmDeltaRemove (Opmphm * opmphm, size_t n, size_t index);
+size_t opmphmDeltaIndex (const Opmphm * opmphm, size_t order);
+size_t opmphmDeltaLookup (Opmphm * opmphm, size_t n, const char * name, opmphmGetName getName, void ** data);
+
 /**
  * Basic functions
  */
@@ -71,6 +71,8 @@ extern "C" {
 typedef struct _Trie Trie;
 typedef struct _Split Split;
 typedef struct _Backend Backend;
+typedef struct _ElektraArena ElektraArena;
+typedef struct _ElektraKsIndex ElektraKsIndex;
 
 
 /* These define the type for pointers to all the kdb functions */
@@ -79,6 +81,8 @@ typedef int (*kdbClosePtr) (Plugin *, Key * errorKey);
 
 typedef int (*kdbGetPtr) (Plugin * handle, KeySet * returned, Key * parentKey);
 typedef int (*kdbSetPtr) (Plugin * handle, KeySet * returned, Key * parentKey);
+typedef int (*kdbSetDeltaPtr) (Plugin * handle, KeySet * returned, KeySet * added, KeySet * changed, KeySet * removed,
+			       Key * parentKey);
 typedef int (*kdbErrorPtr) (Plugin * handle, KeySet * returned, Key * parentKey);
 typedef int (*kdbCommitPtr) (Plugin * handle, KeySet * returned, Key * parentKey);
 
@@ -139,11 +143,24 @@ typedef enum {
 			 This flag is set once a Key name has been moved to a mapped region,
 			 and is removed if the name moves out of the mapped region.
 			 It prevents erroneous free() calls on these keys. */
-	KEY_FLAG_MMAP_DATA = 1 << 6	/*!<
+	KEY_FLAG_MMAP_DATA = 1 << 6,	/*!<
 			 Key value lies inside a mmap region.
 			 This flag is set once a Key value has been moved to a mapped region,
 			 and is removed if the value moves out of the mapped region.
 			 It prevents erroneous free() calls on these keys. */
+	KEY_FLAG_ARENA = 1 << 7,	/*!<
+			 Key struct lies inside an arena of a KeySet.
+			 This flag is always set together with KEY_FLAG_MMAP_STRUCT.
+			 Name and value inside the arena are marked with
+			 KEY_FLAG_MMAP_KEY and KEY_FLAG_MMAP_DATA.
+			 keyDel() releases the reference to the arena
+			 instead of freeing the key. @see ksNewArena() */
+	KEY_FLAG_INTERNED = 1 << 8	/*!<
+			 Name and value of the metakey lie in an entry of the
+			 process-wide intern table, which is shared by all
+			 metakeys with the same name and value. They are also
+			 marked with KEY_FLAG_MMAP_KEY and KEY_FLAG_MMAP_DATA,
+			 keyClear() releases the entry instead. */
 } keyflag_t;
 
 
@@ -176,6 +193,23 @@ typedef enum {
 		 This flag is set for KeySets where the array is in a mapped region,
 		 and is removed if the array is moved out from the mapped region.
 		 It prevents erroneous free() calls on these arrays. */
+	,KS_FLAG_UNSORTED = 1 << 4	/*!<
+		 Keys were added out of order by ksBuilderAdd().
+		 The array needs to be sorted by ksBuilderFinish()
+		 before it can be searched. */
+	,KS_FLAG_VIEW = 1 << 5	/*!<
+		 Array of the KeySet is a range of the array of another KeySet.
+		 The keys are shared without being referenced, and the array
+		 does not end with a NULL pointer. The array is copied
+		 before the KeySet is changed. @see elektraKsViewInit() */
+	,KS_FLAG_SHARED = 1 << 6	/*!<
+		 ksDup() shares the array instead of copying it.
+		 Set by ksShare() and inherited by the duplicates. */
+	,KS_FLAG_SHARED_ARRAY = 1 << 7	/*!<
+		 Array of the KeySet lies inside a reference counted block,
+		 which may be used by several KeySets. The block holds one
+		 reference of every key. The array is copied before the KeySet
+		 is changed. @see elektraKsViewPromote() */
 } ksflag_t;
 
 
@@ -229,6 +263,14 @@ struct _Key
 	 */
 	size_t keyUSize;
 
+	/**
+	 * The first 8 bytes of the unescaped key name as big-endian
+	 * integer, padded with zeros. Keys with different prefixes
+	 * are ordered without reading their names.
+	 * @see elektraKeyUpdateNamePrefix()
+	 */
+	uint64_t namePrefix;
+
 	/**
 	 * Some control and internal flags.
 	 */
@@ -245,6 +287,12 @@ struct _Key
 	 * All the key's meta information.
 	 */
 	KeySet * meta;
+
+	/**
+	 * Position of keyNextMeta() in meta, 0 after keyRewindMeta().
+	 * The cursor of meta cannot be used, meta might be shared.
+	 */
+	size_t metaCursor;
 };
 
 
@@ -285,7 +333,72 @@ struct _KeySet
 	 * The Order Preserving Minimal Perfect Hash Map Predictor.
 	 */
 	OpmphmPredictor * opmphmPredictor;
+	/**
+	 * The search index used instead of binary search for large KeySets.
+	 * Invalidated together with the OPMPHM. @see ksindex.c
+	 */
+	ElektraKsIndex * index;
 #endif
+
+	/**
+	 * The arena keys of ksArenaKeyNew() are allocated from.
+	 * Only set for KeySets created by ksNewArena().
+	 */
+	ElektraArena * arena;
+
+	/**
+	 * Number of additional keys sharing this KeySet as metadata.
+	 * 0 if the KeySet is not shared. Only changed atomically, because
+	 * the keys sharing the KeySet may be used by different threads.
+	 * @see elektraMetaShare()
+	 */
+	size_t metaShares;
+
+	/**
+	 * Epoch of the snapshot kdbGet() of a handle in concurrent mode read
+	 * the keys from, 0 if none. kdbSet() of such a handle fails with a
+	 * conflict, if another thread changed a backend since this epoch.
+	 */
+	size_t snapshotEpoch;
+};
+
+/**
+ * KeySets with at least this many Keys are searched with an ElektraKsIndex
+ * instead of bsearch(), if the OPMPHM is not used.
+ */
+#define ELEKTRA_KS_INDEX_MIN_SIZE 1024
+
+/**
+ * The ElektraKsIndex is only build after ks->size / ELEKTRA_KS_INDEX_BUILD_RATIO
+ * lookups without changes to the KeySet, so that the build pays off.
+ */
+#define ELEKTRA_KS_INDEX_BUILD_RATIO 64
+
+/**
+ * A node of an ElektraKsIndex.
+ */
+typedef struct
+{
+	uint64_t prefix[2]; /**< 16 bytes of the unescaped name following the common prefix, as big-endian integers */
+	const char * name;  /**< the unescaped name, so that the Key itself is not needed */
+	uint32_t nameSize;  /**< size of the unescaped name */
+	uint32_t index;	    /**< position of the Key in the KeySet */
+} ElektraKsIndexNode;
+
+/**
+ * Read optimized search index over the sorted array of a KeySet.
+ *
+ * The nodes are stored in Eytzinger order (the layout of a binary heap),
+ * so the first levels of every search share the same cache lines.
+ * Every node carries a part of the name, so that most steps of a search
+ * do not read the Key.
+ */
+struct _ElektraKsIndex
+{
+	ElektraKsIndexNode * nodes; /**< 1-based, NULL if the index is not build */
+	size_t size;		    /**< number of nodes */
+	size_t commonSize;	  /**< number of bytes all unescaped names start with */
+	size_t lookups;		    /**< lookups since the KeySet changed */
 };
 
 
@@ -328,6 +441,13 @@ struct _KDB
 	KeySet * global; /*!< This keyset can be used by plugins to pass data through
 			the KDB and communicate with other plugins. Plugins shall clean
 			up their parts of the global keyset, which they do not need any more.*/
+
+	size_t getThreads; /*!< The number of threads kdbGet() may use to run the
+			plugins of thread-safe backends, see kdbEnsure().
+			0 and 1 mean everything is done in the calling thread.*/
+
+	struct _ElektraSnapshots * snapshots; /*!< Published KeySets for concurrent kdbGet() calls,
+			see kdbEnsure(). 0 if the handle may only be used by one thread.*/
 };
 
 
@@ -379,6 +499,21 @@ struct _Backend
 	   More than three is not possible, because a backend
 	   can be only mounted in dir, system and user each once
 	   OR only in spec.*/
+
+	int threadSafe; /*!< 1 if all get plugins after the resolver are marked
+	   with threadsafe in infos/status, -1 if not and 0 if not yet checked.
+	   Only thread-safe backends are loaded concurrently by kdbGet().*/
+
+	int delta; /*!< 1 if the set storage plugin exports setDelta,
+	   -1 if not and 0 if not yet checked. */
+	kdbSetDeltaPtr setDelta; /*!< The setDelta export of the set storage plugin, if delta is 1. */
+
+	KeySet * specstate; /*!< The names of the spec keys in storage after the
+		previous get or set, 0 if unknown. Only kept if delta is 1.
+		Needed to tell setDelta which keys were added or removed. */
+	KeySet * dirstate;    /*!< Like specstate for the dir key. */
+	KeySet * userstate;   /*!< Like specstate for the users key. */
+	KeySet * systemstate; /*!< Like specstate for the systems key. */
 };
 
 /**
@@ -424,6 +559,12 @@ struct _Plugin
 };
 
 
+/** Sizes of the nodes of the Trie, see _Trie::alloc */
+#define ELEKTRA_TRIE_NODE4 4
+#define ELEKTRA_TRIE_NODE16 16
+#define ELEKTRA_TRIE_NODE48 48
+#define ELEKTRA_TRIE_NODE256 KDB_MAX_UCHAR
+
 /**
  *
  * The private trie structure.
@@ -432,14 +573,22 @@ struct _Plugin
  * fast. This is exactly what needs to be done when using kdbGet() and kdbSet()
  * in a hierarchy where backends are mounted - you need the backend mounted
  * closest to the parentKey.
+ *
+ * The trie is an adaptive radix tree: every node stores the text of the edge
+ * leading to it and only as many child slots as it needs. Nodes with up to
+ * 4 or 16 children keep the sorted first bytes of their children in index,
+ * nodes with up to 48 children map every byte to a slot and larger nodes
+ * use the byte as slot directly.
  */
 struct _Trie
 {
-	struct _Trie * children[KDB_MAX_UCHAR]; /*!< The children building up the trie recursively */
-	char * text[KDB_MAX_UCHAR];		/*!< Text identifying this node */
-	size_t textlen[KDB_MAX_UCHAR];		/*!< Length of the text */
-	Backend * value[KDB_MAX_UCHAR];		/*!< Pointer to a backend */
-	Backend * empty_value;			/*!< Pointer to a backend for the empty string "" */
+	struct _Trie ** children; /*!< The children building up the trie recursively, followed by the index */
+	unsigned char * index;    /*!< Finds the slot of a child by its first byte, NULL for 256 children */
+	char * text;		  /*!< Text identifying this node, starting with the byte used in the index of the parent */
+	size_t textlen;		  /*!< Length of the text */
+	Backend * value;	  /*!< Pointer to a backend mounted at the text of all nodes up to here */
+	unsigned short size;      /*!< Number of children */
+	unsigned short alloc;     /*!< Number of slots in children, one of 0 and ELEKTRA_TRIE_NODE* */
 };
 
 typedef enum {
@@ -471,6 +620,9 @@ struct _Split
 				Is either the mountpoint of the backend
 				or "user", "system", "spec" for the split root/cascading backends */
 	splitflag_t * syncbits; /*!< Bits for various options, see #splitflag_t for documentation */
+	KeySet ** sources;	/*!< For kdbSet(): the keys passed to kdbSet(), see splitPrepare() */
+	KeySet ** shared;	/*!< For kdbSet(): the copy-on-write duplicates of `sources` given to the plugins */
+	KeySet ** states;	/*!< For kdbSet(): the names written by setDelta backends, see splitUpdateState() */
 };
 
 // clang-format on
@@ -502,6 +654,7 @@ int splitDivide (Split * split, KDB * handle, KeySet * ks);
 int splitSync (Split * split);
 void splitPrepare (Split * split);
 int splitUpdateSize (Split * split);
+void splitUpdateState (Split * split);
 
 /* for cache: store/load state to/from global keyset */
 void splitCacheStoreState (KDB * handle, Split * split, KeySet * global, Key * parentKey, Key * initialParent);
@@ -517,6 +670,10 @@ Backend * backendOpenVersion (KeySet * global, Key * errorKey);
 int backendClose (Backend * backend, Key * errorKey);
 
 int backendUpdateSize (Backend * backend, Key * parent, int size);
+int backendHasDelta (Backend * backend);
+KeySet * backendStateNew (KeySet * ks);
+void backendUpdateState (Backend * backend, Key * parent, KeySet * state);
+KeySet * backendDelta (Backend * backend, Key * parent, KeySet * ks, KeySet * added, KeySet * changed, KeySet * removed);
 
 /*Plugin handling*/
 Plugin * elektraPluginOpen (const char * backendname, KeySet * modules, KeySet * config, Key * errorKey);
@@ -526,10 +683,14 @@ int elektraProcessPlugins (Plugin ** plugins, KeySet * modules, KeySet * referen
 			   KeySet * global, Key * errorKey);
 size_t elektraPluginGetFunction (Plugin * plugin, const char * name);
 Plugin * elektraPluginFindGlobal (KDB * handle, const char * pluginName);
+int elektraPluginIsThreadSafe (Plugin * plugin);
 
 Plugin * elektraPluginMissing (void);
 Plugin * elektraPluginVersion (void);
 
+/*Error handling*/
+void elektraCopyErrorAndWarnings (Key * dest, Key * src);
+
 /*Trie handling*/
 int trieClose (Trie * trie, Key * errorKey);
 Backend * trieLookup (Trie * trie, const Key * key);
@@ -560,6 +721,9 @@ KeySet * ksDeepDup (const KeySet * source);
 
 Key * elektraKsPopAtCursor (KeySet * ks, cursor_t pos);
 
+int elektraKsViewInit (KeySet * view, KeySet * ks, size_t from, size_t to);
+int elektraKsViewPromote (KeySet * ks);
+
 ssize_t ksSearchInternal (const KeySet * ks, const Key * toAppend);
 
 /*Used for internal memcpy/memmove*/
@@ -568,6 +732,7 @@ ssize_t elektraMemmove (Key ** array1, Key ** array2, size_t size);
 
 ssize_t elektraFinalizeName (Key * key);
 ssize_t elektraFinalizeEmptyName (Key * key);
+void elektraKeyUpdateNamePrefix (Key * key);
 
 char * elektraEscapeKeyNamePart (const char * source, char * dest);
 
@@ -582,6 +747,50 @@ int elektraReadArrayNumber (const char * baseName, kdb_long_long_t * oldIndex);
 
 
 KeySet * ksRenameKeys (KeySet * config, const char * name);
+int elektraKeyCmpName (const Key * k1, const Key * k2);
+
+void elektraOpmphmKeyInserted (KeySet * ks, size_t index);
+void elektraOpmphmKeyRemoved (KeySet * ks, size_t index);
+
+/* Arena allocation of keys, see arena.c */
+KeySet * ksNewArena (size_t alloc);
+Key * ksArenaKeyNew (KeySet * ks, const char * name, ...);
+Key * ksArenaKeyVNew (KeySet * ks, const char * name, va_list va);
+int ksArenaAdoptBuffer (KeySet * ks, void * buffer);
+Key * elektraArenaKeyDupName (KeySet * ks, const Key * source);
+
+ElektraArena * elektraArenaNew (void);
+void * elektraArenaAlloc (ElektraArena * arena, size_t size);
+void * elektraArenaMemDup (ElektraArena * arena, const void * source, size_t size);
+void elektraArenaIncRef (ElektraArena * arena);
+void elektraArenaDecRef (ElektraArena * arena);
+
+ElektraArena * elektraKeyGetArena (const Key * key);
+Key * elektraArenaKeyNew (ElektraArena * arena);
+KeySet * elektraKsNewFor (const Key * owner);
+ssize_t elektraArenaKeySetName (Key * key, const char * newName, option_t options);
+void * elektraKeyValueDupFor (Key * key, const void * value, size_t size);
+void elektraKeyVInit (Key * key, const char * name, va_list va);
+
+/* Search index for large KeySets, see ksindex.c */
+ElektraKsIndex * elektraKsIndexNew (void);
+void elektraKsIndexDel (ElektraKsIndex * index);
+void elektraKsIndexClear (ElektraKsIndex * index);
+int elektraKsIndexIsBuild (const ElektraKsIndex * index);
+int elektraKsIndexBuild (ElektraKsIndex * index, const KeySet * ks);
+ssize_t elektraKsIndexLookup (const ElektraKsIndex * index, const KeySet * ks, const Key * key);
+
+/* Interned and copy-on-write shared metadata, see keymeta.c */
+KeySet * elektraMetaShare (KeySet * meta);
+void elektraMetaRelease (KeySet * meta);
+int elektraKeyUnshareMeta (Key * key);
+void elektraMetaInternRelease (Key * key);
+Key * elektraMetaKeyDup (const Key * meta);
+size_t elektraMetaInternSize (void);
+
+/* Copy-on-write duplicates of keys, see key.c */
+int elektraKeyShare (Key * dest, const Key * source);
+int elektraKeyUnshare (Key * key, const Key * source);
 
 
 /* Conveniences Methods for Making Tests */
@@ -26,6 +26,13 @@ KeySet * elektraKeyGetMetaKeySet (const Key * key);
 
 Key * ksPopAtCursor (KeySet * ks, cursor_t c);
 
+ssize_t ksBuilderAdd (KeySet * ks, Key * toAppend);
+ssize_t ksBuilderFinish (KeySet * ks);
+
+KeySet * ksView (KeySet * ks, const Key * cutpoint);
+
+int ksShare (KeySet * ks);
+
 #ifdef __cplusplus
 }
 }
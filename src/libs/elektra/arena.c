@@ -0,0 +1,459 @@
+/**
+ * @file
+ *
+ * @brief Arena (bump) allocator for KeySets.
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ */
+
+#ifdef HAVE_KDBCONFIG_H
+#include "kdbconfig.h"
+#endif
+
+#ifdef HAVE_STDARG_H
+#include <stdarg.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "kdbprivate.h"
+#include <kdbassert.h>
+
+/** Size of a regular arena chunk in bytes (including its header). */
+#define ELEKTRA_ARENA_CHUNK_SIZE (64 * 1024)
+
+/** Allocations larger than this get their own chunk, so that regular chunks are not wasted. */
+#define ELEKTRA_ARENA_LARGE_SIZE (ELEKTRA_ARENA_CHUNK_SIZE / 4)
+
+/** All allocations are aligned to this size. */
+#define ELEKTRA_ARENA_ALIGN (sizeof (void *) > sizeof (size_t) ? sizeof (void *) : sizeof (size_t))
+
+#define ELEKTRA_ARENA_ROUND(size) (((size) + ELEKTRA_ARENA_ALIGN - 1) & ~(ELEKTRA_ARENA_ALIGN - 1))
+
+typedef struct _ElektraArenaChunk ElektraArenaChunk;
+
+/**
+ * @internal
+ *
+ * A chunk of memory of an arena. The usable memory directly follows the header.
+ */
+struct _ElektraArenaChunk
+{
+	ElektraArenaChunk * next; /*!< The previously allocated chunk */
+	size_t size;		  /*!< Usable size of this chunk in bytes */
+};
+
+#define ELEKTRA_ARENA_CHUNK_HEADER ELEKTRA_ARENA_ROUND (sizeof (ElektraArenaChunk))
+
+typedef struct _ElektraArenaBuffer ElektraArenaBuffer;
+
+/**
+ * @internal
+ *
+ * A buffer owned by an arena, see ksArenaAdoptBuffer().
+ * The list nodes themselves are allocated inside of the arena.
+ */
+struct _ElektraArenaBuffer
+{
+	ElektraArenaBuffer * next; /*!< The previously adopted buffer */
+	void * buffer;		   /*!< The buffer allocated with elektraMalloc() */
+};
+
+/**
+ * @internal
+ *
+ * The private arena structure.
+ *
+ * An arena hands out memory by bumping a pointer inside the current chunk.
+ * Single allocations are never given back, the arena is released as a whole
+ * once the last reference is gone.
+ *
+ * References are held by the KeySet created with ksNewArena() and by every
+ * Key whose struct lies inside the arena (see #KEY_FLAG_ARENA). So keys
+ * which outlive their KeySet (e.g. because they were ksAppend()ed to another
+ * KeySet) keep the arena alive.
+ */
+struct _ElektraArena
+{
+	ElektraArenaChunk * chunks;   /*!< Singly linked list of chunks, newest first */
+	ElektraArenaBuffer * buffers; /*!< Buffers which are freed together with the arena */
+	char * next;		      /*!< Next free byte in the current chunk */
+	size_t left;		      /*!< Free bytes left in the current chunk */
+	size_t refs;		      /*!< Number of references to the arena */
+};
+
+/**
+ * @internal
+ *
+ * Every Key struct in an arena is prefixed with a pointer to its arena,
+ * so that keyDel() knows which arena to release.
+ */
+typedef struct
+{
+	ElektraArena * arena;
+	Key key;
+} ElektraArenaKey;
+
+static ElektraArenaChunk * elektraArenaChunkNew (ElektraArena * arena, size_t size)
+{
+	ElektraArenaChunk * chunk = elektraMalloc (ELEKTRA_ARENA_CHUNK_HEADER + size);
+	if (!chunk) return 0;
+	chunk->size = size;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	return chunk;
+}
+
+/**
+ * @internal
+ *
+ * @brief Creates a new, empty arena with one reference.
+ *
+ * @return the new arena
+ * @retval 0 on memory error
+ */
+ElektraArena * elektraArenaNew (void)
+{
+	ElektraArena * arena = elektraCalloc (sizeof (ElektraArena));
+	if (!arena) return 0;
+	arena->refs = 1;
+	return arena;
+}
+
+/**
+ * @internal
+ *
+ * @brief Allocates @p size bytes inside of the arena.
+ *
+ * The memory is aligned suitably for Key and KeySet structs, but it
+ * is not initialized. It must not be passed to elektraFree().
+ *
+ * @param arena the arena to allocate from
+ * @param size the number of bytes needed
+ *
+ * @return pointer to the memory
+ * @retval 0 on memory error or if @p size is 0
+ */
+void * elektraArenaAlloc (ElektraArena * arena, size_t size)
+{
+	if (!arena || !size) return 0;
+
+	size = ELEKTRA_ARENA_ROUND (size);
+
+	if (size > ELEKTRA_ARENA_LARGE_SIZE)
+	{
+		// large allocations get a chunk of their own, but are appended
+		// behind the current chunk so that it can still be filled up
+		ElektraArenaChunk * current = arena->chunks;
+		arena->chunks = current ? current->next : 0;
+		ElektraArenaChunk * chunk = elektraArenaChunkNew (arena, size);
+		if (current)
+		{
+			current->next = arena->chunks;
+			arena->chunks = current;
+		}
+		if (!chunk) return 0;
+		return (char *) chunk + ELEKTRA_ARENA_CHUNK_HEADER;
+	}
+
+	if (size > arena->left)
+	{
+		ElektraArenaChunk * chunk = elektraArenaChunkNew (arena, ELEKTRA_ARENA_CHUNK_SIZE - ELEKTRA_ARENA_CHUNK_HEADER);
+		if (!chunk) return 0;
+		arena->next = (char *) chunk + ELEKTRA_ARENA_CHUNK_HEADER;
+		arena->left = chunk->size;
+	}
+
+	void * ret = arena->next;
+	arena->next += size;
+	arena->left -= size;
+	return ret;
+}
+
+/**
+ * @internal
+ *
+ * @brief Copies @p size bytes from @p source into the arena.
+ *
+ * @return the copy inside of the arena
+ * @retval 0 on memory error
+ */
+void * elektraArenaMemDup (ElektraArena * arena, const void * source, size_t size)
+{
+	void * ret = elektraArenaAlloc (arena, size);
+	if (ret) memcpy (ret, source, size);
+	return ret;
+}
+
+/**
+ * @internal
+ *
+ * @brief Increments the reference counter of the arena.
+ */
+void elektraArenaIncRef (ElektraArena * arena)
+{
+	if (arena) ++arena->refs;
+}
+
+/**
+ * @internal
+ *
+ * @brief Decrements the reference counter of the arena.
+ *
+ * Once no references are left, all adopted buffers and
+ * all chunks of the arena are freed at once.
+ */
+void elektraArenaDecRef (ElektraArena * arena)
+{
+	if (!arena) return;
+	ELEKTRA_ASSERT (arena->refs > 0, "arena has no references left");
+	if (--arena->refs > 0) return;
+
+	// the list nodes lie inside of the chunks freed below
+	for (ElektraArenaBuffer * buffer = arena->buffers; buffer; buffer = buffer->next)
+	{
+		elektraFree (buffer->buffer);
+	}
+
+	ElektraArenaChunk * chunk = arena->chunks;
+	while (chunk)
+	{
+		ElektraArenaChunk * next = chunk->next;
+		elektraFree (chunk);
+		chunk = next;
+	}
+	elektraFree (arena);
+}
+
+/**
+ * @internal
+ *
+ * @brief Returns the arena a key struct lies in.
+ *
+ * @retval 0 if the key is not inside of an arena
+ */
+ElektraArena * elektraKeyGetArena (const Key * key)
+{
+	if (!key || !test_bit (key->flags, KEY_FLAG_ARENA)) return 0;
+	return ((const ElektraArenaKey *) ((const char *) key - offsetof (ElektraArenaKey, key)))->arena;
+}
+
+/**
+ * @internal
+ *
+ * @brief Allocates an initialized key struct inside of the arena.
+ *
+ * The key holds a reference to the arena which is given back
+ * by keyDel().
+ *
+ * @return a fresh key with #KEY_FLAG_ARENA and #KEY_FLAG_MMAP_STRUCT set
+ * @retval 0 on memory error
+ */
+Key * elektraArenaKeyNew (ElektraArena * arena)
+{
+	ElektraArenaKey * arenaKey = elektraArenaAlloc (arena, sizeof (ElektraArenaKey));
+	if (!arenaKey) return 0;
+
+	arenaKey->arena = arena;
+	keyInit (&arenaKey->key);
+	arenaKey->key.flags = KEY_FLAG_ARENA | KEY_FLAG_MMAP_STRUCT;
+	elektraArenaIncRef (arena);
+	return &arenaKey->key;
+}
+
+/**
+ * @internal
+ *
+ * @brief Creates a new, empty KeySet in the arena of @p owner.
+ *
+ * Used for the metadata of keys, whose KeySet and initial array
+ * are carved out of the arena of the key.
+ *
+ * @return a KeySet in the arena of @p owner or a KeySet created by ksNew()
+ */
+KeySet * elektraKsNewFor (const Key * owner)
+{
+	ElektraArena * arena = elektraKeyGetArena (owner);
+	if (!arena) return ksNew (0, KS_END);
+
+	KeySet * ks = elektraArenaAlloc (arena, sizeof (KeySet));
+	if (!ks) return 0;
+	ksInit (ks);
+	ks->array = elektraArenaAlloc (arena, sizeof (struct _Key *) * KEYSET_SIZE);
+	if (!ks->array) return 0;
+	ks->array[0] = 0;
+	ks->alloc = KEYSET_SIZE;
+	set_bit (ks->flags, KS_FLAG_MMAP_STRUCT | KS_FLAG_MMAP_ARRAY);
+	return ks;
+}
+
+/**
+ * @internal
+ *
+ * @brief Duplicates a value for @p key, inside of its arena if it has one.
+ *
+ * Sets or clears #KEY_FLAG_MMAP_DATA accordingly, the caller is
+ * responsible to release the previous value.
+ *
+ * @return the copy
+ * @retval 0 on memory error
+ */
+void * elektraKeyValueDupFor (Key * key, const void * value, size_t size)
+{
+	ElektraArena * arena = elektraKeyGetArena (key);
+	void * ret;
+	if (arena)
+	{
+		ret = elektraArenaMemDup (arena, value, size);
+		if (ret) set_bit (key->flags, KEY_FLAG_MMAP_DATA);
+	}
+	else
+	{
+		ret = elektraMalloc (size);
+		if (ret) memcpy (ret, value, size);
+		if (ret) clear_bit (key->flags, (keyflag_t) KEY_FLAG_MMAP_DATA);
+	}
+	return ret;
+}
+
+/**
+ * Create a new KeySet which allocates its keys from an arena.
+ *
+ * All keys created with ksArenaKeyNew() for this KeySet, including their
+ * names, values and metadata, are carved out of chunks of memory owned by
+ * the KeySet. Instead of freeing every key one by one, all memory is given
+ * back at once when the last of these keys is deleted.
+ *
+ * The KeySet behaves exactly like a KeySet created with ksNew(). Keys
+ * created with ksArenaKeyNew() can be appended to other KeySets, too.
+ * They then keep the arena alive, even after ksDel() of this KeySet.
+ *
+ * @note Memory inside of the arena is never reused. Names, values and
+ * metadata changed later on are allocated as usual, so the arena mode
+ * suits bulk loaded configuration (e.g. storage plugins in kdbGet()).
+ *
+ * @param alloc gives a hint for the size how many Keys may be stored initially
+ * @return a ready to use KeySet object
+ * @retval 0 on memory error
+ * @see ksArenaKeyNew() to create keys in the arena
+ * @see ksNew() for a KeySet without arena
+ */
+KeySet * ksNewArena (size_t alloc)
+{
+	KeySet * ks = ksNew (alloc, KS_END);
+	if (!ks) return 0;
+
+	ks->arena = elektraArenaNew ();
+	if (!ks->arena)
+	{
+		ksDel (ks);
+		return 0;
+	}
+	return ks;
+}
+
+/**
+ * Create a new Key inside of the arena of @p ks.
+ *
+ * Takes the same arguments as keyNew(). The key is not appended to
+ * @p ks, use ksAppendKey() to do that.
+ *
+ * If @p ks was not created with ksNewArena() this is the same as
+ * keyNew().
+ *
+ * @param ks the KeySet owning the arena
+ * @param name a valid name to the key, see keyNew()
+ * @return a pointer to a new key, which has to be deleted with keyDel()
+ * @retval 0 on allocation error or if an invalid @p name was passed
+ * @see ksNewArena(), keyNew()
+ */
+Key * ksArenaKeyNew (KeySet * ks, const char * name, ...)
+{
+	Key * key;
+	va_list va;
+
+	va_start (va, name);
+	key = ksArenaKeyVNew (ks, name, va);
+	va_end (va);
+
+	return key;
+}
+
+/**
+ * @copydoc ksArenaKeyNew
+ *
+ * @pre caller must use va_start and va_end on va
+ * @param va the variadic argument list
+ */
+Key * ksArenaKeyVNew (KeySet * ks, const char * name, va_list va)
+{
+	if (!ks || !ks->arena) return keyVNew (name, va);
+
+	Key * key = elektraArenaKeyNew (ks->arena);
+	if (!key) return 0;
+	if (name) elektraKeyVInit (key, name, va);
+	return key;
+}
+
+/**
+ * @internal
+ *
+ * @brief Creates a key in the arena of @p ks with the name of @p source.
+ *
+ * The name is copied without being parsed again, value and
+ * metadata are not copied. Used for the name-only key sets
+ * remembered by backends, see backendStateNew().
+ *
+ * @param ks the KeySet owning the arena, must be created with ksNewArena()
+ * @param source the key whose name should be copied
+ * @return a key without value, which has to be deleted with keyDel()
+ * @retval 0 on memory error or if @p ks has no arena
+ */
+Key * elektraArenaKeyDupName (KeySet * ks, const Key * source)
+{
+	if (!ks || !ks->arena || !source || !source->key) return 0;
+
+	Key * key = elektraArenaKeyNew (ks->arena);
+	if (!key) return 0;
+
+	key->key = elektraArenaMemDup (ks->arena, source->key, source->keySize + source->keyUSize);
+	if (!key->key)
+	{
+		keyDel (key);
+		return 0;
+	}
+	key->keySize = source->keySize;
+	key->keyUSize = source->keyUSize;
+	key->namePrefix = source->namePrefix;
+	set_bit (key->flags, KEY_FLAG_MMAP_KEY);
+	return key;
+}
+
+/**
+ * Hand over a buffer to the arena of @p ks.
+ *
+ * The buffer is freed once the arena is released, i.e. after
+ * the last key created with ksArenaKeyNew() for @p ks was deleted.
+ * Storage plugins can therefore read a whole file into one buffer
+ * and let the values of arena keys point directly into it, as long
+ * as they set #KEY_FLAG_MMAP_DATA for these keys.
+ *
+ * @param ks the KeySet owning the arena
+ * @param buffer memory allocated with elektraMalloc()
+ * @retval 1 if the arena now owns the buffer
+ * @retval -1 if @p ks has no arena or on memory error (the caller still owns the buffer)
+ * @see ksNewArena()
+ */
+int ksArenaAdoptBuffer (KeySet * ks, void * buffer)
+{
+	if (!ks || !ks->arena || !buffer) return -1;
+
+	ElektraArenaBuffer * node = elektraArenaAlloc (ks->arena, sizeof (ElektraArenaBuffer));
+	if (!node) return -1;
+	node->buffer = buffer;
+	node->next = ks->arena->buffers;
+	ks->arena->buffers = node;
+	return 1;
+}
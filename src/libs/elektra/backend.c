@@ -457,6 +457,178 @@ int backendUpdateSize (Backend * backend, Key * parent, int size)
 	return 0;
 }
 
+/**
+ * @brief Checks if the set storage plugin of a backend exports setDelta.
+ *
+ * The result is cached in the backend, so call it for the first time
+ * in the thread using the backend, like kdbGet() does.
+ *
+ * @param backend the backend to check
+ *
+ * @retval 1 if the storage plugin exports setDelta
+ * @retval 0 otherwise
+ */
+int backendHasDelta (Backend * backend)
+{
+	if (backend->delta == 0)
+	{
+		Plugin * storage = backend->setplugins[STORAGE_PLUGIN];
+		if (storage && storage->kdbGet && storage->kdbSet)
+		{
+			backend->setDelta = (kdbSetDeltaPtr) elektraPluginGetFunction (storage, "setDelta");
+		}
+		backend->delta = backend->setDelta ? 1 : -1;
+	}
+	return backend->delta == 1;
+}
+
+/**
+ * @brief The state of the namespace of @p parent
+ *
+ * @retval 0 if @p parent has no serializable namespace
+ */
+static KeySet ** backendState (Backend * backend, Key * parent)
+{
+	switch (keyGetNamespace (parent))
+	{
+	case KEY_NS_SPEC:
+		return &backend->specstate;
+	case KEY_NS_DIR:
+		return &backend->dirstate;
+	case KEY_NS_USER:
+		return &backend->userstate;
+	case KEY_NS_SYSTEM:
+		return &backend->systemstate;
+	case KEY_NS_PROC:
+	case KEY_NS_EMPTY:
+	case KEY_NS_META:
+	case KEY_NS_CASCADING:
+	case KEY_NS_NONE:
+		break;
+	}
+	return 0;
+}
+
+/**
+ * @brief Copies the names of all keys in @p ks.
+ *
+ * Values and metadata are not copied, the keys live in one arena.
+ *
+ * @param ks the keys as passed to or returned from a storage plugin
+ *
+ * @return the names to be passed to backendUpdateState()
+ * @retval 0 on memory error
+ */
+KeySet * backendStateNew (KeySet * ks)
+{
+	KeySet * state = ksNewArena (ks->size);
+	if (!state) return 0;
+
+	for (size_t i = 0; i < ks->size; ++i)
+	{
+		Key * name = elektraArenaKeyDupName (state, ks->array[i]);
+		if (!name || ksBuilderAdd (state, name) == -1)
+		{
+			keyDel (name);
+			ksDel (state);
+			return 0;
+		}
+	}
+	ksBuilderFinish (state);
+	return state;
+}
+
+/**
+ * @brief Update what the backend has in storage
+ *
+ * Does nothing, except freeing @p state, if the backend
+ * does not export setDelta.
+ *
+ * @param backend the backend to update
+ * @param parent for parent
+ * @param state the names from backendStateNew() or backendDelta(),
+ *        the backend takes ownership. 0 if the content of the storage is unknown.
+ */
+void backendUpdateState (Backend * backend, Key * parent, KeySet * state)
+{
+	KeySet ** current = backendState (backend, parent);
+	if (!current || backend->delta != 1)
+	{
+		ksDel (state);
+		return;
+	}
+
+	ksDel (*current);
+	*current = state;
+}
+
+/**
+ * @brief Compares the keys to be written with what the backend has in storage.
+ *
+ * Appends the keys of @p ks not in storage yet to @p added and the
+ * keys of @p ks flagged with sync to @p changed. The names of the
+ * keys in storage, but no longer in @p ks, are appended to @p removed.
+ * The cost is linear in the number of keys, but only the names of
+ * added keys are copied.
+ *
+ * @param backend the backend with setDelta
+ * @param parent for parent
+ * @param ks the keys to be written, as passed to the storage plugin
+ * @param added, changed, removed the delta
+ *
+ * @return the names in storage after @p ks was written, to be passed to backendUpdateState()
+ * @retval 0 if the content of the storage is unknown or on memory error
+ */
+KeySet * backendDelta (Backend * backend, Key * parent, KeySet * ks, KeySet * added, KeySet * changed, KeySet * removed)
+{
+	KeySet ** current = backendState (backend, parent);
+	if (!current || !*current || backend->delta != 1) return 0;
+
+	KeySet * state = *current;
+	KeySet * next = ksNewArena (ks->size);
+	if (!next) return 0;
+
+	size_t i = 0;
+	size_t j = 0;
+	while (i < ks->size || j < state->size)
+	{
+		int cmp;
+		if (i == ks->size)
+			cmp = 1;
+		else if (j == state->size)
+			cmp = -1;
+		else
+			cmp = elektraKeyCmpName (ks->array[i], state->array[j]);
+
+		Key * name;
+		if (cmp < 0)
+		{
+			name = elektraArenaKeyDupName (next, ks->array[i]);
+			ksAppendKey (added, ks->array[i++]);
+		}
+		else if (cmp > 0)
+		{
+			ksAppendKey (removed, state->array[j++]);
+			continue;
+		}
+		else
+		{
+			name = state->array[j++];
+			if (test_bit (ks->array[i]->flags, KEY_FLAG_SYNC)) ksAppendKey (changed, ks->array[i]);
+			++i;
+		}
+
+		if (!name || ksBuilderAdd (next, name) == -1)
+		{
+			if (name && !name->ksReference) keyDel (name);
+			ksDel (next);
+			return 0;
+		}
+	}
+	ksBuilderFinish (next);
+	return next;
+}
+
 int backendClose (Backend * backend, Key * errorKey)
 {
 	int errorOccurred = 0;
@@ -483,6 +655,10 @@ int backendClose (Backend * backend, Key * errorKey)
 		ret = elektraPluginClose (backend->errorplugins[i], errorKey);
 		if (ret == -1) ++errorOccurred;
 	}
+	ksDel (backend->specstate);
+	ksDel (backend->dirstate);
+	ksDel (backend->userstate);
+	ksDel (backend->systemstate);
 	elektraFree (backend);
 
 	if (errorOccurred)
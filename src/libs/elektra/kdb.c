@@ -45,8 +45,19 @@
 #include <errno.h>
 #endif
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+#include <kdbease.h>
 #include <kdbinternal.h>
 
+#ifdef HAVE_PTHREAD
+static void elektraSnapshotsDel (struct _ElektraSnapshots * snapshots);
+#endif
+
 
 /**
  * @defgroup kdb KDB
@@ -445,6 +456,9 @@ int kdbClose (KDB * handle, Key * errorKey)
 
 	Key * initialParent = keyDup (errorKey);
 	int errnosave = errno;
+#ifdef HAVE_PTHREAD
+	elektraSnapshotsDel (handle->snapshots);
+#endif
 	splitDel (handle->split);
 
 	trieClose (handle->trie, errorKey);
@@ -521,6 +535,8 @@ static int elektraGetCheckUpdateNeeded (Split * split, Key * parentKey)
 			ELEKTRA_LOG_DEBUG ("backend: %s,%s ;; ret: %d", keyName (split->parents[i]), keyString (split->parents[i]), ret);
 
 			backendUpdateSize (backend, split->parents[i], 0);
+			// checked here, plugins might run in other threads later
+			backendHasDelta (backend);
 		}
 		// TODO: set error in else case!
 
@@ -529,6 +545,8 @@ static int elektraGetCheckUpdateNeeded (Split * split, Key * parentKey)
 		case ELEKTRA_PLUGIN_STATUS_CACHE_HIT:
 			// Keys in cache are up-to-date
 			++cacheHits;
+			// storage plugin might not run, so we would not know what it has
+			backendUpdateState (backend, split->parents[i], 0);
 			// Set sync flag, needed in case of cache miss
 			// FALLTHROUGH
 		case ELEKTRA_PLUGIN_STATUS_SUCCESS:
@@ -563,6 +581,319 @@ typedef enum
 	LAST
 } UpdatePass;
 
+/**
+ * @internal
+ * @brief Lets a backend with setDelta remember which keys its storage plugin returned.
+ *
+ * @param ret the return value of the storage plugin, after errors nothing is remembered
+ */
+static void elektraGetUpdateState (Backend * backend, KeySet * ks, Key * parentKey, int ret)
+{
+	if (backend->delta != 1) return;
+	backendUpdateState (backend, parentKey, ret == -1 ? 0 : backendStateNew (ks));
+}
+
+/**
+ * @internal
+ * @brief Calls the get plugins in [@p start, @p end) of a backend.
+ *
+ * @retval -1 if a plugin failed
+ * @retval 0 on success
+ */
+static int elektraGetRunPlugins (Backend * backend, KeySet * ks, Key * parentKey, int start, int end)
+{
+	ksRewind (ks);
+	for (int p = start; p < end; ++p)
+	{
+		if (backend->getplugins[p] && backend->getplugins[p]->kdbGet)
+		{
+			int ret = backend->getplugins[p]->kdbGet (backend->getplugins[p], ks, parentKey);
+			if (p == STORAGE_PLUGIN) elektraGetUpdateState (backend, ks, parentKey, ret);
+			if (ret == -1)
+			{
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Starts a new warning in @p dest, like the ELEKTRA_ADD_*_WARNING macros
+ *
+ * @param buffer `warnings/#00`, receives the name of the new warning
+ */
+static void elektraNextWarning (Key * dest, char * buffer)
+{
+	const Key * meta = keyGetMeta (dest, "warnings");
+	if (meta)
+	{
+		buffer[10] = keyString (meta)[0];
+		buffer[11] = keyString (meta)[1] + 1;
+		if (buffer[11] > '9')
+		{
+			buffer[11] = '0';
+			buffer[10]++;
+			if (buffer[10] > '9') buffer[10] = '0';
+		}
+	}
+	keySetMeta (dest, "warnings", &buffer[10]);
+}
+
+/**
+ * @brief Adds the warnings and the error of @p src to @p dest
+ *
+ * Used to merge the parent keys of plugins, which ran in other threads.
+ * The result is the same as if the plugin had been called with @p dest:
+ * the first error is kept, further errors become warnings.
+ *
+ * @param dest the key to add the warnings and the error to
+ * @param src the key to take the warnings and the error from
+ */
+void elektraCopyErrorAndWarnings (Key * dest, Key * src)
+{
+	char buffer[] = "warnings/#00";
+	const Key * metaKey;
+
+	keyRewindMeta (src);
+	while ((metaKey = keyNextMeta (src)) != NULL)
+	{
+		const char * name = keyName (metaKey);
+		if (strncmp (name, "warnings/#", sizeof ("warnings/#") - 1) || strlen (name) < sizeof (buffer) - 1) continue;
+
+		if (name[sizeof (buffer) - 1] == '\0') elektraNextWarning (dest, buffer);
+
+		char * destName = elektraFormat ("%s%s", buffer, name + sizeof (buffer) - 1);
+		keySetMeta (dest, destName, keyString (metaKey));
+		elektraFree (destName);
+	}
+
+	if (!keyGetMeta (src, "error")) return;
+
+	int isWarning = keyGetMeta (dest, "error") != NULL;
+	if (isWarning)
+	{
+		elektraNextWarning (dest, buffer);
+		keySetMeta (dest, buffer, keyString (keyGetMeta (src, "error")));
+	}
+
+	keyRewindMeta (src);
+	while ((metaKey = keyNextMeta (src)) != NULL)
+	{
+		const char * name = keyName (metaKey);
+		if (strncmp (name, "error/", sizeof ("error/") - 1)) continue;
+
+		if (isWarning)
+		{
+			char * destName = elektraFormat ("%s/%s", buffer, name + sizeof ("error/") - 1);
+			keySetMeta (dest, destName, keyString (metaKey));
+			elektraFree (destName);
+		}
+		else
+		{
+			keySetMeta (dest, name, keyString (metaKey));
+		}
+	}
+	if (!isWarning) keySetMeta (dest, "error", keyString (keyGetMeta (src, "error")));
+}
+
+#ifdef HAVE_PTHREAD
+
+/**
+ * @internal
+ * @brief Checks if all get plugins of a backend after the resolver are thread-safe.
+ *
+ * The result is cached in the backend.
+ *
+ * @retval 1 if the plugins of the backend may run in another thread
+ * @retval 0 otherwise
+ */
+static int elektraBackendIsThreadSafe (Backend * backend)
+{
+	if (backend->threadSafe == 0)
+	{
+		backend->threadSafe = 1;
+		for (size_t p = 1; p < NR_OF_PLUGINS; ++p)
+		{
+			Plugin * plugin = backend->getplugins[p];
+			if (plugin && plugin->kdbGet && !elektraPluginIsThreadSafe (plugin))
+			{
+				backend->threadSafe = -1;
+				break;
+			}
+		}
+	}
+	return backend->threadSafe == 1;
+}
+
+/**
+ * @internal
+ * @brief A backend to be updated by elektraGetDoUpdateParallel().
+ */
+typedef struct
+{
+	Backend * backend;
+	KeySet * keys;
+	Key * parentKey; /*!< receives errors and warnings of this backend only */
+	int threadSafe;
+	int ran; /*!< the plugins were called, so the backend might have recorded state */
+	int ret;
+} ElektraGetJob;
+
+/**
+ * @internal
+ * @brief Work shared by the threads of elektraGetDoUpdateParallel().
+ */
+typedef struct
+{
+	ElektraGetJob * jobs;
+	size_t size;
+	size_t next;   /*!< the next job to take, only accessed atomically */
+	size_t failed; /*!< the first job that failed or size, only accessed atomically */
+	int start;
+	int end;
+} ElektraGetPool;
+
+/**
+ * @internal
+ * @brief Runs the job @p i, unless a job before it already failed.
+ *
+ * Like elektraGetDoUpdate(), backends after a failed one are not updated.
+ */
+static void elektraGetRunJob (ElektraGetPool * pool, size_t i)
+{
+	if (i > __atomic_load_n (&pool->failed, __ATOMIC_ACQUIRE)) return;
+
+	ElektraGetJob * job = &pool->jobs[i];
+	job->ret = elektraGetRunPlugins (job->backend, job->keys, job->parentKey, pool->start, pool->end);
+	job->ran = 1;
+	if (job->ret != -1) return;
+
+	size_t failed = __atomic_load_n (&pool->failed, __ATOMIC_ACQUIRE);
+	while (i < failed && !__atomic_compare_exchange_n (&pool->failed, &failed, i, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		;
+}
+
+static void * elektraGetWorker (void * data)
+{
+	ElektraGetPool * pool = data;
+	size_t i;
+	while ((i = __atomic_fetch_add (&pool->next, 1, __ATOMIC_RELAXED)) < pool->size)
+	{
+		if (pool->jobs[i].threadSafe) elektraGetRunJob (pool, i);
+	}
+	return NULL;
+}
+
+/**
+ * @internal
+ * @brief Calls the get plugins in [@p start, @p end) of all backends
+ * that need an update, using up to `handle->getThreads` threads.
+ *
+ * Thread-safe backends are distributed to the threads, the others are
+ * processed one after the other by the calling thread. Every backend
+ * gets its own copy of @p parentKey. Once a backend failed, no backend
+ * after it in the split is started anymore. Backends after it, which
+ * already ran, forget the state they recorded, as if they had not been
+ * updated. Afterwards, warnings are copied to @p parentKey in the order
+ * of the split, up to the first backend that failed. Its error is copied,
+ * too. So the result does not depend on which backend finished first and
+ * is the same as if all backends were processed one after the other.
+ *
+ * @retval -1 on error
+ * @retval 0 on success
+ * @retval -2 if there are not enough thread-safe backends, nothing was done
+ */
+static int elektraGetDoUpdateParallel (KDB * handle, Split * split, Key * parentKey, int start, int end)
+{
+	const int bypassedSplits = 1;
+	size_t size = 0;
+	size_t threadSafe = 0;
+	for (size_t i = 0; i < split->size - bypassedSplits; i++)
+	{
+		if (!test_bit (split->syncbits[i], SPLIT_FLAG_SYNC)) continue;
+		++size;
+		if (elektraBackendIsThreadSafe (split->handles[i])) ++threadSafe;
+	}
+
+	if (threadSafe < 2)
+	{
+		return -2;
+	}
+
+	ElektraGetJob * jobs = elektraCalloc (size * sizeof (ElektraGetJob));
+	if (!jobs)
+	{
+		return -2;
+	}
+
+	size_t j = 0;
+	for (size_t i = 0; i < split->size - bypassedSplits; i++)
+	{
+		if (!test_bit (split->syncbits[i], SPLIT_FLAG_SYNC)) continue;
+		jobs[j].backend = split->handles[i];
+		jobs[j].keys = split->keysets[i];
+		jobs[j].parentKey = keyNew (keyName (split->parents[i]), KEY_VALUE, keyString (split->parents[i]), KEY_END);
+		jobs[j].threadSafe = split->handles[i]->threadSafe == 1;
+		if (!jobs[j].parentKey)
+		{
+			while (j > 0)
+			{
+				keyDel (jobs[--j].parentKey);
+			}
+			elektraFree (jobs);
+			return -2;
+		}
+		++j;
+	}
+
+	ElektraGetPool pool = { .jobs = jobs, .size = size, .next = 0, .failed = size, .start = start, .end = end };
+	size_t nrThreads = handle->getThreads < threadSafe ? handle->getThreads : threadSafe;
+	pthread_t * threads = elektraCalloc (nrThreads * sizeof (pthread_t));
+	size_t started = 0;
+	// the calling thread is one of the workers
+	while (threads && started + 1 < nrThreads && pthread_create (&threads[started], NULL, elektraGetWorker, &pool) == 0)
+	{
+		++started;
+	}
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (!jobs[i].threadSafe) elektraGetRunJob (&pool, i);
+	}
+	elektraGetWorker (&pool);
+
+	for (size_t t = 0; t < started; ++t)
+	{
+		pthread_join (threads[t], NULL);
+	}
+	elektraFree (threads);
+
+	int ret = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (ret == 0)
+		{
+			elektraCopyErrorAndWarnings (parentKey, jobs[i].parentKey);
+			if (jobs[i].ret == -1)
+			{
+				keySetName (parentKey, keyName (jobs[i].parentKey));
+				keySetString (parentKey, keyString (jobs[i].parentKey));
+				ret = -1;
+			}
+		}
+		else if (jobs[i].ran && start <= STORAGE_PLUGIN && STORAGE_PLUGIN < end)
+		{
+			// the serial update would not have reached this backend
+			elektraGetUpdateState (jobs[i].backend, jobs[i].keys, jobs[i].parentKey, -1);
+		}
+		keyDel (jobs[i].parentKey);
+	}
+	elektraFree (jobs);
+	return ret;
+}
+#endif
+
 /**
  * @internal
  * @brief Do the real update.
@@ -570,8 +901,16 @@ typedef enum
  * @retval -1 on error
  * @retval 0 on success
  */
-static int elektraGetDoUpdate (Split * split, Key * parentKey)
+static int elektraGetDoUpdate (KDB * handle ELEKTRA_UNUSED, Split * split, Key * parentKey)
 {
+#ifdef HAVE_PTHREAD
+	if (handle->getThreads > 1)
+	{
+		int ret = elektraGetDoUpdateParallel (handle, split, parentKey, 1, NR_OF_PLUGINS);
+		if (ret != -2) return ret;
+	}
+#endif
+
 	const int bypassedSplits = 1;
 	for (size_t i = 0; i < split->size - bypassedSplits; i++)
 	{
@@ -580,25 +919,14 @@ static int elektraGetDoUpdate (Split * split, Key * parentKey)
 			// skip it, update is not needed
 			continue;
 		}
-		Backend * backend = split->handles[i];
-		ksRewind (split->keysets[i]);
 		keySetName (parentKey, keyName (split->parents[i]));
 		keySetString (parentKey, keyString (split->parents[i]));
 
-		for (size_t p = 1; p < NR_OF_PLUGINS; ++p)
+		if (elektraGetRunPlugins (split->handles[i], split->keysets[i], parentKey, 1, NR_OF_PLUGINS) == -1)
 		{
-			int ret = 0;
-			if (backend->getplugins[p] && backend->getplugins[p]->kdbGet)
-			{
-				ret = backend->getplugins[p]->kdbGet (backend->getplugins[p], split->keysets[i], parentKey);
-			}
-
-			if (ret == -1)
-			{
-				// Ohh, an error occurred,
-				// lets stop the process.
-				return -1;
-			}
+			// Ohh, an error occurred,
+			// lets stop the process.
+			return -1;
 		}
 	}
 	return 0;
@@ -654,7 +982,22 @@ static int elektraGetDoUpdateWithGlobalHooks (KDB * handle, Split * split, KeySe
 
 	// elektraGlobalGet (handle, ks, parentKey, POSTGETSTORAGE, INIT);
 
-	for (size_t i = 0; i < split->size - bypassedSplits; i++)
+	int parallel = -2;
+#ifdef HAVE_PTHREAD
+	if (run == FIRST && handle->getThreads > 1)
+	{
+		// up to the storage plugin no global plugins are involved
+		parallel = elektraGetDoUpdateParallel (handle, split, parentKey, 1, STORAGE_PLUGIN + 1);
+	}
+#endif
+	if (parallel == -1)
+	{
+		keySetName (parentKey, keyName (initialParent));
+		elektraGlobalError (handle, ks, parentKey, GETSTORAGE, DEINIT);
+		return -1;
+	}
+
+	for (size_t i = 0; parallel == -2 && i < split->size - bypassedSplits; i++)
 	{
 		Backend * backend = split->handles[i];
 		ksRewind (split->keysets[i]);
@@ -711,6 +1054,7 @@ static int elektraGetDoUpdateWithGlobalHooks (KDB * handle, Split * split, KeySe
 					}
 
 					ret = backend->getplugins[p]->kdbGet (backend->getplugins[p], split->keysets[i], parentKey);
+					if (p == STORAGE_PLUGIN) elektraGetUpdateState (backend, split->keysets[i], split->parents[i], ret);
 				}
 				else
 				{
@@ -804,6 +1148,28 @@ static void elektraCacheCutMeta (KDB * handle)
 	keyDel (parentKey);
 }
 
+/**
+ * @brief Marks the cache of @p split as confidential, if a backend decrypts keys
+ *
+ * Such caches contain plain text values and must not be shared with other users.
+ */
+static void elektraCacheMarkConfidential (Split * split, Key * cacheParent)
+{
+	for (size_t i = 0; i < split->size; ++i)
+	{
+		if (!split->handles[i]) continue;
+		for (size_t p = 0; p < NR_OF_PLUGINS; ++p)
+		{
+			Plugin * plugin = split->handles[i]->getplugins[p];
+			if (plugin && (!strncmp (plugin->name, "crypto", sizeof ("crypto") - 1) || !strcmp (plugin->name, "fcrypt")))
+			{
+				keySetMeta (cacheParent, "cache/confidential", "1");
+				return;
+			}
+		}
+	}
+}
+
 KeySet * elektraCutProc (KeySet * ks)
 {
 	Key * parentKey = keyNew ("proc", KEY_END);
@@ -812,141 +1178,1099 @@ KeySet * elektraCutProc (KeySet * ks)
 	return ret;
 }
 
-static void elektraRestoreProc (KeySet * ks, KeySet * proc)
+static void elektraRestoreProc (KeySet * ks, KeySet * proc)
+{
+	ksAppend (ks, proc);
+	ksDel (proc);
+}
+
+static void elektraCacheLoad (KDB * handle, KeySet * cache, Key * parentKey, Key * initialParent ELEKTRA_UNUSED, Key * cacheParent)
+{
+	// prune old cache info
+	elektraCacheCutMeta (handle);
+
+	if (elektraGlobalGet (handle, cache, cacheParent, PREGETCACHE, MAXONCE) != ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	{
+		ELEKTRA_LOG_DEBUG ("CACHE MISS: could not fetch cache");
+		elektraCacheCutMeta (handle);
+		return;
+	}
+	ELEKTRA_ASSERT (elektraStrCmp (keyName (initialParent), keyName (parentKey)) == 0, "parentKey name differs from initial");
+	if (elektraCacheCheckParent (handle->global, cacheParent, parentKey) != 0)
+	{
+		// parentKey in cache does not match, needs rebuild
+		ELEKTRA_LOG_DEBUG ("CACHE WRONG PARENTKEY");
+		elektraCacheCutMeta (handle);
+		return;
+	}
+}
+
+#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
+/**
+ * @brief Deletes the OPMPHM.
+ *
+ * Clears and frees all memory in Opmphm.
+ *
+ * @param opmphm the OPMPHM
+ */
+static void cacheOpmphmDel (Opmphm * opmphm)
+{
+	ELEKTRA_NOT_NULL (opmphm);
+	if (opmphm && opmphm->size && !test_bit (opmphm->flags, OPMPHM_FLAG_MMAP_GRAPH))
+	{
+		elektraFree (opmphm->graph);
+	}
+	if (opmphm->rUniPar && !test_bit (opmphm->flags, OPMPHM_FLAG_MMAP_HASHFUNCTIONSEEDS))
+	{
+		elektraFree (opmphm->hashFunctionSeeds);
+	}
+	if (!test_bit (opmphm->flags, OPMPHM_FLAG_MMAP_STRUCT)) elektraFree (opmphm);
+}
+
+/**
+ * @brief Deletes the OpmphmPredictor.
+ *
+ * Clears and frees all memory in OpmphmPredictor.
+ *
+ * @param op the OpmphmPredictor
+ */
+static void cacheOpmphmPredictorDel (OpmphmPredictor * op)
+{
+	ELEKTRA_NOT_NULL (op);
+	if (!test_bit (op->flags, OPMPHM_PREDICTOR_FLAG_MMAP_PATTERNTABLE)) elektraFree (op->patternTable);
+	if (!test_bit (op->flags, OPMPHM_PREDICTOR_FLAG_MMAP_STRUCT)) elektraFree (op);
+}
+#endif
+
+static int elektraCacheLoadSplit (KDB * handle, Split * split, KeySet * ks, KeySet ** cache, Key ** cacheParent, Key * parentKey,
+				  Key * initialParent, int debugGlobalPositions)
+{
+	ELEKTRA_LOG_DEBUG ("CACHE parentKey: %s, %s", keyName (*cacheParent), keyString (*cacheParent));
+
+	if (splitCacheCheckState (split, handle->global) == -1)
+	{
+		ELEKTRA_LOG_DEBUG ("FAIL, have to discard cache because split state / SIZE FAIL, or file mismatch");
+		elektraCacheCutMeta (handle);
+		return -1;
+	}
+
+	ELEKTRA_LOG_DEBUG ("CACHE HIT");
+	if (splitCacheLoadState (split, handle->global) != 0) return -1;
+
+	if (debugGlobalPositions)
+	{
+		keySetName (parentKey, keyName (initialParent));
+		elektraGlobalGet (handle, *cache, parentKey, PREGETSTORAGE, INIT);
+		elektraGlobalGet (handle, *cache, parentKey, PREGETSTORAGE, MAXONCE);
+		elektraGlobalGet (handle, *cache, parentKey, PREGETSTORAGE, DEINIT);
+	}
+
+	keySetName (parentKey, keyName (initialParent));
+	// TODO: there are no error checks here, see kdbGet
+	elektraGlobalGet (handle, *cache, parentKey, PROCGETSTORAGE, INIT);
+	elektraGlobalGet (handle, *cache, parentKey, PROCGETSTORAGE, MAXONCE);
+	elektraGlobalGet (handle, *cache, parentKey, PROCGETSTORAGE, DEINIT);
+
+	// replace ks with cached keyset
+	ksRewind (*cache);
+	if (ks->size == 0)
+	{
+		ELEKTRA_LOG_DEBUG ("replacing keyset with cached keyset");
+#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
+		if (ks->opmphm) cacheOpmphmDel (ks->opmphm);
+		if (ks->opmphmPredictor) cacheOpmphmPredictorDel (ks->opmphmPredictor);
+#endif
+		ksClose (ks);
+		ks->array = (*cache)->array;
+		ks->size = (*cache)->size;
+		ks->alloc = (*cache)->alloc;
+		ks->flags = (*cache)->flags | (ks->flags & KS_FLAG_SHARED);
+#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
+		ks->opmphm = (*cache)->opmphm;
+		ks->opmphmPredictor = (*cache)->opmphmPredictor;
+		elektraKsIndexDel ((*cache)->index);
+#endif
+		elektraFree (*cache);
+		*cache = 0;
+	}
+	else
+	{
+		ELEKTRA_LOG_DEBUG ("appending cached keyset (ks was not empty)");
+		ksAppend (ks, *cache);
+		ksDel (*cache);
+		*cache = 0;
+	}
+	keyDel (*cacheParent);
+	*cacheParent = 0;
+
+	if (debugGlobalPositions)
+	{
+		keySetName (parentKey, keyName (initialParent));
+		elektraGlobalGet (handle, ks, parentKey, POSTGETSTORAGE, INIT);
+		elektraGlobalGet (handle, ks, parentKey, POSTGETSTORAGE, MAXONCE);
+		elektraGlobalGet (handle, ks, parentKey, POSTGETSTORAGE, DEINIT);
+	}
+
+	return 0;
+}
+
+
+#ifdef HAVE_PTHREAD
+static int elektraKdbGet (KDB * handle, KeySet * ks, Key * parentKey);
+static int elektraKdbSet (KDB * handle, KeySet * ks, Key * parentKey);
+
+/**
+ * @internal
+ *
+ * An immutable copy of the merged KeySet of a handle in concurrent mode.
+ *
+ * Once published, neither the snapshot nor its keys are modified, so
+ * readers may copy from it without locking.
+ */
+typedef struct
+{
+	KeySet * keys;	  /*!< copy of the merged KeySet */
+	size_t size;	  /*!< number of parents retrieved so far */
+	char ** parents;  /*!< names of the parent keys passed to kdbGet() */
+	Key ** cutpoints; /*!< keys below the cutpoint of a parent are returned for the parent */
+	size_t epoch;	  /*!< the epoch the snapshot is published in */
+	size_t backends;  /*!< number of entries in the split of the handle */
+	size_t * changed; /*!< per entry of the split of the handle, the epoch its keys changed last */
+} ElektraSnapshot;
+
+/**
+ * @internal
+ *
+ * A kdbSet() call waiting to be committed together with other calls.
+ * Lives on the stack of the calling thread.
+ */
+typedef struct _ElektraGroupCommit
+{
+	KeySet * ks;
+	Key * parentKey;
+	int ret;			   /*!< the return value of kdbSet(), set by the committing thread */
+	int applied;			   /*!< the changes of the call are written by the common kdbSet() */
+	int done;			   /*!< `ret` is set, protected by `group` */
+	struct _ElektraGroupCommit * next; /*!< the next call in order of arrival */
+} ElektraGroupCommit;
+
+/**
+ * @internal
+ *
+ * The state of a handle in concurrent mode, see kdbEnsure().
+ *
+ * Plugins only run while `writer` is held. The snapshot `published` is
+ * replaced in an RCU-like way: readers announce themselves in the
+ * `readers` counter of the current `epoch` and the writer waits for the
+ * readers of the previous epoch before it deletes the old snapshot.
+ *
+ * With group commit, kdbSet() calls are queued in `pending`. The first
+ * thread finding no `leader` waits for the window, takes all queued
+ * calls and commits them, while the others wait for `committed`.
+ */
+struct _ElektraSnapshots
+{
+	pthread_mutex_t writer; /*!< serializes all calls that run plugins */
+	KeySet * merged;	/*!< the KeySet passed to the plugins, only used while `writer` is held */
+	ElektraSnapshot * published;
+	size_t epoch;
+	size_t readers[2];
+
+	unsigned long window;	   /*!< group commit window in microseconds, 0 if disabled */
+	pthread_mutex_t group;	   /*!< protects `pending`, `leader` and the `done` flags */
+	pthread_cond_t committed;  /*!< signalled after a batch of calls was committed */
+	ElektraGroupCommit * pending; /*!< calls waiting for the next batch */
+	int leader;		      /*!< a thread collects the next batch */
+};
+
+/**
+ * @internal
+ *
+ * Which keys elektraSnapshotReplace() takes from the other KeySet.
+ */
+typedef struct
+{
+	KDB * handle;
+	const Key * cutpoint;
+	Backend * backends[KEY_NS_LAST + 1];
+} ElektraSnapshotFilter;
+
+static void elektraSnapshotDel (ElektraSnapshot * snapshot)
+{
+	if (!snapshot) return;
+
+	for (size_t i = 0; i < snapshot->size; ++i)
+	{
+		elektraFree (snapshot->parents[i]);
+		keyDel (snapshot->cutpoints[i]);
+	}
+	elektraFree (snapshot->parents);
+	elektraFree (snapshot->cutpoints);
+	elektraFree (snapshot->changed);
+	ksDel (snapshot->keys);
+	elektraFree (snapshot);
+}
+
+static struct _ElektraSnapshots * elektraSnapshotsNew (void)
+{
+	struct _ElektraSnapshots * snapshots = elektraCalloc (sizeof (struct _ElektraSnapshots));
+	if (!snapshots) return 0;
+
+	snapshots->merged = ksNew (0, KS_END);
+	if (!snapshots->merged || pthread_mutex_init (&snapshots->writer, 0) != 0)
+	{
+		ksDel (snapshots->merged);
+		elektraFree (snapshots);
+		return 0;
+	}
+	if (pthread_mutex_init (&snapshots->group, 0) != 0)
+	{
+		pthread_mutex_destroy (&snapshots->writer);
+		ksDel (snapshots->merged);
+		elektraFree (snapshots);
+		return 0;
+	}
+	if (pthread_cond_init (&snapshots->committed, 0) != 0)
+	{
+		pthread_mutex_destroy (&snapshots->group);
+		pthread_mutex_destroy (&snapshots->writer);
+		ksDel (snapshots->merged);
+		elektraFree (snapshots);
+		return 0;
+	}
+	return snapshots;
+}
+
+static void elektraSnapshotsDel (struct _ElektraSnapshots * snapshots)
+{
+	if (!snapshots) return;
+
+	elektraSnapshotDel (snapshots->published);
+	ksDel (snapshots->merged);
+	pthread_cond_destroy (&snapshots->committed);
+	pthread_mutex_destroy (&snapshots->group);
+	pthread_mutex_destroy (&snapshots->writer);
+	elektraFree (snapshots);
+}
+
+/**
+ * @internal
+ *
+ * @brief Duplicates a key without writing to it.
+ *
+ * keyDup() shares the metadata of @p source. Copying it later on changes
+ * the reference counters of the metakeys, which must not happen
+ * concurrently for keys of different threads. Here every metakey is
+ * duplicated instead, only interned names and values are shared.
+ *
+ * Unlike keyDup() the sync flag of the duplicate is cleared.
+ *
+ * @param source the key to duplicate
+ *
+ * @return the duplicate
+ * @retval 0 on memory error
+ */
+static Key * elektraSnapshotKeyDup (const Key * source)
+{
+	Key shallow = *source;
+	shallow.meta = 0;
+
+	Key * dup = keyDup (&shallow);
+	if (!dup) return 0;
+	clear_bit (dup->flags, (keyflag_t) KEY_FLAG_SYNC);
+
+	if (!source->meta || source->meta->size == 0) return dup;
+
+	dup->meta = ksNew (source->meta->size, KS_END);
+	if (!dup->meta)
+	{
+		keyDel (dup);
+		return 0;
+	}
+
+	for (size_t i = 0; i < source->meta->size; ++i)
+	{
+		// interned names and values are shared, the metakeys are not
+		Key * meta = elektraMetaKeyDup (source->meta->array[i]);
+		if (!meta)
+		{
+			keyDel (dup);
+			return 0;
+		}
+		// the metadata is already sorted
+		if (ksBuilderAdd (dup->meta, meta) == -1)
+		{
+			keyDel (dup);
+			return 0;
+		}
+	}
+
+	return dup;
+}
+
+static int elektraSnapshotTakeAll (const ElektraSnapshotFilter * filter ELEKTRA_UNUSED, const Key * key ELEKTRA_UNUSED)
+{
+	return 1;
+}
+
+static int elektraSnapshotTakeBelow (const ElektraSnapshotFilter * filter, const Key * key)
+{
+	return keyIsBelowOrSame (filter->cutpoint, key) == 1;
+}
+
+/**
+ * Keys kdbSet() wrote for the parent key `cutpoint`: the keys below it and
+ * all keys of the backends of the parent key.
+ */
+static int elektraSnapshotTakeWritten (const ElektraSnapshotFilter * filter, const Key * key)
+{
+	if (keyIsBelowOrSame (filter->cutpoint, key) == 1) return 1;
+
+	Backend * backend = filter->backends[keyGetNamespace (key)];
+	return backend && mountGetBackend (filter->handle, key) == backend;
+}
+
+/**
+ * @internal
+ *
+ * @brief Replaces the keys of @p ks taken by @p take with copies of the keys of @p from taken by @p take.
+ *
+ * @p from is only read, so it may be a published snapshot.
+ *
+ * @retval 0 on success
+ * @retval -1 on memory error, @p ks is unchanged then
+ */
+static int elektraSnapshotReplace (KeySet * ks, const KeySet * from, int (*take) (const ElektraSnapshotFilter *, const Key *),
+				   const ElektraSnapshotFilter * filter)
+{
+	KeySet * result = ksNew (ks->size + from->size, KS_END);
+	if (!result) return -1;
+
+	for (size_t i = 0; i < ks->size; ++i)
+	{
+		if (!take (filter, ks->array[i])) ksBuilderAdd (result, ks->array[i]);
+	}
+
+	for (size_t i = 0; i < from->size; ++i)
+	{
+		if (!take (filter, from->array[i])) continue;
+
+		Key * key = elektraSnapshotKeyDup (from->array[i]);
+		if (!key || ksBuilderAdd (result, key) == -1)
+		{
+			ksDel (result);
+			return -1;
+		}
+	}
+
+	if (ksBuilderFinish (result) == -1)
+	{
+		ksDel (result);
+		return -1;
+	}
+
+	ksClear (ks);
+	ksAppend (ks, result);
+	ksDel (result);
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Returns the name of the shallower of @p parentKey and the mountpoint of its backend.
+ *
+ * kdbSet() needs all keys of the backend, so they are returned together with the keys below @p parentKey.
+ */
+static const char * elektraSnapshotBackendCutpoint (KDB * handle, const Key * parentKey)
+{
+	Key * mountpoint = mountGetMountpoint (handle, parentKey);
+	if (!mountpoint || !strcmp (keyName (mountpoint), ""))
+	{
+		// the default backend may contain keys anywhere
+		return "/";
+	}
+	if (keyIsBelowOrSame (mountpoint, parentKey) == 1)
+	{
+		return keyName (mountpoint);
+	}
+	return keyName (parentKey);
+}
+
+/**
+ * @internal
+ *
+ * @brief Determines which keys of the merged KeySet kdbGet() returns for @p parentKey.
+ *
+ * @return the key all returned keys are below of
+ * @retval 0 on memory error
+ */
+static Key * elektraSnapshotCutpoint (KDB * handle, const Key * parentKey)
+{
+	if (keyGetNamespace (parentKey) != KEY_NS_CASCADING)
+	{
+		return keyNew (elektraSnapshotBackendCutpoint (handle, parentKey), KEY_CASCADING_NAME, KEY_END);
+	}
+
+	// a cascading parentKey retrieves the backends of all namespaces
+	const char * namespaces[] = { "spec", "dir", "user", "system", 0 };
+	Key * cutpoint = keyNew (keyName (parentKey), KEY_CASCADING_NAME, KEY_END);
+	for (size_t i = 0; cutpoint && namespaces[i]; ++i)
+	{
+		char * name = elektraFormat ("%s%s", namespaces[i], keyName (parentKey));
+		Key * key = keyNew (name, KEY_END);
+		elektraFree (name);
+		if (!key) continue;
+
+		const char * path = strchr (elektraSnapshotBackendCutpoint (handle, key), '/');
+		Key * cascading = keyNew (path ? path : "/", KEY_CASCADING_NAME, KEY_END);
+		keyDel (key);
+
+		if (keyIsBelow (cascading, cutpoint) == 1)
+		{
+			keyDel (cutpoint);
+			cutpoint = cascading;
+		}
+		else
+		{
+			keyDel (cascading);
+		}
+	}
+	return cutpoint;
+}
+
+/**
+ * @internal
+ *
+ * @brief Sets up @p filter to take the keys kdbSet() wrote for @p parentKey.
+ */
+static void elektraSnapshotWrittenFilter (KDB * handle, const Key * parentKey, ElektraSnapshotFilter * filter)
+{
+	memset (filter, 0, sizeof (ElektraSnapshotFilter));
+	filter->handle = handle;
+	filter->cutpoint = parentKey;
+
+	elektraNamespace ns = keyGetNamespace (parentKey);
+	if (ns != KEY_NS_CASCADING)
+	{
+		filter->backends[ns] = mountGetBackend (handle, parentKey);
+		return;
+	}
+
+	const char * namespaces[] = { "spec", "dir", "user", "system", 0 };
+	for (size_t i = 0; namespaces[i]; ++i)
+	{
+		char * name = elektraFormat ("%s%s", namespaces[i], keyName (parentKey));
+		Key * key = keyNew (name, KEY_END);
+		elektraFree (name);
+		if (key) filter->backends[keyGetNamespace (key)] = mountGetBackend (handle, key);
+		keyDel (key);
+	}
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks if @p filter takes the keys of the backend of the @p i th entry of the split of the handle.
+ */
+static int elektraSnapshotTakesBackend (const ElektraSnapshotFilter * filter, size_t i)
+{
+	Split * split = filter->handle->split;
+	return keyIsBelowOrSame (filter->cutpoint, split->parents[i]) == 1 ||
+	       filter->backends[keyGetNamespace (split->parents[i])] == split->handles[i];
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks if the keys of a backend changed in a snapshot published after @p epoch.
+ *
+ * @param taken 1 to check the backends taken by @p filter, 0 to check all other backends
+ */
+static int elektraSnapshotChangedSince (const ElektraSnapshot * snapshot, const ElektraSnapshotFilter * filter, int taken, size_t epoch)
+{
+	if (!snapshot) return 0;
+
+	for (size_t i = 0; i < snapshot->backends; ++i)
+	{
+		if (snapshot->changed[i] > epoch && elektraSnapshotTakesBackend (filter, i) == taken) return 1;
+	}
+	return 0;
+}
+
+static ssize_t elektraSnapshotFind (const ElektraSnapshot * snapshot, const char * parent)
+{
+	if (!snapshot) return -1;
+
+	for (size_t i = 0; i < snapshot->size; ++i)
+	{
+		if (!strcmp (snapshot->parents[i], parent)) return i;
+	}
+	return -1;
+}
+
+/**
+ * @internal
+ *
+ * @brief Creates a new snapshot of the merged KeySet.
+ *
+ * `writer` of the handle must be held.
+ *
+ * @param parentKey a parent to add to the parents of the published snapshot, may be 0
+ * @param changed the parent keys of kdbGet() or kdbSet() calls, which changed the merged KeySet
+ * @param changedSize the number of keys in @p changed
+ *
+ * @return the new snapshot
+ * @retval 0 on memory error
+ */
+static ElektraSnapshot * elektraSnapshotNew (KDB * handle, const Key * parentKey, Key ** changed, size_t changedSize)
+{
+	struct _ElektraSnapshots * snapshots = handle->snapshots;
+	const ElektraSnapshot * old = snapshots->published;
+	size_t oldSize = old ? old->size : 0;
+	size_t size = oldSize + (parentKey ? 1 : 0);
+
+	ElektraSnapshot * snapshot = elektraCalloc (sizeof (ElektraSnapshot));
+	if (!snapshot) return 0;
+
+	snapshot->keys = ksNew (snapshots->merged->size, KS_END);
+	snapshot->parents = elektraCalloc (size * sizeof (char *) + 1);
+	snapshot->cutpoints = elektraCalloc (size * sizeof (Key *) + 1);
+	snapshot->backends = handle->split->size;
+	snapshot->changed = elektraCalloc (snapshot->backends * sizeof (size_t) + 1);
+	if (!snapshot->keys || !snapshot->parents || !snapshot->cutpoints || !snapshot->changed) goto error;
+
+	// elektraSnapshotsPublish() starts the next epoch
+	snapshot->epoch = snapshots->epoch + 1;
+	for (size_t i = 0; old && i < old->backends && i < snapshot->backends; ++i)
+	{
+		snapshot->changed[i] = old->changed[i];
+	}
+	for (size_t c = 0; c < changedSize; ++c)
+	{
+		ElektraSnapshotFilter filter;
+		elektraSnapshotWrittenFilter (handle, changed[c], &filter);
+		for (size_t i = 0; i < snapshot->backends; ++i)
+		{
+			if (elektraSnapshotTakesBackend (&filter, i)) snapshot->changed[i] = snapshot->epoch;
+		}
+	}
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		snapshot->size = i + 1;
+		if (i < oldSize)
+		{
+			snapshot->parents[i] = elektraStrDup (old->parents[i]);
+			snapshot->cutpoints[i] = keyNew (keyName (old->cutpoints[i]), KEY_CASCADING_NAME, KEY_END);
+		}
+		else
+		{
+			snapshot->parents[i] = elektraStrDup (keyName (parentKey));
+			snapshot->cutpoints[i] = elektraSnapshotCutpoint (handle, parentKey);
+		}
+		if (!snapshot->parents[i] || !snapshot->cutpoints[i]) goto error;
+	}
+
+	if (elektraSnapshotReplace (snapshot->keys, snapshots->merged, elektraSnapshotTakeAll, 0) == -1) goto error;
+
+	return snapshot;
+
+error:
+	elektraSnapshotDel (snapshot);
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Enters the read side of the current epoch.
+ *
+ * Until elektraSnapshotsLeave() is called, the returned snapshot will not be deleted.
+ *
+ * @param[out] parity the counter to pass to elektraSnapshotsLeave()
+ *
+ * @return the currently published snapshot, may be 0
+ */
+static const ElektraSnapshot * elektraSnapshotsEnter (struct _ElektraSnapshots * snapshots, size_t * parity)
+{
+	while (1)
+	{
+		size_t epoch = __atomic_load_n (&snapshots->epoch, __ATOMIC_SEQ_CST);
+		__atomic_fetch_add (&snapshots->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n (&snapshots->epoch, __ATOMIC_SEQ_CST) == epoch)
+		{
+			*parity = epoch & 1;
+			return __atomic_load_n (&snapshots->published, __ATOMIC_SEQ_CST);
+		}
+		// the writer started a new epoch meanwhile, it might not wait for us
+		__atomic_fetch_sub (&snapshots->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+static void elektraSnapshotsLeave (struct _ElektraSnapshots * snapshots, size_t parity)
+{
+	__atomic_fetch_sub (&snapshots->readers[parity], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @internal
+ *
+ * @brief Publishes @p snapshot and deletes the previous one, once no reader uses it anymore.
+ *
+ * `writer` must be held.
+ */
+static void elektraSnapshotsPublish (struct _ElektraSnapshots * snapshots, ElektraSnapshot * snapshot)
+{
+	ElektraSnapshot * old = snapshots->published;
+	__atomic_store_n (&snapshots->published, snapshot, __ATOMIC_SEQ_CST);
+
+	size_t epoch = snapshots->epoch;
+	__atomic_store_n (&snapshots->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n (&snapshots->readers[epoch & 1], __ATOMIC_ACQUIRE) != 0)
+	{
+		sched_yield ();
+	}
+
+	elektraSnapshotDel (old);
+}
+
+/**
+ * @internal
+ *
+ * @brief Copies the keys of a published snapshot into @p ks, without locking.
+ *
+ * The epoch of the snapshot is recorded in @p ks, unless @p ks keeps keys
+ * of other parents, which changed since they were read.
+ *
+ * @retval 1 if the keys were copied
+ * @retval 0 if @p parentKey was not retrieved yet
+ * @retval -1 on memory error
+ */
+static int elektraSnapshotsRead (KDB * handle, KeySet * ks, Key * parentKey)
+{
+	struct _ElektraSnapshots * snapshots = handle->snapshots;
+	size_t parity;
+	const ElektraSnapshot * snapshot = elektraSnapshotsEnter (snapshots, &parity);
+
+	ssize_t i = elektraSnapshotFind (snapshot, keyName (parentKey));
+	int ret = 0;
+	if (i >= 0)
+	{
+		ElektraSnapshotFilter filter = { .cutpoint = snapshot->cutpoints[i] };
+		int others = 0;
+		for (size_t k = 0; !others && k < ks->size; ++k)
+		{
+			others = !elektraSnapshotTakeBelow (&filter, ks->array[k]);
+		}
+
+		ret = elektraSnapshotReplace (ks, snapshot->keys, elektraSnapshotTakeBelow, &filter) == -1 ? -1 : 1;
+
+		ElektraSnapshotFilter read;
+		elektraSnapshotWrittenFilter (handle, parentKey, &read);
+		if (ret == 1 && (!others || !elektraSnapshotChangedSince (snapshot, &read, 0, ks->snapshotEpoch)))
+		{
+			ks->snapshotEpoch = snapshot->epoch;
+		}
+	}
+
+	elektraSnapshotsLeave (snapshots, parity);
+
+	if (ret == -1)
+	{
+		ELEKTRA_SET_OUT_OF_MEMORY_ERROR (parentKey);
+	}
+	return ret;
+}
+
+/**
+ * @internal
+ *
+ * @brief kdbGet() for a handle in concurrent mode.
+ *
+ * The thread that gets `writer` runs kdbGet() on the merged KeySet and
+ * publishes a new snapshot, if something changed. Threads that do not
+ * get `writer` copy from the published snapshot if it contains
+ * @p parentKey, so they neither wait for the plugins nor for each other.
+ * Otherwise they wait for `writer`.
+ */
+static int elektraSnapshotsGet (KDB * handle, KeySet * ks, Key * parentKey)
+{
+	struct _ElektraSnapshots * snapshots = handle->snapshots;
+
+	if (pthread_mutex_trylock (&snapshots->writer) != 0)
+	{
+		int ret = elektraSnapshotsRead (handle, ks, parentKey);
+		if (ret != 0) return ret;
+
+		pthread_mutex_lock (&snapshots->writer);
+	}
+
+	int ret = elektraKdbGet (handle, snapshots->merged, parentKey);
+	int known = elektraSnapshotFind (snapshots->published, keyName (parentKey)) >= 0;
+	if (ret == 1 || (ret == 0 && !known))
+	{
+		ElektraSnapshot * snapshot = elektraSnapshotNew (handle, known ? 0 : parentKey, &parentKey, ret == 1 ? 1 : 0);
+		if (snapshot)
+		{
+			elektraSnapshotsPublish (snapshots, snapshot);
+		}
+		else
+		{
+			ELEKTRA_SET_OUT_OF_MEMORY_ERROR (parentKey);
+			ret = -1;
+		}
+	}
+	pthread_mutex_unlock (&snapshots->writer);
+
+	if (ret == -1) return -1;
+
+	// parents are never removed from snapshots, so a newer snapshot contains parentKey as well
+	return elektraSnapshotsRead (handle, ks, parentKey);
+}
+
+/**
+ * @internal
+ *
+ * @brief Publishes the merged KeySet after kdbSet() wrote some of its keys.
+ *
+ * @param merged 0 if the written keys were merged successfully
+ * @param parentKeys the parent keys of the kdbSet() calls, a warning is added to them if the keys cannot be published
+ */
+static void elektraSnapshotsRepublish (KDB * handle, int merged, Key ** parentKeys, size_t size)
+{
+	ElektraSnapshot * snapshot = 0;
+	if (merged == 0)
+	{
+		snapshot = elektraSnapshotNew (handle, 0, parentKeys, size);
+	}
+	if (snapshot)
+	{
+		elektraSnapshotsPublish (handle->snapshots, snapshot);
+		return;
+	}
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		// the configuration was written, only the other threads do not see it
+		ELEKTRA_ADD_RESOURCE_WARNING (parentKeys[i],
+					      "Could not publish the written keys, other threads of this handle might get old keys "
+					      "until the configuration changes again");
+	}
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks if another thread changed a backend taken by @p filter since @p ks was read.
+ *
+ * @retval 1 if @p ks is stale, the conflict is set in @p parentKey
+ * @retval 0 otherwise
+ */
+static int elektraSnapshotsStale (KDB * handle, const ElektraSnapshotFilter * filter, const KeySet * ks, Key * parentKey)
+{
+	if (!elektraSnapshotChangedSince (handle->snapshots->published, filter, 1, ks->snapshotEpoch)) return 0;
+
+	ELEKTRA_SET_CONFLICTING_STATE_ERROR (parentKey,
+					     "Another thread of the handle changed the configuration since kdbGet(). Please "
+					     "retrieve the configuration again");
+	return 1;
+}
+
+/**
+ * @internal
+ *
+ * @brief Runs kdbSet() and publishes the written keys of @p ks.
+ *
+ * Fails with a conflict if another thread changed the keys of a backend
+ * kdbSet() would write, since @p ks was read.
+ *
+ * `writer` must be held.
+ */
+static int elektraSnapshotsCommit (KDB * handle, KeySet * ks, Key * parentKey)
+{
+	struct _ElektraSnapshots * snapshots = handle->snapshots;
+	ElektraSnapshotFilter filter;
+	elektraSnapshotWrittenFilter (handle, parentKey, &filter);
+
+	if (elektraSnapshotsStale (handle, &filter, ks, parentKey)) return -1;
+	// afterwards ks is as new as the snapshot, if its other keys did not change meanwhile
+	int current = !elektraSnapshotChangedSince (snapshots->published, &filter, 0, ks->snapshotEpoch);
+
+	int ret = elektraKdbSet (handle, ks, parentKey);
+	if (ret == 1)
+	{
+		int merged = elektraSnapshotReplace (snapshots->merged, ks, elektraSnapshotTakeWritten, &filter);
+		elektraSnapshotsRepublish (handle, merged, &parentKey, 1);
+		if (current) ks->snapshotEpoch = snapshots->epoch;
+	}
+	return ret;
+}
+
+/**
+ * @internal
+ *
+ * @brief Applies the changes of @p ks to @p combined, unless they overlap with the changes in @p touched.
+ *
+ * The changes are the keys taken by @p filter, which are added, removed or differ in
+ * value or metadata compared to the merged KeySet. As @p ks is not stale, the merged
+ * KeySet still contains the keys @p ks was read with. The keys of @p ks are shared.
+ * `writer` must be held.
+ *
+ * @retval 1 if the changes were applied and their keys added to @p touched
+ * @retval 0 on conflict, the error is set in @p parentKey
+ * @retval -1 on memory error, @p combined might be changed partially then
+ */
+static int elektraSnapshotsApply (KDB * handle, const ElektraSnapshotFilter * filter, KeySet * combined, KeySet * touched, KeySet * ks,
+				  Key * parentKey)
 {
-	ksAppend (ks, proc);
-	ksDel (proc);
-}
+	if (elektraSnapshotsStale (handle, filter, ks, parentKey)) return 0;
 
-static void elektraCacheLoad (KDB * handle, KeySet * cache, Key * parentKey, Key * initialParent ELEKTRA_UNUSED, Key * cacheParent)
-{
-	// prune old cache info
-	elektraCacheCutMeta (handle);
+	KeySet * merged = handle->snapshots->merged;
+	KeySet * changed = ksNew (0, KS_END);
+	KeySet * removed = ksNew (0, KS_END);
+	int ret = changed && removed ? 1 : -1;
 
-	if (elektraGlobalGet (handle, cache, cacheParent, PREGETCACHE, MAXONCE) != ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	for (size_t i = 0; ret == 1 && i < ks->size; ++i)
 	{
-		ELEKTRA_LOG_DEBUG ("CACHE MISS: could not fetch cache");
-		elektraCacheCutMeta (handle);
-		return;
+		Key * key = ks->array[i];
+		if (!elektraSnapshotTakeWritten (filter, key)) continue;
+
+		ssize_t pos = ksSearchInternal (merged, key);
+		if (pos >= 0 && !(keyCompare (merged->array[pos], key) & (KEY_VALUE | KEY_META))) continue;
+
+		if (ksSearchInternal (touched, key) >= 0)
+			ret = 0;
+		else if (ksAppendKey (changed, key) == -1)
+			ret = -1;
 	}
-	ELEKTRA_ASSERT (elektraStrCmp (keyName (initialParent), keyName (parentKey)) == 0, "parentKey name differs from initial");
-	if (elektraCacheCheckParent (handle->global, cacheParent, parentKey) != 0)
+
+	for (size_t i = 0; ret == 1 && i < merged->size; ++i)
 	{
-		// parentKey in cache does not match, needs rebuild
-		ELEKTRA_LOG_DEBUG ("CACHE WRONG PARENTKEY");
-		elektraCacheCutMeta (handle);
-		return;
+		Key * key = merged->array[i];
+		if (!elektraSnapshotTakeWritten (filter, key) || ksSearchInternal (ks, key) >= 0) continue;
+
+		if (ksSearchInternal (touched, key) >= 0)
+			ret = 0;
+		else if (ksAppendKey (removed, key) == -1)
+			ret = -1;
+	}
+
+	if (ret == 0)
+	{
+		ELEKTRA_SET_CONFLICTING_STATE_ERROR (parentKey,
+						     "Another thread of the handle changed the same keys in the same group commit. Please "
+						     "retrieve the configuration again");
+	}
+
+	for (size_t i = 0; ret == 1 && i < changed->size; ++i)
+	{
+		if (ksAppendKey (combined, changed->array[i]) == -1 || ksAppendKey (touched, changed->array[i]) == -1) ret = -1;
+	}
+	for (size_t i = 0; ret == 1 && i < removed->size; ++i)
+	{
+		keyDel (ksLookup (combined, removed->array[i], KDB_O_POP));
+		if (ksAppendKey (touched, removed->array[i]) == -1) ret = -1;
 	}
+
+	ksDel (changed);
+	ksDel (removed);
+	return ret;
 }
 
-#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
 /**
- * @brief Deletes the OPMPHM.
+ * @internal
  *
- * Clears and frees all memory in Opmphm.
+ * @brief Commits the calls from @p first to @p end, which have the same parent key, with a single kdbSet().
  *
- * @param opmphm the OPMPHM
+ * Every call only contributes the keys it changed, see elektraSnapshotsApply(), so
+ * calls changing different keys do not overwrite each other. A call, which is stale
+ * or changes keys a call before it already changed, gets a conflict. Every file is
+ * only written once. If the common kdbSet() fails, the calls are committed one after
+ * the other, so that every call gets its own conflict or error.
+ *
+ * Afterwards a KeySet only moves to the new epoch if its call was the only one
+ * applied, otherwise it lacks the changes of the other calls.
+ *
+ * `writer` must be held.
  */
-static void cacheOpmphmDel (Opmphm * opmphm)
+static void elektraSnapshotsCommitGroup (KDB * handle, ElektraGroupCommit * first, ElektraGroupCommit * end)
 {
-	ELEKTRA_NOT_NULL (opmphm);
-	if (opmphm && opmphm->size && !test_bit (opmphm->flags, OPMPHM_FLAG_MMAP_GRAPH))
+	struct _ElektraSnapshots * snapshots = handle->snapshots;
+	ElektraGroupCommit * call;
+
+	// all calls have the same parent key, so they write the same backends
+	ElektraSnapshotFilter filter;
+	elektraSnapshotWrittenFilter (handle, first->parentKey, &filter);
+
+	// the keys of the calls are shared, the callers wait until the commit is done
+	KeySet * combined = ksDup (snapshots->merged);
+	KeySet * touched = ksNew (0, KS_END);
+	Key * groupKey = keyNew (keyName (first->parentKey), KEY_END);
+	int ret = combined && touched && groupKey ? 0 : -1;
+	size_t applied = 0;
+	for (call = first; ret == 0 && call != end; call = call->next)
 	{
-		elektraFree (opmphm->graph);
+		int status = elektraSnapshotsApply (handle, &filter, combined, touched, call->ks, call->parentKey);
+		if (status == -1) ret = -1;
+		if (status == 0) call->ret = -1;
+		call->applied = status == 1;
+		applied += call->applied;
 	}
-	if (opmphm->rUniPar && !test_bit (opmphm->flags, OPMPHM_FLAG_MMAP_HASHFUNCTIONSEEDS))
+	if (ret == 0 && applied > 0)
 	{
-		elektraFree (opmphm->hashFunctionSeeds);
+		ret = elektraKdbSet (handle, combined, groupKey);
 	}
-	if (!test_bit (opmphm->flags, OPMPHM_FLAG_MMAP_STRUCT)) elektraFree (opmphm);
+
+	if (ret == -1)
+	{
+		for (call = first; call != end; call = call->next)
+		{
+			if (call->applied || call->ret == 0)
+			{
+				call->ret = elektraSnapshotsCommit (handle, call->ks, call->parentKey);
+			}
+		}
+	}
+	else if (applied > 0)
+	{
+		Key ** parentKeys = elektraMalloc (applied * sizeof (Key *));
+		size_t size = 0;
+		KeySet * single = 0;
+		int current = 0;
+		for (call = first; call != end; call = call->next)
+		{
+			if (!call->applied) continue;
+
+			call->ret = ret;
+			elektraCopyErrorAndWarnings (call->parentKey, groupKey);
+			if (parentKeys) parentKeys[size++] = call->parentKey;
+			if (applied == 1)
+			{
+				single = call->ks;
+				current = !elektraSnapshotChangedSince (snapshots->published, &filter, 0, single->snapshotEpoch);
+			}
+		}
+
+		if (ret == 1)
+		{
+			int merged = elektraSnapshotReplace (snapshots->merged, combined, elektraSnapshotTakeWritten, &filter);
+			elektraSnapshotsRepublish (handle, merged, parentKeys, size);
+			if (single && current) single->snapshotEpoch = snapshots->epoch;
+		}
+		elektraFree (parentKeys);
+	}
+
+	keyDel (groupKey);
+	ksDel (touched);
+	ksDel (combined);
 }
 
 /**
- * @brief Deletes the OpmphmPredictor.
+ * @internal
  *
- * Clears and frees all memory in OpmphmPredictor.
+ * @brief Commits a batch of calls in order of their arrival.
  *
- * @param op the OpmphmPredictor
+ * Consecutive calls with the same parent key are committed together.
+ * `writer` must be held.
  */
-static void cacheOpmphmPredictorDel (OpmphmPredictor * op)
+static void elektraSnapshotsCommitBatch (KDB * handle, ElektraGroupCommit * batch)
 {
-	ELEKTRA_NOT_NULL (op);
-	if (!test_bit (op->flags, OPMPHM_PREDICTOR_FLAG_MMAP_PATTERNTABLE)) elektraFree (op->patternTable);
-	if (!test_bit (op->flags, OPMPHM_PREDICTOR_FLAG_MMAP_STRUCT)) elektraFree (op);
+	while (batch)
+	{
+		ElektraGroupCommit * end = batch->next;
+		while (end && !strcmp (keyName (end->parentKey), keyName (batch->parentKey)))
+		{
+			end = end->next;
+		}
+
+		if (end == batch->next)
+		{
+			batch->ret = elektraSnapshotsCommit (handle, batch->ks, batch->parentKey);
+		}
+		else
+		{
+			elektraSnapshotsCommitGroup (handle, batch, end);
+		}
+		batch = end;
+	}
 }
-#endif
 
-static int elektraCacheLoadSplit (KDB * handle, Split * split, KeySet * ks, KeySet ** cache, Key ** cacheParent, Key * parentKey,
-				  Key * initialParent, int debugGlobalPositions)
+/**
+ * @internal
+ *
+ * @brief kdbSet() for a handle in concurrent mode.
+ *
+ * Runs kdbSet() while `writer` is held, see elektraSnapshotsCommit(). Afterwards
+ * the written keys of @p ks replace the ones in the merged KeySet and a new
+ * snapshot is published.
+ *
+ * With group commit the call is queued. The first queued thread waits for
+ * the window and then commits all calls queued so far, see
+ * elektraSnapshotsCommitBatch(). All threads return once their call
+ * was committed.
+ */
+static int elektraSnapshotsSet (KDB * handle, KeySet * ks, Key * parentKey)
 {
-	ELEKTRA_LOG_DEBUG ("CACHE parentKey: %s, %s", keyName (*cacheParent), keyString (*cacheParent));
+	struct _ElektraSnapshots * snapshots = handle->snapshots;
 
-	if (splitCacheCheckState (split, handle->global) == -1)
+	if (snapshots->window == 0)
 	{
-		ELEKTRA_LOG_DEBUG ("FAIL, have to discard cache because split state / SIZE FAIL, or file mismatch");
-		elektraCacheCutMeta (handle);
-		return -1;
+		pthread_mutex_lock (&snapshots->writer);
+		int ret = elektraSnapshotsCommit (handle, ks, parentKey);
+		pthread_mutex_unlock (&snapshots->writer);
+		return ret;
 	}
 
-	ELEKTRA_LOG_DEBUG ("CACHE HIT");
-	if (splitCacheLoadState (split, handle->global) != 0) return -1;
+	ElektraGroupCommit call = { .ks = ks, .parentKey = parentKey };
 
-	if (debugGlobalPositions)
+	pthread_mutex_lock (&snapshots->group);
+	ElektraGroupCommit ** last = &snapshots->pending;
+	while (*last)
 	{
-		keySetName (parentKey, keyName (initialParent));
-		elektraGlobalGet (handle, *cache, parentKey, PREGETSTORAGE, INIT);
-		elektraGlobalGet (handle, *cache, parentKey, PREGETSTORAGE, MAXONCE);
-		elektraGlobalGet (handle, *cache, parentKey, PREGETSTORAGE, DEINIT);
+		last = &(*last)->next;
 	}
+	*last = &call;
 
-	keySetName (parentKey, keyName (initialParent));
-	// TODO: there are no error checks here, see kdbGet
-	elektraGlobalGet (handle, *cache, parentKey, PROCGETSTORAGE, INIT);
-	elektraGlobalGet (handle, *cache, parentKey, PROCGETSTORAGE, MAXONCE);
-	elektraGlobalGet (handle, *cache, parentKey, PROCGETSTORAGE, DEINIT);
-
-	// replace ks with cached keyset
-	ksRewind (*cache);
-	if (ks->size == 0)
-	{
-		ELEKTRA_LOG_DEBUG ("replacing keyset with cached keyset");
-#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
-		if (ks->opmphm) cacheOpmphmDel (ks->opmphm);
-		if (ks->opmphmPredictor) cacheOpmphmPredictorDel (ks->opmphmPredictor);
-#endif
-		ksClose (ks);
-		ks->array = (*cache)->array;
-		ks->size = (*cache)->size;
-		ks->alloc = (*cache)->alloc;
-		ks->flags = (*cache)->flags;
-#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
-		ks->opmphm = (*cache)->opmphm;
-		ks->opmphmPredictor = (*cache)->opmphmPredictor;
-#endif
-		elektraFree (*cache);
-		*cache = 0;
-	}
-	else
+	while (!call.done)
 	{
-		ELEKTRA_LOG_DEBUG ("appending cached keyset (ks was not empty)");
-		ksAppend (ks, *cache);
-		ksDel (*cache);
-		*cache = 0;
-	}
-	keyDel (*cacheParent);
-	*cacheParent = 0;
+		if (snapshots->leader)
+		{
+			pthread_cond_wait (&snapshots->committed, &snapshots->group);
+			continue;
+		}
 
-	if (debugGlobalPositions)
-	{
-		keySetName (parentKey, keyName (initialParent));
-		elektraGlobalGet (handle, ks, parentKey, POSTGETSTORAGE, INIT);
-		elektraGlobalGet (handle, ks, parentKey, POSTGETSTORAGE, MAXONCE);
-		elektraGlobalGet (handle, ks, parentKey, POSTGETSTORAGE, DEINIT);
+		// collect the calls of other threads arriving within the window
+		snapshots->leader = 1;
+		pthread_mutex_unlock (&snapshots->group);
+		struct timespec window = { .tv_sec = snapshots->window / 1000000, .tv_nsec = (snapshots->window % 1000000) * 1000 };
+		nanosleep (&window, 0);
+
+		pthread_mutex_lock (&snapshots->writer);
+		pthread_mutex_lock (&snapshots->group);
+		ElektraGroupCommit * batch = snapshots->pending;
+		snapshots->pending = 0;
+		pthread_mutex_unlock (&snapshots->group);
+
+		elektraSnapshotsCommitBatch (handle, batch);
+		pthread_mutex_unlock (&snapshots->writer);
+
+		pthread_mutex_lock (&snapshots->group);
+		while (batch)
+		{
+			// once done is set, the waiting thread may return and the call is gone
+			ElektraGroupCommit * next = batch->next;
+			batch->done = 1;
+			batch = next;
+		}
+		snapshots->leader = 0;
+		pthread_cond_broadcast (&snapshots->committed);
 	}
+	pthread_mutex_unlock (&snapshots->group);
 
-	return 0;
+	return call.ret;
 }
-
+#endif
 
 /**
  * @brief Retrieve keys in an atomic and universal way.
@@ -1023,6 +2347,23 @@ static int elektraCacheLoadSplit (KDB * handle, Split * split, KeySet * ks, KeyS
  */
 int kdbGet (KDB * handle, KeySet * ks, Key * parentKey)
 {
+#ifdef HAVE_PTHREAD
+	elektraNamespace ns = keyGetNamespace (parentKey);
+	if (handle && handle->snapshots && ks && ns != KEY_NS_NONE && ns != KEY_NS_META)
+	{
+		return elektraSnapshotsGet (handle, ks, parentKey);
+	}
+	return elektraKdbGet (handle, ks, parentKey);
+}
+
+/**
+ * @internal
+ *
+ * @brief kdbGet() for a handle used by a single thread.
+ */
+static int elektraKdbGet (KDB * handle, KeySet * ks, Key * parentKey)
+{
+#endif
 	elektraNamespace ns = keyGetNamespace (parentKey);
 	if (ns == KEY_NS_NONE)
 	{
@@ -1080,6 +2421,7 @@ int kdbGet (KDB * handle, KeySet * ks, Key * parentKey)
 	cache = ksNew (0, KS_END);
 	cacheParent = keyDup (mountGetMountpoint (handle, initialParent));
 	if (ns == KEY_NS_CASCADING) keySetMeta (cacheParent, "cascading", "");
+	keySetMeta (cacheParent, "cache/parent", keyName (initialParent));
 	if (handle->globalPlugins[PREGETCACHE][MAXONCE])
 	{
 		elektraCacheLoad (handle, cache, parentKey, initialParent, cacheParent);
@@ -1234,7 +2576,7 @@ cachemiss:
 		   but not for bypassed keys in split->size-1 */
 		clearError (parentKey);
 		// do everything up to position get_storage
-		if (elektraGetDoUpdate (split, parentKey) == -1)
+		if (elektraGetDoUpdate (handle, split, parentKey) == -1)
 		{
 			goto error;
 		}
@@ -1272,6 +2614,7 @@ cachemiss:
 	if (handle->globalPlugins[POSTGETCACHE][MAXONCE])
 	{
 		splitCacheStoreState (handle, split, handle->global, cacheParent, initialParent);
+		elektraCacheMarkConfidential (split, cacheParent);
 		KeySet * proc = elektraCutProc (ks); // remove proc keys before caching
 		if (elektraGlobalSet (handle, ks, cacheParent, POSTGETCACHE, MAXONCE) != ELEKTRA_PLUGIN_STATUS_SUCCESS)
 		{
@@ -1321,6 +2664,57 @@ error:
 	return -1;
 }
 
+/**
+ * @internal
+ * @brief Calls the storage plugin of a backend with setDelta.
+ *
+ * If the backend knows what is in storage, only the keys that
+ * were added, changed or removed since then are passed to
+ * setDelta, otherwise the storage plugin writes all keys with
+ * kdbSet as usual. What is in storage afterwards is kept in the
+ * split until the commit succeeded, see splitUpdateState().
+ *
+ * @param split all information for iteration
+ * @param i the index of the backend in @p split
+ * @param parentKey the parent key for the storage plugin
+ *
+ * @return the return value of the storage plugin
+ */
+static int elektraSetStorage (Split * split, size_t i, Key * parentKey)
+{
+	Backend * backend = split->handles[i];
+	Plugin * storage = backend->setplugins[STORAGE_PLUGIN];
+	KeySet * added = ksNew (0, KS_END);
+	KeySet * changed = ksNew (0, KS_END);
+	KeySet * removed = ksNew (0, KS_END);
+
+	int ret;
+	KeySet * state = backendDelta (backend, split->parents[i], split->keysets[i], added, changed, removed);
+	if (state)
+	{
+		ELEKTRA_LOG_DEBUG ("setDelta %s: %zd added, %zd changed, %zd removed", keyName (parentKey), ksGetSize (added),
+				   ksGetSize (changed), ksGetSize (removed));
+		ret = backend->setDelta (storage, split->keysets[i], added, changed, removed, parentKey);
+	}
+	else
+	{
+		ret = storage->kdbSet (storage, split->keysets[i], parentKey);
+		if (ret != -1) state = backendStateNew (split->keysets[i]);
+	}
+
+	ksDel (added);
+	ksDel (changed);
+	ksDel (removed);
+
+	ksDel (split->states[i]);
+	split->states[i] = 0;
+	if (ret == -1)
+		ksDel (state);
+	else
+		split->states[i] = state;
+	return ret;
+}
+
 /**
  * @internal
  * @brief Does all set steps but not commit
@@ -1354,7 +2748,14 @@ static int elektraSetPrepare (Split * split, Key * parentKey, Key ** errorKey, P
 					keySetString (parentKey, "");
 				}
 				keySetName (parentKey, keyName (split->parents[i]));
-				ret = backend->setplugins[p]->kdbSet (backend->setplugins[p], split->keysets[i], parentKey);
+				if (p == STORAGE_PLUGIN && backend->delta == 1)
+				{
+					ret = elektraSetStorage (split, i, parentKey);
+				}
+				else
+				{
+					ret = backend->setplugins[p]->kdbSet (backend->setplugins[p], split->keysets[i], parentKey);
+				}
 
 #if VERBOSE && DEBUG
 				printf ("Prepare %s with keys %zd in plugin: %zu, split: %zu, ret: %d\n", keyName (parentKey),
@@ -1369,6 +2770,12 @@ static int elektraSetPrepare (Split * split, Key * parentKey, Key ** errorKey, P
 						// not needed, so we
 						// skip other pre-commit
 						// plugins
+						if (backend->delta == 1)
+						{
+							// the file will be removed on commit
+							ksDel (split->states[i]);
+							split->states[i] = ksNew (0, KS_END);
+						}
 						break;
 					}
 					keySetString (split->parents[i], keyString (parentKey));
@@ -1565,6 +2972,23 @@ static void elektraSetRollback (Split * split, Key * parentKey)
  */
 int kdbSet (KDB * handle, KeySet * ks, Key * parentKey)
 {
+#ifdef HAVE_PTHREAD
+	elektraNamespace ns = keyGetNamespace (parentKey);
+	if (handle && handle->snapshots && ks && ns != KEY_NS_NONE && ns != KEY_NS_META)
+	{
+		return elektraSnapshotsSet (handle, ks, parentKey);
+	}
+	return elektraKdbSet (handle, ks, parentKey);
+}
+
+/**
+ * @internal
+ *
+ * @brief kdbSet() for a handle used by a single thread.
+ */
+static int elektraKdbSet (KDB * handle, KeySet * ks, Key * parentKey)
+{
+#endif
 	elektraNamespace ns = keyGetNamespace (parentKey);
 	if (ns == KEY_NS_NONE)
 	{
@@ -1688,6 +3112,7 @@ int kdbSet (KDB * handle, KeySet * ks, Key * parentKey)
 	elektraGlobalSet (handle, ks, parentKey, COMMIT, DEINIT);
 
 	splitUpdateSize (split);
+	splitUpdateState (split);
 
 	keySetName (parentKey, keyName (initialParent));
 
@@ -2037,6 +3462,31 @@ static int ensurePluginState (KDB * handle ELEKTRA_UNUSED, const char * mountpoi
  * - Keys below `system/elektra/ensure/plugins/<mountpoint>/<pluginname>/config` are extracted and used
  *   as the plugins config KeySet during mounting. `system/elektra/ensure/plugins/<mountpoint>/<pluginname>`
  *   will be replaced by `user` in the keynames. If no keys are given, an empty KeySet is used.
+ * - `system/elektra/ensure/get/parallel` sets the number of threads kdbGet() may use to load backends.
+ *   Only backends, where all plugins after the resolver have `threadsafe` in `infos/status`,
+ *   are loaded concurrently, all other backends are loaded by the calling thread.
+ *   Errors and warnings are reported as if the backends were loaded one after the other.
+ *   `0` and `1` (the default) disable parallel loading. If Elektra was built without
+ *   thread support, values greater than `1` are unmet clauses.
+ * - `system/elektra/ensure/get/concurrent` with the value `1` allows several threads to use
+ *   the handle at the same time. Plugins still only run in one thread at a time, but kdbGet()
+ *   copies keys already retrieved from an immutable snapshot of the configuration instead of
+ *   waiting if another thread currently runs the plugins. kdbSet() publishes the written keys
+ *   to the other threads and fails with a conflict, if another thread changed a backend it
+ *   would write since the keys were retrieved. Keys returned for a parent key are replaced as a whole, so kdbGet()
+ *   always returns `1` in this mode. `0` (the default) disables the concurrent mode again,
+ *   which must only be done while no other thread uses the handle. If Elektra was built without
+ *   thread support, `1` is an unmet clause.
+ * - `system/elektra/ensure/set/group` sets a window in microseconds for group commit. A value greater
+ *   than `0` enables the concurrent mode and makes kdbSet() wait for the window, so that calls of
+ *   other threads arriving within it are written together. Consecutive calls with the same parent key
+ *   write every file only once, other calls are still written one after the other. Calls written
+ *   together only contribute the keys they changed, a call changing keys an earlier call of the window
+ *   already changed gets a conflict. Every call
+ *   returns its own result, if writing the calls together fails, they are written one after the other
+ *   to find out which ones conflict. `0` (the default) disables group commit, but keeps the
+ *   concurrent mode. The window must only be changed while no other thread calls kdbSet().
+ *   If Elektra was built without thread support, values greater than `0` are unmet clauses.
  *
  * There are a few special values for `<mountpoint>`:
  * - `global` is used to indicate the plugin should (un)mounted as a global plugin.
@@ -2075,6 +3525,111 @@ int kdbEnsure (KDB * handle, KeySet * contract, Key * parentKey)
 		return -1;
 	}
 
+	Key * parallelClause = ksLookupByName (contract, "system/elektra/ensure/get/parallel", 0);
+	if (parallelClause != NULL)
+	{
+		const char * value = keyString (parallelClause);
+		char * end = NULL;
+		int errnosave = errno;
+		errno = 0;
+		unsigned long threads = strtoul (value, &end, 10);
+		if (!isdigit ((unsigned char) value[0]) || *end != '\0' || errno != 0)
+		{
+			ELEKTRA_SET_INTERFACE_ERRORF (parentKey, "The key '%s' contained the value '%s', but only a number of threads may be used",
+						      keyName (parallelClause), value);
+			errno = errnosave;
+			ksDel (contract);
+			return -1;
+		}
+		errno = errnosave;
+#ifndef HAVE_PTHREAD
+		if (threads > 1)
+		{
+			ksDel (contract);
+			return 1;
+		}
+#endif
+		handle->getThreads = threads;
+	}
+
+	Key * concurrentClause = ksLookupByName (contract, "system/elektra/ensure/get/concurrent", 0);
+	if (concurrentClause != NULL)
+	{
+		const char * value = keyString (concurrentClause);
+		if (strcmp (value, "0") != 0 && strcmp (value, "1") != 0)
+		{
+			ELEKTRA_SET_INTERFACE_ERRORF (parentKey, "The key '%s' contained the value '%s', but only '0' or '1' may be used",
+						      keyName (concurrentClause), value);
+			ksDel (contract);
+			return -1;
+		}
+#ifndef HAVE_PTHREAD
+		if (!strcmp (value, "1"))
+		{
+			ksDel (contract);
+			return 1;
+		}
+#else
+		if (!strcmp (value, "1") && !handle->snapshots)
+		{
+			handle->snapshots = elektraSnapshotsNew ();
+			if (!handle->snapshots)
+			{
+				ELEKTRA_SET_OUT_OF_MEMORY_ERROR (parentKey);
+				ksDel (contract);
+				return -1;
+			}
+		}
+		else if (!strcmp (value, "0"))
+		{
+			elektraSnapshotsDel (handle->snapshots);
+			handle->snapshots = 0;
+		}
+#endif
+	}
+
+	Key * groupClause = ksLookupByName (contract, "system/elektra/ensure/set/group", 0);
+	if (groupClause != NULL)
+	{
+		const char * value = keyString (groupClause);
+		char * end = NULL;
+		int errnosave = errno;
+		errno = 0;
+		unsigned long window = strtoul (value, &end, 10);
+		if (!isdigit ((unsigned char) value[0]) || *end != '\0' || errno != 0)
+		{
+			ELEKTRA_SET_INTERFACE_ERRORF (parentKey,
+						      "The key '%s' contained the value '%s', but only a window in microseconds may be used",
+						      keyName (groupClause), value);
+			errno = errnosave;
+			ksDel (contract);
+			return -1;
+		}
+		errno = errnosave;
+#ifndef HAVE_PTHREAD
+		if (window > 0)
+		{
+			ksDel (contract);
+			return 1;
+		}
+#else
+		if (window > 0 && !handle->snapshots)
+		{
+			handle->snapshots = elektraSnapshotsNew ();
+			if (!handle->snapshots)
+			{
+				ELEKTRA_SET_OUT_OF_MEMORY_ERROR (parentKey);
+				ksDel (contract);
+				return -1;
+			}
+		}
+		if (handle->snapshots)
+		{
+			handle->snapshots->window = window;
+		}
+#endif
+	}
+
 	Key * cutpoint = keyNew ("system/elektra/ensure/plugins", KEY_END);
 	KeySet * pluginsContract = ksCut (contract, cutpoint);
 
@@ -227,111 +227,127 @@ Key * keyVNew (const char * name, va_list va)
 	Key * key = elektraCalloc (sizeof (Key));
 
 	keyInit (key);
-	if (name)
+	if (name) elektraKeyVInit (key, name, va);
+	return key;
+}
+
+/**
+ * @internal
+ *
+ * @brief Sets name and all properties given by keyNew() arguments on
+ * an already initialized key.
+ *
+ * Shared by keyVNew() and ksArenaKeyVNew(), which only differ in where the
+ * key struct is allocated.
+ *
+ * @pre caller must use va_start and va_end on va
+ * @param key the freshly initialized key
+ * @param name the name of the key, see keyNew()
+ * @param va the variadic argument list
+ */
+void elektraKeyVInit (Key * key, const char * name, va_list va)
+{
+	keyswitch_t action = 0;
+	size_t value_size = 0;
+	void * value = 0;
+	void (*func) (void) = 0;
+	int flags = 0;
+	char * owner = 0;
+	int mode = 0;
+	int hasMode = 0;
+
+	while ((action = va_arg (va, keyswitch_t)))
 	{
-		keyswitch_t action = 0;
-		size_t value_size = 0;
-		void * value = 0;
-		void (*func) (void) = 0;
-		int flags = 0;
-		char * owner = 0;
-		int mode = 0;
-		int hasMode = 0;
-
-		while ((action = va_arg (va, keyswitch_t)))
+		switch (action)
 		{
-			switch (action)
-			{
-			/* flags with an argument */
-			case KEY_SIZE:
-				value_size = va_arg (va, size_t);
-				break;
-			case KEY_VALUE:
-				value = va_arg (va, void *);
-				if (value_size && keyIsBinary (key))
-					keySetBinary (key, value, value_size);
-				else if (keyIsBinary (key))
-					keySetBinary (key, value, elektraStrLen (value));
-				else
-					keySetString (key, value);
-				break;
-			case KEY_FUNC:
-				func = va_arg (va, void (*) (void));
-				keySetBinary (key, &func, sizeof (func));
-				break;
-			case KEY_META:
-				value = va_arg (va, char *);
-				/* First parameter is name */
-				keySetMeta (key, value, va_arg (va, char *));
-				break;
-
-			/* flags without an argument */
-			case KEY_FLAGS:
-				flags |= va_arg (va, int); // FALLTHROUGH
-			case KEY_BINARY:
-			case KEY_LOCK_NAME:
-			case KEY_LOCK_VALUE:
-			case KEY_LOCK_META:
-			case KEY_CASCADING_NAME:
-			case KEY_META_NAME:
-			case KEY_EMPTY_NAME:
-				if (action != KEY_FLAGS) flags |= action;
-				if (test_bit (flags, KEY_BINARY)) keySetMeta (key, "binary", "");
-				break;
-
-			/* deprecated flags */
-			case KEY_NAME:
-				name = va_arg (va, char *);
-				break;
-			case KEY_OWNER:
-				owner = va_arg (va, char *);
-				break;
-			case KEY_COMMENT:
-				keySetMeta (key, "comment", va_arg (va, char *));
-				break;
-			case KEY_UID:
-				elektraSetMetaInt (key, "uid", va_arg (va, int));
-				break;
-			case KEY_GID:
-				elektraSetMetaInt (key, "gid", va_arg (va, int));
-				break;
-			case KEY_DIR:
-				mode |= KDB_DIR_MODE;
-				break;
-			case KEY_MODE:
-				hasMode = 1;
-				mode |= va_arg (va, int);
-				break;
-			case KEY_ATIME:
-				elektraSetMetaInt (key, "atime", va_arg (va, time_t));
-				break;
-			case KEY_MTIME:
-				elektraSetMetaInt (key, "mtime", va_arg (va, time_t));
-				break;
-			case KEY_CTIME:
-				elektraSetMetaInt (key, "ctime", va_arg (va, time_t));
-				break;
-
-			default:
-				ELEKTRA_ASSERT (0, "Unknown option " ELEKTRA_UNSIGNED_LONG_LONG_F " in keyNew",
-						(kdb_unsigned_long_long_t) action);
-				break;
-			}
+		/* flags with an argument */
+		case KEY_SIZE:
+			value_size = va_arg (va, size_t);
+			break;
+		case KEY_VALUE:
+			value = va_arg (va, void *);
+			if (value_size && keyIsBinary (key))
+				keySetBinary (key, value, value_size);
+			else if (keyIsBinary (key))
+				keySetBinary (key, value, elektraStrLen (value));
+			else
+				keySetString (key, value);
+			break;
+		case KEY_FUNC:
+			func = va_arg (va, void (*) (void));
+			keySetBinary (key, &func, sizeof (func));
+			break;
+		case KEY_META:
+			value = va_arg (va, char *);
+			/* First parameter is name */
+			keySetMeta (key, value, va_arg (va, char *));
+			break;
+
+		/* flags without an argument */
+		case KEY_FLAGS:
+			flags |= va_arg (va, int); // FALLTHROUGH
+		case KEY_BINARY:
+		case KEY_LOCK_NAME:
+		case KEY_LOCK_VALUE:
+		case KEY_LOCK_META:
+		case KEY_CASCADING_NAME:
+		case KEY_META_NAME:
+		case KEY_EMPTY_NAME:
+			if (action != KEY_FLAGS) flags |= action;
+			if (test_bit (flags, KEY_BINARY)) keySetMeta (key, "binary", "");
+			break;
+
+		/* deprecated flags */
+		case KEY_NAME:
+			name = va_arg (va, char *);
+			break;
+		case KEY_OWNER:
+			owner = va_arg (va, char *);
+			break;
+		case KEY_COMMENT:
+			keySetMeta (key, "comment", va_arg (va, char *));
+			break;
+		case KEY_UID:
+			elektraSetMetaInt (key, "uid", va_arg (va, int));
+			break;
+		case KEY_GID:
+			elektraSetMetaInt (key, "gid", va_arg (va, int));
+			break;
+		case KEY_DIR:
+			mode |= KDB_DIR_MODE;
+			break;
+		case KEY_MODE:
+			hasMode = 1;
+			mode |= va_arg (va, int);
+			break;
+		case KEY_ATIME:
+			elektraSetMetaInt (key, "atime", va_arg (va, time_t));
+			break;
+		case KEY_MTIME:
+			elektraSetMetaInt (key, "mtime", va_arg (va, time_t));
+			break;
+		case KEY_CTIME:
+			elektraSetMetaInt (key, "ctime", va_arg (va, time_t));
+			break;
+
+		default:
+			ELEKTRA_ASSERT (0, "Unknown option " ELEKTRA_UNSIGNED_LONG_LONG_F " in keyNew",
+					(kdb_unsigned_long_long_t) action);
+			break;
 		}
+	}
 
-		option_t name_options = flags & (KEY_CASCADING_NAME | KEY_META_NAME | KEY_EMPTY_NAME);
-		elektraKeySetName (key, name, name_options);
+	option_t name_options = flags & (KEY_CASCADING_NAME | KEY_META_NAME | KEY_EMPTY_NAME);
+	elektraArenaKeySetName (key, name, name_options);
 
-		if (!hasMode && mode == KDB_DIR_MODE)
-			elektraSetMode (key, KDB_FILE_MODE | KDB_DIR_MODE);
-		else if (mode != 0)
-			elektraSetMode (key, mode);
+	if (!hasMode && mode == KDB_DIR_MODE)
+		elektraSetMode (key, KDB_FILE_MODE | KDB_DIR_MODE);
+	else if (mode != 0)
+		elektraSetMode (key, mode);
 
-		if (owner) keySetOwner (key, owner);
+	if (owner) keySetOwner (key, owner);
 
-		(void) keyLock (key, flags);
-	}
-	return key;
+	(void) keyLock (key, flags);
 }
 
 /**
@@ -409,6 +425,85 @@ Key * keyDup (const Key * source)
 	return dest;
 }
 
+/**
+ * @internal
+ *
+ * @brief Makes the fresh key @p dest a copy-on-write duplicate of @p source.
+ *
+ * @p dest shares the name and the value of @p source. They are marked like
+ * the ones in a mapped region (#KEY_FLAG_MMAP_KEY, #KEY_FLAG_MMAP_DATA), so
+ * @p dest copies them as soon as they are changed. The metadata is shared
+ * with elektraMetaShare(). As for ksDeepDup() the sync flag is taken from
+ * @p source.
+ *
+ * @p source must neither be changed nor deleted while @p dest shares its
+ * name or value, see elektraKeyUnshare().
+ *
+ * @param dest a key without name, value and metadata, e.g. from ksArenaKeyNew()
+ * @param source the key to duplicate
+ *
+ * @retval 0 on success
+ * @retval -1 on NULL pointers or memory error
+ */
+int elektraKeyShare (Key * dest, const Key * source)
+{
+	if (!dest || !source) return -1;
+	ELEKTRA_ASSERT (!dest->key && !dest->data.v && !dest->meta, "the key to share into is not empty");
+
+	if (source->meta)
+	{
+		dest->meta = elektraMetaShare (source->meta);
+		if (!dest->meta) return -1;
+	}
+
+	dest->key = source->key;
+	dest->keySize = source->keySize;
+	dest->keyUSize = source->keyUSize;
+	dest->namePrefix = source->namePrefix;
+	if (dest->key) set_bit (dest->flags, KEY_FLAG_MMAP_KEY);
+
+	dest->data.v = source->data.v;
+	dest->dataSize = source->dataSize;
+	if (dest->data.v) set_bit (dest->flags, KEY_FLAG_MMAP_DATA);
+
+	if (test_bit (source->flags, KEY_FLAG_SYNC)) set_bit (dest->flags, KEY_FLAG_SYNC);
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Gives @p key its own copy of the name and value it still shares with @p source.
+ *
+ * Must be called before @p source gets changed or deleted if @p key,
+ * a duplicate created by elektraKeyShare(), is still used.
+ *
+ * @retval 0 on success (also if nothing was shared anymore)
+ * @retval -1 on memory error
+ */
+int elektraKeyUnshare (Key * key, const Key * source)
+{
+	if (test_bit (key->flags, KEY_FLAG_MMAP_KEY) && key->key == source->key)
+	{
+		char * name = elektraMalloc (key->keySize + key->keyUSize);
+		if (!name) return -1;
+		memcpy (name, key->key, key->keySize + key->keyUSize);
+		key->key = name;
+		clear_bit (key->flags, (keyflag_t) KEY_FLAG_MMAP_KEY);
+	}
+
+	if (test_bit (key->flags, KEY_FLAG_MMAP_DATA) && key->data.v == source->data.v)
+	{
+		void * value = elektraMalloc (key->dataSize);
+		if (!value) return -1;
+		memcpy (value, key->data.v, key->dataSize);
+		key->data.v = value;
+		clear_bit (key->flags, (keyflag_t) KEY_FLAG_MMAP_DATA);
+	}
+
+	return 0;
+}
+
 
 /**
  * Copy or Clear a key.
@@ -503,7 +598,8 @@ int keyCopy (Key * dest, const Key * source)
 
 	if (source->meta)
 	{
-		dest->meta = ksDup (source->meta);
+		// metadata is shared until one of the keys modifies it
+		dest->meta = elektraMetaShare (source->meta);
 		if (!dest->meta) goto memerror;
 	}
 	else
@@ -517,19 +613,21 @@ int keyCopy (Key * dest, const Key * source)
 	// copy sizes accordingly
 	dest->keySize = source->keySize;
 	dest->keyUSize = source->keyUSize;
+	dest->namePrefix = source->namePrefix;
 	dest->dataSize = source->dataSize;
 
 	// free old resources of destination
 	if (!test_bit (dest->flags, KEY_FLAG_MMAP_KEY)) elektraFree (destKey);
 	if (!test_bit (dest->flags, KEY_FLAG_MMAP_DATA)) elektraFree (destData);
-	ksDel (destMeta);
+	clear_bit (dest->flags, (keyflag_t) KEY_FLAG_MMAP_KEY | KEY_FLAG_MMAP_DATA);
+	elektraMetaRelease (destMeta);
 
 	return 1;
 
 memerror:
-	elektraFree (dest->key);
-	elektraFree (dest->data.v);
-	ksDel (dest->meta);
+	if (dest->key != destKey) elektraFree (dest->key);
+	if (dest->data.v != destData) elektraFree (dest->data.v);
+	if (dest->meta != destMeta) elektraMetaRelease (dest->meta);
 
 	dest->key = destKey;
 	dest->data.v = destData;
@@ -577,12 +675,16 @@ int keyDel (Key * key)
 	}
 
 	int keyInMmap = test_bit (key->flags, KEY_FLAG_MMAP_STRUCT);
+	ElektraArena * arena = elektraKeyGetArena (key);
 
 	rc = keyClear (key);
 
-	ksDel (key->meta);
-
-	if (!keyInMmap)
+	if (arena)
+	{
+		// the key struct lives in the arena, just give back our reference
+		elektraArenaDecRef (arena);
+	}
+	else if (!keyInMmap)
 	{
 		elektraFree (key);
 	}
@@ -631,15 +733,18 @@ int keyClear (Key * key)
 	ref = key->ksReference;
 
 	int keyStructInMmap = test_bit (key->flags, KEY_FLAG_MMAP_STRUCT);
+	int keyStructInArena = test_bit (key->flags, KEY_FLAG_ARENA);
 
 	if (key->key && !test_bit (key->flags, KEY_FLAG_MMAP_KEY)) elektraFree (key->key);
 	if (key->data.v && !test_bit (key->flags, KEY_FLAG_MMAP_DATA)) elektraFree (key->data.v);
+	if (test_bit (key->flags, KEY_FLAG_INTERNED)) elektraMetaInternRelease (key);
 
-	ksDel (key->meta);
+	elektraMetaRelease (key->meta);
 
 	keyInit (key);
 
 	if (keyStructInMmap) key->flags |= KEY_FLAG_MMAP_STRUCT;
+	if (keyStructInArena) key->flags |= KEY_FLAG_ARENA;
 
 	/* Set reference properties */
 	key->ksReference = ref;
@@ -793,7 +898,8 @@ int keyLock (Key * key, option_t what)
 	what &= (KEY_LOCK_NAME | KEY_LOCK_VALUE | KEY_LOCK_META);
 	what >>= 16; // to KEY_FLAG_RO_xyz
 	int ret = test_bit (~key->flags, what);
-	set_bit (key->flags, what);
+	// do not write to keys which are already locked, e.g. shared metakeys
+	if (ret) set_bit (key->flags, what);
 	return (ret << 16);
 }
 
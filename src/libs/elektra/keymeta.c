@@ -119,10 +119,398 @@
 #include <stdlib.h>
 #endif
 
+#include <stddef.h>
+
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+
+/* Buckets of the intern table, must be a power of two */
+#define ELEKTRA_META_INTERN_SLOTS 4096
+/* Maximum number of interned name/value pairs, keeps the chains short */
+#define ELEKTRA_META_INTERN_MAX (ELEKTRA_META_INTERN_SLOTS * 4)
+/* Longer values are rarely shared (e.g. comments) and are not interned */
+#define ELEKTRA_META_INTERN_MAX_VALUE 128
+
+/**
+ * @internal
+ *
+ * A name/value pair of the intern table. Metakeys flagged with
+ * #KEY_FLAG_INTERNED point into `data`: the name (escaped and
+ * unescaped) directly followed by the value.
+ */
+typedef struct _ElektraMetaInterned
+{
+	struct _ElektraMetaInterned * next; /*!< Next entry in the same bucket */
+	size_t hash;			    /*!< Hash of name and value */
+	size_t refs;			    /*!< Number of metakeys using the entry */
+	size_t keySize;			    /*!< Size of the escaped name, see struct _Key */
+	size_t keyUSize;		    /*!< Size of the unescaped name, see struct _Key */
+	size_t dataSize;		    /*!< Size of the value */
+	char data[];
+} ElektraMetaInterned;
+
+#define ELEKTRA_META_INTERNED(metaKey) ((ElektraMetaInterned *) ((metaKey)->key - offsetof (ElektraMetaInterned, data)))
+
+#ifdef __GNUC__
+static ElektraMetaInterned ** elektraMetaInternTable;
+static size_t elektraMetaInternCount;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t elektraMetaInternMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void elektraMetaInternLockTable (void)
+{
+	pthread_mutex_lock (&elektraMetaInternMutex);
+}
+
+static void elektraMetaInternUnlockTable (void)
+{
+	pthread_mutex_unlock (&elektraMetaInternMutex);
+}
+#else
+static void elektraMetaInternLockTable (void)
+{
+}
+
+static void elektraMetaInternUnlockTable (void)
+{
+}
+#endif
+
+static size_t elektraMetaInternHash (const char * data, size_t size, size_t hash)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= (unsigned char) data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * @internal
+ *
+ * @brief Lets the metakey @p key use the interned name and value.
+ *
+ * Metadata with the same name and value is very common (e.g. type,
+ * order or the metadata of spec). The process-wide intern table stores
+ * every such pair once, the metakeys themselves stay separate keys.
+ * Name and value of @p key are flagged like mapped ones
+ * (#KEY_FLAG_MMAP_KEY, #KEY_FLAG_MMAP_DATA), so they are never freed
+ * or changed by the key functions. Instead keyClear() releases the entry,
+ * which is freed with the last metakey using it.
+ *
+ * To bound the memory, only short values are interned and the number
+ * of entries is limited.
+ *
+ * @param key a fresh metakey, which has a name but no value
+ * @param value the value of the metakey
+ * @param valueSize the size of value including the null terminator
+ *
+ * @retval 0 if @p key now uses the interned name and value
+ * @retval -1 if the pair cannot be interned, the caller must set the value itself
+ */
+static int elektraMetaIntern (Key * key, const char * value, size_t valueSize)
+{
+	if (valueSize > ELEKTRA_META_INTERN_MAX_VALUE) return -1;
+
+	size_t nameSize = key->keySize + key->keyUSize;
+	size_t hash = elektraMetaInternHash (key->key, key->keySize, 2166136261u);
+	hash = elektraMetaInternHash (value, valueSize, hash);
+
+	elektraMetaInternLockTable ();
+
+	ElektraMetaInterned * entry = 0;
+	if (!elektraMetaInternTable) elektraMetaInternTable = elektraCalloc (sizeof (ElektraMetaInterned *) * ELEKTRA_META_INTERN_SLOTS);
+	if (!elektraMetaInternTable) goto unlock;
+
+	ElektraMetaInterned ** bucket = &elektraMetaInternTable[hash & (ELEKTRA_META_INTERN_SLOTS - 1)];
+	for (entry = *bucket; entry; entry = entry->next)
+	{
+		if (entry->hash == hash && entry->keySize == key->keySize && entry->dataSize == valueSize &&
+		    !memcmp (entry->data, key->key, key->keySize) && !memcmp (entry->data + nameSize, value, valueSize))
+		{
+			++entry->refs;
+			goto unlock;
+		}
+	}
+
+	if (elektraMetaInternCount >= ELEKTRA_META_INTERN_MAX) goto unlock;
+
+	entry = elektraMalloc (sizeof (ElektraMetaInterned) + nameSize + valueSize);
+	if (!entry) goto unlock;
+
+	entry->hash = hash;
+	entry->refs = 1;
+	entry->keySize = key->keySize;
+	entry->keyUSize = key->keyUSize;
+	entry->dataSize = valueSize;
+	memcpy (entry->data, key->key, nameSize);
+	memcpy (entry->data + nameSize, value, valueSize);
+
+	entry->next = *bucket;
+	*bucket = entry;
+	++elektraMetaInternCount;
+
+unlock:
+	elektraMetaInternUnlockTable ();
+	if (!entry) return -1;
+
+	if (!test_bit (key->flags, KEY_FLAG_MMAP_KEY)) elektraFree (key->key);
+	key->key = entry->data;
+	key->data.c = entry->data + nameSize;
+	key->dataSize = valueSize;
+	set_bit (key->flags, KEY_FLAG_MMAP_KEY | KEY_FLAG_MMAP_DATA | KEY_FLAG_INTERNED);
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Releases the interned name and value of the metakey @p key.
+ *
+ * Called by keyClear() for keys flagged with #KEY_FLAG_INTERNED.
+ * The entry is removed from the table once no metakey uses it anymore.
+ */
+void elektraMetaInternRelease (Key * key)
+{
+	ElektraMetaInterned * entry = ELEKTRA_META_INTERNED (key);
+
+	elektraMetaInternLockTable ();
+
+	if (--entry->refs > 0)
+	{
+		elektraMetaInternUnlockTable ();
+		return;
+	}
+
+	ElektraMetaInterned ** cur = &elektraMetaInternTable[entry->hash & (ELEKTRA_META_INTERN_SLOTS - 1)];
+	while (*cur != entry)
+	{
+		cur = &(*cur)->next;
+	}
+	*cur = entry->next;
+	--elektraMetaInternCount;
+
+	elektraMetaInternUnlockTable ();
+	elektraFree (entry);
+}
+
+/**
+ * @internal
+ *
+ * @brief Duplicates the metakey @p meta, sharing interned name and value.
+ *
+ * Unlike keyDup(), name and value are not copied if they are interned.
+ * The duplicate is read-only like every metakey.
+ *
+ * @return the duplicate
+ * @retval 0 on memory error
+ */
+Key * elektraMetaKeyDup (const Key * meta)
+{
+	if (!test_bit (meta->flags, KEY_FLAG_INTERNED))
+	{
+		Key * dup = keyDup (meta);
+		if (!dup) return 0;
+		clear_bit (dup->flags, (keyflag_t) KEY_FLAG_SYNC);
+		set_bit (dup->flags, KEY_FLAG_RO_NAME | KEY_FLAG_RO_VALUE | KEY_FLAG_RO_META);
+		return dup;
+	}
+
+	Key * dup = keyNew (0, KEY_END);
+	if (!dup) return 0;
+
+	elektraMetaInternLockTable ();
+	++ELEKTRA_META_INTERNED (meta)->refs;
+	elektraMetaInternUnlockTable ();
+
+	dup->key = meta->key;
+	dup->keySize = meta->keySize;
+	dup->keyUSize = meta->keyUSize;
+	dup->namePrefix = meta->namePrefix;
+	dup->data.c = meta->data.c;
+	dup->dataSize = meta->dataSize;
+	dup->flags = KEY_FLAG_MMAP_KEY | KEY_FLAG_MMAP_DATA | KEY_FLAG_INTERNED | KEY_FLAG_RO_NAME | KEY_FLAG_RO_VALUE | KEY_FLAG_RO_META;
+	return dup;
+}
+
+/**
+ * @internal
+ *
+ * @brief Returns the number of interned name/value pairs.
+ */
+size_t elektraMetaInternSize (void)
+{
+	elektraMetaInternLockTable ();
+	size_t count = elektraMetaInternCount;
+	elektraMetaInternUnlockTable ();
+	return count;
+}
+#else
+static int elektraMetaIntern (Key * key ELEKTRA_UNUSED, const char * value ELEKTRA_UNUSED, size_t valueSize ELEKTRA_UNUSED)
+{
+	return -1;
+}
+
+void elektraMetaInternRelease (Key * key ELEKTRA_UNUSED)
+{
+}
+
+Key * elektraMetaKeyDup (const Key * meta)
+{
+	Key * dup = keyDup (meta);
+	if (!dup) return 0;
+	clear_bit (dup->flags, (keyflag_t) KEY_FLAG_SYNC);
+	set_bit (dup->flags, KEY_FLAG_RO_NAME | KEY_FLAG_RO_VALUE | KEY_FLAG_RO_META);
+	return dup;
+}
+
+size_t elektraMetaInternSize (void)
+{
+	return 0;
+}
+#endif
+
+/**
+ * @internal
+ *
+ * @brief Shares the metadata @p meta with an additional key.
+ *
+ * Shared metadata is copied by elektraKeyUnshareMeta() before it
+ * gets modified. Metadata inside a mapped region or an arena
+ * might go away with its region and is duplicated instead.
+ *
+ * The keys sharing @p meta may be used by different threads, so
+ * `metaShares` is only changed atomically.
+ *
+ * @param meta the metadata to share
+ *
+ * @return the KeySet to be used as metadata of the additional key
+ * @retval 0 on memory error
+ */
+KeySet * elektraMetaShare (KeySet * meta)
+{
+	if (test_bit (meta->flags, KS_FLAG_MMAP_STRUCT)) return ksDup (meta);
+
+	if (__atomic_load_n (&meta->metaShares, __ATOMIC_ACQUIRE) == 0)
+	{
+		// metakeys also used by other keys (keyCopyMeta()) must not be released by other threads
+		for (size_t i = 0; i < meta->size; ++i)
+		{
+			if (meta->array[i]->ksReference == 1) continue;
+
+			Key * dup = elektraMetaKeyDup (meta->array[i]);
+			if (!dup) return 0;
+			keyIncRef (dup);
+			keyDecRef (meta->array[i]);
+			meta->array[i] = dup;
+#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
+			// the index points to the names of the replaced metakeys
+			if (meta->index) elektraKsIndexClear (meta->index);
+#endif
+		}
+	}
+
+	__atomic_fetch_add (&meta->metaShares, 1, __ATOMIC_RELAXED);
+	return meta;
+}
+
+/**
+ * @internal
+ *
+ * @brief Returns the metakey @p meta of @p source to be added to the metadata of another key.
+ *
+ * Metakeys of shared metadata are duplicated, so that only the metadata
+ * of @p source changes their reference counter.
+ *
+ * @return @p meta or its duplicate
+ * @retval 0 on memory error
+ */
+static Key * elektraMetaKeyForCopy (const Key * source, Key * meta)
+{
+	if (__atomic_load_n (&source->meta->metaShares, __ATOMIC_ACQUIRE) == 0) return meta;
+	return elektraMetaKeyDup (meta);
+}
+
+/**
+ * @internal
+ *
+ * @brief Releases the reference of a key to its metadata.
+ *
+ * The metadata is deleted when no other key shares it. Metakeys of
+ * shared metadata are not used by any other KeySet, so only the key
+ * releasing the last share changes their reference counters.
+ *
+ * @param meta the metadata to release, may be 0
+ */
+void elektraMetaRelease (KeySet * meta)
+{
+	if (!meta) return;
+
+	// the key releasing the last share deletes the metadata
+	if (__atomic_fetch_sub (&meta->metaShares, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+	ksDel (meta);
+}
+
+/**
+ * @internal
+ *
+ * @brief Gives @p key its own copy of its metadata.
+ *
+ * Must be called before the metadata of a key gets modified.
+ * Reading, including keyNextMeta(), works on shared metadata.
+ *
+ * @param key the key whose metadata will be modified
+ *
+ * @retval 0 on success (also if the metadata was not shared)
+ * @retval -1 on memory error
+ */
+int elektraKeyUnshareMeta (Key * key)
+{
+	if (!key->meta || __atomic_load_n (&key->meta->metaShares, __ATOMIC_ACQUIRE) == 0) return 0;
+
+	// other threads may use the shared metakeys, so their reference counters must not change
+	KeySet * copy = ksNew (key->meta->size, KS_END);
+	if (!copy) return -1;
+	for (size_t i = 0; i < key->meta->size; ++i)
+	{
+		Key * dup = elektraMetaKeyDup (key->meta->array[i]);
+		if (!dup || ksAppendKey (copy, dup) == -1)
+		{
+			ksDel (copy);
+			return -1;
+		}
+	}
+
+	elektraMetaRelease (key->meta);
+	key->meta = copy;
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Takes over the cursor of the metadata of @p key after modifying it.
+ *
+ * Adding metadata moves the cursor to the new metakey, removing it
+ * rewinds the cursor. keyNextMeta() continues from there, as it did
+ * before the metadata was shared.
+ *
+ * @param key the key whose own metadata was modified
+ */
+static void elektraKeyTakeMetaCursor (Key * key)
+{
+	key->metaCursor = key->meta->cursor ? key->meta->current + 1 : 0;
+}
+
 
 /**Rewind the internal iterator to first metadata.
  *
@@ -153,9 +541,10 @@ while ((meta = keyNextMeta (key))!=0)
 int keyRewindMeta (Key * key)
 {
 	if (!key) return -1;
-	if (!key->meta) return 0;
 
-	return ksRewind (key->meta);
+	// the cursor is part of the key, the metadata might be shared with other keys
+	key->metaCursor = 0;
+	return 0;
 }
 
 /** Iterate to the next meta information.
@@ -185,13 +574,17 @@ int keyRewindMeta (Key * key)
  **/
 const Key * keyNextMeta (Key * key)
 {
-	Key * ret;
 	if (!key) return 0;
 	if (!key->meta) return 0;
 
-	ret = ksNext (key->meta);
+	if (key->metaCursor >= key->meta->size)
+	{
+		// stay at the end, even if metadata is added
+		key->metaCursor = key->meta->size + 1;
+		return 0;
+	}
 
-	return ret;
+	return key->meta->array[key->metaCursor++];
 }
 
 /**Returns the value of a meta-information which is current.
@@ -212,13 +605,11 @@ const Key * keyNextMeta (Key * key)
  **/
 const Key * keyCurrentMeta (const Key * key)
 {
-	Key * ret;
 	if (!key) return 0;
 	if (!key->meta) return 0;
+	if (key->metaCursor == 0 || key->metaCursor > key->meta->size) return 0;
 
-	ret = ksCurrent (key->meta);
-
-	return ret;
+	return key->meta->array[key->metaCursor - 1];
 }
 
 /**Do a shallow copy of metadata from source to dest.
@@ -305,6 +696,7 @@ int keyCopyMeta (Key * dest, const Key * source, const char * metaName)
 	if (dest->meta)
 	{
 		Key * r;
+		if (elektraKeyUnshareMeta (dest) == -1) return -1;
 		r = ksLookup (dest->meta, ret, KDB_O_POP);
 		if (r && r != ret)
 		{
@@ -315,7 +707,7 @@ int keyCopyMeta (Key * dest, const Key * source, const char * metaName)
 	else
 	{
 		/*Create a new place for meta information.*/
-		dest->meta = ksNew (0, KS_END);
+		dest->meta = elektraKsNewFor (dest);
 		if (!dest->meta)
 		{
 			return -1;
@@ -323,7 +715,9 @@ int keyCopyMeta (Key * dest, const Key * source, const char * metaName)
 	}
 
 	// now we can simply append that key
-	ksAppendKey (dest->meta, ret);
+	ret = elektraMetaKeyForCopy (source, ret);
+	if (!ret || ksAppendKey (dest->meta, ret) == -1) return -1;
+	elektraKeyTakeMetaCursor (dest);
 
 	return 1;
 }
@@ -374,11 +768,28 @@ int keyCopyAllMeta (Key * dest, const Key * source)
 		/*Make sure that dest also does not have metaName*/
 		if (dest->meta)
 		{
-			ksAppend (dest->meta, source->meta);
+			if (dest->meta == source->meta) return 1;
+			if (elektraKeyUnshareMeta (dest) == -1) return -1;
+			if (__atomic_load_n (&source->meta->metaShares, __ATOMIC_ACQUIRE) == 0)
+			{
+				if (ksAppend (dest->meta, source->meta) == -1) return -1;
+			}
+			else
+			{
+				for (size_t i = 0; i < source->meta->size; ++i)
+				{
+					Key * meta = elektraMetaKeyDup (source->meta->array[i]);
+					if (!meta || ksAppendKey (dest->meta, meta) == -1) return -1;
+				}
+			}
+			elektraKeyTakeMetaCursor (dest);
 		}
 		else
 		{
-			dest->meta = ksDup (source->meta);
+			// share the metadata until one of the keys modifies it
+			dest->meta = elektraMetaShare (source->meta);
+			if (!dest->meta) return -1;
+			dest->metaCursor = 0;
 		}
 		return 1;
 	}
@@ -423,7 +834,15 @@ const Key * keyGetMeta (const Key * key, const char * metaName)
 	search = keyNew (0);
 	elektraKeySetName (search, metaName, KEY_META_NAME | KEY_EMPTY_NAME);
 
-	ret = ksLookup (key->meta, search, 0);
+	// like ksLookup() the cursor is moved to the metakey found, but the cursor of the key is used,
+	// because the metadata might be shared
+	ssize_t pos = ksSearchInternal (key->meta, search);
+	ret = 0;
+	if (pos >= 0)
+	{
+		ret = key->meta->array[pos];
+		((Key *) key)->metaCursor = pos + 1;
+	}
 
 	keyDel (search);
 
@@ -479,19 +898,30 @@ ssize_t keySetMeta (Key * key, const char * metaName, const char * newMetaString
 	elektraKeySetName (toSet, metaName, KEY_META_NAME | KEY_EMPTY_NAME);
 
 	/*Lets have a look if the key is already inserted.*/
-	if (key->meta)
+	if (key->meta && ksSearchInternal (key->meta, toSet) >= 0)
 	{
-		Key * ret;
-		ret = ksLookup (key->meta, toSet, KDB_O_POP);
-		if (ret)
+		// the metadata might be shared with other keys
+		if (elektraKeyUnshareMeta (key) == -1)
 		{
-			/*It was already there, so lets drop that one*/
-			keyDel (ret);
-			key->flags |= KEY_FLAG_SYNC;
+			keyDel (toSet);
+			return -1;
 		}
+
+		/*It was already there, so lets drop that one*/
+		keyDel (ksLookup (key->meta, toSet, KDB_O_POP));
+		elektraKeyTakeMetaCursor (key);
+		key->flags |= KEY_FLAG_SYNC;
 	}
 
-	if (newMetaString)
+	if (!newMetaString)
+	{
+		/*The request is to remove the meta string.
+		  So simply drop it.*/
+		keyDel (toSet);
+		return 0;
+	}
+
+	if (elektraMetaIntern (toSet, newMetaString, metaStringSize) == -1)
 	{
 		/*Add the meta information to the key*/
 		metaStringDup = elektraStrNDup (newMetaString, metaStringSize);
@@ -503,35 +933,32 @@ ssize_t keySetMeta (Key * key, const char * metaName, const char * newMetaString
 			return -1;
 		}
 
-		if (toSet->data.v && !test_bit (toSet->flags, KEY_FLAG_MMAP_DATA)) elektraFree (toSet->data.v);
-		clear_bit (toSet->flags, (keyflag_t) KEY_FLAG_MMAP_DATA);
 		toSet->data.c = metaStringDup;
 		toSet->dataSize = metaStringSize;
 	}
-	else
-	{
-		/*The request is to remove the meta string.
-		  So simply drop it.*/
-		keyDel (toSet);
-		return 0;
-	}
+
+	set_bit (toSet->flags, KEY_FLAG_RO_NAME);
+	set_bit (toSet->flags, KEY_FLAG_RO_VALUE);
+	set_bit (toSet->flags, KEY_FLAG_RO_META);
 
 	if (!key->meta)
 	{
 		/*Create a new place for meta information.*/
-		key->meta = ksNew (0, KS_END);
+		key->meta = elektraKsNewFor (key);
 		if (!key->meta)
 		{
 			keyDel (toSet);
 			return -1;
 		}
 	}
-
-	set_bit (toSet->flags, KEY_FLAG_RO_NAME);
-	set_bit (toSet->flags, KEY_FLAG_RO_VALUE);
-	set_bit (toSet->flags, KEY_FLAG_RO_META);
+	else if (elektraKeyUnshareMeta (key) == -1)
+	{
+		keyDel (toSet);
+		return -1;
+	}
 
 	ksAppendKey (key->meta, toSet);
+	elektraKeyTakeMetaCursor (key);
 	key->flags |= KEY_FLAG_SYNC;
 	return metaStringSize;
 }
@@ -563,7 +990,9 @@ ssize_t keySetMeta (Key * key, const char * metaName, const char * newMetaString
 KeySet * keyMeta (Key * key)
 {
 	if (!key) return 0;
-	if (!key->meta) key->meta = ksNew (0, KS_END);
+	if (!key->meta) key->meta = elektraKsNewFor (key);
+	// the returned KeySet may be modified
+	if (elektraKeyUnshareMeta (key) == -1) return 0;
 
 	return key->meta;
 }
@@ -380,17 +380,48 @@ ssize_t elektraFinalizeName (Key * key)
 	key->key[key->keySize - 1] = 0; /* finalize string */
 
 	key->keyUSize = elektraUnescapeKeyName (key->key, key->key + key->keySize);
+	elektraKeyUpdateNamePrefix (key);
 
 	key->flags |= KEY_FLAG_SYNC;
 
 	return key->keySize;
 }
 
+/**
+ * @internal
+ *
+ * @brief Updates the cached prefix of the unescaped name
+ *
+ * Must be called whenever key->key, key->keySize or key->keyUSize
+ * is changed without elektraFinalizeName().
+ *
+ * The prefix compares like memcmp() on the first 8 bytes, so
+ * keyCompareByName() only needs to look at the names if the
+ * prefixes are equal.
+ *
+ * @param key the key to update
+ */
+void elektraKeyUpdateNamePrefix (Key * key)
+{
+	const unsigned char * uname = (const unsigned char *) key->key + key->keySize;
+	const size_t size = key->key ? key->keyUSize : 0;
+	uint64_t prefix = 0;
+
+	for (size_t i = 0; i < sizeof (prefix); ++i)
+	{
+		prefix <<= 8;
+		if (i < size) prefix |= uname[i];
+	}
+
+	key->namePrefix = prefix;
+}
+
 ssize_t elektraFinalizeEmptyName (Key * key)
 {
 	key->key = elektraCalloc (2); // two null pointers
 	key->keySize = 1;
 	key->keyUSize = 1;
+	key->namePrefix = 0;
 	key->flags |= KEY_FLAG_SYNC;
 
 	return key->keySize;
@@ -425,8 +456,12 @@ static void elektraRemoveKeyName (Key * key)
 	key->key = 0;
 	key->keySize = 0;
 	key->keyUSize = 0;
+	key->namePrefix = 0;
 }
 
+static ssize_t elektraSetName (Key * key, const char * newName, option_t options, ElektraArena * arena);
+static ssize_t elektraAddName (Key * key, const char * newName, int reserved);
+
 /**
  * @brief Checks if in name is something else other than slashes
  *
@@ -512,6 +547,27 @@ ssize_t keySetName (Key * key, const char * newName)
 }
 
 ssize_t elektraKeySetName (Key * key, const char * newName, option_t options)
+{
+	return elektraSetName (key, newName, options, 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Sets the name of a key created in an arena
+ *
+ * Unlike elektraKeySetName() the name is built directly in the arena of @p key,
+ * so no memory is allocated on the heap. Later changes of the name are
+ * allocated as usual.
+ *
+ * @see elektraKeySetName()
+ */
+ssize_t elektraArenaKeySetName (Key * key, const char * newName, option_t options)
+{
+	return elektraSetName (key, newName, options, elektraKeyGetArena (key));
+}
+
+static ssize_t elektraSetName (Key * key, const char * newName, option_t options, ElektraArena * arena)
 {
 	if (!key) return -1;
 	if (test_bit (key->flags, KEY_FLAG_RO_NAME)) return -1;
@@ -553,7 +609,17 @@ ssize_t elektraKeySetName (Key * key, const char * newName, option_t options)
 	} // Note that we abused keyUSize for cascading and user:owner
 
 	const size_t length = elektraStrLen (newName);
-	key->key = elektraMalloc (key->keySize * 2);
+	if (arena)
+	{
+		// the canonical name is never longer than newName, so it fits together with its unescaped form
+		key->key = elektraArenaAlloc (arena, (key->keySize + length) * 2);
+		if (!key->key) return -1;
+		set_bit (key->flags, KEY_FLAG_MMAP_KEY);
+	}
+	else
+	{
+		key->key = elektraMalloc (key->keySize * 2);
+	}
 	memcpy (key->key, newName, key->keySize);
 	if (length == key->keyUSize || length == key->keySize)
 	{ // use || because full length is keyUSize in user, but keySize for /
@@ -569,7 +635,7 @@ ssize_t elektraKeySetName (Key * key, const char * newName, option_t options)
 	}
 
 	key->key[key->keySize - 1] = '\0';
-	const ssize_t ret = keyAddName (key, newName + key->keyUSize);
+	const ssize_t ret = elektraAddName (key, newName + key->keyUSize, arena != 0);
 	if (ret == -1)
 		elektraRemoveKeyName (key);
 	else
@@ -844,6 +910,7 @@ ssize_t keyAddBaseName (Key * key, const char * baseName)
 	if (test_bit (key->flags, KEY_FLAG_RO_NAME)) return -1;
 	if (!key->key) return -1;
 
+	const size_t origSize = key->keySize;
 	char * escaped = elektraMalloc (strlen (baseName) * 2 + 2);
 	elektraEscapeKeyNamePart (baseName, escaped);
 	size_t len = strlen (escaped);
@@ -860,7 +927,9 @@ ssize_t keyAddBaseName (Key * key, const char * baseName)
 	if (test_bit (key->flags, KEY_FLAG_MMAP_KEY))
 	{
 		// key was in mmap region, clear flag and trigger malloc instead of realloc
+		char * previous = key->key;
 		key->key = elektraMalloc (newSize);
+		if (key->key) memcpy (key->key, previous, origSize);
 		clear_bit (key->flags, (keyflag_t) KEY_FLAG_MMAP_KEY);
 	}
 	else
@@ -963,6 +1032,19 @@ static void elektraRemoveOneLevel (Key * key, int * avoidSlash)
  * @ingroup keyname
  */
 ssize_t keyAddName (Key * key, const char * newName)
+{
+	return elektraAddName (key, newName, 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Implements keyAddName()
+ *
+ * @param reserved if set, the name of @p key is not reallocated, because the
+ *                 caller already reserved (keySize + size of @p newName) * 2 bytes
+ */
+static ssize_t elektraAddName (Key * key, const char * newName, int reserved)
 {
 	if (!key) return -1;
 	if (test_bit (key->flags, KEY_FLAG_RO_NAME)) return -1;
@@ -976,10 +1058,16 @@ ssize_t keyAddName (Key * key, const char * newName)
 	const size_t origSize = key->keySize;
 	const size_t newSize = (origSize + nameSize) * 2;
 
-	if (test_bit (key->flags, KEY_FLAG_MMAP_KEY))
+	if (reserved)
+	{
+		// name is built in place
+	}
+	else if (test_bit (key->flags, KEY_FLAG_MMAP_KEY))
 	{
 		// key was in mmap region, clear flag and trigger malloc instead of realloc
+		char * previous = key->key;
 		key->key = elektraMalloc (newSize);
+		if (key->key) memcpy (key->key, previous, origSize);
 		clear_bit (key->flags, (keyflag_t) KEY_FLAG_MMAP_KEY);
 	}
 	else
@@ -1127,7 +1215,9 @@ ssize_t keySetBaseName (Key * key, const char * baseName)
 	if (test_bit (key->flags, KEY_FLAG_MMAP_KEY))
 	{
 		// key was in mmap region, clear flag and trigger malloc instead of realloc
+		char * previous = key->key;
 		key->key = elektraMalloc (newSize);
+		if (key->key) memcpy (key->key, previous, key->keySize);
 		clear_bit (key->flags, (keyflag_t) KEY_FLAG_MMAP_KEY);
 	}
 	else
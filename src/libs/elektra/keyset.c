@@ -26,6 +26,8 @@
 #include <string.h>
 #endif
 
+#include <stddef.h>
+
 #include <kdbtypes.h>
 
 #include "kdbinternal.h"
@@ -42,7 +44,7 @@
  * @brief KeySets OPMPHM cleaner.
  *
  * Must be invoked by every function that changes a Key name in a KeySet, adds a Key or
- * removes a Key.
+ * removes a Key. Also invalidates the ElektraKsIndex.
  * Set also the KS_FLAG_NAME_CHANGE KeySet flag.
  *
  * @param ks the KeySet
@@ -52,6 +54,46 @@ static void elektraOpmphmInvalidate (KeySet * ks ELEKTRA_UNUSED)
 #ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
 	set_bit (ks->flags, KS_FLAG_NAME_CHANGE);
 	if (ks && ks->opmphm) opmphmClear (ks->opmphm);
+	if (ks && ks->index) elektraKsIndexClear (ks->index);
+#endif
+}
+
+/**
+ * @internal
+ *
+ * @brief Records a Key inserted into a KeySet in its OPMPHM.
+ *
+ * A build OPMPHM stays valid, the insertion is recorded in its delta.
+ * Once the delta is full the OPMPHM is invalidated and rebuild on demand.
+ *
+ * @param ks the KeySet, ks->size already includes the inserted Key
+ * @param index the position of the inserted Key
+ */
+void elektraOpmphmKeyInserted (KeySet * ks ELEKTRA_UNUSED, size_t index ELEKTRA_UNUSED)
+{
+#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
+	if (ks->index) elektraKsIndexClear (ks->index);
+	if (opmphmIsBuild (ks->opmphm) && !opmphmDeltaInsert (ks->opmphm, ks->size - 1, index)) return;
+	elektraOpmphmInvalidate (ks);
+#endif
+}
+
+/**
+ * @internal
+ *
+ * @brief Records a Key removed from a KeySet in its OPMPHM.
+ *
+ * @see elektraOpmphmKeyInserted()
+ *
+ * @param ks the KeySet, ks->size still includes the removed Key
+ * @param index the position of the removed Key
+ */
+void elektraOpmphmKeyRemoved (KeySet * ks ELEKTRA_UNUSED, size_t index ELEKTRA_UNUSED)
+{
+#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
+	if (ks->index) elektraKsIndexClear (ks->index);
+	if (opmphmIsBuild (ks->opmphm) && !opmphmDeltaRemove (ks->opmphm, ks->size, index)) return;
+	elektraOpmphmInvalidate (ks);
 #endif
 }
 
@@ -285,6 +327,141 @@ KeySet * ksVNew (size_t alloc, va_list va)
 	return keyset;
 }
 
+/**
+ * @internal
+ *
+ * A reference counted block holding the array of KeySets
+ * with #KS_FLAG_SHARED_ARRAY. The array of such KeySets points
+ * to the member array.
+ */
+typedef struct
+{
+	size_t refs; /*!< Number of KeySets using the array */
+	Key * array[];
+} ElektraKsShared;
+
+#define ELEKTRA_KS_SHARED(ks) ((ElektraKsShared *) ((char *) (ks)->array - offsetof (ElektraKsShared, array)))
+
+/**
+ * @internal
+ *
+ * @brief Moves the array of @p ks into a reference counted block
+ *
+ * The references of the keys are transferred from @p ks to the block.
+ *
+ * @retval 0 on success
+ * @retval -1 on memory error, @p ks is not changed then
+ */
+static int elektraKsSharedInit (KeySet * ks)
+{
+	if (test_bit (ks->flags, KS_FLAG_SHARED_ARRAY)) return 0;
+
+	size_t alloc = ks->alloc > ks->size ? ks->alloc : ks->size + 1;
+	ElektraKsShared * shared = elektraMalloc (sizeof (ElektraKsShared) + sizeof (struct _Key *) * alloc);
+	if (!shared) return -1;
+
+	shared->refs = 1;
+	elektraMemcpy (shared->array, ks->array, ks->size);
+	shared->array[ks->size] = 0;
+
+	if (!test_bit (ks->flags, KS_FLAG_MMAP_ARRAY))
+	{
+		elektraFree (ks->array);
+	}
+	clear_bit (ks->flags, (ksflag_t) KS_FLAG_MMAP_ARRAY);
+	set_bit (ks->flags, KS_FLAG_SHARED_ARRAY);
+
+	ks->array = shared->array;
+	ks->alloc = alloc;
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Duplicates @p source without copying its array
+ *
+ * Neither the array is copied nor are the reference counters
+ * of the keys changed, only the block is referenced once more.
+ *
+ * @return a KeySet sharing the array of @p source
+ * @retval 0 on memory errors
+ */
+static KeySet * elektraKsSharedDup (KeySet * source)
+{
+	if (elektraKsSharedInit (source) == -1) return 0;
+
+	KeySet * keyset = ksNew (0, KS_END);
+	if (!keyset) return 0;
+
+	keyset->array = source->array;
+	keyset->size = source->size;
+	keyset->alloc = source->alloc;
+	set_bit (keyset->flags, KS_FLAG_SHARED | KS_FLAG_SHARED_ARRAY);
+	++ELEKTRA_KS_SHARED (source)->refs;
+
+	// the OPMPHM is rebuilt lazily, copying it would not be O(1)
+	return keyset;
+}
+
+/**
+ * @internal
+ *
+ * @brief Gives @p ks an own array
+ *
+ * If other KeySets still use the shared array, it is copied and the
+ * keys are referenced. Otherwise the keys keep the references of the block.
+ *
+ * @retval 0 on success
+ * @retval -1 on memory error, the array stays shared then
+ */
+static int elektraKsSharedPromote (KeySet * ks)
+{
+	ElektraKsShared * shared = ELEKTRA_KS_SHARED (ks);
+	Key ** array = elektraMalloc (sizeof (struct _Key *) * ks->alloc);
+	if (!array) return -1;
+
+	elektraMemcpy (array, ks->array, ks->size);
+	array[ks->size] = 0;
+
+	if (shared->refs == 1)
+	{
+		elektraFree (shared);
+	}
+	else
+	{
+		--shared->refs;
+		for (size_t i = 0; i < ks->size; ++i)
+		{
+			keyIncRef (array[i]);
+		}
+	}
+
+	ks->array = array;
+	clear_bit (ks->flags, (ksflag_t) KS_FLAG_SHARED_ARRAY);
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Finishes a build of ksBuilderAdd() before @p ks is read
+ *
+ * Every function that depends on the order of the array calls it, so
+ * a KeySet filled by ksBuilderAdd() is never seen unsorted. The cursor
+ * is rewound, if a build was pending.
+ *
+ * @retval 0 if @p ks is sorted
+ * @retval -1 on memory error, @p ks stays unsorted then
+ */
+static int elektraKsBuilderPending (const KeySet * ks)
+{
+	if (!test_bit (ks->flags, KS_FLAG_UNSORTED)) return 0;
+
+	// only the order changes, so even const KeySets may be finished
+	return ksBuilderFinish ((KeySet *) ks) == -1 ? -1 : 0;
+}
+
 /**
  * Return a duplicate of a keyset.
  *
@@ -297,6 +474,10 @@ KeySet * ksVNew (size_t alloc, va_list va)
  * but their reference counter is updated, so both keysets
  * need ksDel().
  *
+ * If ksShare() was called for @p source (or @p source was duplicated
+ * from such a KeySet), the array is not copied either: both KeySets
+ * share it until one of them is changed.
+ *
  * @param source has to be an initialized source KeySet
  * @return a flat copy of source on success
  * @retval 0 on NULL pointer
@@ -306,6 +487,18 @@ KeySet * ksVNew (size_t alloc, va_list va)
 KeySet * ksDup (const KeySet * source)
 {
 	if (!source) return 0;
+	if (elektraKsBuilderPending (source) == -1) return 0;
+
+	if (test_bit (source->flags, KS_FLAG_SHARED) && !test_bit (source->flags, KS_FLAG_VIEW) && source->array)
+	{
+		// only the representation of source changes, its keys stay the same
+		KeySet * keyset = elektraKsSharedDup ((KeySet *) source);
+		if (keyset)
+		{
+			keyset->snapshotEpoch = source->snapshotEpoch;
+			return keyset;
+		}
+	}
 
 	size_t size = source->alloc;
 	if (size < KEYSET_SIZE)
@@ -314,11 +507,50 @@ KeySet * ksDup (const KeySet * source)
 	}
 
 	KeySet * keyset = ksNew (size, KS_END);
+	if (!keyset) return 0;
 	ksAppend (keyset, source);
 	elektraOpmphmCopy (keyset, source);
+	keyset->snapshotEpoch = source->snapshotEpoch;
 	return keyset;
 }
 
+/**
+ * Lets ksDup() share the array of @p ks.
+ *
+ * Afterwards ksDup() takes O(1): the duplicate uses the array of
+ * @p ks, which is copied only once either KeySet is changed, e.g.
+ * with ksAppendKey(), ksCut() or ksPop(). So readers can cheaply
+ * keep a snapshot of a KeySet, which is rarely changed.
+ * Duplicates of @p ks share their array, too.
+ *
+ * As with any ksDup(), the keys are not duplicated: changing the value
+ * or metadata of a key is visible in all KeySets containing it.
+ *
+ * @note Keys in a shared array are referenced once by the array and
+ * not once per KeySet, see keyGetRef(). Like the reference counters of
+ * keys, the array must not be shared between threads.
+ *
+ * @code
+KeySet * snapshot = ksDup (ks); // no copy, if ksShare (ks) was called before
+ksAppendKey (ks, keyNew ("user/new", KEY_END)); // ks copies the array
+// snapshot does not contain user/new
+ksDel (snapshot);
+ * @endcode
+ *
+ * @param ks the KeySet to share
+ *
+ * @retval 0 on success
+ * @retval -1 on NULL pointer
+ * @see ksDup()
+ */
+int ksShare (KeySet * ks)
+{
+	if (!ks) return -1;
+
+	set_bit (ks->flags, KS_FLAG_SHARED);
+	return 0;
+}
+
 /**
  * @internal
  * @brief Deeply copies from source to dest.
@@ -339,6 +571,7 @@ KeySet * ksDup (const KeySet * source)
 KeySet * ksDeepDup (const KeySet * source)
 {
 	if (!source) return 0;
+	if (elektraKsBuilderPending (source) == -1) return 0;
 
 	size_t s = source->size;
 	size_t i = 0;
@@ -410,6 +643,7 @@ int f (KeySet *ks)
 int ksCopy (KeySet * dest, const KeySet * source)
 {
 	if (!dest) return -1;
+	if (source && elektraKsBuilderPending (source) == -1) return -1;
 	ksClear (dest);
 	if (!source) return 0;
 
@@ -417,6 +651,7 @@ int ksCopy (KeySet * dest, const KeySet * source)
 	ksSetCursor (dest, ksGetCursor (source));
 
 	elektraOpmphmCopy (dest, source);
+	dest->snapshotEpoch = source->snapshotEpoch;
 	return 1;
 }
 
@@ -451,9 +686,13 @@ int ksDel (KeySet * ks)
 	{
 		opmphmPredictorDel (ks->opmphmPredictor);
 	}
+	elektraKsIndexDel (ks->index);
 
 #endif
 
+	// the arena is freed once the last key in it is gone, too
+	elektraArenaDecRef (ks->arena);
+
 	if (!test_bit (ks->flags, KS_FLAG_MMAP_STRUCT))
 	{
 		elektraFree (ks);
@@ -503,38 +742,34 @@ int ksClear (KeySet * ks)
  *
  * Is suitable for binary search (but may return wrong owner)
  *
+ * The first 8 bytes are compared using Key::namePrefix, the
+ * names themselves are only read if they start the same way.
  */
 static int keyCompareByName (const void * p1, const void * p2)
 {
 	Key * key1 = *(Key **) p1;
 	Key * key2 = *(Key **) p2;
-	const void * name1 = key1->key + key1->keySize;
-	const void * name2 = key2->key + key2->keySize;
+	if (key1->namePrefix != key2->namePrefix)
+	{
+		return key1->namePrefix < key2->namePrefix ? -1 : 1;
+	}
+
 	size_t const nameSize1 = key1->keyUSize;
 	size_t const nameSize2 = key2->keyUSize;
+	size_t const prefixSize = sizeof (key1->namePrefix);
+	size_t const nameSize = nameSize1 < nameSize2 ? nameSize1 : nameSize2;
 	int ret = 0;
-	if (nameSize1 == nameSize2)
+	if (nameSize > prefixSize)
 	{
-		ret = memcmp (name1, name2, nameSize2);
+		// equal prefixes mean that the first bytes of both names are equal
+		const char * name1 = key1->key + key1->keySize + prefixSize;
+		const char * name2 = key2->key + key2->keySize + prefixSize;
+		ret = memcmp (name1, name2, nameSize - prefixSize);
 	}
-	else
+
+	if (ret == 0 && nameSize1 != nameSize2)
 	{
-		if (nameSize1 < nameSize2)
-		{
-			ret = memcmp (name1, name2, nameSize1);
-			if (ret == 0)
-			{
-				ret = -1;
-			}
-		}
-		else
-		{
-			ret = memcmp (name1, name2, nameSize2);
-			if (ret == 0)
-			{
-				ret = 1;
-			}
-		}
+		ret = nameSize1 < nameSize2 ? -1 : 1;
 	}
 	return ret;
 }
@@ -655,6 +890,21 @@ int keyCmp (const Key * k1, const Key * k2)
 	return keyCompareByNameOwner (&k1, &k2);
 }
 
+/**
+ * @internal
+ *
+ * @brief Compares the names of two keys in the order of a KeySet.
+ *
+ * Unlike keyCmp() the owner is ignored, so keys with the same
+ * name are always equal.
+ *
+ * @pre both keys have a name
+ */
+int elektraKeyCmpName (const Key * k1, const Key * k2)
+{
+	return keyCompareByName (&k1, &k2);
+}
+
 /**
  * Checks if KeySet needs sync.
  *
@@ -694,6 +944,7 @@ int ksNeedSync (const KeySet * ks)
 ssize_t ksGetSize (const KeySet * ks)
 {
 	if (!ks) return -1;
+	if (elektraKsBuilderPending (ks) == -1) return -1;
 
 	return ks->size;
 }
@@ -731,6 +982,7 @@ if (result >= 0)
  */
 ssize_t ksSearchInternal (const KeySet * ks, const Key * toAppend)
 {
+	ELEKTRA_ASSERT (!test_bit (ks->flags, KS_FLAG_UNSORTED), "binary search in KeySet with pending ksBuilderFinish()");
 	ssize_t left = 0;
 	ssize_t right = ks->size;
 	--right;
@@ -842,6 +1094,14 @@ ssize_t ksAppendKey (KeySet * ks, Key * toAppend)
 		return -1;
 	}
 
+	if (elektraKsViewPromote (ks) == -1)
+	{
+		keyDel (toAppend);
+		return -1;
+	}
+
+	if (elektraKsBuilderPending (ks) == -1) return -1;
+
 	keyLock (toAppend, KEY_LOCK_NAME);
 
 	result = ksSearchInternal (ks, toAppend);
@@ -912,7 +1172,7 @@ ssize_t ksAppendKey (KeySet * ks, Key * toAppend)
 			ks->array[insertpos] = toAppend;
 			ksSetCursor (ks, insertpos);
 		}
-		elektraOpmphmInvalidate (ks);
+		elektraOpmphmKeyInserted (ks, insertpos);
 	}
 
 	return ks->size;
@@ -944,9 +1204,11 @@ ssize_t ksAppend (KeySet * ks, const KeySet * toAppend)
 
 	if (!ks) return -1;
 	if (!toAppend) return -1;
+	if (elektraKsBuilderPending (toAppend) == -1) return -1;
 
 	if (toAppend->size == 0) return ks->size;
 	if (toAppend->array == NULL) return ks->size;
+	if (elektraKsViewPromote (ks) == -1) return -1;
 
 	if (ks->array == NULL)
 		toAlloc = KEYSET_SIZE;
@@ -967,6 +1229,188 @@ ssize_t ksAppend (KeySet * ks, const KeySet * toAppend)
 }
 
 
+/**
+ * @internal
+ *
+ * @brief Stable merge sort of a key array by name.
+ *
+ * Keys with the same name keep their relative order, which is needed
+ * for the last-wins semantics of ksBuilderFinish().
+ *
+ * @param array the keys to sort
+ * @param buffer scratch space of at least @p size elements
+ * @param size the number of keys in @p array
+ */
+static void elektraKsMergeSort (Key ** array, Key ** buffer, size_t size)
+{
+	if (size < 2) return;
+
+	size_t const middle = size / 2;
+	elektraKsMergeSort (array, buffer, middle);
+	elektraKsMergeSort (array + middle, buffer, size - middle);
+
+	// both halves are in order already (the common case for nearly sorted input)
+	if (keyCompareByName (&array[middle - 1], &array[middle]) <= 0) return;
+
+	memcpy (buffer, array, middle * sizeof (Key *));
+
+	size_t left = 0;
+	size_t right = middle;
+	size_t out = 0;
+	while (left < middle && right < size)
+	{
+		// take from the left half on equality to stay stable
+		if (keyCompareByName (&array[right], &buffer[left]) < 0)
+			array[out++] = array[right++];
+		else
+			array[out++] = buffer[left++];
+	}
+	while (left < middle)
+	{
+		array[out++] = buffer[left++];
+	}
+}
+
+/**
+ * Add a key to a KeySet without keeping the KeySet sorted.
+ *
+ * Storage plugins often create many keys at once. ksAppendKey() searches
+ * and moves the array for every key, ksBuilderAdd() instead adds the key
+ * at the end of the array. ksBuilderFinish() then sorts the KeySet once and
+ * removes duplicates.
+ *
+ * As long as keys are added in sorted order, the KeySet stays valid.
+ * Otherwise the KeySet is marked as unsorted and every other function
+ * working with the KeySet, e.g. ksNext(), ksAtCursor(), ksLookup() or
+ * ksDup(), calls ksBuilderFinish() implicitly before, which also
+ * rewinds the cursor. Only code accessing the array directly must
+ * call ksBuilderFinish() itself.
+ *
+ * The name of the key will be locked, like in ksAppendKey().
+ *
+ * @param ks KeySet that will receive the key
+ * @param toAppend key that will be added to ks or deleted in case of error
+ * @return the size of the KeySet after insertion
+ * @retval -1 on NULL pointers
+ * @retval -1 if insertion failed, the key will be deleted then.
+ * @see ksBuilderFinish() to sort the KeySet
+ * @see ksAppendKey() to keep the KeySet sorted on every insertion
+ */
+ssize_t ksBuilderAdd (KeySet * ks, Key * toAppend)
+{
+	if (!ks) return -1;
+	if (!toAppend) return -1;
+	if (!toAppend->key)
+	{
+		// needed for ksBuilderAdd(ks, keyNew(0))
+		keyDel (toAppend);
+		return -1;
+	}
+
+	if (elektraKsViewPromote (ks) == -1)
+	{
+		keyDel (toAppend);
+		return -1;
+	}
+
+	keyLock (toAppend, KEY_LOCK_NAME);
+
+	if (ks->size > 0 && ks->array[ks->size - 1] == toAppend)
+	{
+		/* user tried to insert the key with same identity */
+		return ks->size;
+	}
+
+	if (ks->size > 0 && !test_bit (ks->flags, KS_FLAG_UNSORTED))
+	{
+		Key ** last = &ks->array[ks->size - 1];
+		int cmp = keyCompareByName (&toAppend, last);
+		if (cmp == 0)
+		{
+			/* replace the last key, as ksAppendKey() would do */
+			keyDecRef (*last);
+			keyDel (*last);
+			keyIncRef (toAppend);
+			*last = toAppend;
+			return ks->size;
+		}
+		if (cmp < 0) set_bit (ks->flags, KS_FLAG_UNSORTED);
+	}
+
+	if (ks->size + 1 >= ks->alloc)
+	{
+		size_t newSize = ks->alloc == 0 ? KEYSET_SIZE : ks->alloc * 2;
+		if (ksResize (ks, newSize - 1) == -1)
+		{
+			keyDel (toAppend);
+			return -1;
+		}
+	}
+
+	keyIncRef (toAppend);
+	ks->array[ks->size++] = toAppend;
+	ks->array[ks->size] = 0;
+
+#ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
+	// only invalidate once for many added keys
+	if (!test_bit (ks->flags, KS_FLAG_NAME_CHANGE))
+	{
+		elektraOpmphmInvalidate (ks);
+	}
+	else if (ks->index)
+	{
+		elektraKsIndexClear (ks->index);
+	}
+#endif
+
+	return ks->size;
+}
+
+/**
+ * Finish adding keys with ksBuilderAdd().
+ *
+ * Sorts the keys added by ksBuilderAdd() and removes keys with
+ * duplicated names. As with ksAppendKey(), the key added last wins.
+ *
+ * Does nothing if the keys were added in sorted order.
+ *
+ * @param ks the KeySet filled by ksBuilderAdd()
+ * @return the size of the sorted KeySet
+ * @retval -1 on NULL pointer or memory error, the KeySet stays unsorted then
+ * @see ksBuilderAdd()
+ */
+ssize_t ksBuilderFinish (KeySet * ks)
+{
+	if (!ks) return -1;
+	if (!test_bit (ks->flags, KS_FLAG_UNSORTED)) return ks->size;
+
+	Key ** buffer = elektraMalloc ((ks->size / 2 + 1) * sizeof (Key *));
+	if (!buffer) return -1;
+	elektraKsMergeSort (ks->array, buffer, ks->size);
+	elektraFree (buffer);
+
+	size_t out = 0;
+	for (size_t i = 0; i < ks->size; ++i)
+	{
+		if (i + 1 < ks->size && keyCompareByName (&ks->array[i], &ks->array[i + 1]) == 0)
+		{
+			/* a key with the same name was added later */
+			keyDecRef (ks->array[i]);
+			keyDel (ks->array[i]);
+			continue;
+		}
+		ks->array[out++] = ks->array[i];
+	}
+	ks->size = out;
+	ks->array[ks->size] = 0;
+
+	clear_bit (ks->flags, (ksflag_t) KS_FLAG_UNSORTED);
+	ksRewind (ks);
+	elektraOpmphmInvalidate (ks);
+
+	return ks->size;
+}
+
 /**
  * @internal
  *
@@ -1143,6 +1587,8 @@ KeySet * ksCut (KeySet * ks, const Key * cutpoint)
 	if (!cutpoint) return 0;
 
 	if (!ks->array) return ksNew (0, KS_END);
+	if (elektraKsViewPromote (ks) == -1) return 0;
+	if (elektraKsBuilderPending (ks) == -1) return 0;
 
 	char * name = cutpoint->key;
 	if (!name) return 0;
@@ -1155,6 +1601,7 @@ KeySet * ksCut (KeySet * ks, const Key * cutpoint)
 		Key * key = (Key *) cutpoint;
 		size_t size = key->keySize;
 		size_t usize = key->keyUSize;
+		uint64_t namePrefix = key->namePrefix;
 		size_t length = strlen (name) + ELEKTRA_MAX_NAMESPACE_SIZE;
 		char newname[length * 2];
 
@@ -1223,6 +1670,7 @@ KeySet * ksCut (KeySet * ks, const Key * cutpoint)
 		key->key = name;
 		key->keySize = size;
 		key->keyUSize = usize;
+		key->namePrefix = namePrefix;
 
 		// now look for cascading keys
 	}
@@ -1250,6 +1698,207 @@ KeySet * ksCut (KeySet * ks, const Key * cutpoint)
 	return returned;
 }
 
+/**
+ * @internal
+ *
+ * @brief Makes @p view a read-only view of the keys [@p from, @p to) of @p ks
+ *
+ * The view shares the array of @p ks: neither the array is copied nor are
+ * the reference counters of the keys changed. Reading functions like
+ * ksNext(), ksLookup() or ksAppend() with the view as source work as
+ * for any other KeySet. Functions changing the view first copy the keys
+ * to an own array, see elektraKsViewPromote().
+ *
+ * @p ks must neither be changed nor deleted while the view is used.
+ *
+ * @param view an initialized KeySet, its keys are removed
+ * @param ks the KeySet to view
+ * @param from the position of the first key of the view
+ * @param to the position after the last key of the view
+ *
+ * @retval 0 on success
+ * @retval -1 on NULL pointers, an invalid range or if @p ks could not be sorted
+ */
+int elektraKsViewInit (KeySet * view, KeySet * ks, size_t from, size_t to)
+{
+	if (!view || !ks || view == ks) return -1;
+	if (from > to || to > ks->size) return -1;
+	if (elektraKsBuilderPending (ks) == -1) return -1;
+
+	ksClose (view);
+	if (from == to) return 0;
+
+	view->array = ks->array + from;
+	view->size = to - from;
+	view->alloc = 0;
+	set_bit (view->flags, KS_FLAG_VIEW);
+
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Turns a view into a normal KeySet
+ *
+ * Copies the array of the view and references its keys, so that
+ * the KeySet can be changed independently of the viewed KeySet.
+ * A KeySet sharing its array with other KeySets (see ksShare())
+ * gets an own array, too. Does nothing for other KeySets.
+ *
+ * @param ks the KeySet to promote
+ *
+ * @retval 0 on success
+ * @retval -1 on memory error, the KeySet stays a view then
+ */
+int elektraKsViewPromote (KeySet * ks)
+{
+	if (test_bit (ks->flags, KS_FLAG_SHARED_ARRAY)) return elektraKsSharedPromote (ks);
+	if (!test_bit (ks->flags, KS_FLAG_VIEW)) return 0;
+
+	size_t alloc = ks->size < KEYSET_SIZE ? KEYSET_SIZE : ks->size + 1;
+	Key ** array = elektraMalloc (sizeof (struct _Key *) * alloc);
+	if (!array) return -1;
+
+	elektraMemcpy (array, ks->array, ks->size);
+	array[ks->size] = 0;
+	for (size_t i = 0; i < ks->size; ++i)
+	{
+		keyIncRef (array[i]);
+	}
+
+	ks->array = array;
+	ks->alloc = alloc;
+	clear_bit (ks->flags, (ksflag_t) KS_FLAG_VIEW);
+
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Finds the keys below or same as @p cutpoint without changing @p ks
+ *
+ * @param ks the sorted KeySet
+ * @param cutpoint a non-cascading cutpoint
+ * @param from the position of the first key below @p cutpoint
+ * @param to the position after the last key below @p cutpoint
+ */
+static void elektraKsViewRange (const KeySet * ks, const Key * cutpoint, size_t * from, size_t * to)
+{
+	ssize_t search = ksSearchInternal (ks, cutpoint);
+	size_t it = search < 0 ? -search - 1 : search;
+
+	*from = it;
+	while (it < ks->size && keyIsBelowOrSame (cutpoint, ks->array[it]) == 1)
+	{
+		++it;
+	}
+	*to = it;
+}
+
+/**
+ * @internal
+ *
+ * @brief Collects the keys of all namespaces below a cascading @p cutpoint
+ *
+ * The keys of every namespace are a separate range of @p ks, so the
+ * result cannot be a single view. The ranges are appended to a
+ * new KeySet instead, without copying @p ks first.
+ *
+ * @return a new KeySet with the keys below @p cutpoint
+ * @retval 0 on memory error
+ */
+static KeySet * elektraKsViewCascading (KeySet * ks, const Key * cutpoint)
+{
+	static const char * const namespaces[] = { "spec", "proc", "dir", "user", "system", "", 0 };
+	KeySet * returned = ksNew (0, KS_END);
+	KeySet view;
+	ksInit (&view);
+
+	for (size_t i = 0; returned && namespaces[i]; ++i)
+	{
+		char * name = elektraFormat ("%s%s", namespaces[i], cutpoint->key);
+		Key * nsCutpoint = name ? keyNew (name, KEY_END) : 0;
+		elektraFree (name);
+		if (!nsCutpoint)
+		{
+			ksDel (returned);
+			returned = 0;
+			break;
+		}
+
+		size_t from, to;
+		elektraKsViewRange (ks, nsCutpoint, &from, &to);
+		keyDel (nsCutpoint);
+
+		if (elektraKsViewInit (&view, ks, from, to) == -1 || ksAppend (returned, &view) == -1)
+		{
+			ksDel (returned);
+			returned = 0;
+		}
+	}
+
+	ksClose (&view);
+	return returned;
+}
+
+/**
+ * Returns a read-only view of the keys below @p cutpoint.
+ *
+ * Contains the same keys as ksCut(), but @p ks is not changed
+ * and its cursor stays where it is.
+ *
+ * For non-cascading cutpoints, no key is copied: the view refers to the
+ * keys inside of @p ks. The view can be iterated, searched or appended
+ * to other KeySets like any other KeySet. As soon as the view is
+ * changed, e.g. with ksAppendKey() or ksPop(), it copies the keys and
+ * becomes a normal KeySet. As long as it is a view, @p ks must not be
+ * changed or deleted.
+ *
+ * For cascading cutpoints, the keys of the different namespaces are
+ * collected into a normal KeySet.
+ *
+ * @code
+KeySet * below = ksView (ks, parentKey);
+Key * cur;
+ksRewind (below);
+while ((cur = ksNext (below)) != 0)
+{
+	// inspect cur, but do not change ks
+}
+ksDel (below); // ks is not changed
+ * @endcode
+ *
+ * @param ks the KeySet to view
+ * @param cutpoint the key, below which the keys are returned
+ *
+ * @return a new KeySet, which needs to be deleted with ksDel()
+ * @retval 0 on NULL pointers, no key name or memory errors
+ * @see ksCut() to remove the keys from @p ks
+ */
+KeySet * ksView (KeySet * ks, const Key * cutpoint)
+{
+	if (!ks) return 0;
+	if (!cutpoint) return 0;
+	if (!cutpoint->key) return 0;
+	if (elektraKsBuilderPending (ks) == -1) return 0;
+
+	if (cutpoint->key[0] == '/') return elektraKsViewCascading (ks, cutpoint);
+
+	size_t from, to;
+	elektraKsViewRange (ks, cutpoint, &from, &to);
+
+	KeySet * view = ksNew (0, KS_END);
+	if (!view) return 0;
+	if (elektraKsViewInit (view, ks, from, to) == -1)
+	{
+		ksDel (view);
+		return 0;
+	}
+	return view;
+}
+
 
 /**
  * Remove and return the last key of @p ks.
@@ -1298,8 +1947,10 @@ Key * ksPop (KeySet * ks)
 	ks->flags |= KS_FLAG_SYNC;
 
 	if (ks->size == 0) return 0;
+	if (elektraKsViewPromote (ks) == -1) return 0;
+	if (elektraKsBuilderPending (ks) == -1) return 0;
 
-	elektraOpmphmInvalidate (ks);
+	elektraOpmphmKeyRemoved (ks, ks->size - 1);
 
 	--ks->size;
 	if (ks->size + 1 < ks->alloc / 2) ksResize (ks, ks->alloc / 2 - 1);
@@ -1336,6 +1987,7 @@ while ((key = ksNext (ks))!=0) {}
 int ksRewind (KeySet * ks)
 {
 	if (!ks) return -1;
+	if (elektraKsBuilderPending (ks) == -1) return -1;
 
 	ks->cursor = 0;
 	ks->current = 0;
@@ -1370,6 +2022,7 @@ int ksRewind (KeySet * ks)
 Key * ksNext (KeySet * ks)
 {
 	if (!ks) return 0;
+	if (elektraKsBuilderPending (ks) == -1) return 0;
 
 	if (ks->size == 0) return 0;
 	if (ks->current >= ks->size)
@@ -1378,6 +2031,8 @@ Key * ksNext (KeySet * ks)
 	}
 
 	if (ks->cursor) ks->current++;
+	// the array of a view does not end with NULL
+	if (ks->current == ks->size) return ks->cursor = 0;
 	return ks->cursor = ks->array[ks->current];
 }
 
@@ -1421,6 +2076,7 @@ Key * ksCurrent (const KeySet * ks)
 Key * ksHead (const KeySet * ks)
 {
 	if (!ks) return 0;
+	if (elektraKsBuilderPending (ks) == -1) return 0;
 
 	if (ks->size > 0)
 		return ks->array[0];
@@ -1447,6 +2103,7 @@ Key * ksHead (const KeySet * ks)
 Key * ksTail (const KeySet * ks)
 {
 	if (!ks) return 0;
+	if (elektraKsBuilderPending (ks) == -1) return 0;
 
 	if (ks->size > 0)
 		return ks->array[ks->size - 1];
@@ -1559,8 +2216,9 @@ cursor_t ksGetCursor (const KeySet * ks)
 Key * ksAtCursor (KeySet * ks, cursor_t pos)
 {
 	if (!ks) return 0;
+	if (elektraKsBuilderPending (ks) == -1) return 0;
 	if (pos < 0) return 0;
-	if (ks->size < (size_t) pos) return 0;
+	if (ks->size <= (size_t) pos) return 0;
 	return ks->array[pos];
 }
 
@@ -1599,6 +2257,7 @@ ksCurrent(ks); // in same position as before
 int ksSetCursor (KeySet * ks, cursor_t cursor)
 {
 	if (!ks) return -1;
+	if (elektraKsBuilderPending (ks) == -1) return -1;
 
 	if ((cursor_t) -1 == cursor)
 	{
@@ -1770,6 +2429,7 @@ static Key * elektraLookupBySpecNamespaces (KeySet * ks, Key * specKey, char * b
 	char * name = specKey->key;
 	size_t size = specKey->keySize;
 	size_t usize = specKey->keyUSize;
+	uint64_t namePrefix = specKey->namePrefix;
 	size_t nameLength = strlen (name);
 	size_t maxSize = nameLength + ELEKTRA_MAX_NAMESPACE_SIZE;
 	char newname[maxSize * 2]; // buffer for all new names (namespace + cascading key name)
@@ -1796,6 +2456,7 @@ static Key * elektraLookupBySpecNamespaces (KeySet * ks, Key * specKey, char * b
 	specKey->key = name;
 	specKey->keySize = size;
 	specKey->keyUSize = usize;
+	specKey->namePrefix = namePrefix;
 	return ret;
 }
 
@@ -1853,6 +2514,7 @@ static Key * elektraLookupByCascading (KeySet * ks, Key * key, option_t options)
 	char * name = key->key;
 	size_t size = key->keySize;
 	size_t usize = key->keyUSize;
+	uint64_t namePrefix = key->namePrefix;
 	size_t length = strlen (name) + ELEKTRA_MAX_NAMESPACE_SIZE;
 	char newname[length * 2];
 	Key * found = 0;
@@ -1874,6 +2536,7 @@ static Key * elektraLookupByCascading (KeySet * ks, Key * key, option_t options)
 		key->key = name;
 		key->keySize = size;
 		key->keyUSize = usize;
+		key->namePrefix = namePrefix;
 
 		if (strncmp (keyName (specKey), "spec/", 5))
 		{ // the search was modified in a way that not a spec Key was returned
@@ -1932,6 +2595,7 @@ static Key * elektraLookupByCascading (KeySet * ks, Key * key, option_t options)
 	key->key = name;
 	key->keySize = size;
 	key->keyUSize = usize;
+	key->namePrefix = namePrefix;
 
 	if (!found && !(options & KDB_O_NODEFAULT))
 	{
@@ -2075,7 +2739,16 @@ static Key * elektraLookupOpmphmSearch (KeySet * ks, Key const * key, option_t o
 	ELEKTRA_ASSERT (opmphmIsBuild (ks->opmphm), "OPMPHM not build");
 	cursor_t cursor = 0;
 	cursor = ksGetCursor (ks);
-	size_t index = opmphmLookup (ks->opmphm, ks->size, keyName (key));
+	size_t index;
+	if (ks->opmphm->delta)
+	{
+		// the KeySet changed since the OPMPHM was build
+		index = opmphmDeltaLookup (ks->opmphm, ks->size, keyName (key), elektraOpmphmGetString, (void **) ks->array);
+	}
+	else
+	{
+		index = opmphmLookup (ks->opmphm, ks->size, keyName (key));
+	}
 	if (index >= ks->size)
 	{
 		return 0;
@@ -2103,6 +2776,55 @@ static Key * elektraLookupOpmphmSearch (KeySet * ks, Key const * key, option_t o
 	}
 }
 
+/**
+ * @internal
+ *
+ * @brief Searches for a Key with the ElektraKsIndex of large KeySets.
+ *
+ * Small KeySets and KeySets that changed recently are searched with
+ * binary search. The index is build once enough lookups happened
+ * since the last change.
+ *
+ * @param ks the KeySet
+ * @param key the Key to search for
+ * @param options lookup options
+ *
+ * @return Key * when key found
+ * @return NULL when key not found
+ */
+static Key * elektraLookupIndexSearch (KeySet * ks, Key const * key, option_t options)
+{
+	if (ks->size < ELEKTRA_KS_INDEX_MIN_SIZE)
+	{
+		return elektraLookupBinarySearch (ks, key, options);
+	}
+	if (!ks->index)
+	{
+		ks->index = elektraKsIndexNew ();
+		if (!ks->index) return elektraLookupBinarySearch (ks, key, options);
+	}
+	if (!elektraKsIndexIsBuild (ks->index))
+	{
+		if (++ks->index->lookups * ELEKTRA_KS_INDEX_BUILD_RATIO < ks->size || elektraKsIndexBuild (ks->index, ks))
+		{
+			return elektraLookupBinarySearch (ks, key, options);
+		}
+	}
+
+	ssize_t index = elektraKsIndexLookup (ks->index, ks, key);
+	if (index < 0)
+	{
+		return 0;
+	}
+
+	if (options & KDB_O_POP)
+	{
+		return elektraKsPopAtCursor (ks, index);
+	}
+	ksSetCursor (ks, index);
+	return ks->array[index];
+}
+
 #endif
 
 /**
@@ -2184,12 +2906,12 @@ static Key * elektraLookupSearch (KeySet * ks, Key * key, option_t options)
 		else
 		{
 			// when OPMPHM build fails use binary search as backup
-			found = elektraLookupBinarySearch (ks, key, options);
+			found = elektraLookupIndexSearch (ks, key, options);
 		}
 	}
 	else if ((options & (KDB_O_BINSEARCH | KDB_O_OPMPHM)) == KDB_O_BINSEARCH)
 	{
-		found = elektraLookupBinarySearch (ks, key, options);
+		found = elektraLookupIndexSearch (ks, key, options);
 	}
 	else
 	{
@@ -2200,7 +2922,7 @@ static Key * elektraLookupSearch (KeySet * ks, Key * key, option_t options)
 		}
 		else
 		{
-			found = elektraLookupBinarySearch (ks, key, options);
+			found = elektraLookupIndexSearch (ks, key, options);
 		}
 	}
 
@@ -2330,6 +3052,8 @@ Key * ksLookup (KeySet * ks, Key * key, option_t options)
 	const char * name = key->key;
 	if (!name) return 0;
 
+	if (elektraKsBuilderPending (ks) == -1) return 0;
+
 	Key * ret = 0;
 	const int mask = ~KDB_O_DEL & ~KDB_O_CREATE;
 
@@ -2437,6 +3161,7 @@ Key * ksLookupByName (KeySet * ks, const char * name, option_t options)
 int ksResize (KeySet * ks, size_t alloc)
 {
 	if (!ks) return -1;
+	if (elektraKsViewPromote (ks) == -1) return -1;
 
 	alloc++; /* for ending null byte */
 	if (alloc == ks->alloc) return 1;
@@ -2530,11 +3255,16 @@ int ksInit (KeySet * ks)
 
 #ifdef ELEKTRA_ENABLE_OPTIMIZATIONS
 	ks->opmphm = NULL;
+	ks->index = NULL;
 	// first lookup should predict so invalidate it
 	elektraOpmphmInvalidate (ks);
 	ks->opmphmPredictor = NULL;
 #endif
 
+	ks->arena = NULL;
+	ks->metaShares = 0;
+	ks->snapshotEpoch = 0;
+
 	return 0;
 }
 
@@ -2552,15 +3282,38 @@ int ksClose (KeySet * ks)
 	Key * k;
 
 	ksRewind (ks);
-	while ((k = ksNext (ks)) != 0)
+	if (test_bit (ks->flags, KS_FLAG_VIEW))
 	{
-		keyDecRef (k);
-		keyDel (k);
+		// keys and array belong to the viewed KeySet
+		clear_bit (ks->flags, (keyflag_t) KS_FLAG_VIEW);
 	}
-
-	if (ks->array && !test_bit (ks->flags, KS_FLAG_MMAP_ARRAY))
+	else if (test_bit (ks->flags, KS_FLAG_SHARED_ARRAY))
 	{
-		elektraFree (ks->array);
+		// the last KeySet using the array releases the keys
+		ElektraKsShared * shared = ELEKTRA_KS_SHARED (ks);
+		if (--shared->refs == 0)
+		{
+			while ((k = ksNext (ks)) != 0)
+			{
+				keyDecRef (k);
+				keyDel (k);
+			}
+			elektraFree (shared);
+		}
+		clear_bit (ks->flags, (keyflag_t) KS_FLAG_SHARED_ARRAY);
+	}
+	else
+	{
+		while ((k = ksNext (ks)) != 0)
+		{
+			keyDecRef (k);
+			keyDel (k);
+		}
+
+		if (ks->array && !test_bit (ks->flags, KS_FLAG_MMAP_ARRAY))
+		{
+			elektraFree (ks->array);
+		}
 	}
 	clear_bit (ks->flags, (keyflag_t) KS_FLAG_MMAP_ARRAY);
 
@@ -581,25 +581,27 @@ keyswitch_t keyCompare (const Key * key1, const Key * key2)
  */
 int keyCompareMeta (const Key * k1, const Key * k2)
 {
-	const Key * meta1;
+	// keys sharing their metadata have the same metadata
+	if (k1->meta == k2->meta) return 0;
 
-	Key * key1 = (Key *) k1;
-	Key * key2 = (Key *) k2;
+	// iterate the arrays directly, the cursor is shared with other keys
+	size_t size1 = k1->meta ? k1->meta->size : 0;
+	size_t size2 = k2->meta ? k2->meta->size : 0;
 
-	keyRewindMeta (key1);
-	keyRewindMeta (key2);
-	while ((meta1 = keyNextMeta (key1)) != 0)
+	for (size_t i = 0; i < size1; ++i)
 	{
-		const Key * meta2 = keyNextMeta (key2);
-		if (!meta2)
+		if (i >= size2)
 		{
 			return KEY_META;
 		}
 
+		const Key * meta1 = k1->meta->array[i];
+		const Key * meta2 = k2->meta->array[i];
+		if (meta1 == meta2) continue;
+
 		if (strcmp (keyName (meta1), keyName (meta2))) return KEY_META;
 		if (strcmp (keyString (meta1), keyString (meta2))) return KEY_META;
 	}
 
-	// TODO: rewind metadata to previous position
 	return 0;
 }
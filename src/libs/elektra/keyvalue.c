@@ -554,10 +554,10 @@ ssize_t keySetRaw (Key * key, const void * newBinary, size_t dataSize)
 	}
 	else
 	{
-		char * p = elektraMalloc (key->dataSize);
+		// first value of keys in an arena goes into the arena
+		void * p = elektraKeyValueDupFor (key, newBinary, key->dataSize);
 		if (NULL == p) return -1;
 		key->data.v = p;
-		memcpy (key->data.v, newBinary, key->dataSize);
 	}
 
 	set_bit (key->flags, KEY_FLAG_SYNC);
@@ -0,0 +1,268 @@
+/**
+ * @file
+ *
+ * @brief Eytzinger ordered search index for large KeySets.
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ */
+
+#ifdef HAVE_KDBCONFIG_H
+#include "kdbconfig.h"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "kdbprivate.h"
+#include <kdbassert.h>
+
+/**
+ * @internal
+ *
+ * @brief Reads 8 bytes of an unescaped name, starting at @p offset
+ *
+ * Bytes behind the end of the name are 0. Like Key::namePrefix the result
+ * compares like memcmp() on these bytes.
+ *
+ * @param name the unescaped name
+ * @param size the size of the unescaped name
+ * @param offset the first byte
+ *
+ * @return the bytes as big-endian integer
+ */
+static uint64_t elektraKsIndexPrefix (const char * name, size_t size, size_t offset)
+{
+	const unsigned char * uname = (const unsigned char *) name;
+	uint64_t prefix = 0;
+
+	for (size_t i = offset; i < offset + sizeof (prefix); ++i)
+	{
+		prefix <<= 8;
+		if (i < size) prefix |= uname[i];
+	}
+
+	return prefix;
+}
+
+/**
+ * @internal
+ *
+ * @brief Compares two unescaped names, which are equal up to @p offset
+ *
+ * @return < 0, 0 or > 0 like keyCmp() without owner
+ */
+static int elektraKsIndexCmp (const char * name1, size_t size1, const char * name2, size_t size2, size_t offset)
+{
+	const size_t size = size1 < size2 ? size1 : size2;
+	int ret = 0;
+
+	if (size > offset)
+	{
+		ret = memcmp (name1 + offset, name2 + offset, size - offset);
+	}
+
+	if (ret == 0 && size1 != size2)
+	{
+		ret = size1 < size2 ? -1 : 1;
+	}
+	return ret;
+}
+
+/**
+ * @internal
+ *
+ * @brief Fills the subtree of node @p k with the Keys starting at @p i
+ *
+ * An in-order traversal of the implicit tree visits the nodes in the
+ * order of the KeySet.
+ *
+ * @return the position of the first Key not in the subtree
+ */
+static size_t elektraKsIndexFill (ElektraKsIndex * index, Key ** array, size_t i, size_t k)
+{
+	if (k > index->size) return i;
+
+	i = elektraKsIndexFill (index, array, i, 2 * k);
+
+	ElektraKsIndexNode * node = &index->nodes[k];
+	const Key * key = array[i];
+	node->name = key->key + key->keySize;
+	node->nameSize = key->keyUSize;
+	node->index = i;
+	node->prefix[0] = elektraKsIndexPrefix (node->name, node->nameSize, index->commonSize);
+	node->prefix[1] = elektraKsIndexPrefix (node->name, node->nameSize, index->commonSize + sizeof (uint64_t));
+
+	return elektraKsIndexFill (index, array, i + 1, 2 * k + 1);
+}
+
+/**
+ * @internal
+ *
+ * @brief Allocates an empty ElektraKsIndex
+ *
+ * @return the new index or NULL on memory error
+ */
+ElektraKsIndex * elektraKsIndexNew (void)
+{
+	return elektraCalloc (sizeof (ElektraKsIndex));
+}
+
+/**
+ * @internal
+ *
+ * @brief Frees an ElektraKsIndex
+ *
+ * @param index the index, may be NULL
+ */
+void elektraKsIndexDel (ElektraKsIndex * index)
+{
+	if (!index) return;
+	elektraKsIndexClear (index);
+	elektraFree (index);
+}
+
+/**
+ * @internal
+ *
+ * @brief Invalidates an ElektraKsIndex
+ *
+ * Must be called whenever the KeySet changes.
+ * Also resets the lookup counter.
+ *
+ * @param index the index
+ */
+void elektraKsIndexClear (ElektraKsIndex * index)
+{
+	ELEKTRA_NOT_NULL (index);
+	if (index->nodes) elektraFree (index->nodes);
+	index->nodes = NULL;
+	index->size = 0;
+	index->lookups = 0;
+}
+
+/**
+ * @internal
+ *
+ * @retval 1 if the index can be used for lookups
+ * @retval 0 otherwise
+ */
+int elektraKsIndexIsBuild (const ElektraKsIndex * index)
+{
+	return index && index->nodes;
+}
+
+/**
+ * @internal
+ *
+ * @brief Builds the index over the current array of @p ks
+ *
+ * The Keys of a large KeySet usually share a long common prefix,
+ * e.g. the mountpoint. The nodes therefore store the 16 bytes following
+ * the prefix of all names, not the first bytes.
+ *
+ * @param index the not build index
+ * @param ks the sorted KeySet
+ *
+ * @retval 0 on success
+ * @retval -1 on memory error, an empty or a too large KeySet
+ */
+int elektraKsIndexBuild (ElektraKsIndex * index, const KeySet * ks)
+{
+	ELEKTRA_ASSERT (!elektraKsIndexIsBuild (index), "index already build");
+	if (!ks->size || ks->size >= UINT32_MAX) return -1;
+	for (size_t i = 0; i < ks->size; ++i)
+	{
+		if (ks->array[i]->keyUSize >= UINT32_MAX) return -1;
+	}
+
+	index->nodes = elektraMalloc ((ks->size + 1) * sizeof (ElektraKsIndexNode));
+	if (!index->nodes) return -1;
+	index->size = ks->size;
+
+	// all Keys between the first and the last one share their common prefix
+	const Key * first = ks->array[0];
+	const Key * last = ks->array[ks->size - 1];
+	const char * firstName = first->key + first->keySize;
+	const char * lastName = last->key + last->keySize;
+	const size_t max = first->keyUSize < last->keyUSize ? first->keyUSize : last->keyUSize;
+	size_t common = 0;
+	while (common < max && firstName[common] == lastName[common])
+	{
+		++common;
+	}
+	index->commonSize = common;
+
+	elektraKsIndexFill (index, ks->array, 0, 1);
+	return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Searches for @p key
+ *
+ * Descends through the Eytzinger layout to the first Key not smaller
+ * than @p key. The names are only read if the inline prefixes are equal.
+ *
+ * @param index the index build for @p ks
+ * @param ks the KeySet
+ * @param key the Key to search for
+ *
+ * @return the position of the Key in @p ks
+ * @retval -1 if no Key with the name of @p key is in @p ks
+ */
+ssize_t elektraKsIndexLookup (const ElektraKsIndex * index, const KeySet * ks, const Key * key)
+{
+	ELEKTRA_ASSERT (elektraKsIndexIsBuild (index) && index->size == ks->size, "index not build for this KeySet");
+	const size_t common = index->commonSize;
+	const Key * first = ks->array[0];
+
+	if (key->keyUSize < common || memcmp (key->key + key->keySize, first->key + first->keySize, common))
+	{
+		// not below the common prefix of all Keys
+		return -1;
+	}
+
+	const char * name = key->key + key->keySize;
+	const size_t nameSize = key->keyUSize;
+	const size_t offset = common + 2 * sizeof (uint64_t);
+	const uint64_t prefix0 = elektraKsIndexPrefix (name, nameSize, common);
+	const uint64_t prefix1 = elektraKsIndexPrefix (name, nameSize, common + sizeof (uint64_t));
+	const ElektraKsIndexNode * nodes = index->nodes;
+	size_t k = 1;
+
+	while (k <= index->size)
+	{
+#ifdef __GNUC__
+		// the grandchildren share two cache lines
+		__builtin_prefetch (nodes + 4 * k);
+#endif
+		const ElektraKsIndexNode * node = &nodes[k];
+		int less;
+		if (node->prefix[0] != prefix0)
+		{
+			less = node->prefix[0] < prefix0;
+		}
+		else if (node->prefix[1] != prefix1)
+		{
+			less = node->prefix[1] < prefix1;
+		}
+		else
+		{
+			less = elektraKsIndexCmp (node->name, node->nameSize, name, nameSize, offset) < 0;
+		}
+		k = 2 * k + less;
+	}
+
+	// the result is the last node where the search went left
+	while (k & 1)
+	{
+		k >>= 1;
+	}
+	k >>= 1;
+
+	if (!k || nodes[k].prefix[0] != prefix0 || nodes[k].prefix[1] != prefix1) return -1;
+	if (elektraKsIndexCmp (nodes[k].name, nodes[k].nameSize, name, nameSize, offset)) return -1;
+	return nodes[k].index;
+}
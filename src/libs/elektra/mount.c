@@ -30,6 +30,8 @@
 #include <stdio.h>
 #endif
 
+#include <inttypes.h>
+
 #include <kdbassert.h>
 
 #include "kdbinternal.h"
@@ -277,6 +279,50 @@ Key * elektraMountGlobalsFindPlugin (KeySet * referencePlugins, Key * cur)
 	return refKey;
 }
 
+/**
+ * @brief Passes the settings of the shared cache to the cache plugin
+ *
+ * Adds the directory of the shared cache (`system/elektra/cache/shared`)
+ * and a hash of the mount configuration to the configuration of the plugin.
+ * Processes with different mount configurations use different caches.
+ *
+ * @param config the configuration of the cache plugin
+ * @param system the bootstrap keys including the mount configuration
+ */
+static void elektraMountGlobalsCacheConfig (KeySet * config, KeySet * system)
+{
+	Key * shared = ksLookupByName (system, "system/elektra/cache/shared", 0);
+	if (!shared) return;
+
+	Key * root = keyNew ("system/elektra/mountpoints", KEY_END);
+	KeySet * mountpoints = ksView (system, root);
+	keyDel (root);
+
+	// 64 bit FNV-1a over all names and values
+	uint64_t hash = 14695981039346656037ULL;
+	Key * cur;
+	ksRewind (mountpoints);
+	while ((cur = ksNext (mountpoints)) != 0)
+	{
+		const unsigned char * name = (const unsigned char *) keyName (cur);
+		const unsigned char * value = keyValue (cur);
+		for (ssize_t i = 0; i < keyGetNameSize (cur); ++i)
+		{
+			hash = (hash ^ name[i]) * 1099511628211ULL;
+		}
+		for (ssize_t i = 0; i < keyGetValueSize (cur); ++i)
+		{
+			hash = (hash ^ value[i]) * 1099511628211ULL;
+		}
+	}
+	ksDel (mountpoints);
+
+	char hashString[2 * sizeof (hash) + 1];
+	snprintf (hashString, sizeof (hashString), "%016" PRIx64, hash);
+	ksAppendKey (config, keyNew ("system/shared", KEY_VALUE, keyString (shared), KEY_END));
+	ksAppendKey (config, keyNew ("system/shared/mountpoints", KEY_VALUE, hashString, KEY_END));
+}
+
 /**
  * Loads global plugin
  *
@@ -309,6 +355,8 @@ int elektraMountGlobalsLoadPlugin (Plugin ** plugin, KeySet * referencePlugins,
 			return 0;
 		}
 
+		if (!elektraStrCmp (pluginName, "cache")) elektraMountGlobalsCacheConfig (config, system);
+
 		// loading the new plugin
 		*plugin = elektraPluginOpen (pluginName, modules, config, openKey);
 		if (!(*plugin) && !elektraStrCmp (pluginName, "cache") && !ksLookupByName (system, "system/elektra/cache/enabled", 0))
@@ -53,6 +53,217 @@ size_t opmphmLookup (Opmphm * opmphm, size_t n, const void * name)
 	return ret % n;
 }
 
+/**
+ * @brief Counts the orders in a sorted array smaller than order.
+ *
+ * @param orders the sorted array
+ * @param size the number of elements in orders
+ * @param order the order to compare with
+ *
+ * @retval size_t the number of orders smaller than order
+ */
+static size_t opmphmDeltaCount (const size_t * orders, size_t size, size_t order)
+{
+	size_t l = 0;
+	size_t h = size;
+	while (l < h)
+	{
+		size_t m = l + (h - l) / 2;
+		if (orders[m] < order)
+		{
+			l = m + 1;
+		}
+		else
+		{
+			h = m;
+		}
+	}
+	return l;
+}
+
+/**
+ * @brief Returns the order of the live element with the given number of live elements in front of it.
+ *
+ * @param delta the delta
+ * @param live the number of not removed elements of the OPMPHM in front of the element
+ *
+ * @retval size_t the order of the element, `delta->n` if behind all elements
+ */
+static size_t opmphmDeltaSelect (const OpmphmDelta * delta, size_t live)
+{
+	size_t order = live;
+	for (size_t i = 0; i < delta->removedSize && delta->removed[i] <= order; ++i)
+	{
+		++order;
+	}
+	return order;
+}
+
+/**
+ * @brief Returns the current index of the inserted element at position i of `delta->inserted`.
+ */
+static size_t opmphmDeltaInsertedIndex (const OpmphmDelta * delta, size_t i)
+{
+	size_t order = delta->inserted[i];
+	return order - opmphmDeltaCount (delta->removed, delta->removedSize, order) + i;
+}
+
+/**
+ * @brief Returns the delta of the OPMPHM, creates it when not here.
+ *
+ * @param opmphm the build OPMPHM
+ * @param n the number of elements, the OPMPHM was build for n elements if there is no delta
+ *
+ * @return the delta
+ * @retval NULL on memory error
+ */
+static OpmphmDelta * opmphmDeltaGet (Opmphm * opmphm, size_t n)
+{
+	if (!opmphm->delta)
+	{
+		opmphm->delta = elektraCalloc (sizeof (OpmphmDelta));
+		if (!opmphm->delta) return NULL;
+		opmphm->delta->n = n;
+	}
+	return opmphm->delta;
+}
+
+/**
+ * @brief Records an element inserted after the OPMPHM was build.
+ *
+ * The inserted element is not part of the OPMPHM, but the order of all elements behind it changes.
+ * The OPMPHM must be build.
+ *
+ * @param opmphm the OPMPHM
+ * @param n the number of elements before the insertion
+ * @param index the position of the inserted element
+ *
+ * @retval 0 on success
+ * @retval -1 on memory error or when the delta is full, the OPMPHM needs to be rebuild then
+ */
+int opmphmDeltaInsert (Opmphm * opmphm, size_t n, size_t index)
+{
+	ELEKTRA_NOT_NULL (opmphm);
+	ELEKTRA_ASSERT (opmphmIsBuild (opmphm), "OPMPHM not build");
+	ELEKTRA_ASSERT (index <= n, "index %zu out of range", index);
+	OpmphmDelta * delta = opmphmDeltaGet (opmphm, n);
+	if (!delta || delta->insertedSize + delta->removedSize >= OPMPHM_DELTA_MAX) return -1;
+
+	// inserted elements in front of the new one
+	size_t i = 0;
+	while (i < delta->insertedSize && opmphmDeltaInsertedIndex (delta, i) < index)
+	{
+		++i;
+	}
+	// the new element is placed in front of the live element with this order
+	size_t order = opmphmDeltaSelect (delta, index - i);
+	if (i < delta->insertedSize && delta->inserted[i] < order)
+	{
+		order = delta->inserted[i];
+	}
+
+	memmove (delta->inserted + i + 1, delta->inserted + i, (delta->insertedSize - i) * sizeof (size_t));
+	delta->inserted[i] = order;
+	++delta->insertedSize;
+	return 0;
+}
+
+/**
+ * @brief Records an element removed after the OPMPHM was build.
+ *
+ * The OPMPHM must be build.
+ *
+ * @param opmphm the OPMPHM
+ * @param n the number of elements before the removal
+ * @param index the position of the removed element
+ *
+ * @retval 0 on success
+ * @retval -1 on memory error or when the delta is full, the OPMPHM needs to be rebuild then
+ */
+int opmphmDeltaRemove (Opmphm * opmphm, size_t n, size_t index)
+{
+	ELEKTRA_NOT_NULL (opmphm);
+	ELEKTRA_ASSERT (opmphmIsBuild (opmphm), "OPMPHM not build");
+	ELEKTRA_ASSERT (index < n, "index %zu out of range", index);
+	OpmphmDelta * delta = opmphmDeltaGet (opmphm, n);
+	if (!delta) return -1;
+
+	size_t i = 0;
+	for (; i < delta->insertedSize; ++i)
+	{
+		size_t insertedIndex = opmphmDeltaInsertedIndex (delta, i);
+		if (insertedIndex == index)
+		{
+			// removal of an inserted element reverts the insertion
+			--delta->insertedSize;
+			memmove (delta->inserted + i, delta->inserted + i + 1, (delta->insertedSize - i) * sizeof (size_t));
+			return 0;
+		}
+		if (insertedIndex > index) break;
+	}
+
+	if (delta->insertedSize + delta->removedSize >= OPMPHM_DELTA_MAX) return -1;
+
+	size_t order = opmphmDeltaSelect (delta, index - i);
+	size_t pos = opmphmDeltaCount (delta->removed, delta->removedSize, order);
+	memmove (delta->removed + pos + 1, delta->removed + pos, (delta->removedSize - pos) * sizeof (size_t));
+	delta->removed[pos] = order;
+	++delta->removedSize;
+	return 0;
+}
+
+/**
+ * @brief Returns the current index of an element of the OPMPHM.
+ *
+ * @param opmphm the OPMPHM
+ * @param order the order of the element returned by `opmphmLookup ()`
+ *
+ * @retval size_t the current index of the element
+ * @retval SIZE_MAX if the element was removed
+ */
+size_t opmphmDeltaIndex (const Opmphm * opmphm, size_t order)
+{
+	ELEKTRA_NOT_NULL (opmphm);
+	const OpmphmDelta * delta = opmphm->delta;
+	if (!delta) return order;
+
+	size_t removed = opmphmDeltaCount (delta->removed, delta->removedSize, order);
+	if (removed < delta->removedSize && delta->removed[removed] == order) return SIZE_MAX;
+
+	return order - removed + opmphmDeltaCount (delta->inserted, delta->insertedSize, order + 1);
+}
+
+/**
+ * @brief Looks up a element in the OPMPHM and its delta.
+ *
+ * In contrast to `opmphmLookup ()` the found element is already compared with name.
+ *
+ * @param opmphm the build OPMPHM
+ * @param n the current number of elements
+ * @param name the name of the element
+ * @param getName function to extract the name of an element
+ * @param data the current elements
+ *
+ * @retval size_t the current index of the element
+ * @retval n if the element is not found
+ */
+size_t opmphmDeltaLookup (Opmphm * opmphm, size_t n, const char * name, opmphmGetName getName, void ** data)
+{
+	ELEKTRA_NOT_NULL (opmphm);
+	ELEKTRA_NOT_NULL (opmphm->delta);
+	const OpmphmDelta * delta = opmphm->delta;
+
+	size_t index = opmphmDeltaIndex (opmphm, opmphmLookup (opmphm, delta->n, name));
+	if (index < n && !strcmp (getName (data[index]), name)) return index;
+
+	for (size_t i = 0; i < delta->insertedSize; ++i)
+	{
+		index = opmphmDeltaInsertedIndex (delta, i);
+		if (!strcmp (getName (data[index]), name)) return index;
+	}
+	return n;
+}
+
 /**
  * @brief Assigns the vertices of the r-uniform r-partite hypergraph.
  *
@@ -569,6 +780,18 @@ int opmphmCopy (Opmphm * dest, const Opmphm * source)
 		memcpy (dest->graph, source->graph, source->size);
 	}
 
+	if (source->delta)
+	{
+		dest->delta = elektraMalloc (sizeof (OpmphmDelta));
+		if (!dest->delta)
+		{
+			if (source->rUniPar) elektraFree (dest->hashFunctionSeeds);
+			if (source->size) elektraFree (dest->graph);
+			return -1;
+		}
+		memcpy (dest->delta, source->delta, sizeof (OpmphmDelta));
+	}
+
 	// copy values
 	dest->componentSize = source->componentSize;
 	dest->rUniPar = source->rUniPar;
@@ -620,6 +843,7 @@ void opmphmDel (Opmphm * opmphm)
  *
  * The OPMPHM must be successfully created with `opmphmNew ()`.
  * Clears and frees all internal memory of Opmphm, but not `Opmphm->hashFunctionSeeds` and the Opmphm instance.
+ * Also drops the delta, the OPMPHM needs to be rebuild afterwards.
  *
  * @param opmphm the OPMPHM
  */
@@ -632,6 +856,11 @@ void opmphmClear (Opmphm * opmphm)
 		clear_bit (opmphm->flags, OPMPHM_FLAG_MMAP_GRAPH);
 		opmphm->size = 0;
 	}
+	if (opmphm->delta)
+	{
+		elektraFree (opmphm->delta);
+		opmphm->delta = NULL;
+	}
 }
 
 /**
@@ -388,6 +388,44 @@ size_t elektraPluginGetFunction (Plugin * plugin, const char * name)
 	return func;
 }
 
+/**
+ * Checks if a plugin is marked as thread-safe.
+ *
+ * Queries the contract of the plugin like elektraPluginGetFunction().
+ *
+ * @param  plugin Plugin handle
+ * @retval 1 if `threadsafe` is in `infos/status`
+ * @retval 0 otherwise
+ */
+int elektraPluginIsThreadSafe (Plugin * plugin)
+{
+	KeySet * contract = ksNew (0, KS_END);
+	Key * pk = keyNew ("system/elektra/modules", KEY_END);
+	keyAddBaseName (pk, plugin->name);
+	plugin->kdbGet (plugin, contract, pk);
+	keyAddName (pk, "infos/status");
+	const Key * status = ksLookup (contract, pk, 0);
+
+	int ret = 0;
+	const char * word = status ? keyString (status) : "";
+	const size_t size = sizeof ("threadsafe") - 1;
+	while ((word = strstr (word, "threadsafe")) != NULL)
+	{
+		if ((word == keyString (status) || isspace ((unsigned char) word[-1])) &&
+		    (word[size] == '\0' || isspace ((unsigned char) word[size])))
+		{
+			ret = 1;
+			break;
+		}
+		word += size;
+	}
+
+	keyDel (pk);
+	ksDel (contract);
+	return ret;
+}
+
+
 static int elektraMissingGet (Plugin * plugin ELEKTRA_UNUSED, KeySet * ks ELEKTRA_UNUSED, Key * error)
 {
 	ELEKTRA_SET_INSTALLATION_ERRORF (error, "Tried to get a key from a missing backend: %s", keyName (error));
@@ -22,11 +22,14 @@ Key * elektraKsPopAtCursor (KeySet * ks, cursor_t pos)
 
 	size_t c = pos;
 	if (c >= ks->size) return 0;
+	if (elektraKsViewPromote (ks) == -1) return 0;
 
 	if (c != ks->size - 1)
 	{
 		Key ** found = ks->array + c;
 		Key * k = *found;
+		// the key is moved to the end, so that ksPop() removes it
+		elektraOpmphmKeyRemoved (ks, c);
 		/* Move the array over the place where key was found
 		 *
 		 * e.g. c = 2
@@ -40,6 +43,7 @@ Key * elektraKsPopAtCursor (KeySet * ks, cursor_t pos)
 		 * */
 		memmove (found, found + 1, (ks->size - c - 1) * sizeof (Key *));
 		*(ks->array + ks->size - 1) = k; // prepare last element to pop
+		elektraOpmphmKeyInserted (ks, ks->size - 1);
 	}
 	else
 	{
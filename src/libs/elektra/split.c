@@ -62,10 +62,32 @@ Split * splitNew (void)
 	ret->handles = elektraCalloc (sizeof (KDB *) * ret->alloc);
 	ret->parents = elektraCalloc (sizeof (Key *) * ret->alloc);
 	ret->syncbits = elektraCalloc (sizeof (int) * ret->alloc);
+	ret->sources = elektraCalloc (sizeof (KeySet *) * ret->alloc);
+	ret->shared = elektraCalloc (sizeof (KeySet *) * ret->alloc);
+	ret->states = elektraCalloc (sizeof (KeySet *) * ret->alloc);
 
 	return ret;
 }
 
+/**
+ * @internal
+ *
+ * @brief Gives the duplicates of @p shared still used by plugins their own names and values.
+ *
+ * @param shared the duplicates created by splitPrepare()
+ * @param sources the keys they were duplicated from, in the same order
+ */
+static void splitUnshare (KeySet * shared, KeySet * sources)
+{
+	for (size_t i = 0; i < shared->size; ++i)
+	{
+		// only referenced by shared, so deleted below
+		if (shared->array[i]->ksReference <= 1) continue;
+
+		elektraKeyUnshare (shared->array[i], sources->array[i]);
+	}
+}
+
 
 /**
  * Delete a split object.
@@ -82,11 +104,21 @@ void splitDel (Split * keysets)
 		ksDel (keysets->keysets[i]);
 		keyDecRef (keysets->parents[i]);
 		keyDel (keysets->parents[i]);
+		if (keysets->shared[i])
+		{
+			splitUnshare (keysets->shared[i], keysets->sources[i]);
+			ksDel (keysets->shared[i]);
+			ksDel (keysets->sources[i]);
+		}
+		ksDel (keysets->states[i]);
 	}
 	elektraFree (keysets->keysets);
 	elektraFree (keysets->handles);
 	elektraFree (keysets->parents);
 	elektraFree (keysets->syncbits);
+	elektraFree (keysets->sources);
+	elektraFree (keysets->shared);
+	elektraFree (keysets->states);
 	elektraFree (keysets);
 }
 
@@ -106,6 +138,7 @@ void splitRemove (Split * split, size_t where)
 	ELEKTRA_ASSERT (where < split->size, "cannot remove behind size: %zu smaller than %zu", where, split->size);
 	ksDel (split->keysets[where]);
 	keyDel (split->parents[where]);
+	ksDel (split->states[where]);
 	--split->size; // reduce size
 	for (size_t i = where; i < split->size; ++i)
 	{
@@ -113,6 +146,9 @@ void splitRemove (Split * split, size_t where)
 		split->handles[i] = split->handles[i + 1];
 		split->parents[i] = split->parents[i + 1];
 		split->syncbits[i] = split->syncbits[i + 1];
+		split->sources[i] = split->sources[i + 1];
+		split->shared[i] = split->shared[i + 1];
+		split->states[i] = split->states[i + 1];
 	}
 }
 
@@ -130,6 +166,9 @@ static void splitResize (Split * split)
 	elektraRealloc ((void **) &split->handles, split->alloc * sizeof (KDB *));
 	elektraRealloc ((void **) &split->parents, split->alloc * sizeof (Key *));
 	elektraRealloc ((void **) &split->syncbits, split->alloc * sizeof (int));
+	elektraRealloc ((void **) &split->sources, split->alloc * sizeof (KeySet *));
+	elektraRealloc ((void **) &split->shared, split->alloc * sizeof (KeySet *));
+	elektraRealloc ((void **) &split->states, split->alloc * sizeof (KeySet *));
 }
 
 /**
@@ -167,6 +206,9 @@ ssize_t splitAppend (Split * split, Backend * backend, Key * parentKey, int sync
 	split->handles[n] = backend;
 	split->parents[n] = parentKey;
 	split->syncbits[n] = syncbits;
+	split->sources[n] = 0;
+	split->shared[n] = 0;
+	split->states[n] = 0;
 
 	return n;
 }
@@ -352,6 +394,164 @@ int splitBuildup (Split * split, KDB * kdb, Key * parentKey)
 }
 
 
+/**
+ * @internal
+ *
+ * @brief A mountpoint of the handle with its backend
+ */
+typedef struct
+{
+	const Key * mountpoint; /*!< the name the backend is mounted at */
+	Backend * backend;	/*!< the mounted backend */
+	size_t order;		/*!< position in the split of the handle, the last mount wins */
+} ElektraSplitMountpoint;
+
+/**
+ * @internal
+ *
+ * @brief State of walking over a sorted KeySet along the sorted mountpoints
+ *
+ * Keys below a mountpoint form a contiguous range of the KeySet, like
+ * the keys cut out by ksCut(). The walk merges the keys with the
+ * mountpoints and keeps the mountpoints above the current key on a stack,
+ * so that every key is only compared with the innermost of them and
+ * the next mountpoint.
+ */
+typedef struct
+{
+	ElektraSplitMountpoint * mountpoints; /*!< all mountpoints sorted by name, NULL to use mountGetBackend() */
+	size_t size;			      /*!< number of mountpoints */
+	size_t next;			      /*!< first mountpoint not reached yet */
+	size_t * stack;			      /*!< positions of the mountpoints above the current key */
+	size_t depth;			      /*!< number of mountpoints on the stack */
+} ElektraSplitWalk;
+
+static int elektraSplitMountpointCmp (const void * a, const void * b)
+{
+	const ElektraSplitMountpoint * m1 = a;
+	const ElektraSplitMountpoint * m2 = b;
+	int ret = keyCmp (m1->mountpoint, m2->mountpoint);
+	if (ret != 0) return ret;
+	return (m1->order > m2->order) - (m1->order < m2->order);
+}
+
+/**
+ * @internal
+ *
+ * @brief Sorts the mountpoints of the handle for elektraSplitWalkNext()
+ *
+ * Every backend in the trie has been appended to the split of the
+ * handle with its mountpoint as parent by mountBackend().
+ *
+ * If the mountpoints are not available, e.g. on memory errors, the walk
+ * falls back to looking up every key with mountGetBackend().
+ *
+ * @param walk the walk to initialize
+ * @param handle the handle with the mountpoints
+ */
+static void elektraSplitWalkInit (ElektraSplitWalk * walk, KDB * handle)
+{
+	memset (walk, 0, sizeof (ElektraSplitWalk));
+
+	const Split * mounted = handle->split;
+	if (!mounted || mounted->size == 0) return;
+
+	walk->mountpoints = elektraMalloc (mounted->size * sizeof (ElektraSplitMountpoint));
+	walk->stack = elektraMalloc (mounted->size * sizeof (size_t));
+	if (!walk->mountpoints || !walk->stack)
+	{
+		elektraFree (walk->mountpoints);
+		elektraFree (walk->stack);
+		walk->mountpoints = 0;
+		walk->stack = 0;
+		return;
+	}
+
+	for (size_t i = 0; i < mounted->size; ++i)
+	{
+		if (!mounted->parents[i] || !mounted->handles[i]) continue;
+		walk->mountpoints[walk->size].mountpoint = mounted->parents[i];
+		walk->mountpoints[walk->size].backend = mounted->handles[i];
+		walk->mountpoints[walk->size].order = i;
+		++walk->size;
+	}
+	qsort (walk->mountpoints, walk->size, sizeof (ElektraSplitMountpoint), elektraSplitMountpointCmp);
+}
+
+static void elektraSplitWalkClose (ElektraSplitWalk * walk)
+{
+	elektraFree (walk->mountpoints);
+	elektraFree (walk->stack);
+}
+
+/**
+ * @internal
+ *
+ * @brief Removes all mountpoints from the stack, which are not above or same as @p key
+ */
+static void elektraSplitWalkLeave (ElektraSplitWalk * walk, const Key * key)
+{
+	while (walk->depth > 0 && keyIsBelowOrSame (walk->mountpoints[walk->stack[walk->depth - 1]].mountpoint, key) != 1)
+	{
+		--walk->depth;
+	}
+}
+
+/**
+ * @internal
+ *
+ * @brief Finds the range of keys starting at @p from, which belong to the same backend
+ *
+ * The range ends before the first key which is not below the innermost
+ * mountpoint of the key at @p from or which reaches the next mountpoint.
+ * Without any mountpoint above it, the range ends at the next namespace.
+ *
+ * @pre the ranges are requested in the order of @p ks
+ *
+ * @param walk the walk initialized with elektraSplitWalkInit()
+ * @param handle to get the default backend from
+ * @param ks the sorted keyset
+ * @param from the first key of the range
+ * @param to the first key after the range will be stored here
+ *
+ * @return the backend of all keys in the range, like mountGetBackend()
+ */
+static Backend * elektraSplitWalkNext (ElektraSplitWalk * walk, KDB * handle, KeySet * ks, size_t from, size_t * to)
+{
+	Key * first = ks->array[from];
+	size_t end = from + 1;
+
+	if (!walk->mountpoints)
+	{
+		*to = end;
+		return mountGetBackend (handle, first);
+	}
+
+	// enter all mountpoints up to the key
+	while (walk->next < walk->size && keyCmp (walk->mountpoints[walk->next].mountpoint, first) <= 0)
+	{
+		elektraSplitWalkLeave (walk, walk->mountpoints[walk->next].mountpoint);
+		walk->stack[walk->depth++] = walk->next++;
+	}
+	elektraSplitWalkLeave (walk, first);
+
+	const ElektraSplitMountpoint * above = walk->depth > 0 ? &walk->mountpoints[walk->stack[walk->depth - 1]] : 0;
+	const Key * nextMountpoint = walk->next < walk->size ? walk->mountpoints[walk->next].mountpoint : 0;
+	const elektraNamespace ns = keyGetNamespace (first);
+
+	while (end < ks->size)
+	{
+		const Key * cur = ks->array[end];
+		if (above && keyIsBelowOrSame (above->mountpoint, cur) != 1) break;
+		if (!above && keyGetNamespace (cur) != ns) break;
+		if (nextMountpoint && keyCmp (nextMountpoint, cur) <= 0) break;
+		++end;
+	}
+
+	*to = end;
+	return above ? above->backend : handle->defaultBackend;
+}
+
 /**
  * Splits up the keysets and search for a sync bit in every key.
  *
@@ -361,6 +561,10 @@ int splitBuildup (Split * split, KDB * kdb, Key * parentKey)
  * It does not create new backends, this has to be
  * done by buildup before.
  *
+ * A backend, whose keys are a single range of @p ks, gets a view
+ * of this range instead of a copy (see elektraKsViewInit()).
+ * So @p ks must not be changed until splitDel(), see splitPrepare().
+ *
  * @pre splitBuildup() need to be executed before.
  *
  * @param split the split object to work with
@@ -375,32 +579,50 @@ int splitBuildup (Split * split, KDB * kdb, Key * parentKey)
 int splitDivide (Split * split, KDB * handle, KeySet * ks)
 {
 	int needsSync = 0;
-	Key * curKey = 0;
+	ElektraSplitWalk walk;
 
 	ksRewind (ks);
-	while ((curKey = ksNext (ks)) != 0)
+	elektraSplitWalkInit (&walk, handle);
+	for (size_t from = 0, to = 0; from < ks->size; from = to)
 	{
 		// TODO: handle keys in wrong namespaces
-		Backend * curHandle = mountGetBackend (handle, curKey);
-		if (!curHandle) return -1;
+		Backend * curHandle = elektraSplitWalkNext (&walk, handle, ks, from, &to);
+		if (!curHandle)
+		{
+			ksSetCursor (ks, from);
+			elektraSplitWalkClose (&walk);
+			return -1;
+		}
 
-		/* If key could be appended to any of the existing split keysets */
-		ssize_t curFound = splitSearchBackend (split, curHandle, curKey);
+		/* If keys could be appended to any of the existing split keysets */
+		ssize_t curFound = splitSearchBackend (split, curHandle, ks->array[from]);
 
 		if (curFound == -1)
 		{
-			ELEKTRA_LOG_DEBUG ("SKIPPING NOT RELEVANT KEY: %p key: %s, string: %s", (void *) curKey, keyName (curKey),
-					   keyString (curKey));
-			continue; // key not relevant in this kdbSet
+			ELEKTRA_LOG_DEBUG ("SKIPPING %zu NOT RELEVANT KEYS: %p key: %s, string: %s", to - from, (void *) ks->array[from],
+					   keyName (ks->array[from]), keyString (ks->array[from]));
+			continue; // keys not relevant in this kdbSet
 		}
 
-		ksAppendKey (split->keysets[curFound], curKey);
-		if (keyNeedSync (curKey) == 1)
+		KeySet * curKs = split->keysets[curFound];
+		int isView = curKs->size == 0 && elektraKsViewInit (curKs, ks, from, to) == 0;
+		for (size_t i = from; i < to; ++i)
 		{
-			split->syncbits[curFound] |= 1;
-			needsSync = 1;
+			Key * curKey = ks->array[i];
+			if (!isView) ksBuilderAdd (curKs, curKey);
+			if (keyNeedSync (curKey) == 1)
+			{
+				split->syncbits[curFound] |= 1;
+				needsSync = 1;
+			}
 		}
 	}
+	elektraSplitWalkClose (&walk);
+
+	for (size_t i = 0; i < split->size; ++i)
+	{
+		ksBuilderFinish (split->keysets[i]);
+	}
 
 	return needsSync;
 }
@@ -442,17 +664,22 @@ void splitUpdateFileName (Split * split, KDB * handle, Key * key)
  */
 int splitAppoint (Split * split, KDB * handle, KeySet * ks)
 {
-	Key * curKey = 0;
 	ssize_t defFound = splitAppend (split, 0, 0, 0);
+	ElektraSplitWalk walk;
 
 	ksRewind (ks);
-	while ((curKey = ksNext (ks)) != 0)
+	elektraSplitWalkInit (&walk, handle);
+	for (size_t from = 0, to = 0; from < ks->size; from = to)
 	{
-		Backend * curHandle = mountGetBackend (handle, curKey);
-		if (!curHandle) return -1;
+		Backend * curHandle = elektraSplitWalkNext (&walk, handle, ks, from, &to);
+		if (!curHandle)
+		{
+			elektraSplitWalkClose (&walk);
+			return -1;
+		}
 
-		/* If key could be appended to any of the existing split keysets */
-		ssize_t curFound = splitSearchBackend (split, curHandle, curKey);
+		/* If keys could be appended to any of the existing split keysets */
+		ssize_t curFound = splitSearchBackend (split, curHandle, ks->array[from]);
 
 		if (curFound == -1) curFound = defFound;
 
@@ -461,7 +688,16 @@ int splitAppoint (Split * split, KDB * handle, KeySet * ks)
 			continue;
 		}
 
-		ksAppendKey (split->keysets[curFound], curKey);
+		for (size_t i = from; i < to; ++i)
+		{
+			ksBuilderAdd (split->keysets[curFound], ks->array[i]);
+		}
+	}
+	elektraSplitWalkClose (&walk);
+
+	for (size_t i = 0; i < split->size; ++i)
+	{
+		ksBuilderFinish (split->keysets[i]);
 	}
 
 	return 1;
@@ -663,6 +899,25 @@ int splitUpdateSize (Split * split)
 	return 1;
 }
 
+/**
+ * Hands the names written by setDelta backends over to them.
+ *
+ * Must only be called after a successful commit, so that the
+ * backends know what is in their storage for the next kdbSet().
+ *
+ * @param split the split object to work with
+ * @see backendUpdateState()
+ */
+void splitUpdateState (Split * split)
+{
+	for (size_t i = 0; i < split->size; ++i)
+	{
+		if (!split->states[i]) continue;
+		backendUpdateState (split->handles[i], split->parents[i], split->states[i]);
+		split->states[i] = 0;
+	}
+}
+
 /**
  * Merges together the backend based parts of split into dest,
  * but bypasses the default split.
@@ -800,10 +1055,79 @@ int splitSync (Split * split)
 	return needsSync;
 }
 
+/**
+ * @internal
+ *
+ * @brief Creates copy-on-write duplicates of the keys of @p source for the plugins.
+ *
+ * The duplicates are allocated in an arena and share name, value and
+ * metadata with the keys of @p source, see elektraKeyShare().
+ *
+ * @return the KeySet with the duplicates
+ * @retval 0 on memory error
+ */
+static KeySet * splitShareKeys (KeySet * source)
+{
+	KeySet * ks = ksNewArena (source->size);
+	if (!ks) return 0;
+
+	for (size_t i = 0; i < source->size; ++i)
+	{
+		Key * key = ksArenaKeyNew (ks, 0);
+		if (!key || elektraKeyShare (key, source->array[i]) == -1 || ksBuilderAdd (ks, key) == -1)
+		{
+			keyDel (key);
+			ksDel (ks);
+			return 0;
+		}
+	}
+
+	if (ksBuilderFinish (ks) == -1)
+	{
+		ksDel (ks);
+		return 0;
+	}
+	return ks;
+}
+
+/**
+ * @internal
+ *
+ * @brief Gives the plugins copy-on-write duplicates of the keys of split @p i.
+ *
+ * The keys passed to kdbSet() stay referenced in `sources`, the duplicates
+ * are remembered in `shared`, so that splitDel() can unshare the
+ * duplicates plugins still hold on to.
+ *
+ * @retval 0 on success
+ * @retval -1 on memory error, the split is unchanged then
+ */
+static int splitShare (Split * split, size_t i)
+{
+	KeySet * source = split->keysets[i];
+	if (elektraKsViewPromote (source) == -1) return -1;
+
+	KeySet * keys = splitShareKeys (source);
+	KeySet * shared = keys ? ksDup (keys) : 0;
+	if (!shared)
+	{
+		ksDel (keys);
+		return -1;
+	}
+
+	split->keysets[i] = keys;
+	split->sources[i] = source;
+	split->shared[i] = shared;
+	return 0;
+}
+
 /** Prepares for kdbSet() mainloop afterwards.
  *
- * All splits which do not need sync are removed and a deep copy
- * of the remaining keysets is done.
+ * All splits which do not need sync are removed. The remaining keysets
+ * are replaced with copy-on-write duplicates, so that plugins only copy
+ * the names, values or metadata they change. Thus the keys passed to
+ * kdbSet() stay unchanged, also on rollback. They must not be changed
+ * until splitDel().
  *
  * @param split the split object to work with
  * @ingroup split
@@ -815,9 +1139,12 @@ void splitPrepare (Split * split)
 		int inc = 1;
 		if ((split->syncbits[i] & 1) == 1)
 		{
-			KeySet * n = ksDeepDup (split->keysets[i]);
-			ksDel (split->keysets[i]);
-			split->keysets[i] = n;
+			if (splitShare (split, i) == -1)
+			{
+				KeySet * n = ksDeepDup (split->keysets[i]);
+				ksDel (split->keysets[i]);
+				split->keysets[i] = n;
+			}
 		}
 		else
 		{
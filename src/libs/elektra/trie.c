@@ -32,8 +32,175 @@
 
 #include "kdbinternal.h"
 
-static char * elektraTrieStartsWith (const char * str, const char * substr);
-static Backend * elektraTriePrefixLookup (Trie * trie, const char * name);
+/**
+ * @internal
+ *
+ * @brief Returns the slot of the child starting with @p c
+ *
+ * @param trie the node to search in
+ * @param c the first byte of the text of the child
+ *
+ * @return pointer to the slot of the child
+ * @retval NULL if there is no such child
+ */
+static Trie ** elektraTrieChild (const Trie * trie, unsigned char c)
+{
+	if (trie->alloc <= ELEKTRA_TRIE_NODE16)
+	{
+		for (size_t i = 0; i < trie->size && trie->index[i] <= c; ++i)
+		{
+			if (trie->index[i] == c) return &trie->children[i];
+		}
+		return NULL;
+	}
+
+	if (trie->alloc == ELEKTRA_TRIE_NODE48)
+	{
+		return trie->index[c] ? &trie->children[trie->index[c] - 1] : NULL;
+	}
+
+	return trie->children[c] ? &trie->children[c] : NULL;
+}
+
+/**
+ * @internal
+ *
+ * @brief Allocates the children of a node with room for @p alloc children
+ *
+ * The index is stored directly behind the children.
+ */
+static void elektraTrieAllocChildren (Trie * trie, unsigned short alloc)
+{
+	size_t indexSize = 0;
+	if (alloc <= ELEKTRA_TRIE_NODE16)
+		indexSize = alloc;
+	else if (alloc == ELEKTRA_TRIE_NODE48)
+		indexSize = KDB_MAX_UCHAR;
+
+	trie->children = elektraCalloc (alloc * sizeof (Trie *) + indexSize);
+	trie->index = indexSize ? (unsigned char *) (trie->children + alloc) : NULL;
+	trie->alloc = alloc;
+}
+
+/**
+ * @internal
+ *
+ * @brief Changes a node to the next larger kind of node
+ */
+static void elektraTrieGrow (Trie * trie)
+{
+	Trie old = *trie;
+
+	switch (old.alloc)
+	{
+	case 0:
+		elektraTrieAllocChildren (trie, ELEKTRA_TRIE_NODE4);
+		return;
+	case ELEKTRA_TRIE_NODE4:
+		elektraTrieAllocChildren (trie, ELEKTRA_TRIE_NODE16);
+		memcpy (trie->children, old.children, old.size * sizeof (Trie *));
+		memcpy (trie->index, old.index, old.size);
+		break;
+	case ELEKTRA_TRIE_NODE16:
+		elektraTrieAllocChildren (trie, ELEKTRA_TRIE_NODE48);
+		memcpy (trie->children, old.children, old.size * sizeof (Trie *));
+		for (size_t i = 0; i < old.size; ++i)
+		{
+			trie->index[old.index[i]] = i + 1;
+		}
+		break;
+	default:
+		elektraTrieAllocChildren (trie, ELEKTRA_TRIE_NODE256);
+		for (size_t c = 0; c < KDB_MAX_UCHAR; ++c)
+		{
+			if (old.index[c]) trie->children[c] = old.children[old.index[c] - 1];
+		}
+		break;
+	}
+
+	elektraFree (old.children);
+}
+
+/**
+ * @internal
+ *
+ * @brief Adds a child to a node, which does not have a child with the same first byte
+ */
+static void elektraTrieAddChild (Trie * trie, Trie * child)
+{
+	const unsigned char c = (unsigned char) child->text[0];
+
+	if (trie->size == trie->alloc)
+	{
+		elektraTrieGrow (trie);
+	}
+
+	if (trie->alloc <= ELEKTRA_TRIE_NODE16)
+	{
+		// keep the index sorted
+		size_t i = trie->size;
+		while (i > 0 && trie->index[i - 1] > c)
+		{
+			trie->index[i] = trie->index[i - 1];
+			trie->children[i] = trie->children[i - 1];
+			--i;
+		}
+		trie->index[i] = c;
+		trie->children[i] = child;
+	}
+	else if (trie->alloc == ELEKTRA_TRIE_NODE48)
+	{
+		trie->children[trie->size] = child;
+		trie->index[c] = trie->size + 1;
+	}
+	else
+	{
+		trie->children[c] = child;
+	}
+	++trie->size;
+}
+
+/**
+ * @internal
+ *
+ * @brief Allocates a node without children
+ *
+ * @param text the text of the node, copied
+ * @param textlen the length of @p text
+ * @param value the backend of the node
+ */
+static Trie * elektraTrieNew (const char * text, size_t textlen, Backend * value)
+{
+	Trie * trie = elektraCalloc (sizeof (Trie));
+	trie->text = elektraMalloc (textlen + 1);
+	memcpy (trie->text, text, textlen);
+	trie->text[textlen] = '\0';
+	trie->textlen = textlen;
+	trie->value = value;
+	return trie;
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks if the text of @p trie matches @p name at @p pos
+ *
+ * The name is matched as if a '/' was appended.
+ *
+ * @param size the size of @p name including the appended '/'
+ */
+static int elektraTrieMatches (const Trie * trie, const char * name, size_t size, size_t pos)
+{
+	if (trie->textlen > size - pos) return 0;
+
+	if (pos + trie->textlen < size)
+	{
+		return !memcmp (name + pos, trie->text, trie->textlen);
+	}
+
+	// the last byte of the text is compared to the appended '/'
+	return !memcmp (name + pos, trie->text, trie->textlen - 1) && trie->text[trie->textlen - 1] == '/';
+}
 
 /**
  * @brief The Trie structure
@@ -42,6 +209,9 @@ static Backend * elektraTriePrefixLookup (Trie * trie, const char * name);
 /**
  * Lookups a backend inside the trie.
  *
+ * Returns the backend with the longest mountpoint which is
+ * a prefix of the name of @p key followed by a '/'.
+ *
  * @return the backend if found
  * @return 0 otherwise
  * @param trie the trie object to work with
@@ -50,21 +220,29 @@ static Backend * elektraTriePrefixLookup (Trie * trie, const char * name);
  */
 Backend * trieLookup (Trie * trie, const Key * key)
 {
-	char * where = 0;
-	Backend * ret = 0;
-	size_t len = 0;
-
 	if (!key) return 0;
 	if (!trie) return 0;
 
-	len = keyGetNameSize (key) + 1;
-	if (len <= 1) return 0; // would crash otherwise
-	where = elektraMalloc (len);
-	strncpy (where, keyName (key), len);
-	where[len - 2] = '/';
+	const char * name = keyName (key);
+	// the size includes the '/' appended instead of the null byte
+	const size_t size = keyGetNameSize (key);
+	if (size == 0) return 0;
+
+	Backend * ret = trie->value;
+	size_t pos = 0;
+
+	while (pos < size)
+	{
+		const unsigned char c = pos + 1 < size ? (unsigned char) name[pos] : '/';
+		Trie ** child = elektraTrieChild (trie, c);
+		if (!child) break;
+
+		trie = *child;
+		if (!elektraTrieMatches (trie, name, size, pos)) break;
 
-	ret = elektraTriePrefixLookup (trie, where);
-	elektraFree (where);
+		pos += trie->textlen;
+		if (trie->value) ret = trie->value;
+	}
 
 	return ret;
 }
@@ -79,21 +257,17 @@ Backend * trieLookup (Trie * trie, const Key * key)
  */
 int trieClose (Trie * trie, Key * errorKey)
 {
-	size_t i;
 	if (trie == NULL) return 0;
-	for (i = 0; i < KDB_MAX_UCHAR; ++i)
+	for (size_t i = 0; i < trie->alloc; ++i)
 	{
-		if (trie->text[i] != NULL)
-		{
-			trieClose (trie->children[i], errorKey);
-			if (trie->value[i]) backendClose (trie->value[i], errorKey);
-			elektraFree (trie->text[i]);
-		}
+		trieClose (trie->children[i], errorKey);
 	}
-	if (trie->empty_value)
+	if (trie->value)
 	{
-		backendClose (trie->empty_value, errorKey);
+		backendClose (trie->value, errorKey);
 	}
+	elektraFree (trie->children);
+	elektraFree (trie->text);
 	elektraFree (trie);
 	return 0;
 }
@@ -111,167 +285,52 @@ int trieClose (Trie * trie, Key * errorKey)
  */
 Trie * trieInsert (Trie * trie, const char * name, Backend * value)
 {
-	unsigned char idx;
-
 	if (name == 0)
 	{
 		name = "";
 	}
-	idx = (unsigned char) name[0];
 
 	if (trie == NULL)
 	{
-		trie = elektraCalloc (sizeof (Trie));
-
-		if (!strcmp ("", name))
-		{
-			trie->empty_value = value;
-			return trie;
-		}
-
-		trie->textlen[idx] = strlen (name);
-
-		trie->text[idx] = elektraStrDup (name);
-
-		trie->value[idx] = value;
-		return trie;
+		trie = elektraTrieNew ("", 0, NULL);
 	}
 
-	if (!strcmp ("", name))
-	{
-		trie->empty_value = value;
-		return trie;
-	}
+	const size_t len = strlen (name);
+	size_t pos = 0;
+	Trie * node = trie;
 
-	if (trie->text[idx])
+	while (pos < len)
 	{
-		char * p;
-		/* there exists an entry with the same first character */
-		if ((p = elektraTrieStartsWith (name, trie->text[idx])) == 0)
+		Trie ** slot = elektraTrieChild (node, (unsigned char) name[pos]);
+		if (!slot)
 		{
-			/* the name in the trie is part of the searched name --> continue search */
-			trie->children[idx] = trieInsert (trie->children[idx], name + trie->textlen[idx], value);
+			/* there doesn't exist an entry with the same first character */
+			elektraTrieAddChild (node, elektraTrieNew (name + pos, len - pos, value));
+			return trie;
 		}
-		else
-		{
-			/* name in trie doesn't match name --> split trie */
-			char * newname;
-			Trie * child;
-			unsigned char idx2;
-
-			newname = elektraStrDup (p);
-			*p = 0; /* shorten the old name in the trie */
-			trie->textlen[idx] = strlen (trie->text[idx]);
-
-			child = trie->children[idx];
-
-			/* insert the name given as a parameter into the new trie entry */
-			trie->children[idx] = trieInsert (NULL, name + (p - trie->text[idx]), value);
-
-			/* insert the split try into the new trie entry */
 
-			idx2 = (unsigned char) newname[0];
-			trie->children[idx]->text[idx2] = newname;
-			trie->children[idx]->textlen[idx2] = strlen (newname);
-			trie->children[idx]->value[idx2] = trie->value[idx];
-			trie->children[idx]->children[idx2] = child;
-
-			trie->value[idx] = 0;
+		Trie * child = *slot;
+		size_t common = 1;
+		while (common < child->textlen && pos + common < len && child->text[common] == name[pos + common])
+		{
+			++common;
 		}
-	}
-	else
-	{
-		/* there doesn't exist an entry with the same first character */
-		trie->text[idx] = elektraStrDup (name);
-		trie->value[idx] = (void *) value;
-		trie->textlen[idx] = strlen (name);
-	}
-
-	return trie;
-}
-
-
-#if 0
-
-static Trie *delete_trie(Trie *trie, char *name, CloseMapper closemapper)
-{
-	Trie *tr;
-	unsigned char idx;
-	if (trie==NULL) {
-		return NULL;
-	}
-
-	idx=(unsigned char) name[0];
-
-	if (trie->text[idx]==NULL) {
-		return NULL;
-	}
 
-	if (elektraTrieStartsWith(name,trie->text[idx])==0) {
-
-		tr=delete_trie(trie->children[idx],name+trie->textlen[idx],closemapper);
-
-		if (tr==NULL) {
-			/* child trie has been deleted */
-			trie->children[idx]=NULL;
-			elektraFree (trie->text[idx]);
-			closemapper(trie->value[idx]);
-			trie->text[idx]=NULL;
+		if (common < child->textlen)
+		{
+			/* name in trie doesn't match name --> split the node */
+			Trie * split = elektraTrieNew (child->text, common, NULL);
+			child->textlen -= common;
+			memmove (child->text, child->text + common, child->textlen + 1);
+			*slot = split;
+			elektraTrieAddChild (split, child);
+			child = split;
 		}
 
-		return trie;
-	}
-	return NULL;
-}
-
-#endif
-
-/**
- * return NULL if string starts with substring, except for the terminating '\0',
- * otherwise return a pointer to the first mismatch in substr.
- *
- * Takes const char* arguments but return char* pointer to it.
- * (like e.g. strchr)
- */
-static char * elektraTrieStartsWith (const char * str, const char * substr)
-{
-	size_t i = 0;
-	size_t sublen = strlen (substr);
-
-	for (i = 0; i < sublen; i++)
-	{
-		if (substr[i] != str[i]) return (char *) substr + i;
-	}
-	return 0;
-}
-
-static Backend * elektraTriePrefixLookup (Trie * trie, const char * name)
-{
-	if (trie == NULL) return NULL;
-
-	unsigned char idx = (unsigned char) name[0];
-	const char * trieText = trie->text[idx];
-
-	if (trieText == NULL)
-	{
-		return trie->empty_value;
+		node = child;
+		pos += common;
 	}
 
-	void * ret = NULL;
-	if (elektraTrieStartsWith (name, trieText) == 0)
-	{
-		ret = elektraTriePrefixLookup (trie->children[idx], name + trie->textlen[idx]);
-	}
-	else
-	{
-		return trie->empty_value;
-	}
-
-	if (ret == NULL && trie->value[idx] == NULL)
-	{
-		return trie->empty_value;
-	}
-	if (ret == NULL) return trie->value[idx];
-
-	return ret;
+	node->value = value;
+	return trie;
 }
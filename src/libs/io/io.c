@@ -39,6 +39,18 @@ void elektraIoSetBinding (KDB * kdb, ElektraIoInterface * ioBinding)
 		}
 	}
 
+	// resolvers of mountpoints may watch their files
+	for (size_t i = 0; kdb->split && i < kdb->split->size; i++)
+	{
+		Backend * backend = kdb->split->handles[i];
+		if (!backend || !backend->getplugins[RESOLVER_PLUGIN])
+		{
+			continue;
+		}
+
+		elektraDeferredCall (backend->getplugins[RESOLVER_PLUGIN], "setIoBinding", parameters);
+	}
+
 	ksDel (parameters);
 }
 
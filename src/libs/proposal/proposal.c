@@ -67,6 +67,7 @@ ssize_t keySetStringF (Key * key, const char * format, ...)
 	{
 		elektraFree (key->data.c);
 	}
+	clear_bit (key->flags, (keyflag_t) KEY_FLAG_MMAP_DATA);
 
 	key->data.c = p;
 	key->dataSize = elektraStrLen (key->data.c);
@@ -149,6 +149,7 @@ const std::map<std::string, int> PluginDatabase::statusMap = {
    {"global",           1},
    {"readonly",         0},
    {"writeonly",        0},
+   {"threadsafe",       0},
    {"preview",        -50},
    {"memleak",       -250},
    {"experimental",  -500},
@@ -35,6 +35,8 @@
 #define KDB_CACHE_STORAGE "mmapstorage"
 #define POSTFIX_SIZE 50
 #define MAX_FD_USED 32
+#define KDB_SHARED_CACHE_FILE_MODE 0644
+#define KDB_SHARED_CACHE_DIR_MODE 0755
 
 typedef enum
 {
@@ -48,6 +50,8 @@ struct _cacheHandle
 {
 	KeySet * modules;
 	Key * cachePath;
+	char * sharedDirectory;
+	char * sharedPath;
 	Plugin * resolver;
 	Plugin * cacheStorage;
 };
@@ -91,9 +95,9 @@ static int loadCacheStoragePlugin (Plugin * handle, CacheHandle * ch, Key * erro
 	return 0;
 }
 
-static int elektraMkdirParents (const char * pathname)
+static int elektraMkdirParents (const char * pathname, mode_t mode)
 {
-	if (mkdir (pathname, KDB_FILE_MODE | KDB_DIR_MODE) == -1)
+	if (mkdir (pathname, mode) == -1)
 	{
 		if (errno != ENOENT)
 		{
@@ -126,7 +130,7 @@ static int elektraMkdirParents (const char * pathname)
 		*p = 0;
 
 		/* Now call ourselves recursively */
-		if (elektraMkdirParents (pathname) == -1)
+		if (elektraMkdirParents (pathname, mode) == -1)
 		{
 			// do not yield an error, was already done
 			// before
@@ -137,7 +141,7 @@ static int elektraMkdirParents (const char * pathname)
 		/* Restore path. */
 		*p = '/';
 
-		if (mkdir (pathname, KDB_FILE_MODE | KDB_DIR_MODE) == -1)
+		if (mkdir (pathname, mode) == -1)
 		{
 			return -1;
 		}
@@ -155,7 +159,7 @@ static char * elektraStrConcat (const char * a, const char * b)
 	return ret;
 }
 
-static char * elektraGenTempFilename (char * cacheFileName)
+static char * elektraGenTempFilename (const char * cacheFileName)
 {
 	char * tmpFile = NULL;
 	size_t len = 0;
@@ -173,10 +177,9 @@ static char * elektraGenTempFilename (char * cacheFileName)
 	return tmpFile;
 }
 
-static char * kdbCacheFileName (CacheHandle * ch, Key * parentKey, PathMode mode)
+static char * kdbCacheFileName (const char * directory, Key * parentKey, PathMode mode, mode_t dirMode)
 {
 	char * cacheFileName = 0;
-	const char * directory = keyString (ch->cachePath);
 	ELEKTRA_LOG_DEBUG ("cache dir: %s", directory);
 	if (mode == modeDirectory) return elektraStrDup (directory);
 
@@ -204,7 +207,7 @@ static char * kdbCacheFileName (CacheHandle * ch, Key * parentKey, PathMode mode
 	{
 		if (access (cacheFileName, O_RDWR) != 0)
 		{
-			elektraMkdirParents (cacheFileName);
+			elektraMkdirParents (cacheFileName, dirMode);
 		}
 
 		char * tmp = cacheFileName;
@@ -231,6 +234,153 @@ static int unlinkCacheFiles (const char * fpath, const struct stat * sb ELEKTRA_
 	return 0;
 }
 
+/**
+ * @brief Checks if the cache for @p parentKey may be shared with other users
+ *
+ * Only the keys of the system and spec namespace are the same for all users,
+ * cascading caches also contain the keys of the user.
+ */
+static int isSharedCache (CacheHandle * ch, Key * parentKey)
+{
+	if (!ch->sharedPath) return 0;
+	if (keyGetMeta (parentKey, "cascading")) return 0;
+
+	const Key * parentName = keyGetMeta (parentKey, "cache/parent");
+	if (!parentName) return 0;
+
+	Key * initialParent = keyNew (keyString (parentName), KEY_END);
+	elektraNamespace ns = keyGetNamespace (initialParent);
+	keyDel (initialParent);
+	return ns == KEY_NS_SYSTEM || ns == KEY_NS_SPEC;
+}
+
+/**
+ * @brief Checks if everyone may read the keys of all backends of the cache
+ *
+ * The split state, which kdb.c stores in @p global, contains the resolved
+ * file of every backend. Keys of files, which not everyone can read, and keys
+ * decrypted by a crypto plugin (kdb.c sets `cache/confidential`) must only be
+ * written to the cache of the user.
+ */
+static int isPublicConfiguration (KeySet * global, Key * parentKey)
+{
+	if (keyGetMeta (parentKey, "cache/confidential")) return 0;
+	if (!global) return 1;
+
+	Key * splitState = keyNew (KDB_CACHE_PREFIX "/splitState", KEY_END);
+	int readable = 1;
+	for (cursor_t it = 0; readable && it < ksGetSize (global); ++it)
+	{
+		Key * cur = ksAtCursor (global, it);
+		if (!keyIsBelow (splitState, cur) || elektraStrCmp (keyBaseName (cur), "splitParentValue")) continue;
+
+		struct stat file;
+		readable = stat (keyString (cur), &file) == 0 && (file.st_mode & S_IROTH);
+		ELEKTRA_LOG_DEBUG ("backend file %s is %s", keyString (cur), readable ? "readable" : "private");
+	}
+	keyDel (splitState);
+	return readable;
+}
+
+/**
+ * @brief Checks if a shared cache file may be loaded
+ *
+ * Everyone who can write to the shared directory can publish caches.
+ * Only files of root, of the current user or of the owner of the
+ * shared directory are loaded, and only if nobody else can change them.
+ */
+static int isTrustedCacheFile (CacheHandle * ch, const struct stat * file)
+{
+	struct stat directory;
+
+	if (!S_ISREG (file->st_mode)) return 0;
+	if (file->st_mode & (S_IWGRP | S_IWOTH)) return 0;
+	if (file->st_uid == 0 || file->st_uid == geteuid ()) return 1;
+	return stat (ch->sharedDirectory, &directory) == 0 && file->st_uid == directory.st_uid;
+}
+
+/**
+ * @brief Opens the shared cache file, if it is trusted and newer than the cache file of the user
+ *
+ * A user, who cannot replace an outdated shared cache, writes an own cache
+ * instead. This cache must not be hidden by the outdated shared cache.
+ *
+ * The checks are done on the opened file, which must then be passed to the
+ * storage plugin, because the shared file may be replaced at any time.
+ *
+ * @return the file descriptor of the shared cache file
+ * @retval -1 if the cache file of the user should be used
+ */
+static int openNewerSharedCacheFile (CacheHandle * ch, const char * sharedFileName, const char * cacheFileName)
+{
+	struct stat shared;
+	struct stat own;
+
+	int fd = open (sharedFileName, O_RDONLY | O_NOFOLLOW);
+	if (fd == -1) return -1;
+
+	if (fstat (fd, &shared) == -1 || !isTrustedCacheFile (ch, &shared)) goto notused;
+	if (stat (cacheFileName, &own) == -1) return fd;
+
+	if (ELEKTRA_STAT_SECONDS (shared) != ELEKTRA_STAT_SECONDS (own))
+	{
+		if (ELEKTRA_STAT_SECONDS (shared) > ELEKTRA_STAT_SECONDS (own)) return fd;
+	}
+	else if (ELEKTRA_STAT_NANO_SECONDS (shared) > ELEKTRA_STAT_NANO_SECONDS (own))
+	{
+		return fd;
+	}
+
+notused:
+	close (fd);
+	return -1;
+}
+
+/**
+ * @brief Writes the cache to a temporary file and renames it to @p cacheFileName
+ *
+ * Readers see either the old or the new cache file, never a partially written one.
+ *
+ * @param mode the permissions of the cache file
+ * @param errorKey gets an error if the file cannot be renamed, may be NULL
+ */
+static int writeCacheFile (CacheHandle * ch, KeySet * returned, Key * cacheFile, const char * cacheFileName, mode_t mode,
+			   Key * errorKey)
+{
+	char * tmpFile = elektraGenTempFilename (cacheFileName);
+	ELEKTRA_ASSERT (tmpFile != 0, "Could not construct temp file name.");
+	ELEKTRA_LOG_DEBUG ("tmpFile: %s", tmpFile);
+
+	// write cache to temp file
+	keySetString (cacheFile, tmpFile);
+	if (ch->cacheStorage->kdbSet (ch->cacheStorage, returned, cacheFile) != ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	{
+		elektraFree (tmpFile);
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	// mmapstorage creates files only readable by the user
+	if (mode != KDB_FILE_MODE && chmod (tmpFile, mode) == -1)
+	{
+		ELEKTRA_LOG_DEBUG ("could not change mode of %s: %s", tmpFile, strerror (errno));
+		goto error;
+	}
+
+	if (rename (tmpFile, cacheFileName) == -1)
+	{
+		if (errorKey) ELEKTRA_SET_RESOURCE_ERRORF (errorKey, "Could not rename file. Reason: %s", strerror (errno));
+		goto error;
+	}
+
+	elektraFree (tmpFile);
+	return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+
+error:
+	unlink (tmpFile);
+	elektraFree (tmpFile);
+	return ELEKTRA_PLUGIN_STATUS_ERROR;
+}
+
 int elektraCacheOpen (Plugin * handle, Key * errorKey)
 {
 	// plugin initialization logic
@@ -241,10 +391,23 @@ int elektraCacheOpen (Plugin * handle, Key * errorKey)
 	ch->modules = ksNew (0, KS_END);
 	elektraModulesInit (ch->modules, 0);
 	ch->cachePath = keyNew ("user/elektracache", KEY_END);
+	ch->sharedDirectory = 0;
+	ch->sharedPath = 0;
 
 	if (resolveCacheDirectory (handle, ch, errorKey) == -1) return ELEKTRA_PLUGIN_STATUS_ERROR;
 	if (loadCacheStoragePlugin (handle, ch, errorKey) == -1) return ELEKTRA_PLUGIN_STATUS_ERROR;
 
+	KeySet * config = elektraPluginGetConfig (handle);
+	Key * shared = ksLookupByName (config, "/shared", 0);
+	if (shared && strlen (keyString (shared)) != 0)
+	{
+		// caches of different mount configurations must not replace each other
+		Key * mountpoints = ksLookupByName (config, "/shared/mountpoints", 0);
+		ch->sharedDirectory = elektraStrDup (keyString (shared));
+		ch->sharedPath = elektraFormat ("%s/%s", ch->sharedDirectory, mountpoints ? keyString (mountpoints) : "default");
+		ELEKTRA_LOG_DEBUG ("shared cache dir: %s", ch->sharedPath);
+	}
+
 	elektraPluginSetData (handle, ch);
 	return ELEKTRA_PLUGIN_STATUS_SUCCESS;
 }
@@ -262,6 +425,8 @@ int elektraCacheClose (Plugin * handle, Key * errorKey ELEKTRA_UNUSED)
 		elektraModulesClose (ch->modules, 0);
 		ksDel (ch->modules);
 		keyDel (ch->cachePath);
+		elektraFree (ch->sharedDirectory);
+		elektraFree (ch->sharedPath);
 
 		elektraFree (ch);
 		elektraPluginSetData (handle, 0);
@@ -299,7 +464,7 @@ int elektraCacheGet (Plugin * handle ELEKTRA_UNUSED, KeySet * returned, Key * pa
 	{
 		// clear all caches
 		Key * cacheFile = keyDup (parentKey);
-		char * cacheFileName = kdbCacheFileName (ch, cacheFile, modeDirectory);
+		char * cacheFileName = kdbCacheFileName (keyString (ch->cachePath), cacheFile, modeDirectory, KDB_FILE_MODE | KDB_DIR_MODE);
 		ELEKTRA_LOG_DEBUG ("CLEAR CACHES path: %s", cacheFileName);
 
 		keySetString (cacheFile, cacheFileName);
@@ -311,21 +476,40 @@ int elektraCacheGet (Plugin * handle ELEKTRA_UNUSED, KeySet * returned, Key * pa
 
 	// construct cache file name from parentKey (which stores the mountpoint from mountGetMountpoint)
 	Key * cacheFile = keyDup (parentKey);
-	char * cacheFileName = kdbCacheFileName (ch, cacheFile, modeFile);
+	char * cacheFileName = kdbCacheFileName (keyString (ch->cachePath), cacheFile, modeFile, KDB_FILE_MODE | KDB_DIR_MODE);
 	ELEKTRA_ASSERT (cacheFileName != 0, "Could not construct cache file name.");
+
+	int sharedFd = -1;
+	if (isSharedCache (ch, parentKey))
+	{
+		char * sharedFileName = kdbCacheFileName (ch->sharedPath, cacheFile, modeFile, KDB_SHARED_CACHE_DIR_MODE);
+		if (sharedFileName && (sharedFd = openNewerSharedCacheFile (ch, sharedFileName, cacheFileName)) != -1)
+		{
+			elektraFree (cacheFileName);
+			cacheFileName = sharedFileName;
+		}
+		else
+		{
+			elektraFree (sharedFileName);
+		}
+	}
 	ELEKTRA_LOG_DEBUG ("CACHE get cacheFileName: %s, parentKey: %s, %s", cacheFileName, keyName (parentKey), keyString (parentKey));
 
 	// load cache from storage
 	keySetString (cacheFile, cacheFileName);
 	elektraFree (cacheFileName);
-	if (ch->cacheStorage->kdbGet (ch->cacheStorage, returned, cacheFile) == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	if (sharedFd != -1)
 	{
-		keyDel (cacheFile);
-		return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+		// load exactly the file checked above
+		char fdString[32];
+		snprintf (fdString, sizeof (fdString), "%d", sharedFd);
+		keySetMeta (cacheFile, "mmapstorage/fd", fdString);
 	}
-
+	int ret = ch->cacheStorage->kdbGet (ch->cacheStorage, returned, cacheFile);
+	if (sharedFd != -1) close (sharedFd);
 	keyDel (cacheFile); // TODO: maybe propagate errors?
-	return ELEKTRA_PLUGIN_STATUS_ERROR;
+
+	return ret == ELEKTRA_PLUGIN_STATUS_SUCCESS ? ELEKTRA_PLUGIN_STATUS_SUCCESS : ELEKTRA_PLUGIN_STATUS_ERROR;
 }
 
 int elektraCacheSet (Plugin * handle, KeySet * returned, Key * parentKey)
@@ -345,35 +529,33 @@ int elektraCacheSet (Plugin * handle, KeySet * returned, Key * parentKey)
 
 	// construct cache file name from parentKey (which stores the mountpoint from mountGetMountpoint)
 	Key * cacheFile = keyDup (parentKey);
-	char * cacheFileName = kdbCacheFileName (ch, cacheFile, modeFile);
-	ELEKTRA_ASSERT (cacheFileName != 0, "Could not construct cache file name.");
-	ELEKTRA_LOG_DEBUG ("CACHE set cacheFileName: %s, parentKey: %s, %s", cacheFileName, keyName (parentKey), keyString (parentKey));
+	int ret;
 
-	char * tmpFile = elektraGenTempFilename (cacheFileName);
-	ELEKTRA_ASSERT (tmpFile != 0, "Could not construct temp file name.");
-	ELEKTRA_LOG_DEBUG ("tmpFile: %s", tmpFile);
-
-	// write cache to temp file
-	keySetString (cacheFile, tmpFile);
-	if (ch->cacheStorage->kdbSet (ch->cacheStorage, returned, cacheFile) == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	if (isSharedCache (ch, parentKey) && isPublicConfiguration (elektraPluginGetGlobalKeySet (handle), parentKey))
 	{
-		if (rename (tmpFile, cacheFileName) == -1)
+		char * sharedFileName = kdbCacheFileName (ch->sharedPath, cacheFile, modeFile, KDB_SHARED_CACHE_DIR_MODE);
+		ELEKTRA_LOG_DEBUG ("CACHE set sharedFileName: %s, parentKey: %s", sharedFileName, keyName (parentKey));
+		ret = sharedFileName ? writeCacheFile (ch, returned, cacheFile, sharedFileName, KDB_SHARED_CACHE_FILE_MODE, 0)
+				     : ELEKTRA_PLUGIN_STATUS_ERROR;
+		elektraFree (sharedFileName);
+		if (ret == ELEKTRA_PLUGIN_STATUS_SUCCESS)
 		{
-			ELEKTRA_SET_RESOURCE_ERRORF (parentKey, "Could not rename file. Reason: %s", strerror (errno));
-			goto error;
+			keyDel (cacheFile);
+			return ret;
 		}
-
-		elektraFree (cacheFileName);
-		elektraFree (tmpFile);
-		keyDel (cacheFile);
-		return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+		// e.g. no permission to write to the shared directory, so use the cache of the user
+		ELEKTRA_LOG_DEBUG ("could not write shared cache, falling back to cache of user");
 	}
 
-error:
+	char * cacheFileName = kdbCacheFileName (keyString (ch->cachePath), cacheFile, modeFile, KDB_FILE_MODE | KDB_DIR_MODE);
+	ELEKTRA_ASSERT (cacheFileName != 0, "Could not construct cache file name.");
+	ELEKTRA_LOG_DEBUG ("CACHE set cacheFileName: %s, parentKey: %s, %s", cacheFileName, keyName (parentKey), keyString (parentKey));
+
+	ret = writeCacheFile (ch, returned, cacheFile, cacheFileName, KDB_FILE_MODE, parentKey);
+
 	elektraFree (cacheFileName);
-	elektraFree (tmpFile);
 	keyDel (cacheFile);
-	return ELEKTRA_PLUGIN_STATUS_ERROR;
+	return ret;
 }
 
 Plugin * ELEKTRA_PLUGIN_EXPORT
@@ -9,9 +9,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <kdb.h>
 #include <kdbconfig.h>
+#include <kdbhelper.h>
+#include <kdbprivate.h>
 
 #include <tests_plugin.h>
 
@@ -63,6 +67,127 @@ static void test_cacheNonBackendKeys (void)
 	kdbClose (handle, 0);
 }
 
+static void test_shared (void)
+{
+	printf ("test shared cache\n");
+
+	char * sharedDirectory = elektraFormat ("%s/shared", tempHome);
+	KeySet * conf = ksNew (2, keyNew ("system/shared", KEY_VALUE, sharedDirectory, KEY_END),
+			       keyNew ("system/shared/mountpoints", KEY_VALUE, "0123456789abcdef", KEY_END), KS_END);
+	PLUGIN_OPEN ("cache");
+	KeySet * global = ksNew (0, KS_END);
+	plugin->global = global;
+
+	Key * parentKey = keyNew ("system/tests/cache", KEY_META, "cache/parent", "system/tests/cache", KEY_END);
+	KeySet * ks = ksNew (1, keyNew ("system/tests/cache/key", KEY_VALUE, "shared", KEY_END), KS_END);
+	succeed_if (plugin->kdbSet (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not write shared cache");
+
+	struct stat buf;
+	char * sharedFile = elektraFormat ("%s/0123456789abcdef/backend/system/tests/cache/cache.mmap", sharedDirectory);
+	succeed_if (stat (sharedFile, &buf) == 0, "shared cache file was not written");
+	succeed_if ((buf.st_mode & 0777) == 0644, "shared cache file is not readable by everyone");
+
+	KeySet * cached = ksNew (0, KS_END);
+	succeed_if (plugin->kdbGet (plugin, cached, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not read shared cache");
+	succeed_if_same_string (keyString (ksLookupByName (cached, "system/tests/cache/key", 0)), "shared");
+	ksDel (cached);
+
+	// files others can change are not loaded
+	chmod (sharedFile, 0666);
+	cached = ksNew (0, KS_END);
+	succeed_if (plugin->kdbGet (plugin, cached, parentKey) == ELEKTRA_PLUGIN_STATUS_ERROR, "untrusted shared cache was loaded");
+	ksDel (cached);
+
+	// symlinks are not followed, even to trusted files
+	chmod (sharedFile, 0644);
+	char * target = elektraFormat ("%s.target", sharedFile);
+	succeed_if (rename (sharedFile, target) == 0 && symlink (target, sharedFile) == 0, "could not replace shared cache by symlink");
+	cached = ksNew (0, KS_END);
+	succeed_if (plugin->kdbGet (plugin, cached, parentKey) == ELEKTRA_PLUGIN_STATUS_ERROR, "symlinked shared cache was loaded");
+	ksDel (cached);
+	unlink (sharedFile);
+	unlink (target);
+	elektraFree (target);
+	elektraFree (sharedFile);
+
+	// keys of users are never shared
+	Key * userKey = keyNew ("user/tests/cache", KEY_META, "cache/parent", "user/tests/cache", KEY_END);
+	KeySet * userKs = ksNew (1, keyNew ("user/tests/cache/key", KEY_VALUE, "private", KEY_END), KS_END);
+	succeed_if (plugin->kdbSet (plugin, userKs, userKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not write cache");
+	sharedFile = elektraFormat ("%s/0123456789abcdef/backend/user/tests/cache/cache.mmap", sharedDirectory);
+	succeed_if (stat (sharedFile, &buf) == -1, "cache of user was shared");
+	elektraFree (sharedFile);
+
+	Key * cascadingKey = keyNew ("/tests/cache", KEY_META, "cache/parent", "/tests/cache", KEY_META, "cascading", "", KEY_END);
+	succeed_if (plugin->kdbSet (plugin, userKs, cascadingKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not write cache");
+	sharedFile = elektraFormat ("%s/0123456789abcdef/backend/tests/cache/cache_cascading.mmap", sharedDirectory);
+	succeed_if (stat (sharedFile, &buf) == -1, "cascading cache was shared");
+	elektraFree (sharedFile);
+
+	keyDel (cascadingKey);
+	keyDel (userKey);
+	ksDel (userKs);
+	keyDel (parentKey);
+	ksDel (ks);
+	PLUGIN_CLOSE ();
+	ksDel (global);
+	elektraFree (sharedDirectory);
+}
+
+static void test_sharedPrivateFile (void)
+{
+	printf ("test shared cache of private files\n");
+
+	char * sharedDirectory = elektraFormat ("%s/shared", tempHome);
+	KeySet * conf = ksNew (2, keyNew ("system/shared", KEY_VALUE, sharedDirectory, KEY_END),
+			       keyNew ("system/shared/mountpoints", KEY_VALUE, "fedcba9876543210", KEY_END), KS_END);
+	PLUGIN_OPEN ("cache");
+
+	// split state of a backend, which reads a file only its owner can read
+	char * sourceFile = elektraFormat ("%s/private.ecf", tempHome);
+	FILE * source = fopen (sourceFile, "w");
+	succeed_if (source != 0, "could not create source file");
+	if (source) fclose (source);
+	chmod (sourceFile, 0600);
+	KeySet * global = ksNew (1,
+				 keyNew (KDB_CACHE_PREFIX "/splitState/mountpoint/system/tests/cache/system/tests/cache/splitParentValue",
+					 KEY_VALUE, sourceFile, KEY_END),
+				 KS_END);
+	plugin->global = global;
+
+	Key * parentKey = keyNew ("system/tests/cache", KEY_META, "cache/parent", "system/tests/cache", KEY_END);
+	KeySet * ks = ksNew (1, keyNew ("system/tests/cache/key", KEY_VALUE, "secret", KEY_END), KS_END);
+	succeed_if (plugin->kdbSet (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not write cache");
+
+	struct stat buf;
+	char * sharedFile = elektraFormat ("%s/fedcba9876543210/backend/system/tests/cache/cache.mmap", sharedDirectory);
+	succeed_if (stat (sharedFile, &buf) == -1, "cache of private file was shared");
+
+	KeySet * cached = ksNew (0, KS_END);
+	succeed_if (plugin->kdbGet (plugin, cached, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not read cache of user");
+	succeed_if_same_string (keyString (ksLookupByName (cached, "system/tests/cache/key", 0)), "secret");
+	ksDel (cached);
+
+	// decrypted keys are never shared, even of files everyone can read
+	chmod (sourceFile, 0644);
+	keySetMeta (parentKey, "cache/confidential", "1");
+	succeed_if (plugin->kdbSet (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not write cache");
+	succeed_if (stat (sharedFile, &buf) == -1, "cache of encrypted backend was shared");
+
+	keySetMeta (parentKey, "cache/confidential", 0);
+	succeed_if (plugin->kdbSet (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not write shared cache");
+	succeed_if (stat (sharedFile, &buf) == 0, "cache of readable file was not shared");
+
+	unlink (sharedFile);
+	unlink (sourceFile);
+	elektraFree (sharedFile);
+	elektraFree (sourceFile);
+	keyDel (parentKey);
+	ksDel (ks);
+	PLUGIN_CLOSE ();
+	ksDel (global);
+	elektraFree (sharedDirectory);
+}
 
 int main (int argc, char ** argv)
 {
@@ -73,6 +198,8 @@ int main (int argc, char ** argv)
 
 	test_basics ();
 	test_cacheNonBackendKeys ();
+	test_shared ();
+	test_sharedPrivateFile ();
 
 	print_result ("testmod_cache");
 
@@ -190,26 +190,79 @@ static int elektraCryptoCreateRandomString (Key * errorKey ELEKTRA_UNUSED, char
 	return -1;
 }
 
+#if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL)
+
+typedef struct
+{
+	ElektraCryptoSession * session;
+	Key ** keys;
+	size_t size;
+	size_t next;
+} DeriveJobs;
+
+static void * deriveWorker (void * data)
+{
+	DeriveJobs * jobs = data;
+	size_t i;
+	while ((i = __atomic_fetch_add (&jobs->next, 1, __ATOMIC_RELAXED)) < jobs->size)
+	{
+		// errors are reported by the serial decryption afterwards
+		Key * errorKey = keyNew (0);
+#if defined(ELEKTRA_CRYPTO_API_GCRYPT)
+		elektraCryptoGcryDeriveKey (jobs->session, errorKey, jobs->keys[i]);
+#elif defined(ELEKTRA_CRYPTO_API_OPENSSL)
+		elektraCryptoOpenSSLDeriveKey (jobs->session, errorKey, jobs->keys[i]);
+#endif
+		keyDel (errorKey);
+	}
+	return NULL;
+}
+
 /**
- * @brief overwrites the value of the key with zeroes and then releases the Key.
- * @param key to be overwritten and released
+ * @brief run the key derivation for the Keys to be decrypted on several threads.
+ *
+ * The derived key material is put into the session, so the actual decryption
+ * afterwards does not need to run the expensive key derivation function again.
+ * The number of threads is configured in ELEKTRA_CRYPTO_PARAM_THREADS.
+ *
+ * @param session the current crypto session
+ * @param data the KeySet holding the data
  */
-static void elektraCryptoSafelyReleaseKey (Key * key)
+static void elektraCryptoDeriveParallel (ElektraCryptoSession * session, KeySet * data)
 {
-	if (key)
+	Key * threadsKey = ksLookupByName (session->config, ELEKTRA_CRYPTO_PARAM_THREADS, 0);
+	size_t nrThreads = threadsKey ? strtoul (keyString (threadsKey), NULL, 10) : 0;
+	if (nrThreads < 2) return;
+
+	DeriveJobs jobs = { .session = session, .keys = elektraMalloc ((ksGetSize (data) + 1) * sizeof (Key *)), .size = 0, .next = 0 };
+	if (!jobs.keys) return;
+
+	Key * k;
+	ksRewind (data);
+	while ((k = ksNext (data)) != 0)
 	{
-		// overwrite key content with zeroes
-		ssize_t length = keyGetValueSize (key);
-		if (length > 0)
-		{
-			memset ((void *) keyValue (key), 0, length);
-		}
+		if (isMarkedForEncryption (k) && !isSpecNamespace (k)) jobs.keys[jobs.size++] = k;
+	}
 
-		// release the key
-		keyDel (key);
+	if (nrThreads > jobs.size) nrThreads = jobs.size;
+	pthread_t * threads = elektraCalloc ((nrThreads + 1) * sizeof (pthread_t));
+	size_t started = 0;
+	// the calling thread is one of the workers
+	while (threads && started + 1 < nrThreads && pthread_create (&threads[started], NULL, deriveWorker, &jobs) == 0)
+	{
+		++started;
 	}
+	if (started > 0) deriveWorker (&jobs);
+	for (size_t t = 0; t < started; ++t)
+	{
+		pthread_join (threads[t], NULL);
+	}
+	elektraFree (threads);
+	elektraFree (jobs.keys);
 }
 
+#endif
+
 /**
  * @brief encrypt the (Elektra) Keys contained in data.
  * @param handle for the current plugin instance
@@ -221,19 +274,27 @@ static void elektraCryptoSafelyReleaseKey (Key * key)
 static int elektraCryptoEncrypt (Plugin * handle ELEKTRA_UNUSED, KeySet * data ELEKTRA_UNUSED, Key * errorKey ELEKTRA_UNUSED)
 {
 	Key * k;
-	Key * masterKey = NULL;
+	int result = -1;
+
+#if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL)
+	// the cipher context is reused for all Keys
+	elektraCryptoHandle * cryptoHandle = NULL;
+#endif
 
 #if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL) || defined(ELEKTRA_CRYPTO_API_BOTAN)
-	KeySet * pluginConfig = elektraPluginGetConfig (handle);
-	masterKey = ELEKTRA_PLUGIN_FUNCTION (getMasterPassword) (errorKey, pluginConfig);
-	if (!masterKey)
+	ElektraCryptoSession session;
+	if (ELEKTRA_PLUGIN_FUNCTION (sessionBegin) (&session, handle, errorKey) != 1)
 	{
-		goto error; // error has been set by getMasterPassword
+		goto error; // error has been set by sessionBegin
 	}
 #endif
 
-#if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL)
-	elektraCryptoHandle * cryptoHandle = NULL;
+#if defined(ELEKTRA_CRYPTO_API_BOTAN)
+	Key * masterKey = ELEKTRA_PLUGIN_FUNCTION (sessionGetMasterPassword) (&session, errorKey);
+	if (!masterKey)
+	{
+		goto error; // error has been set by getMasterPassword
+	}
 #endif
 
 	ksRewind (data);
@@ -246,52 +307,49 @@ static int elektraCryptoEncrypt (Plugin * handle ELEKTRA_UNUSED, KeySet * data E
 
 #if defined(ELEKTRA_CRYPTO_API_GCRYPT)
 
-		if (elektraCryptoGcryHandleCreate (&cryptoHandle, pluginConfig, errorKey, masterKey, k, ELEKTRA_CRYPTO_ENCRYPT) != 1)
+		if (elektraCryptoGcryHandleCreate (&cryptoHandle, &session, errorKey, k, ELEKTRA_CRYPTO_ENCRYPT) != 1)
 		{
 			goto error;
 		}
 
 		if (elektraCryptoGcryEncrypt (cryptoHandle, k, errorKey) != 1)
 		{
-			elektraCryptoGcryHandleDestroy (cryptoHandle);
 			goto error;
 		}
 
-		elektraCryptoGcryHandleDestroy (cryptoHandle);
-		cryptoHandle = NULL;
-
 #elif defined(ELEKTRA_CRYPTO_API_OPENSSL)
 
-		if (elektraCryptoOpenSSLHandleCreate (&cryptoHandle, pluginConfig, errorKey, masterKey, k, ELEKTRA_CRYPTO_ENCRYPT) != 1)
+		if (elektraCryptoOpenSSLHandleCreate (&cryptoHandle, &session, errorKey, k, ELEKTRA_CRYPTO_ENCRYPT) != 1)
 		{
-			elektraCryptoOpenSSLHandleDestroy (cryptoHandle);
 			goto error;
 		}
 
 		if (elektraCryptoOpenSSLEncrypt (cryptoHandle, k, errorKey) != 1)
 		{
-			elektraCryptoOpenSSLHandleDestroy (cryptoHandle);
 			goto error;
 		}
 
-		elektraCryptoOpenSSLHandleDestroy (cryptoHandle);
-		cryptoHandle = NULL;
-
 #elif defined(ELEKTRA_CRYPTO_API_BOTAN)
 
-		if (elektraCryptoBotanEncrypt (pluginConfig, k, errorKey, masterKey) != 1)
+		if (elektraCryptoBotanEncrypt (session.config, k, errorKey, masterKey) != 1)
 		{
 			goto error; // failure, error has been set by elektraCryptoBotanEncrypt
 		}
 
 #endif
 	}
-	elektraCryptoSafelyReleaseKey (masterKey);
-	return 1;
+	result = 1;
 
 error:
-	elektraCryptoSafelyReleaseKey (masterKey);
-	return -1;
+#if defined(ELEKTRA_CRYPTO_API_GCRYPT)
+	elektraCryptoGcryHandleDestroy (cryptoHandle);
+#elif defined(ELEKTRA_CRYPTO_API_OPENSSL)
+	elektraCryptoOpenSSLHandleDestroy (cryptoHandle);
+#endif
+#if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL) || defined(ELEKTRA_CRYPTO_API_BOTAN)
+	ELEKTRA_PLUGIN_FUNCTION (sessionEnd) (&session, handle);
+#endif
+	return result;
 }
 
 /**
@@ -305,19 +363,29 @@ error:
 static int elektraCryptoDecrypt (Plugin * handle ELEKTRA_UNUSED, KeySet * data, Key * errorKey)
 {
 	Key * k;
-	Key * masterKey = NULL;
+	int result = -1;
+
+#if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL)
+	// the cipher context is reused for all Keys
+	elektraCryptoHandle * cryptoHandle = NULL;
+#endif
 
 #if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL) || defined(ELEKTRA_CRYPTO_API_BOTAN)
-	KeySet * pluginConfig = elektraPluginGetConfig (handle);
-	masterKey = ELEKTRA_PLUGIN_FUNCTION (getMasterPassword) (errorKey, pluginConfig);
-	if (!masterKey)
+	ElektraCryptoSession session;
+	if (ELEKTRA_PLUGIN_FUNCTION (sessionBegin) (&session, handle, errorKey) != 1)
 	{
-		goto error; // error has been set by getMasterPassword
+		goto error; // error has been set by sessionBegin
 	}
 #endif
 
 #if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL)
-	elektraCryptoHandle * cryptoHandle = NULL;
+	elektraCryptoDeriveParallel (&session, data);
+#elif defined(ELEKTRA_CRYPTO_API_BOTAN)
+	Key * masterKey = ELEKTRA_PLUGIN_FUNCTION (sessionGetMasterPassword) (&session, errorKey);
+	if (!masterKey)
+	{
+		goto error; // error has been set by getMasterPassword
+	}
 #endif
 
 	ksRewind (data);
@@ -336,52 +404,49 @@ static int elektraCryptoDecrypt (Plugin * handle ELEKTRA_UNUSED, KeySet * data,
 
 #if defined(ELEKTRA_CRYPTO_API_GCRYPT)
 
-		if (elektraCryptoGcryHandleCreate (&cryptoHandle, pluginConfig, errorKey, masterKey, k, ELEKTRA_CRYPTO_DECRYPT) != 1)
+		if (elektraCryptoGcryHandleCreate (&cryptoHandle, &session, errorKey, k, ELEKTRA_CRYPTO_DECRYPT) != 1)
 		{
 			goto error;
 		}
 
 		if (elektraCryptoGcryDecrypt (cryptoHandle, k, errorKey) != 1)
 		{
-			elektraCryptoGcryHandleDestroy (cryptoHandle);
 			goto error;
 		}
 
-		elektraCryptoGcryHandleDestroy (cryptoHandle);
-		cryptoHandle = NULL;
-
 #elif defined(ELEKTRA_CRYPTO_API_OPENSSL)
 
-		if (elektraCryptoOpenSSLHandleCreate (&cryptoHandle, pluginConfig, errorKey, masterKey, k, ELEKTRA_CRYPTO_DECRYPT) != 1)
+		if (elektraCryptoOpenSSLHandleCreate (&cryptoHandle, &session, errorKey, k, ELEKTRA_CRYPTO_DECRYPT) != 1)
 		{
-			elektraCryptoOpenSSLHandleDestroy (cryptoHandle);
 			goto error;
 		}
 
 		if (elektraCryptoOpenSSLDecrypt (cryptoHandle, k, errorKey) != 1)
 		{
-			elektraCryptoOpenSSLHandleDestroy (cryptoHandle);
 			goto error;
 		}
 
-		elektraCryptoOpenSSLHandleDestroy (cryptoHandle);
-		cryptoHandle = NULL;
-
 #elif defined(ELEKTRA_CRYPTO_API_BOTAN)
 
-		if (elektraCryptoBotanDecrypt (pluginConfig, k, errorKey, masterKey) != 1)
+		if (elektraCryptoBotanDecrypt (session.config, k, errorKey, masterKey) != 1)
 		{
 			goto error; // failure, error has been set by elektraCryptoBotanDecrypt
 		}
 
 #endif
 	}
-	elektraCryptoSafelyReleaseKey (masterKey);
-	return 1;
+	result = 1;
 
 error:
-	elektraCryptoSafelyReleaseKey (masterKey);
-	return -1;
+#if defined(ELEKTRA_CRYPTO_API_GCRYPT)
+	elektraCryptoGcryHandleDestroy (cryptoHandle);
+#elif defined(ELEKTRA_CRYPTO_API_OPENSSL)
+	elektraCryptoOpenSSLHandleDestroy (cryptoHandle);
+#endif
+#if defined(ELEKTRA_CRYPTO_API_GCRYPT) || defined(ELEKTRA_CRYPTO_API_OPENSSL) || defined(ELEKTRA_CRYPTO_API_BOTAN)
+	ELEKTRA_PLUGIN_FUNCTION (sessionEnd) (&session, handle);
+#endif
+	return result;
 }
 
 /**
@@ -418,6 +483,8 @@ int ELEKTRA_PLUGIN_FUNCTION (open) (Plugin * handle ELEKTRA_UNUSED, Key * errorK
  */
 int ELEKTRA_PLUGIN_FUNCTION (close) (Plugin * handle, Key * errorKey ELEKTRA_UNUSED)
 {
+	ELEKTRA_PLUGIN_FUNCTION (sessionFreeCache) (handle);
+
 	/* default behaviour: no teardown except the user/system requests it */
 	KeySet * pluginConfig = elektraPluginGetConfig (handle);
 	if (!pluginConfig)
@@ -76,6 +76,7 @@ enum ElektraCryptoOperation
 #define ELEKTRA_CRYPTO_PARAM_MASTER_PASSWORD "/crypto/masterpassword"
 #define ELEKTRA_CRYPTO_PARAM_SHUTDOWN "/shutdown"
 #define ELEKTRA_CRYPTO_PARAM_ITERATION_COUNT "/crypto/iterations"
+#define ELEKTRA_CRYPTO_PARAM_THREADS "/crypto/threads"
 
 // metakeys
 #define ELEKTRA_CRYPTO_META_ENCRYPT "crypto/encrypt"
@@ -28,26 +28,59 @@
 GCRY_THREAD_OPTION_PTHREAD_IMPL;
 
 
+/**
+ * @brief run the key derivation function for the given salt, unless the session already knows the result.
+ * @param session the current crypto session
+ * @param errorKey holds an error description in case of failure
+ * @param salt the salt
+ * @param saltLen the length of the salt
+ * @param keyBuffer is set to the cryptographic key followed by the IV
+ * @retval -1 on failure. errorKey holds the error description.
+ * @retval 1 on success
+ */
+static int deriveKeyIv (ElektraCryptoSession * session, Key * errorKey, const kdb_octet_t * salt, size_t saltLen,
+			kdb_octet_t keyBuffer[KEY_BUFFER_SIZE])
+{
+	gcry_error_t gcry_err;
+
+	if (ELEKTRA_PLUGIN_FUNCTION (sessionGetDerivedKey) (session, salt, saltLen, keyBuffer, KEY_BUFFER_SIZE) == 1)
+	{
+		return 1;
+	}
+
+	Key * masterKey = ELEKTRA_PLUGIN_FUNCTION (sessionGetMasterPassword) (session, errorKey);
+	if (!masterKey)
+	{
+		return -1; // error set by ELEKTRA_PLUGIN_FUNCTION(getMasterPassword)()
+	}
+
+	if ((gcry_err = gcry_kdf_derive (keyValue (masterKey), keyGetValueSize (masterKey), GCRY_KDF_PBKDF2, GCRY_MD_SHA512, salt, saltLen,
+					 session->iterations, KEY_BUFFER_SIZE, keyBuffer)))
+	{
+		ELEKTRA_SET_INTERNAL_ERRORF (errorKey, "Failed to derive a cryptographic key. Reason: %s", gcry_strerror (gcry_err));
+		return -1;
+	}
+
+	ELEKTRA_PLUGIN_FUNCTION (sessionSetDerivedKey) (session, salt, saltLen, keyBuffer, KEY_BUFFER_SIZE);
+	return 1;
+}
+
 /**
  * @brief derive the cryptographic key and IV for a given (Elektra) Key k
- * @param config KeySet holding the plugin/backend configuration
+ * @param session the current crypto session
  * @param errorKey holds an error description in case of failure
- * @param masterKey holds the decrypted master password from the plugin configuration
  * @param k the (Elektra)-Key to be encrypted
  * @param cKey (Elektra)-Key holding the cryptographic material
  * @param cIv (Elektra)-Key holding the initialization vector
  * @retval -1 on failure. errorKey holds the error description.
  * @retval 1 on success
  */
-static int getKeyIvForEncryption (KeySet * config, Key * errorKey, Key * masterKey, Key * k, Key * cKey, Key * cIv)
+static int getKeyIvForEncryption (ElektraCryptoSession * session, Key * errorKey, Key * k, Key * cKey, Key * cIv)
 {
-	gcry_error_t gcry_err;
 	kdb_octet_t salt[ELEKTRA_CRYPTO_DEFAULT_SALT_LEN];
 	kdb_octet_t keyBuffer[KEY_BUFFER_SIZE];
 	char * saltHexString = NULL;
 
-	ELEKTRA_ASSERT (masterKey != NULL, "Parameter `masterKey` must not be NULL");
-
 	// generate the salt
 	gcry_create_nonce (salt, sizeof (salt));
 	const int encodingResult = ELEKTRA_PLUGIN_FUNCTION (base64Encode) (errorKey, salt, sizeof (salt), &saltHexString);
@@ -64,66 +97,68 @@ static int getKeyIvForEncryption (KeySet * config, Key * errorKey, Key * masterK
 	keySetMeta (k, ELEKTRA_CRYPTO_META_SALT, saltHexString);
 	elektraFree (saltHexString);
 
-	// read iteration count
-	const kdb_unsigned_long_t iterations = ELEKTRA_PLUGIN_FUNCTION (getIterationCount) (errorKey, config);
-
 	// generate/derive the cryptographic key and the IV
-	if ((gcry_err = gcry_kdf_derive (keyValue (masterKey), keyGetValueSize (masterKey), GCRY_KDF_PBKDF2, GCRY_MD_SHA512, salt,
-					 sizeof (salt), iterations, KEY_BUFFER_SIZE, keyBuffer)))
+	if (deriveKeyIv (session, errorKey, salt, sizeof (salt), keyBuffer) != 1)
 	{
-		ELEKTRA_SET_INTERNAL_ERRORF (errorKey, "Failed to create a cryptographic key for encryption. Reason: %s",
-					     gcry_strerror (gcry_err));
 		return -1;
 	}
 
 	keySetBinary (cKey, keyBuffer, ELEKTRA_CRYPTO_GCRY_KEYSIZE);
 	keySetBinary (cIv, keyBuffer + ELEKTRA_CRYPTO_GCRY_KEYSIZE, ELEKTRA_CRYPTO_GCRY_BLOCKSIZE);
+	memset (keyBuffer, 0, sizeof (keyBuffer));
 	return 1;
 }
 
 /**
  * @brief derive the cryptographic key and IV for a given (Elektra) Key k
- * @param config KeySet holding the plugin/backend configuration
+ * @param session the current crypto session
  * @param errorKey holds an error description in case of failure
- * @param masterKey holds the decrypted master password from the plugin configuration
- * @param k the (Elektra)-Key to be encrypted
+ * @param k the (Elektra)-Key to be decrypted
  * @param cKey (Elektra)-Key holding the cryptographic material
  * @param cIv (Elektra)-Key holding the initialization vector
  * @retval -1 on failure. errorKey holds the error description.
  * @retval 1 on success
  */
-static int getKeyIvForDecryption (KeySet * config, Key * errorKey, Key * masterKey, Key * k, Key * cKey, Key * cIv)
+static int getKeyIvForDecryption (ElektraCryptoSession * session, Key * errorKey, Key * k, Key * cKey, Key * cIv)
 {
-	gcry_error_t gcry_err;
 	kdb_octet_t keyBuffer[KEY_BUFFER_SIZE];
 	kdb_octet_t * saltBuffer = NULL;
 	kdb_unsigned_long_t saltBufferLen = 0;
 
-	ELEKTRA_ASSERT (masterKey != NULL, "Parameter `masterKey` must not be NULL");
-
 	// get the salt
 	if (ELEKTRA_PLUGIN_FUNCTION (getSaltFromPayload) (errorKey, k, &saltBuffer, &saltBufferLen) != 1)
 	{
 		return -1; // error set by ELEKTRA_PLUGIN_FUNCTION(getSaltFromPayload)()
 	}
 
-	// get the iteration count
-	const kdb_unsigned_long_t iterations = ELEKTRA_PLUGIN_FUNCTION (getIterationCount) (errorKey, config);
-
 	// derive the cryptographic key and the IV
-	if ((gcry_err = gcry_kdf_derive (keyValue (masterKey), keyGetValueSize (masterKey), GCRY_KDF_PBKDF2, GCRY_MD_SHA512, saltBuffer,
-					 saltBufferLen, iterations, KEY_BUFFER_SIZE, keyBuffer)))
+	if (deriveKeyIv (session, errorKey, saltBuffer, saltBufferLen, keyBuffer) != 1)
 	{
-		ELEKTRA_SET_INTERNAL_ERRORF (errorKey, "Failed to restore the cryptographic key for decryption. Reason: %s",
-					     gcry_strerror (gcry_err));
 		return -1;
 	}
 
 	keySetBinary (cKey, keyBuffer, ELEKTRA_CRYPTO_GCRY_KEYSIZE);
 	keySetBinary (cIv, keyBuffer + ELEKTRA_CRYPTO_GCRY_KEYSIZE, ELEKTRA_CRYPTO_GCRY_BLOCKSIZE);
+	memset (keyBuffer, 0, sizeof (keyBuffer));
 	return 1;
 }
 
+int elektraCryptoGcryDeriveKey (ElektraCryptoSession * session, Key * errorKey, Key * k)
+{
+	kdb_octet_t keyBuffer[KEY_BUFFER_SIZE];
+	kdb_octet_t * saltBuffer = NULL;
+	kdb_unsigned_long_t saltBufferLen = 0;
+
+	if (ELEKTRA_PLUGIN_FUNCTION (getSaltFromPayload) (errorKey, k, &saltBuffer, &saltBufferLen) != 1)
+	{
+		return -1; // error set by ELEKTRA_PLUGIN_FUNCTION(getSaltFromPayload)()
+	}
+
+	int result = deriveKeyIv (session, errorKey, saltBuffer, saltBufferLen, keyBuffer);
+	memset (keyBuffer, 0, sizeof (keyBuffer));
+	return result;
+}
+
 void elektraCryptoGcryHandleDestroy (elektraCryptoHandle * handle)
 {
 	if (handle != NULL)
@@ -156,22 +191,20 @@ int elektraCryptoGcryInit (Key * errorKey)
 	return 1;
 }
 
-int elektraCryptoGcryHandleCreate (elektraCryptoHandle ** handle, KeySet * config, Key * errorKey, Key * masterKey, Key * k,
+int elektraCryptoGcryHandleCreate (elektraCryptoHandle ** handle, ElektraCryptoSession * session, Key * errorKey, Key * k,
 				   const enum ElektraCryptoOperation op)
 {
 	gcry_error_t gcry_err;
 	unsigned char keyBuffer[64], ivBuffer[64];
 	size_t keyLength, ivLength;
 
-	(*handle) = NULL;
-
 	// retrieve/derive the cryptographic material
 	Key * key = keyNew (0);
 	Key * iv = keyNew (0);
 	switch (op)
 	{
 	case ELEKTRA_CRYPTO_ENCRYPT:
-		if (getKeyIvForEncryption (config, errorKey, masterKey, k, key, iv) != 1)
+		if (getKeyIvForEncryption (session, errorKey, k, key, iv) != 1)
 		{
 			keyDel (key);
 			keyDel (iv);
@@ -180,7 +213,7 @@ int elektraCryptoGcryHandleCreate (elektraCryptoHandle ** handle, KeySet * confi
 		break;
 
 	case ELEKTRA_CRYPTO_DECRYPT:
-		if (getKeyIvForDecryption (config, errorKey, masterKey, k, key, iv) != 1)
+		if (getKeyIvForDecryption (session, errorKey, k, key, iv) != 1)
 		{
 			keyDel (key);
 			keyDel (iv);
@@ -197,23 +230,29 @@ int elektraCryptoGcryHandleCreate (elektraCryptoHandle ** handle, KeySet * confi
 	keyLength = keyGetBinary (key, keyBuffer, sizeof (keyBuffer));
 	ivLength = keyGetBinary (iv, ivBuffer, sizeof (ivBuffer));
 
-	// create the handle
-	(*handle) = elektraMalloc (sizeof (elektraCryptoHandle));
+	// create the handle, or reuse the handle of the previous Key
 	if (*handle == NULL)
 	{
-		memset (keyBuffer, 0, sizeof (keyBuffer));
-		memset (ivBuffer, 0, sizeof (ivBuffer));
-		keyDel (key);
-		keyDel (iv);
-		ELEKTRA_SET_OUT_OF_MEMORY_ERROR (errorKey);
-		return -1;
-	}
+		(*handle) = elektraMalloc (sizeof (elektraCryptoHandle));
+		if (*handle == NULL)
+		{
+			memset (keyBuffer, 0, sizeof (keyBuffer));
+			memset (ivBuffer, 0, sizeof (ivBuffer));
+			keyDel (key);
+			keyDel (iv);
+			ELEKTRA_SET_OUT_OF_MEMORY_ERROR (errorKey);
+			return -1;
+		}
 
-	if ((gcry_err = gcry_cipher_open (*handle, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_CBC, 0)) != 0)
-	{
-		goto error;
+		if ((gcry_err = gcry_cipher_open (*handle, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_CBC, 0)) != 0)
+		{
+			elektraFree (*handle);
+			(*handle) = NULL;
+			goto error;
+		}
 	}
 
+	// setting the key resets the state of the handle
 	if ((gcry_err = gcry_cipher_setkey (**handle, keyBuffer, keyLength)) != 0)
 	{
 		goto error;
@@ -234,8 +273,7 @@ error:
 	memset (keyBuffer, 0, sizeof (keyBuffer));
 	memset (ivBuffer, 0, sizeof (ivBuffer));
 	ELEKTRA_SET_INTERNAL_ERRORF (errorKey, "Failed to setup libgcrypt. Reason: %s", gcry_strerror (gcry_err));
-	gcry_cipher_close (**handle);
-	elektraFree (*handle);
+	elektraCryptoGcryHandleDestroy (*handle);
 	(*handle) = NULL;
 	keyDel (key);
 	keyDel (iv);
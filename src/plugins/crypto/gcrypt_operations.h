@@ -10,6 +10,7 @@
 #ifndef ELEKTRA_PLUGIN_GCRYPT_OPERATIONS_H
 #define ELEKTRA_PLUGIN_GCRYPT_OPERATIONS_H
 
+#include "helper.h"
 #include <kdb.h>
 #include <kdbtypes.h>
 
@@ -18,8 +19,9 @@
 
 char * elektraCryptoGcryCreateRandomString (Key * errorKey, const kdb_unsigned_short_t length);
 int elektraCryptoGcryInit (Key * errorKey);
-int elektraCryptoGcryHandleCreate (elektraCryptoHandle ** handle, KeySet * config, Key * errorKey, Key * masterKey, Key * k,
+int elektraCryptoGcryHandleCreate (elektraCryptoHandle ** handle, ElektraCryptoSession * session, Key * errorKey, Key * k,
 				   const enum ElektraCryptoOperation op);
+int elektraCryptoGcryDeriveKey (ElektraCryptoSession * session, Key * errorKey, Key * k);
 void elektraCryptoGcryHandleDestroy (elektraCryptoHandle * handle);
 int elektraCryptoGcryEncrypt (elektraCryptoHandle * handle, Key * k, Key * errorKey);
 int elektraCryptoGcryDecrypt (elektraCryptoHandle * handle, Key * k, Key * errorKey);
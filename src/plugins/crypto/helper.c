@@ -232,6 +232,182 @@ kdb_unsigned_long_t ELEKTRA_PLUGIN_FUNCTION (getIterationCount) (Key * errorKey,
 	return ELEKTRA_CRYPTO_DEFAULT_ITERATION_COUNT;
 }
 
+/**
+ * @brief overwrites the values of all Keys in ks with zeroes and then releases the KeySet.
+ * @param ks the KeySet to be released, may be NULL
+ */
+static void safelyReleaseKeySet (KeySet * ks)
+{
+	if (!ks) return;
+	Key * k;
+	ksRewind (ks);
+	while ((k = ksNext (ks)) != 0)
+	{
+		ssize_t length = keyGetValueSize (k);
+		if (length > 0)
+		{
+			memset ((void *) keyValue (k), 0, length);
+		}
+	}
+	ksDel (ks);
+}
+
+/**
+ * @brief create the (Elektra) Key used as index of the derived key material for the given salt.
+ * @returns the Key or NULL if the allocation failed. Must be freed by the caller.
+ */
+static Key * newSaltKey (const kdb_octet_t * salt, size_t saltLen)
+{
+	static const char hex[] = "0123456789abcdef";
+	char name[2 * saltLen + 1];
+	for (size_t i = 0; i < saltLen; i++)
+	{
+		name[2 * i] = hex[salt[i] >> 4];
+		name[2 * i + 1] = hex[salt[i] & 0x0F];
+	}
+	name[2 * saltLen] = '\0';
+
+	Key * k = keyNew ("/", KEY_CASCADING_NAME, KEY_END);
+	if (k) keyAddBaseName (k, name);
+	return k;
+}
+
+/**
+ * @brief start a crypto session for one call of kdbGet() or kdbSet().
+ *
+ * The derived key material of the previous session is taken over from the plugin data,
+ * so Keys whose salt did not change do not need to run the key derivation function again.
+ *
+ * @param session the session to be initialized
+ * @param handle for the current plugin instance
+ * @param errorKey holds an error description in case of failure
+ * @retval 1 on success
+ * @retval -1 if the master password is missing in the configuration. errorKey holds a description.
+ */
+int ELEKTRA_PLUGIN_FUNCTION (sessionBegin) (ElektraCryptoSession * session, Plugin * handle, Key * errorKey)
+{
+	session->config = elektraPluginGetConfig (handle);
+	session->masterKey = NULL;
+	session->cache = elektraPluginGetData (handle);
+	session->derived = ksNew (0, KS_END);
+	session->iterations = ELEKTRA_PLUGIN_FUNCTION (getIterationCount) (errorKey, session->config);
+	pthread_mutex_init (&session->lock, NULL);
+	elektraPluginSetData (handle, NULL);
+
+	// the master password is decrypted on demand, but it must be configured in any case
+	if (!ksLookupByName (session->config, ELEKTRA_CRYPTO_PARAM_MASTER_PASSWORD, 0))
+	{
+		ELEKTRA_SET_INSTALLATION_ERRORF (errorKey, "Missing %s in plugin configuration", ELEKTRA_CRYPTO_PARAM_MASTER_PASSWORD);
+		return -1;
+	}
+	return 1;
+}
+
+/**
+ * @brief finish a crypto session.
+ *
+ * Only the key material used in this session is kept for the next one, all other material is overwritten with zeroes.
+ *
+ * @param session the session to be finished
+ * @param handle for the current plugin instance
+ */
+void ELEKTRA_PLUGIN_FUNCTION (sessionEnd) (ElektraCryptoSession * session, Plugin * handle)
+{
+	if (session->masterKey)
+	{
+		ssize_t length = keyGetValueSize (session->masterKey);
+		if (length > 0)
+		{
+			memset ((void *) keyValue (session->masterKey), 0, length);
+		}
+		keyDel (session->masterKey);
+		session->masterKey = NULL;
+	}
+	safelyReleaseKeySet (session->cache);
+	session->cache = NULL;
+	elektraPluginSetData (handle, session->derived);
+	session->derived = NULL;
+	pthread_mutex_destroy (&session->lock);
+}
+
+/**
+ * @brief release the derived key material kept by the plugin instance.
+ * @param handle for the current plugin instance
+ */
+void ELEKTRA_PLUGIN_FUNCTION (sessionFreeCache) (Plugin * handle)
+{
+	safelyReleaseKeySet (elektraPluginGetData (handle));
+	elektraPluginSetData (handle, NULL);
+}
+
+/**
+ * @brief decrypt the master password once per session.
+ * @param session the current session
+ * @param errorKey holds an error description in case of failure
+ * @returns the decrypted master password or NULL in case of error. Owned by the session.
+ */
+Key * ELEKTRA_PLUGIN_FUNCTION (sessionGetMasterPassword) (ElektraCryptoSession * session, Key * errorKey)
+{
+	pthread_mutex_lock (&session->lock);
+	if (!session->masterKey)
+	{
+		session->masterKey = ELEKTRA_PLUGIN_FUNCTION (getMasterPassword) (errorKey, session->config);
+	}
+	Key * masterKey = session->masterKey;
+	pthread_mutex_unlock (&session->lock);
+	return masterKey;
+}
+
+/**
+ * @brief lookup the derived key material for the given salt.
+ * @param session the current session
+ * @param salt the salt of the key derivation
+ * @param saltLen the length of the salt
+ * @param buffer is set to the key material
+ * @param bufferLen the size of buffer, must match the size of the stored material
+ * @retval 1 if the key material was found
+ * @retval 0 if the key derivation function has to be run
+ */
+int ELEKTRA_PLUGIN_FUNCTION (sessionGetDerivedKey) (ElektraCryptoSession * session, const kdb_octet_t * salt, size_t saltLen,
+						     kdb_octet_t * buffer, size_t bufferLen)
+{
+	Key * lookup = newSaltKey (salt, saltLen);
+	if (!lookup) return 0;
+
+	pthread_mutex_lock (&session->lock);
+	Key * found = ksLookup (session->derived, lookup, 0);
+	if (!found && session->cache)
+	{
+		found = ksLookup (session->cache, lookup, KDB_O_POP);
+		if (found) ksAppendKey (session->derived, found);
+	}
+	int result = found && keyGetBinary (found, buffer, bufferLen) == (ssize_t) bufferLen;
+	pthread_mutex_unlock (&session->lock);
+
+	keyDel (lookup);
+	return result;
+}
+
+/**
+ * @brief store the derived key material for the given salt.
+ * @param session the current session
+ * @param salt the salt of the key derivation
+ * @param saltLen the length of the salt
+ * @param buffer holds the key material
+ * @param bufferLen the size of buffer
+ */
+void ELEKTRA_PLUGIN_FUNCTION (sessionSetDerivedKey) (ElektraCryptoSession * session, const kdb_octet_t * salt, size_t saltLen,
+						      const kdb_octet_t * buffer, size_t bufferLen)
+{
+	Key * k = newSaltKey (salt, saltLen);
+	if (!k) return;
+	keySetBinary (k, buffer, bufferLen);
+
+	pthread_mutex_lock (&session->lock);
+	ksAppendKey (session->derived, k);
+	pthread_mutex_unlock (&session->lock);
+}
+
 /**
  * @brief call the gpg binary to encrypt the random master password.
  *
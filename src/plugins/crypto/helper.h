@@ -13,12 +13,35 @@
 #include "crypto.h"
 #include <kdb.h>
 #include <kdbtypes.h>
+#include <pthread.h>
+
+/**
+ * State shared by all Keys of one kdbGet() or kdbSet() call.
+ */
+typedef struct
+{
+	KeySet * config;		 /*!< the plugin configuration */
+	Key * masterKey;		 /*!< the decrypted master password, NULL until it is needed */
+	KeySet * cache;			 /*!< derived key material of the previous call, indexed by salt */
+	KeySet * derived;		 /*!< derived key material used in this call, indexed by salt */
+	kdb_unsigned_long_t iterations; /*!< the iteration count of the key derivation function */
+	pthread_mutex_t lock;		 /*!< protects the members above if Keys are processed in parallel */
+} ElektraCryptoSession;
 
 int ELEKTRA_PLUGIN_FUNCTION (getSaltFromMetakey) (Key * errorKey, Key * k, kdb_octet_t ** salt, kdb_unsigned_long_t * saltLen);
 int ELEKTRA_PLUGIN_FUNCTION (getSaltFromPayload) (Key * errorKey, Key * k, kdb_octet_t ** salt, kdb_unsigned_long_t * saltLen);
 Key * ELEKTRA_PLUGIN_FUNCTION (getMasterPassword) (Key * errorKey, KeySet * config);
 kdb_unsigned_long_t ELEKTRA_PLUGIN_FUNCTION (getIterationCount) (Key * errorKey, KeySet * config);
 
+int ELEKTRA_PLUGIN_FUNCTION (sessionBegin) (ElektraCryptoSession * session, Plugin * handle, Key * errorKey);
+void ELEKTRA_PLUGIN_FUNCTION (sessionEnd) (ElektraCryptoSession * session, Plugin * handle);
+void ELEKTRA_PLUGIN_FUNCTION (sessionFreeCache) (Plugin * handle);
+Key * ELEKTRA_PLUGIN_FUNCTION (sessionGetMasterPassword) (ElektraCryptoSession * session, Key * errorKey);
+int ELEKTRA_PLUGIN_FUNCTION (sessionGetDerivedKey) (ElektraCryptoSession * session, const kdb_octet_t * salt, size_t saltLen,
+						     kdb_octet_t * buffer, size_t bufferLen);
+void ELEKTRA_PLUGIN_FUNCTION (sessionSetDerivedKey) (ElektraCryptoSession * session, const kdb_octet_t * salt, size_t saltLen,
+						      const kdb_octet_t * buffer, size_t bufferLen);
+
 int ELEKTRA_PLUGIN_FUNCTION (gpgEncryptMasterPassword) (KeySet * conf, Key * errorKey, Key * msgKey);
 int ELEKTRA_PLUGIN_FUNCTION (gpgDecryptMasterPassword) (KeySet * conf, Key * errorKey, Key * msgKey);
 
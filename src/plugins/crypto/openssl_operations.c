@@ -37,25 +37,66 @@
  */
 static pthread_mutex_t mutex_ssl = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ * @brief run the key derivation function for the given salt, unless the session already knows the result.
+ * @param session the current crypto session
+ * @param errorKey holds an error description in case of failure
+ * @param salt the salt
+ * @param saltLen the length of the salt
+ * @param keyBuffer is set to the cryptographic key followed by the IV
+ * @retval -1 on failure. errorKey holds the error description.
+ * @retval 1 on success
+ */
+static int deriveKeyIv (ElektraCryptoSession * session, Key * errorKey, const kdb_octet_t * salt, size_t saltLen,
+			kdb_octet_t keyBuffer[KEY_BUFFER_SIZE])
+{
+	if (ELEKTRA_PLUGIN_FUNCTION (sessionGetDerivedKey) (session, salt, saltLen, keyBuffer, KEY_BUFFER_SIZE) == 1)
+	{
+		return 1;
+	}
+
+	Key * masterKey = ELEKTRA_PLUGIN_FUNCTION (sessionGetMasterPassword) (session, errorKey);
+	if (!masterKey)
+	{
+		return -1; // error set by ELEKTRA_PLUGIN_FUNCTION(getMasterPassword)()
+	}
+
+	// libcrypto is thread-safe since version 1.1.0
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	pthread_mutex_lock (&mutex_ssl);
+#endif
+	int result = PKCS5_PBKDF2_HMAC_SHA1 (keyValue (masterKey), keyGetValueSize (masterKey), salt, saltLen, session->iterations,
+					     KEY_BUFFER_SIZE, keyBuffer);
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	pthread_mutex_unlock (&mutex_ssl);
+#endif
+	if (!result)
+	{
+		ELEKTRA_SET_INTERNAL_ERRORF (errorKey, "Failed to derive a cryptographic key. Libcrypto returned error code: %lu",
+					     ERR_get_error ());
+		return -1;
+	}
+
+	ELEKTRA_PLUGIN_FUNCTION (sessionSetDerivedKey) (session, salt, saltLen, keyBuffer, KEY_BUFFER_SIZE);
+	return 1;
+}
+
 /**
  * @brief derive the cryptographic key and IV for a given (Elektra) Key k
- * @param config KeySet holding the plugin/backend configuration
+ * @param session the current crypto session
  * @param errorKey holds an error description in case of failure
- * @param masterKey holds the decrypted master password from the plugin configuration
  * @param k the (Elektra)-Key to be encrypted
  * @param cKey (Elektra)-Key holding the cryptographic material
  * @param cIv (Elektra)-Key holding the initialization vector
  * @retval -1 on failure. errorKey holds the error description.
  * @retval 1 on success
  */
-static int getKeyIvForEncryption (KeySet * config, Key * errorKey, Key * masterKey, Key * k, Key * cKey, Key * cIv)
+static int getKeyIvForEncryption (ElektraCryptoSession * session, Key * errorKey, Key * k, Key * cKey, Key * cIv)
 {
 	kdb_octet_t salt[ELEKTRA_CRYPTO_DEFAULT_SALT_LEN] = { 0 };
 	kdb_octet_t keyBuffer[KEY_BUFFER_SIZE] = { 0 };
 	char * saltHexString = NULL;
 
-	ELEKTRA_ASSERT (masterKey != NULL, "Parameter `masterKey` must not be NULL");
-
 	// generate the salt
 	pthread_mutex_lock (&mutex_ssl);
 	if (!RAND_bytes (salt, ELEKTRA_CRYPTO_DEFAULT_SALT_LEN - 1))
@@ -79,73 +120,68 @@ static int getKeyIvForEncryption (KeySet * config, Key * errorKey, Key * masterK
 	keySetMeta (k, ELEKTRA_CRYPTO_META_SALT, saltHexString);
 	elektraFree (saltHexString);
 
-	// read iteration count
-	const kdb_unsigned_long_t iterations = ELEKTRA_PLUGIN_FUNCTION (getIterationCount) (errorKey, config);
-
 	// generate/derive the cryptographic key and the IV
-	pthread_mutex_lock (&mutex_ssl);
-	if (!PKCS5_PBKDF2_HMAC_SHA1 (keyValue (masterKey), keyGetValueSize (masterKey), salt, sizeof (salt), iterations, KEY_BUFFER_SIZE,
-				     keyBuffer))
+	if (deriveKeyIv (session, errorKey, salt, sizeof (salt), keyBuffer) != 1)
 	{
-		ELEKTRA_SET_INTERNAL_ERRORF (errorKey,
-					     "Failed to create a cryptographic key for encryption. Libcrypto returned error code: %lu",
-					     ERR_get_error ());
-		pthread_mutex_unlock (&mutex_ssl);
 		return -1;
 	}
-	pthread_mutex_unlock (&mutex_ssl);
 
 	keySetBinary (cKey, keyBuffer, ELEKTRA_CRYPTO_SSL_KEYSIZE);
 	keySetBinary (cIv, keyBuffer + ELEKTRA_CRYPTO_SSL_KEYSIZE, ELEKTRA_CRYPTO_SSL_BLOCKSIZE);
+	memset (keyBuffer, 0, sizeof (keyBuffer));
 	return 1;
 }
 
 /**
  * @brief derive the cryptographic key and IV for a given (Elektra) Key k
- * @param config KeySet holding the plugin/backend configuration
+ * @param session the current crypto session
  * @param errorKey holds an error description in case of failure
- * @param masterKey holds the decrypted master password from the plugin configuration
- * @param k the (Elektra)-Key to be encrypted
+ * @param k the (Elektra)-Key to be decrypted
  * @param cKey (Elektra)-Key holding the cryptographic material
  * @param cIv (Elektra)-Key holding the initialization vector
  * @retval -1 on failure. errorKey holds the error description.
  * @retval 1 on success
  */
-static int getKeyIvForDecryption (KeySet * config, Key * errorKey, Key * masterKey, Key * k, Key * cKey, Key * cIv)
+static int getKeyIvForDecryption (ElektraCryptoSession * session, Key * errorKey, Key * k, Key * cKey, Key * cIv)
 {
 	kdb_octet_t keyBuffer[KEY_BUFFER_SIZE];
 	kdb_octet_t * saltBuffer = NULL;
 	kdb_unsigned_long_t saltBufferLen = 0;
 
-	ELEKTRA_ASSERT (masterKey != NULL, "Parameter `masterKey` must not be NULL");
-
 	// get the salt
 	if (ELEKTRA_PLUGIN_FUNCTION (getSaltFromPayload) (errorKey, k, &saltBuffer, &saltBufferLen) != 1)
 	{
 		return -1; // error set by ELEKTRA_PLUGIN_FUNCTION(getSaltFromPayload)()
 	}
 
-	// get the iteration count
-	const kdb_unsigned_long_t iterations = ELEKTRA_PLUGIN_FUNCTION (getIterationCount) (errorKey, config);
-
 	// derive the cryptographic key and the IV
-	pthread_mutex_lock (&mutex_ssl);
-	if (!PKCS5_PBKDF2_HMAC_SHA1 (keyValue (masterKey), keyGetValueSize (masterKey), saltBuffer, saltBufferLen, iterations,
-				     KEY_BUFFER_SIZE, keyBuffer))
+	if (deriveKeyIv (session, errorKey, saltBuffer, saltBufferLen, keyBuffer) != 1)
 	{
-		ELEKTRA_SET_INTERNAL_ERRORF (
-			errorKey, "Failed to restore the cryptographic key for decryption. Libcrypto returned the error code: %lu",
-			ERR_get_error ());
-		pthread_mutex_unlock (&mutex_ssl);
 		return -1;
 	}
-	pthread_mutex_unlock (&mutex_ssl);
 
 	keySetBinary (cKey, keyBuffer, ELEKTRA_CRYPTO_SSL_KEYSIZE);
 	keySetBinary (cIv, keyBuffer + ELEKTRA_CRYPTO_SSL_KEYSIZE, ELEKTRA_CRYPTO_SSL_BLOCKSIZE);
+	memset (keyBuffer, 0, sizeof (keyBuffer));
 	return 1;
 }
 
+int elektraCryptoOpenSSLDeriveKey (ElektraCryptoSession * session, Key * errorKey, Key * k)
+{
+	kdb_octet_t keyBuffer[KEY_BUFFER_SIZE];
+	kdb_octet_t * saltBuffer = NULL;
+	kdb_unsigned_long_t saltBufferLen = 0;
+
+	if (ELEKTRA_PLUGIN_FUNCTION (getSaltFromPayload) (errorKey, k, &saltBuffer, &saltBufferLen) != 1)
+	{
+		return -1; // error set by ELEKTRA_PLUGIN_FUNCTION(getSaltFromPayload)()
+	}
+
+	int result = deriveKeyIv (session, errorKey, saltBuffer, saltBufferLen, keyBuffer);
+	memset (keyBuffer, 0, sizeof (keyBuffer));
+	return result;
+}
+
 int elektraCryptoOpenSSLInit (Key * errorKey ELEKTRA_UNUSED)
 {
 	// initialize OpenSSL according to
@@ -159,20 +195,18 @@ int elektraCryptoOpenSSLInit (Key * errorKey ELEKTRA_UNUSED)
 	return 1;
 }
 
-int elektraCryptoOpenSSLHandleCreate (elektraCryptoHandle ** handle, KeySet * config, Key * errorKey, Key * masterKey, Key * k,
+int elektraCryptoOpenSSLHandleCreate (elektraCryptoHandle ** handle, ElektraCryptoSession * session, Key * errorKey, Key * k,
 				      const enum ElektraCryptoOperation op)
 {
 	unsigned char keyBuffer[64], ivBuffer[64];
 
-	*handle = NULL;
-
 	// retrieve/derive the cryptographic material
 	Key * key = keyNew (0);
 	Key * iv = keyNew (0);
 	switch (op)
 	{
 	case ELEKTRA_CRYPTO_ENCRYPT:
-		if (getKeyIvForEncryption (config, errorKey, masterKey, k, key, iv) != 1)
+		if (getKeyIvForEncryption (session, errorKey, k, key, iv) != 1)
 		{
 			keyDel (key);
 			keyDel (iv);
@@ -181,7 +215,7 @@ int elektraCryptoOpenSSLHandleCreate (elektraCryptoHandle ** handle, KeySet * co
 		break;
 
 	case ELEKTRA_CRYPTO_DECRYPT:
-		if (getKeyIvForDecryption (config, errorKey, masterKey, k, key, iv) != 1)
+		if (getKeyIvForDecryption (session, errorKey, k, key, iv) != 1)
 		{
 			keyDel (key);
 			keyDel (iv);
@@ -218,20 +252,26 @@ int elektraCryptoOpenSSLHandleCreate (elektraCryptoHandle ** handle, KeySet * co
 	keyDel (key);
 	keyDel (iv);
 
-	*handle = elektraMalloc (sizeof (elektraCryptoHandle));
+	// create the handle, or reuse the cipher contexts of the previous Key
 	if (!(*handle))
 	{
-		memset (keyBuffer, 0, sizeof (keyBuffer));
-		memset (ivBuffer, 0, sizeof (ivBuffer));
-		ELEKTRA_SET_OUT_OF_MEMORY_ERROR (errorKey);
-		return -1;
+		*handle = elektraMalloc (sizeof (elektraCryptoHandle));
+		if (!(*handle))
+		{
+			memset (keyBuffer, 0, sizeof (keyBuffer));
+			memset (ivBuffer, 0, sizeof (ivBuffer));
+			ELEKTRA_SET_OUT_OF_MEMORY_ERROR (errorKey);
+			return -1;
+		}
+
+		pthread_mutex_lock (&mutex_ssl);
+		(*handle)->encrypt = EVP_CIPHER_CTX_new ();
+		(*handle)->decrypt = EVP_CIPHER_CTX_new ();
+		pthread_mutex_unlock (&mutex_ssl);
 	}
 
 	pthread_mutex_lock (&mutex_ssl);
 
-	(*handle)->encrypt = EVP_CIPHER_CTX_new ();
-	(*handle)->decrypt = EVP_CIPHER_CTX_new ();
-
 	EVP_EncryptInit ((*handle)->encrypt, EVP_aes_256_cbc (), keyBuffer, ivBuffer);
 	EVP_DecryptInit ((*handle)->decrypt, EVP_aes_256_cbc (), keyBuffer, ivBuffer);
 
@@ -10,6 +10,7 @@
 #ifndef ELEKTRA_PLUGIN_LIBCRYPTO_OPERATIONS_H
 #define ELEKTRA_PLUGIN_LIBCRYPTO_OPERATIONS_H
 
+#include "helper.h"
 #include <kdb.h>
 #include <kdbtypes.h>
 
@@ -18,8 +19,9 @@
 
 char * elektraCryptoOpenSSLCreateRandomString (Key * errorKey, const kdb_unsigned_short_t length);
 int elektraCryptoOpenSSLInit (Key * errorKey);
-int elektraCryptoOpenSSLHandleCreate (elektraCryptoHandle ** handle, KeySet * config, Key * errorKey, Key * masterKey, Key * k,
+int elektraCryptoOpenSSLHandleCreate (elektraCryptoHandle ** handle, ElektraCryptoSession * session, Key * errorKey, Key * k,
 				      const enum ElektraCryptoOperation op);
+int elektraCryptoOpenSSLDeriveKey (ElektraCryptoSession * session, Key * errorKey, Key * k);
 void elektraCryptoOpenSSLHandleDestroy (elektraCryptoHandle * handle);
 int elektraCryptoOpenSSLEncrypt (elektraCryptoHandle * handle, Key * k, Key * errorKey);
 int elektraCryptoOpenSSLDecrypt (elektraCryptoHandle * handle, Key * k, Key * errorKey);
@@ -9,6 +9,7 @@
  */
 
 #include "crypto.h"
+#include "crypto_kdb_functions.h"
 #include "gpg.h"
 #include "helper.h"
 #include <kdb.h>
@@ -34,6 +35,7 @@ static KeySet * newPluginConfiguration (void);
 		test_init (PLUGIN_NAME);                                                                                                   \
 		test_incomplete_config (PLUGIN_NAME);                                                                                      \
 		test_crypto_operations (PLUGIN_NAME);                                                                                      \
+		test_crypto_session (PLUGIN_NAME);                                                                                         \
 		test_teardown ();                                                                                                          \
 	}                                                                                                                                  \
 	else                                                                                                                               \
@@ -260,6 +262,64 @@ static void test_crypto_operations (const char * pluginName)
 	keyDel (parentKey);
 }
 
+static void test_crypto_session (const char * pluginName)
+{
+	Key * parentKey = keyNew ("system", KEY_END);
+	KeySet * modules = ksNew (0, KS_END);
+	KeySet * config = newPluginConfiguration ();
+	ksAppendKey (config, keyNew (ELEKTRA_CRYPTO_PARAM_THREADS, KEY_VALUE, "4", KEY_END));
+	ksAppendKey (config, keyNew (ELEKTRA_CRYPTO_PARAM_ITERATION_COUNT, KEY_VALUE, "1000", KEY_END));
+	setPluginShutdown (config);
+
+	elektraModulesInit (modules, 0);
+
+	Plugin * plugin = elektraPluginOpen (pluginName, modules, config, 0);
+	exit_if_fail (plugin, "failed to open the plugin");
+
+	// generate the master password
+	KeySet * pluginConfig = elektraPluginGetConfig (plugin);
+	succeed_if (ELEKTRA_PLUGIN_FUNCTION (checkconf) (parentKey, pluginConfig) == 1, "checkconf call failed");
+
+	KeySet * data = newTestdataKeySet ();
+	for (int i = 0; i < 50; ++i)
+	{
+		char name[64];
+		snprintf (name, sizeof (name), "user/crypto/test/many/#%d", i);
+		ksAppendKey (data, keyNew (name, KEY_VALUE, name, KEY_META, ELEKTRA_CRYPTO_META_ENCRYPT, "1", KEY_END));
+	}
+	KeySet * original = ksDeepDup (data);
+
+	succeed_if (plugin->kdbSet (plugin, data, parentKey) == 1, "kdb set failed");
+	KeySet * encrypted = ksDeepDup (data);
+
+	// the same instance knows the derived keys of its last kdbSet
+	succeed_if (plugin->kdbGet (plugin, data, parentKey) == 1, "kdb get failed");
+	compare_keyset (data, original);
+
+	// a new instance has to derive all keys, which is done in parallel
+	KeySet * otherConfig = ksDup (pluginConfig);
+	Plugin * other = elektraPluginOpen (pluginName, modules, otherConfig, 0);
+	exit_if_fail (other, "failed to open the plugin");
+	succeed_if (other->kdbGet (other, encrypted, parentKey) == 1, "kdb get with parallel key derivation failed");
+	compare_keyset (encrypted, original);
+
+	// a corrupted payload must still be reported
+	Key * broken = ksLookupByName (data, "user/crypto/test/many/#42", 0);
+	succeed_if (plugin->kdbSet (plugin, data, parentKey) == 1, "kdb set failed");
+	keySetBinary (broken, ELEKTRA_CRYPTO_MAGIC_NUMBER "xx", ELEKTRA_CRYPTO_MAGIC_NUMBER_LEN + 2);
+	succeed_if (other->kdbGet (other, data, parentKey) == -1, "kdb get of corrupted payload succeeded");
+	succeed_if (keyGetMeta (parentKey, "error"), "no error for corrupted payload");
+
+	elektraPluginClose (other, 0);
+	elektraPluginClose (plugin, 0);
+	ksDel (encrypted);
+	ksDel (original);
+	ksDel (data);
+	elektraModulesClose (modules, 0);
+	ksDel (modules);
+	keyDel (parentKey);
+}
+
 static void test_gpg (void)
 {
 	// Plugin configuration
@@ -0,0 +1,1007 @@
+/**
+ * @file
+ *
+ * @brief Source for journalstorage plugin
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ *
+ */
+
+#ifdef HAVE_KDBCONFIG_H
+#include "kdbconfig.h"
+#endif
+
+#include "journalstorage.h"
+
+#include <kdbendian.h>
+#include <kdbhelper.h>
+
+#include <kdberrors.h>
+#include <kdbprivate.h>
+#include <kdbproposal.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
+#define MAGIC_NUMBER ((kdb_unsigned_long_long_t) 0x454b444a00000001UL) // EKDJ (in ASCII) + version 1
+
+// the header consists of: magic number, end of the base, number of records in the journal
+#define HEADER_SIZE (3 * sizeof (kdb_unsigned_long_long_t))
+// offset of the part of the header, which is updated when appending to the journal
+#define HEADER_UPDATE_OFFSET sizeof (kdb_unsigned_long_long_t)
+// a record consists of: type, size of the payload, payload, checksum
+#define RECORD_START_SIZE (1 + sizeof (kdb_unsigned_long_t))
+
+// FNV-1a (32 bit)
+#define CHECKSUM_OFFSET_BASIS 2166136261u
+#define CHECKSUM_PRIME 16777619u
+
+#define DEFAULT_COMPACT 1000
+
+// keep #ifdef in sync with kdb export
+#ifdef _WIN32
+#define STDOUT_FILENAME ("CON")
+#else
+#define STDOUT_FILENAME ("/dev/stdout")
+#endif
+
+/**
+ * The part of the header following the magic number.
+ */
+struct header
+{
+	kdb_unsigned_long_long_t baseEnd; // end of the base, 0 if the file has no journal
+	kdb_unsigned_long_long_t records; // number of records in the journal
+};
+
+/**
+ * The file the journal is appended to.
+ *
+ * kdbSet() only gets the name of the temporary file, so the name is remembered by kdbGet(). The temporary
+ * file written by kdbSet() is kept open: once it is renamed by the resolver, it is the current file.
+ */
+typedef struct
+{
+	char * name; // file read by the last kdbGet()
+	int written; // file written by the last kdbSet(), -1 if none
+} JournalFile;
+
+typedef struct
+{
+	JournalFile files[4];		  // per namespace (spec, dir, user, system)
+	kdb_unsigned_long_long_t compact; // maximum number of records in the journal
+} JournalHandle;
+
+struct buffer
+{
+	size_t alloc;
+	size_t size;
+	char * data;
+};
+
+struct reader
+{
+	char * cur;
+	char * end;
+};
+
+static kdb_unsigned_long_t checksum (const char * data, size_t size)
+{
+	kdb_unsigned_long_t hash = CHECKSUM_OFFSET_BASIS;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= (unsigned char) data[i];
+		hash *= CHECKSUM_PRIME;
+	}
+	return hash;
+}
+
+static JournalFile * journalFile (JournalHandle * jh, Key * parentKey)
+{
+	switch (keyGetNamespace (parentKey))
+	{
+	case KEY_NS_SPEC:
+		return &jh->files[0];
+	case KEY_NS_DIR:
+		return &jh->files[1];
+	case KEY_NS_USER:
+		return &jh->files[2];
+	case KEY_NS_SYSTEM:
+		return &jh->files[3];
+	case KEY_NS_PROC:
+	case KEY_NS_EMPTY:
+	case KEY_NS_META:
+	case KEY_NS_CASCADING:
+	case KEY_NS_NONE:
+		break;
+	}
+	return NULL;
+}
+
+/**
+ * Opens the current file, which @p journal was remembered for.
+ *
+ * @return a file descriptor to be closed by the caller
+ * @retval -1 if the current file is not known
+ */
+static int openJournal (JournalFile * journal)
+{
+	struct stat st;
+
+	// if the temporary file was removed instead of renamed (e.g. rollback), it has no links anymore
+	if (journal->written != -1 && fstat (journal->written, &st) == 0 && st.st_nlink > 0)
+	{
+		return dup (journal->written);
+	}
+
+	return journal->name == NULL ? -1 : open (journal->name, O_RDONLY);
+}
+
+static void rememberWritten (JournalHandle * jh, Key * parentKey)
+{
+	JournalFile * journal = journalFile (jh, parentKey);
+	if (journal == NULL)
+	{
+		return;
+	}
+
+	if (journal->written != -1)
+	{
+		close (journal->written);
+	}
+	journal->written = open (keyString (parentKey), O_RDONLY);
+}
+
+static void ensureBufferSize (struct buffer * buffer, size_t minSize)
+{
+	if (buffer->alloc >= minSize)
+	{
+		return;
+	}
+
+	size_t alloc = buffer->alloc;
+	while (alloc < minSize)
+	{
+		alloc *= 2;
+	}
+	elektraRealloc ((void **) &buffer->data, alloc);
+	buffer->alloc = alloc;
+}
+
+static inline void appendData (struct buffer * buffer, const void * data, size_t size)
+{
+	ensureBufferSize (buffer, buffer->size + size);
+	if (size > 0)
+	{
+		memcpy (&buffer->data[buffer->size], data, size);
+	}
+	buffer->size += size;
+}
+
+static inline void appendUInt32 (struct buffer * buffer, kdb_unsigned_long_t value)
+{
+	value = htole32 (value);
+	appendData (buffer, &value, sizeof (kdb_unsigned_long_t));
+}
+
+/**
+ * Strings are stored with their size and a null terminator,
+ * so that they can be used directly from the buffer they are read into.
+ */
+static inline bool appendString (struct buffer * buffer, const char * data, size_t size, Key * errorKey)
+{
+	if (size >= UINT32_MAX)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (errorKey, "String too large");
+		return false;
+	}
+
+	appendUInt32 (buffer, (kdb_unsigned_long_t) size);
+	appendData (buffer, data, size);
+	appendData (buffer, "", 1);
+	return true;
+}
+
+static inline void beginRecord (struct buffer * buffer, char type)
+{
+	buffer->size = 0;
+	appendData (buffer, &type, 1);
+	appendUInt32 (buffer, 0); // size of the payload, set by endRecord
+}
+
+static inline bool endRecord (struct buffer * buffer, Key * errorKey)
+{
+	size_t payloadSize = buffer->size - RECORD_START_SIZE;
+	if (payloadSize >= UINT32_MAX)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (errorKey, "Key too large");
+		return false;
+	}
+
+	kdb_unsigned_long_t size = htole32 ((kdb_unsigned_long_t) payloadSize);
+	memcpy (&buffer->data[1], &size, sizeof (kdb_unsigned_long_t));
+	appendUInt32 (buffer, checksum (buffer->data, buffer->size));
+	return true;
+}
+
+static bool encodeName (struct buffer * buffer, Key * cur, size_t parentOffset, Key * parentKey)
+{
+	size_t fullNameSize = keyGetNameSize (cur);
+	if (fullNameSize < parentOffset)
+	{
+		ELEKTRA_SET_INTERFACE_ERRORF (parentKey, "The key '%s' is not below the parent key", keyName (cur));
+		return false;
+	}
+
+	size_t nameSize = fullNameSize == parentOffset ? 0 : fullNameSize - 1 - parentOffset;
+	return appendString (buffer, keyName (cur) + parentOffset, nameSize, parentKey);
+}
+
+/**
+ * Encodes an upsert record of @p cur: name, value and metadata.
+ */
+static bool encodeKey (struct buffer * buffer, Key * cur, size_t parentOffset, Key * parentKey)
+{
+	beginRecord (buffer, 'k');
+	if (!encodeName (buffer, cur, parentOffset, parentKey))
+	{
+		return false;
+	}
+
+	if (keyIsBinary (cur))
+	{
+		// binary values are stored as they are, without null terminator
+		size_t valueSize = keyGetValueSize (cur);
+		if (valueSize >= UINT32_MAX)
+		{
+			ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Value too large");
+			return false;
+		}
+		appendData (buffer, "b", 1);
+		appendUInt32 (buffer, (kdb_unsigned_long_t) valueSize);
+		appendData (buffer, keyValue (cur), valueSize);
+	}
+	else
+	{
+		appendData (buffer, "s", 1);
+		if (!appendString (buffer, keyString (cur), keyGetValueSize (cur) - 1, parentKey))
+		{
+			return false;
+		}
+	}
+
+	keyRewindMeta (cur);
+	const Key * meta;
+	while ((meta = keyNextMeta (cur)) != NULL)
+	{
+		if (!appendString (buffer, keyName (meta), keyGetNameSize (meta) - 1, parentKey) ||
+		    !appendString (buffer, keyString (meta), keyGetValueSize (meta) - 1, parentKey))
+		{
+			return false;
+		}
+	}
+
+	return endRecord (buffer, parentKey);
+}
+
+/**
+ * Encodes a delete record of @p cur, only its name is stored.
+ */
+static bool encodeRemoval (struct buffer * buffer, Key * cur, size_t parentOffset, Key * parentKey)
+{
+	beginRecord (buffer, 'd');
+	return encodeName (buffer, cur, parentOffset, parentKey) && endRecord (buffer, parentKey);
+}
+
+static bool writeRecords (FILE * file, KeySet * ks, char type, struct buffer * buffer, Key * parentKey)
+{
+	size_t parentOffset = keyGetNameSize (parentKey);
+
+	for (cursor_t it = 0; it < ksGetSize (ks); ++it)
+	{
+		Key * cur = ksAtCursor (ks, it);
+		bool encoded = type == 'd' ? encodeRemoval (buffer, cur, parentOffset, parentKey) :
+					     encodeKey (buffer, cur, parentOffset, parentKey);
+		if (!encoded)
+		{
+			return false;
+		}
+
+		// every record is written at once
+		if (fwrite (buffer->data, sizeof (char), buffer->size, file) < buffer->size)
+		{
+			ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not write file");
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline bool readUInt32 (struct reader * reader, kdb_unsigned_long_t * value)
+{
+	if (reader->end - reader->cur < (ssize_t) sizeof (kdb_unsigned_long_t))
+	{
+		return false;
+	}
+	memcpy (value, reader->cur, sizeof (kdb_unsigned_long_t));
+	*value = le32toh (*value);
+	reader->cur += sizeof (kdb_unsigned_long_t);
+	return true;
+}
+
+static inline char * readString (struct reader * reader, size_t * sizePtr)
+{
+	kdb_unsigned_long_t size;
+	if (!readUInt32 (reader, &size) || (size_t) (reader->end - reader->cur) <= size || reader->cur[size] != '\0')
+	{
+		return NULL;
+	}
+
+	char * string = reader->cur;
+	reader->cur += size + 1;
+	*sizePtr = size;
+	return string;
+}
+
+/**
+ * Reads the next record and verifies its checksum.
+ *
+ * @param payload is set to the payload of the record
+ *
+ * @return the type of the record
+ * @retval -1 if the record is truncated or corrupt, an error is set on @p parentKey
+ */
+static int readRecord (struct reader * reader, struct reader * payload, Key * parentKey)
+{
+	char * start = reader->cur;
+	kdb_unsigned_long_t size;
+	kdb_unsigned_long_t expected;
+
+	++reader->cur;
+	if (reader->cur > reader->end || !readUInt32 (reader, &size) || (size_t) (reader->end - reader->cur) < size)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Premature end of file");
+		return -1;
+	}
+
+	payload->cur = reader->cur;
+	payload->end = reader->cur + size;
+	reader->cur = payload->end;
+
+	if (!readUInt32 (reader, &expected))
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Premature end of file");
+		return -1;
+	}
+
+	if (checksum (start, payload->end - start) != expected)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Checksum mismatch, the file is corrupt");
+		return -1;
+	}
+
+	return (unsigned char) *start;
+}
+
+/**
+ * Appends the name relative to the parent key read from @p payload to @p nameBuffer.
+ *
+ * @return the full name in @p nameBuffer
+ * @retval NULL if the record is corrupt
+ */
+static const char * readName (struct reader * payload, struct buffer * nameBuffer, size_t parentSize)
+{
+	size_t nameSize;
+	const char * name = readString (payload, &nameSize);
+	if (name == NULL)
+	{
+		return NULL;
+	}
+
+	nameBuffer->size = parentSize;
+	appendData (nameBuffer, name, nameSize + 1);
+	return nameBuffer->data;
+}
+
+/**
+ * Creates a new key in the arena of @p keys from the payload of an upsert record.
+ *
+ * The value of the key points directly into the buffer owned by the arena,
+ * it is only copied once it is changed.
+ */
+static Key * readKey (KeySet * keys, struct reader * payload, struct buffer * nameBuffer, size_t parentSize, Key * parentKey)
+{
+	const char * name = readName (payload, nameBuffer, parentSize);
+	if (name == NULL || payload->cur == payload->end)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Invalid key record");
+		return NULL;
+	}
+
+	char type = *payload->cur++;
+	char * value;
+	size_t valueSize;
+	kdb_unsigned_long_t binarySize;
+	switch (type)
+	{
+	case 'b':
+		if (!readUInt32 (payload, &binarySize) || (size_t) (payload->end - payload->cur) < binarySize)
+		{
+			ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Invalid key record");
+			return NULL;
+		}
+		value = payload->cur;
+		valueSize = binarySize;
+		payload->cur += binarySize;
+		break;
+	case 's':
+		value = readString (payload, &valueSize);
+		if (value == NULL)
+		{
+			ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Invalid key record");
+			return NULL;
+		}
+		break;
+	default:
+		ELEKTRA_SET_VALIDATION_SEMANTIC_ERRORF (parentKey, "Unknown key type %c", type);
+		return NULL;
+	}
+
+	Key * k = type == 'b' ? ksArenaKeyNew (keys, name, KEY_BINARY, KEY_END) : ksArenaKeyNew (keys, name, KEY_END);
+	if (k == NULL)
+	{
+		ELEKTRA_SET_VALIDATION_SEMANTIC_ERRORF (parentKey, "Invalid key name '%s'", name);
+		return NULL;
+	}
+
+	if (type == 's' || valueSize > 0)
+	{
+		k->data.v = value;
+		k->dataSize = type == 'b' ? valueSize : valueSize + 1;
+		set_bit (k->flags, KEY_FLAG_MMAP_DATA);
+	}
+
+	while (payload->cur < payload->end)
+	{
+		size_t metaNameSize;
+		size_t metaValueSize;
+		const char * metaName = readString (payload, &metaNameSize);
+		const char * metaValue = metaName == NULL ? NULL : readString (payload, &metaValueSize);
+		if (metaValue == NULL)
+		{
+			keyDel (k);
+			ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Invalid metadata in key record");
+			return NULL;
+		}
+		keySetMeta (k, metaName, metaValue);
+	}
+
+	return k;
+}
+
+/**
+ * Reads the whole @p file into a single buffer owned by the arena of @p keys.
+ */
+static bool readContents (FILE * file, KeySet * keys, struct reader * reader)
+{
+	struct buffer buffer;
+
+	// regular files are read at once, otherwise (e.g. pipes) the buffer grows as needed
+	struct stat st;
+	buffer.alloc = 4096;
+	if (fstat (fileno (file), &st) == 0 && S_ISREG (st.st_mode) && (size_t) st.st_size >= buffer.alloc)
+	{
+		buffer.alloc = st.st_size + 1;
+	}
+	buffer.size = 0;
+	buffer.data = elektraMalloc (buffer.alloc);
+
+	size_t bytesRead;
+	while ((bytesRead = fread (&buffer.data[buffer.size], sizeof (char), buffer.alloc - buffer.size, file)) > 0)
+	{
+		buffer.size += bytesRead;
+		ensureBufferSize (&buffer, buffer.size + 1);
+	}
+
+	if (ferror (file) || ksArenaAdoptBuffer (keys, buffer.data) != 1)
+	{
+		elektraFree (buffer.data);
+		return false;
+	}
+
+	reader->cur = buffer.data;
+	reader->end = buffer.data + buffer.size;
+	return true;
+}
+
+static bool decodeHeader (const char * data, struct header * header)
+{
+	kdb_unsigned_long_long_t fields[3];
+	memcpy (fields, data, HEADER_SIZE);
+
+	// magic number is written big endian so EKDJ magic string is readable
+	if (be64toh (fields[0]) != MAGIC_NUMBER)
+	{
+		return false;
+	}
+	header->baseEnd = le64toh (fields[1]);
+	header->records = le64toh (fields[2]);
+	return true;
+}
+
+/**
+ * Decodes the base and replays the journal on top of it.
+ */
+static int readKeys (struct reader * reader, KeySet * keys, Key * parentKey)
+{
+	kdb_unsigned_long_long_t fileSize = reader->end - reader->cur;
+	struct header header;
+	if (fileSize < HEADER_SIZE || !decodeHeader (reader->cur, &header))
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Not a journalstorage file");
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	kdb_unsigned_long_long_t baseEnd = header.baseEnd == 0 ? fileSize : header.baseEnd;
+	if (baseEnd < HEADER_SIZE || baseEnd > fileSize)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERRORF (parentKey, "Invalid end of base " ELEKTRA_UNSIGNED_LONG_LONG_F, baseEnd);
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	struct buffer nameBuffer;
+	size_t parentSize = keyGetNameSize (parentKey); // includes null terminator
+	nameBuffer.alloc = parentSize + 64;
+	nameBuffer.data = elektraMalloc (nameBuffer.alloc);
+	keyGetName (parentKey, nameBuffer.data, parentSize);
+	nameBuffer.data[parentSize - 1] = '/'; // names are relative to the parent key
+	nameBuffer.size = parentSize;
+
+	char * base = reader->cur + baseEnd;
+	reader->cur += HEADER_SIZE;
+
+	int result = ELEKTRA_PLUGIN_STATUS_SUCCESS;
+
+	// the base contains each key once, in order
+	while (reader->cur < base)
+	{
+		struct reader payload;
+		int type = readRecord (reader, &payload, parentKey);
+		if (type != 'k')
+		{
+			if (type != -1)
+			{
+				ELEKTRA_SET_VALIDATION_SEMANTIC_ERRORF (parentKey, "Unexpected record type %c in base", type);
+			}
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+			break;
+		}
+
+		Key * k = readKey (keys, &payload, &nameBuffer, parentSize, parentKey);
+		if (k == NULL)
+		{
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+			break;
+		}
+		ksBuilderAdd (keys, k);
+	}
+	ksBuilderFinish (keys);
+
+	if (result == ELEKTRA_PLUGIN_STATUS_SUCCESS && reader->cur != base)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Record crosses the end of the base");
+		result = ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	// the journal is replayed in the order it was written
+	kdb_unsigned_long_long_t records = 0;
+	while (result == ELEKTRA_PLUGIN_STATUS_SUCCESS && reader->cur < reader->end)
+	{
+		struct reader payload;
+		int type = readRecord (reader, &payload, parentKey);
+		Key * k;
+		const char * name;
+		switch (type)
+		{
+		case 'k':
+			k = readKey (keys, &payload, &nameBuffer, parentSize, parentKey);
+			if (k == NULL)
+			{
+				result = ELEKTRA_PLUGIN_STATUS_ERROR;
+				break;
+			}
+			ksAppendKey (keys, k);
+			break;
+		case 'd':
+			name = readName (&payload, &nameBuffer, parentSize);
+			if (name == NULL || payload.cur != payload.end)
+			{
+				ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Invalid delete record");
+				result = ELEKTRA_PLUGIN_STATUS_ERROR;
+				break;
+			}
+			keyDel (ksLookupByName (keys, name, KDB_O_POP));
+			break;
+		case -1:
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+			break;
+		default:
+			ELEKTRA_SET_VALIDATION_SEMANTIC_ERRORF (parentKey, "Unknown record type %c", type);
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+			break;
+		}
+		++records;
+	}
+
+	if (result == ELEKTRA_PLUGIN_STATUS_SUCCESS && records != header.records)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERRORF (parentKey,
+							 "Journal contains " ELEKTRA_UNSIGNED_LONG_LONG_F
+							 " records, but header says " ELEKTRA_UNSIGNED_LONG_LONG_F,
+							 records, header.records);
+		result = ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	elektraFree (nameBuffer.data);
+	return result;
+}
+
+int elektraJournalstorageOpen (Plugin * handle, Key * errorKey)
+{
+	JournalHandle * jh = elektraCalloc (sizeof (JournalHandle));
+	jh->compact = DEFAULT_COMPACT;
+	for (size_t i = 0; i < sizeof (jh->files) / sizeof (jh->files[0]); ++i)
+	{
+		jh->files[i].written = -1;
+	}
+
+	Key * compact = ksLookupByName (elektraPluginGetConfig (handle), "/compact", 0);
+	if (compact != NULL)
+	{
+		char * end;
+		errno = 0;
+		jh->compact = strtoull (keyString (compact), &end, 10);
+		if (errno != 0 || *keyString (compact) == '\0' || *end != '\0')
+		{
+			ELEKTRA_SET_INSTALLATION_ERRORF (errorKey, "Invalid value '%s' for /compact, expected a number of records",
+							 keyString (compact));
+			elektraFree (jh);
+			return ELEKTRA_PLUGIN_STATUS_ERROR;
+		}
+	}
+
+	elektraPluginSetData (handle, jh);
+	return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+}
+
+int elektraJournalstorageClose (Plugin * handle, Key * errorKey ELEKTRA_UNUSED)
+{
+	JournalHandle * jh = elektraPluginGetData (handle);
+	if (jh == NULL)
+	{
+		return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+	}
+
+	for (size_t i = 0; i < sizeof (jh->files) / sizeof (jh->files[0]); ++i)
+	{
+		elektraFree (jh->files[i].name);
+		if (jh->files[i].written != -1)
+		{
+			close (jh->files[i].written);
+		}
+	}
+	elektraFree (jh);
+	elektraPluginSetData (handle, NULL);
+	return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+}
+
+int elektraJournalstorageGet (Plugin * handle, KeySet * returned, Key * parentKey)
+{
+	if (!elektraStrCmp (keyName (parentKey), "system/elektra/modules/journalstorage"))
+	{
+		KeySet * contract = ksNew (
+			30,
+			keyNew ("system/elektra/modules/journalstorage", KEY_VALUE, "journalstorage plugin waits for your orders", KEY_END),
+			keyNew ("system/elektra/modules/journalstorage/exports", KEY_END),
+			keyNew ("system/elektra/modules/journalstorage/exports/open", KEY_FUNC, elektraJournalstorageOpen, KEY_END),
+			keyNew ("system/elektra/modules/journalstorage/exports/close", KEY_FUNC, elektraJournalstorageClose, KEY_END),
+			keyNew ("system/elektra/modules/journalstorage/exports/get", KEY_FUNC, elektraJournalstorageGet, KEY_END),
+			keyNew ("system/elektra/modules/journalstorage/exports/set", KEY_FUNC, elektraJournalstorageSet, KEY_END),
+			keyNew ("system/elektra/modules/journalstorage/exports/setDelta", KEY_FUNC, elektraJournalstorageSetDelta, KEY_END),
+#include ELEKTRA_README
+			keyNew ("system/elektra/modules/journalstorage/infos/version", KEY_VALUE, PLUGINVERSION, KEY_END), KS_END);
+		ksAppend (returned, contract);
+		ksDel (contract);
+
+		return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+	}
+
+	// the file is only known here, kdbSet() gets the name of the temporary file
+	JournalFile * journal = journalFile (elektraPluginGetData (handle), parentKey);
+	if (journal != NULL)
+	{
+		elektraFree (journal->name);
+		journal->name = elektraStrDup (keyString (parentKey));
+		if (journal->written != -1)
+		{
+			close (journal->written);
+			journal->written = -1;
+		}
+	}
+
+	int errnoSave = errno;
+	FILE * file = fopen (keyString (parentKey), "rb");
+	if (file == NULL)
+	{
+		if (errno == ENOENT)
+		{
+			// a missing file is the same as an empty one
+			errno = errnoSave;
+			return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+		}
+		ELEKTRA_SET_ERROR_GET (parentKey);
+		errno = errnoSave;
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	// keys are allocated in bulk from an arena, which also owns the contents of the file
+	KeySet * keys = ksNewArena (0);
+
+	struct reader reader;
+	if (!readContents (file, keys, &reader))
+	{
+		fclose (file);
+		ksDel (keys);
+		ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not read file");
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+	fclose (file);
+
+	int result = reader.cur == reader.end ? ELEKTRA_PLUGIN_STATUS_SUCCESS : readKeys (&reader, keys, parentKey);
+	if (result == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	{
+		ksAppend (returned, keys);
+	}
+	ksDel (keys);
+
+	return result;
+}
+
+/**
+ * Writes all keys of @p returned as new base without journal.
+ *
+ * This is also how the journal is compacted.
+ */
+int elektraJournalstorageSet (Plugin * handle, KeySet * returned, Key * parentKey)
+{
+	FILE * file;
+
+	// cannot open stdout for writing, because its already open
+	if (elektraStrCmp (keyString (parentKey), STDOUT_FILENAME) == 0)
+	{
+		file = stdout;
+	}
+	else
+	{
+		file = fopen (keyString (parentKey), "wb");
+	}
+
+	if (file == NULL)
+	{
+		ELEKTRA_SET_ERROR_SET (parentKey);
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	// magic number is written big endian so EKDJ magic string is readable
+	kdb_unsigned_long_long_t header[3] = { htobe64 (MAGIC_NUMBER), 0, 0 };
+
+	struct buffer buffer;
+	buffer.alloc = 4096;
+	buffer.size = 0;
+	buffer.data = elektraMalloc (buffer.alloc);
+
+	bool success = fwrite (header, sizeof (char), HEADER_SIZE, file) == HEADER_SIZE;
+	if (!success)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not write file");
+	}
+	success = success && writeRecords (file, returned, 'k', &buffer, parentKey);
+
+	elektraFree (buffer.data);
+
+	bool regular = file != stdout;
+	if (fclose (file) != 0 && success)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not write file");
+		success = false;
+	}
+
+	if (success && regular)
+	{
+		rememberWritten (elektraPluginGetData (handle), parentKey);
+	}
+
+	return success ? ELEKTRA_PLUGIN_STATUS_SUCCESS : ELEKTRA_PLUGIN_STATUS_ERROR;
+}
+
+static bool copyData (int in, int out, off_t size)
+{
+	off_t offset = 0;
+
+#ifdef __linux__
+	// copies inside of the kernel
+	while (offset < size)
+	{
+		if (sendfile (out, in, &offset, size - offset) <= 0)
+		{
+			break;
+		}
+	}
+	if (offset == size)
+	{
+		return true;
+	}
+#endif
+
+	if (lseek (in, offset, SEEK_SET) == -1 || lseek (out, offset, SEEK_SET) == -1)
+	{
+		return false;
+	}
+
+	char buffer[BUFSIZ];
+	while (offset < size)
+	{
+		ssize_t bytesRead = read (in, buffer, sizeof (buffer));
+		if (bytesRead <= 0)
+		{
+			return false;
+		}
+		for (ssize_t written = 0; written < bytesRead;)
+		{
+			ssize_t n = write (out, buffer + written, bytesRead - written);
+			if (n <= 0)
+			{
+				return false;
+			}
+			written += n;
+		}
+		offset += bytesRead;
+	}
+	return true;
+}
+
+/**
+ * Copies the file @p in to @p destination and reads its header. @p in is closed.
+ *
+ * On file systems supporting it, the data is shared between both files.
+ *
+ * @retval true if @p destination is a copy of a journalstorage file
+ * @retval false otherwise, e.g. because @p in is empty
+ */
+static bool copyFile (int in, const char * destination, struct header * header, kdb_unsigned_long_long_t * size)
+{
+	if (in == -1)
+	{
+		return false;
+	}
+
+	struct stat st;
+	char data[HEADER_SIZE];
+	if (fstat (in, &st) == -1 || !S_ISREG (st.st_mode) || (size_t) st.st_size < HEADER_SIZE ||
+	    pread (in, data, HEADER_SIZE, 0) != HEADER_SIZE || !decodeHeader (data, header))
+	{
+		close (in);
+		return false;
+	}
+	*size = st.st_size;
+
+	// permissions are set by the resolver
+	int out = open (destination, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (out == -1)
+	{
+		close (in);
+		return false;
+	}
+
+	bool copied = false;
+#ifdef FICLONE
+	copied = ioctl (out, FICLONE, in) == 0;
+#endif
+	copied = copied || copyData (in, out, st.st_size);
+
+	close (in);
+	return close (out) == 0 && copied;
+}
+
+/**
+ * Appends the changes to the journal of the current file.
+ *
+ * The file is copied to the temporary file of the resolver and the records are
+ * appended to the copy. If the journal would get longer than configured with
+ * /compact or there is no suitable file, all keys are written instead.
+ */
+int elektraJournalstorageSetDelta (Plugin * handle, KeySet * returned, KeySet * added, KeySet * changed, KeySet * removed, Key * parentKey)
+{
+	JournalHandle * jh = elektraPluginGetData (handle);
+	JournalFile * journal = journalFile (jh, parentKey);
+	kdb_unsigned_long_long_t changes = ksGetSize (added) + ksGetSize (changed) + ksGetSize (removed);
+
+	struct header header;
+	kdb_unsigned_long_long_t size;
+	if (journal == NULL || !copyFile (openJournal (journal), keyString (parentKey), &header, &size) ||
+	    header.records + changes > jh->compact)
+	{
+		return elektraJournalstorageSet (handle, returned, parentKey);
+	}
+
+	FILE * file = fopen (keyString (parentKey), "r+b");
+	if (file == NULL)
+	{
+		ELEKTRA_SET_ERROR_SET (parentKey);
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	struct buffer buffer;
+	buffer.alloc = 4096;
+	buffer.size = 0;
+	buffer.data = elektraMalloc (buffer.alloc);
+
+	bool success = fseek (file, 0, SEEK_END) == 0;
+	if (!success)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not write file");
+	}
+
+	success = success && writeRecords (file, removed, 'd', &buffer, parentKey) && writeRecords (file, changed, 'k', &buffer, parentKey) &&
+		  writeRecords (file, added, 'k', &buffer, parentKey);
+
+	elektraFree (buffer.data);
+
+	if (success)
+	{
+		kdb_unsigned_long_long_t update[2] = { htole64 (header.baseEnd == 0 ? size : header.baseEnd),
+						       htole64 (header.records + changes) };
+		if (fseek (file, HEADER_UPDATE_OFFSET, SEEK_SET) != 0 || fwrite (update, sizeof (char), sizeof (update), file) < sizeof (update))
+		{
+			ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not write file");
+			success = false;
+		}
+	}
+
+	if (fclose (file) != 0 && success)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not write file");
+		success = false;
+	}
+
+	if (success)
+	{
+		rememberWritten (jh, parentKey);
+	}
+
+	return success ? ELEKTRA_PLUGIN_STATUS_SUCCESS : ELEKTRA_PLUGIN_STATUS_ERROR;
+}
+
+Plugin * ELEKTRA_PLUGIN_EXPORT
+{
+	// clang-format off
+	return elektraPluginExport ("journalstorage",
+				    ELEKTRA_PLUGIN_OPEN,	&elektraJournalstorageOpen,
+				    ELEKTRA_PLUGIN_CLOSE,	&elektraJournalstorageClose,
+				    ELEKTRA_PLUGIN_GET,		&elektraJournalstorageGet,
+				    ELEKTRA_PLUGIN_SET,		&elektraJournalstorageSet,
+				    ELEKTRA_PLUGIN_END);
+	// clang-format on
+}
@@ -0,0 +1,24 @@
+/**
+ * @file
+ *
+ * @brief Header for journalstorage plugin
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ *
+ */
+
+#ifndef ELEKTRA_PLUGIN_JOURNALSTORAGE_H
+#define ELEKTRA_PLUGIN_JOURNALSTORAGE_H
+
+#include <kdbplugin.h>
+
+
+int elektraJournalstorageOpen (Plugin * handle, Key * errorKey);
+int elektraJournalstorageClose (Plugin * handle, Key * errorKey);
+int elektraJournalstorageGet (Plugin * handle, KeySet * ks, Key * parentKey);
+int elektraJournalstorageSet (Plugin * handle, KeySet * ks, Key * parentKey);
+int elektraJournalstorageSetDelta (Plugin * handle, KeySet * ks, KeySet * added, KeySet * changed, KeySet * removed, Key * parentKey);
+
+Plugin * ELEKTRA_PLUGIN_EXPORT;
+
+#endif
@@ -0,0 +1,364 @@
+/**
+ * @file
+ *
+ * @brief Tests for journalstorage plugin
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <kdbconfig.h>
+#include <kdbendian.h>
+#include <kdbprivate.h>
+
+#include <tests_plugin.h>
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "journalstorage.h"
+
+typedef int (*SetDelta) (Plugin * handle, KeySet * ks, KeySet * added, KeySet * changed, KeySet * removed, Key * parentKey);
+
+static KeySet * getKeys (Plugin * plugin, const char * filename, int expectedResult)
+{
+	KeySet * ks = ksNew (0, KS_END);
+	Key * getKey = keyNew ("user/tests/journalstorage", KEY_VALUE, filename, KEY_END);
+	succeed_if (plugin->kdbGet (plugin, ks, getKey) == expectedResult, "call to kdbGet returned unexpected result");
+	keyDel (getKey);
+	return ks;
+}
+
+static void readHeader (const char * filename, kdb_unsigned_long_long_t * baseEnd, kdb_unsigned_long_long_t * records)
+{
+	kdb_unsigned_long_long_t header[3] = { 0, 0, 0 };
+	FILE * file = fopen (filename, "rb");
+	exit_if_fail (file != NULL, "could not open file");
+	succeed_if (fread (header, sizeof (kdb_unsigned_long_long_t), 3, file) == 3, "could not read header");
+	fclose (file);
+
+	succeed_if (be64toh (header[0]) == 0x454b444a00000001UL, "wrong magic number");
+	*baseEnd = le64toh (header[1]);
+	*records = le64toh (header[2]);
+}
+
+static off_t fileSize (const char * filename)
+{
+	struct stat st;
+	return stat (filename, &st) == 0 ? st.st_size : -1;
+}
+
+static KeySet * simple (void)
+{
+	return ksNew (4, keyNew ("user/tests/journalstorage", KEY_VALUE, "root", KEY_END),
+		      keyNew ("user/tests/journalstorage/a", KEY_VALUE, "a", KEY_META, "meta", "value", KEY_END),
+		      keyNew ("user/tests/journalstorage/b", KEY_VALUE, "b", KEY_END), KS_END);
+}
+
+static int setDelta (Plugin * plugin, KeySet * ks, KeySet * added, KeySet * changed, KeySet * removed, const char * filename)
+{
+	SetDelta func = (SetDelta) elektraPluginGetFunction (plugin, "setDelta");
+	exit_if_fail (func != NULL, "setDelta not exported");
+
+	Key * setKey = keyNew ("user/tests/journalstorage", KEY_VALUE, filename, KEY_END);
+	int result = func (plugin, ks, added, changed, removed, setKey);
+	keyDel (setKey);
+	return result;
+}
+
+static void test_roundtrip (void)
+{
+	printf ("test roundtrip\n");
+
+	const char * filename = elektraFilename ();
+	KeySet * ks = ksNew (
+		6, keyNew ("user/tests/journalstorage", KEY_VALUE, "root", KEY_END),
+		keyNew ("user/tests/journalstorage/empty", KEY_VALUE, "", KEY_END),
+		keyNew ("user/tests/journalstorage/binary", KEY_BINARY, KEY_SIZE, 3, KEY_VALUE, "a\0b", KEY_END),
+		keyNew ("user/tests/journalstorage/nobinary", KEY_BINARY, KEY_END),
+		keyNew ("user/tests/journalstorage/meta", KEY_VALUE, "value", KEY_META, "a", "1", KEY_META, "b", "", KEY_END), KS_END);
+
+	KeySet * conf = ksNew (0, KS_END);
+	PLUGIN_OPEN ("journalstorage");
+
+	Key * setKey = keyNew ("user/tests/journalstorage", KEY_VALUE, filename, KEY_END);
+	succeed_if (plugin->kdbSet (plugin, ks, setKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbSet was not successful");
+	keyDel (setKey);
+
+	kdb_unsigned_long_long_t baseEnd, records;
+	readHeader (filename, &baseEnd, &records);
+	succeed_if (baseEnd == 0 && records == 0, "full write should not have a journal");
+
+	KeySet * read = getKeys (plugin, filename, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+	compare_keyset (ks, read);
+
+	Key * binary = ksLookupByName (read, "user/tests/journalstorage/binary", 0);
+	succeed_if (binary != NULL && keyIsBinary (binary) && keyGetValueSize (binary) == 3, "binary value wrong");
+	succeed_if (binary != NULL && memcmp (keyValue (binary), "a\0b", 3) == 0, "binary value wrong");
+	Key * nobinary = ksLookupByName (read, "user/tests/journalstorage/nobinary", 0);
+	succeed_if (nobinary != NULL && keyIsBinary (nobinary) && keyValue (nobinary) == NULL, "empty binary value wrong");
+
+	ksDel (read);
+	ksDel (ks);
+	remove (filename);
+
+	// a missing file has no keys
+	read = getKeys (plugin, filename, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+	succeed_if (ksGetSize (read) == 0, "missing file should not have keys");
+	ksDel (read);
+
+	PLUGIN_CLOSE ();
+}
+
+static void test_journal (void)
+{
+	printf ("test journal\n");
+
+	char * first = elektraFormat ("%s.first", elektraFilename ());
+	char * second = elektraFormat ("%s.second", elektraFilename ());
+	char * third = elektraFormat ("%s.third", elektraFilename ());
+
+	KeySet * conf = ksNew (0, KS_END);
+	PLUGIN_OPEN ("journalstorage");
+
+	KeySet * ks = simple ();
+	Key * setKey = keyNew ("user/tests/journalstorage", KEY_VALUE, first, KEY_END);
+	succeed_if (plugin->kdbSet (plugin, ks, setKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbSet was not successful");
+	keyDel (setKey);
+	ksDel (ks);
+
+	// kdbGet remembers the file, which is appended to
+	ks = getKeys (plugin, first, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+
+	Key * a = ksLookupByName (ks, "user/tests/journalstorage/a", 0);
+	keySetString (a, "changed");
+	keySetMeta (a, "meta", "other");
+	keyDel (ksLookupByName (ks, "user/tests/journalstorage/b", KDB_O_POP));
+	Key * c = keyNew ("user/tests/journalstorage/c", KEY_VALUE, "c", KEY_END);
+	ksAppendKey (ks, c);
+
+	KeySet * added = ksNew (1, c, KS_END);
+	KeySet * changed = ksNew (1, a, KS_END);
+	KeySet * removed = ksNew (1, keyNew ("user/tests/journalstorage/b", KEY_END), KS_END);
+	succeed_if (setDelta (plugin, ks, added, changed, removed, second) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to setDelta was not successful");
+
+	kdb_unsigned_long_long_t baseEnd, records;
+	readHeader (second, &baseEnd, &records);
+	succeed_if (baseEnd == (kdb_unsigned_long_long_t) fileSize (first), "base should end where the old file ended");
+	succeed_if (records == 3, "journal should have three records");
+	succeed_if (fileSize (second) > fileSize (first), "journal was not appended");
+
+	KeySet * read = getKeys (plugin, second, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+	compare_keyset (ks, read);
+	ksDel (read);
+
+	ksDel (added);
+	ksDel (changed);
+	ksDel (removed);
+
+	// appending to a file, which already has a journal, keeps the base
+	read = getKeys (plugin, second, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+	ksDel (read);
+
+	removed = ksNew (1, keyNew ("user/tests/journalstorage/a", KEY_END), KS_END);
+	added = ksNew (0, KS_END);
+	changed = ksNew (0, KS_END);
+	keyDel (ksLookupByName (ks, "user/tests/journalstorage/a", KDB_O_POP));
+	succeed_if (setDelta (plugin, ks, added, changed, removed, third) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to setDelta was not successful");
+
+	kdb_unsigned_long_long_t thirdBaseEnd;
+	readHeader (third, &thirdBaseEnd, &records);
+	succeed_if (thirdBaseEnd == baseEnd, "base should not change");
+	succeed_if (records == 4, "journal should have four records");
+
+	read = getKeys (plugin, third, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+	compare_keyset (ks, read);
+	succeed_if (ksLookupByName (read, "user/tests/journalstorage/b", 0) == NULL, "removed key was read");
+	ksDel (read);
+
+	ksDel (added);
+	ksDel (changed);
+	ksDel (removed);
+	ksDel (ks);
+
+	PLUGIN_CLOSE ();
+
+	remove (first);
+	remove (second);
+	remove (third);
+	elektraFree (first);
+	elektraFree (second);
+	elektraFree (third);
+}
+
+static void test_written (void)
+{
+	printf ("test written\n");
+
+	char * temp = elektraFormat ("%s.tmp", elektraFilename ());
+	char * real = elektraFormat ("%s.real", elektraFilename ());
+
+	KeySet * conf = ksNew (0, KS_END);
+	PLUGIN_OPEN ("journalstorage");
+
+	// without kdbGet, the file written by the last kdbSet is appended to, once the resolver renamed it
+	KeySet * ks = simple ();
+	Key * setKey = keyNew ("user/tests/journalstorage", KEY_VALUE, temp, KEY_END);
+	succeed_if (plugin->kdbSet (plugin, ks, setKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbSet was not successful");
+	succeed_if (rename (temp, real) == 0, "could not rename file");
+
+	Key * c = keyNew ("user/tests/journalstorage/c", KEY_VALUE, "c", KEY_END);
+	ksAppendKey (ks, c);
+	KeySet * added = ksNew (1, c, KS_END);
+	KeySet * empty = ksNew (0, KS_END);
+	succeed_if (setDelta (plugin, ks, added, empty, empty, temp) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to setDelta was not successful");
+
+	kdb_unsigned_long_long_t baseEnd, records;
+	readHeader (temp, &baseEnd, &records);
+	succeed_if (baseEnd == (kdb_unsigned_long_long_t) fileSize (real) && records == 1, "journal was not appended");
+
+	// the temporary file was removed (e.g. by a rollback), so all keys are written
+	succeed_if (unlink (temp) == 0, "could not remove file");
+	succeed_if (setDelta (plugin, ks, added, empty, empty, temp) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to setDelta was not successful");
+	readHeader (temp, &baseEnd, &records);
+	succeed_if (baseEnd == 0 && records == 0, "removed file was appended to");
+
+	KeySet * read = getKeys (plugin, temp, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+	compare_keyset (ks, read);
+	ksDel (read);
+
+	ksDel (added);
+	ksDel (empty);
+	ksDel (ks);
+	keyDel (setKey);
+
+	PLUGIN_CLOSE ();
+
+	remove (temp);
+	remove (real);
+	elektraFree (temp);
+	elektraFree (real);
+}
+
+static void test_compact (void)
+{
+	printf ("test compact\n");
+
+	char * first = elektraFormat ("%s.first", elektraFilename ());
+	char * second = elektraFormat ("%s.second", elektraFilename ());
+
+	KeySet * conf = ksNew (1, keyNew ("system/compact", KEY_VALUE, "2", KEY_END), KS_END);
+	PLUGIN_OPEN ("journalstorage");
+
+	KeySet * ks = simple ();
+	Key * setKey = keyNew ("user/tests/journalstorage", KEY_VALUE, first, KEY_END);
+	succeed_if (plugin->kdbSet (plugin, ks, setKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbSet was not successful");
+	keyDel (setKey);
+	ksDel (ks);
+
+	ks = getKeys (plugin, first, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+
+	Key * c = keyNew ("user/tests/journalstorage/c", KEY_VALUE, "c", KEY_END);
+	Key * d = keyNew ("user/tests/journalstorage/d", KEY_VALUE, "d", KEY_END);
+	ksAppendKey (ks, c);
+	ksAppendKey (ks, d);
+	keyDel (ksLookupByName (ks, "user/tests/journalstorage/b", KDB_O_POP));
+
+	KeySet * added = ksNew (2, c, d, KS_END);
+	KeySet * changed = ksNew (0, KS_END);
+	KeySet * removed = ksNew (1, keyNew ("user/tests/journalstorage/b", KEY_END), KS_END);
+	succeed_if (setDelta (plugin, ks, added, changed, removed, second) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to setDelta was not successful");
+
+	// more records than configured with /compact, so all keys were written
+	kdb_unsigned_long_long_t baseEnd, records;
+	readHeader (second, &baseEnd, &records);
+	succeed_if (baseEnd == 0 && records == 0, "journal was not compacted");
+
+	KeySet * read = getKeys (plugin, second, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+	compare_keyset (ks, read);
+	ksDel (read);
+
+	ksDel (added);
+	ksDel (changed);
+	ksDel (removed);
+	ksDel (ks);
+
+	PLUGIN_CLOSE ();
+
+	remove (first);
+	remove (second);
+	elektraFree (first);
+	elektraFree (second);
+}
+
+static void test_corrupt (void)
+{
+	printf ("test corrupt\n");
+
+	char * first = elektraFormat ("%s.first", elektraFilename ());
+	char * second = elektraFormat ("%s.second", elektraFilename ());
+
+	KeySet * conf = ksNew (0, KS_END);
+	PLUGIN_OPEN ("journalstorage");
+
+	KeySet * ks = simple ();
+	Key * setKey = keyNew ("user/tests/journalstorage", KEY_VALUE, first, KEY_END);
+	succeed_if (plugin->kdbSet (plugin, ks, setKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbSet was not successful");
+	keyDel (setKey);
+	ksDel (ks);
+
+	ks = getKeys (plugin, first, ELEKTRA_PLUGIN_STATUS_SUCCESS);
+	Key * c = keyNew ("user/tests/journalstorage/c", KEY_VALUE, "value", KEY_END);
+	ksAppendKey (ks, c);
+	KeySet * added = ksNew (1, c, KS_END);
+	KeySet * empty = ksNew (0, KS_END);
+	succeed_if (setDelta (plugin, ks, added, empty, empty, second) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to setDelta was not successful");
+	ksDel (added);
+	ksDel (empty);
+	ksDel (ks);
+
+	// change a byte of the value in the journal
+	FILE * file = fopen (second, "r+b");
+	exit_if_fail (file != NULL, "could not open file");
+	fseek (file, -8, SEEK_END);
+	fputc ('V', file);
+	fclose (file);
+
+	ks = getKeys (plugin, second, ELEKTRA_PLUGIN_STATUS_ERROR);
+	succeed_if (ksGetSize (ks) == 0, "keys of a corrupt file were returned");
+	ksDel (ks);
+
+	// a truncated journal is detected as well
+	succeed_if (truncate (second, fileSize (second) - 2) == 0, "could not truncate file");
+	ks = getKeys (plugin, second, ELEKTRA_PLUGIN_STATUS_ERROR);
+	ksDel (ks);
+
+	PLUGIN_CLOSE ();
+
+	remove (first);
+	remove (second);
+	elektraFree (first);
+	elektraFree (second);
+}
+
+int main (int argc, char ** argv)
+{
+	printf ("JOURNALSTORAGE     TESTS\n");
+	printf ("========================\n\n");
+
+	init (argc, argv);
+
+	test_roundtrip ();
+	test_journal ();
+	test_written ();
+	test_compact ();
+	test_corrupt ();
+
+	print_result ("testmod_journalstorage");
+
+	return nbError;
+}
@@ -53,11 +53,20 @@
 /** Magic byte order marker, as used by UTF. */
 #define ELEKTRA_MMAP_MAGIC_BOM (0xFEFF)
 
-/** Magic number used in mmap format (8 bytes). Previously used: 0x0A6172746B656C45 */
-#define ELEKTRA_MAGIC_MMAP_NUMBER (0x0A3472746B656C45)
+/** Magic number used in mmap format (8 bytes). Previously used: 0x0A6172746B656C45, 0x0A3472746B656C45 */
+#define ELEKTRA_MAGIC_MMAP_NUMBER (0x0A3572746B656C45)
 
 /** Mmap format version (1 byte). Increment on breaking changes to invalidate old files. */
-#define ELEKTRA_MMAP_FORMAT_VERSION (2)
+#define ELEKTRA_MMAP_FORMAT_VERSION (10)
+
+/**
+ * Preferred addresses of mapped files.
+ * Every file gets one of `ELEKTRA_MMAP_PREFERRED_SLOTS` slots, chosen by its path.
+ * The region is far away from heap, stack and shared libraries on 64-bit systems.
+ */
+#define ELEKTRA_MMAP_PREFERRED_BASE ((uint64_t) 0x200000000000)
+#define ELEKTRA_MMAP_PREFERRED_SLOTS (4096)
+#define ELEKTRA_MMAP_PREFERRED_SLOT_SIZE ((uint64_t) 1 << 30)
 
 /** Mmap temp file template */
 #define ELEKTRA_MMAP_TMP_NAME "/tmp/elektraMmapTmpXXXXXX"
@@ -110,7 +119,7 @@ struct _mmapAddr
 	char * keyPtr;			/**<Pointer to the current Key struct. */
 	char * dataPtr;			/**<Pointer to the data region, where Key->key and Key->data is stored. */
 
-	const uintptr_t mmapAddrInt;	/**<Address of the mapped region as integer. */
+	const uintptr_t mmapAddrInt;	/**<Address of the mapped region minus the preferred address as integer. */
 	// clang-format on
 };
 
@@ -137,6 +146,7 @@ struct _mmapHeader
 	uint64_t mmapMagicNumber;	/**<Magic number for consistency check */
 	uint64_t allocSize;		/**<Size of the complete allocation in bytes */
 	uint64_t cksumSize;		/**<Size of the critical data for checksum (structs, pointers, sizes)*/
+	uint64_t preferredAddr;		/**<Address the pointers are written for, no relocation needed if mapped there */
 
 	uint32_t checksum;		/**<Checksum of the data */
 	uint8_t formatFlags;		/**<Mmap format flags (e.g. checksum ON/OFF) */
@@ -148,15 +158,16 @@ struct _mmapHeader
 	// clang-format on
 };
 
-#define STATIC_SIZEOF_MMAPHEADER 32
+#define STATIC_SIZEOF_MMAPHEADER 40
 #define STATIC_HEADER_OFFSETOF_MAGICNUMBER 0
 #define STATIC_HEADER_OFFSETOF_ALLOCSIZE 8
 #define STATIC_HEADER_OFFSETOF_CHECKSUMSIZE 16
-#define STATIC_HEADER_OFFSETOF_CHECKSUM 24
-#define STATIC_HEADER_OFFSETOF_FORMATFLAGS 28
-#define STATIC_HEADER_OFFSETOF_FORMATVERSION 29
-#define STATIC_HEADER_OFFSETOF_RESERVED_A 30
-#define STATIC_HEADER_OFFSETOF_RESERVED_B 31
+#define STATIC_HEADER_OFFSETOF_PREFERREDADDR 24
+#define STATIC_HEADER_OFFSETOF_CHECKSUM 32
+#define STATIC_HEADER_OFFSETOF_FORMATFLAGS 36
+#define STATIC_HEADER_OFFSETOF_FORMATVERSION 37
+#define STATIC_HEADER_OFFSETOF_RESERVED_A 38
+#define STATIC_HEADER_OFFSETOF_RESERVED_B 39
 
 /**
  * Mmap meta-data
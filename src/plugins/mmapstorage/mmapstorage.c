@@ -305,6 +305,48 @@ static void initFooter (MmapFooter * mmapFooter)
 	mmapFooter->mmapMagicNumber = ELEKTRA_MAGIC_MMAP_NUMBER;
 }
 
+/**
+ * @brief Chooses the preferred address of a mapped file.
+ *
+ * The pointers inside the file are written for this address.
+ * Different files get different addresses, such that they do not
+ * compete for the same region when mapped by the same process.
+ *
+ * @param path the path of the file
+ *
+ * @return the preferred address or 0 if the address space is too small
+ */
+static uint64_t preferredAddress (const char * path)
+{
+	if (UINTPTR_MAX <= UINT32_MAX) return 0;
+
+	// FNV-1a hash of the path
+	uint64_t hash = 0xcbf29ce484222325;
+	for (const char * c = path; *c; ++c)
+	{
+		hash ^= (unsigned char) *c;
+		hash *= 0x100000001b3;
+	}
+
+	return ELEKTRA_MMAP_PREFERRED_BASE + (hash % ELEKTRA_MMAP_PREFERRED_SLOTS) * ELEKTRA_MMAP_PREFERRED_SLOT_SIZE;
+}
+
+/**
+ * @brief Reads the preferred address from the header of a file, without mapping the file.
+ *
+ * @param fd the file descriptor
+ *
+ * @return the preferred address or 0 if the header could not be read
+ */
+static void * readPreferredAddress (int fd)
+{
+	MmapHeader mmapHeader;
+	if (pread (fd, &mmapHeader, SIZEOF_MMAPHEADER, 0) != (ssize_t) SIZEOF_MMAPHEADER) return 0;
+	if (mmapHeader.mmapMagicNumber != ELEKTRA_MAGIC_MMAP_NUMBER || mmapHeader.formatVersion != ELEKTRA_MMAP_FORMAT_VERSION) return 0;
+
+	return (void *) (uintptr_t) mmapHeader.preferredAddr;
+}
+
 /**
  * @brief Reads the MmapHeader and MmapMetaData from a file.
  *
@@ -425,6 +467,7 @@ static void initMagicKey (const uintptr_t magicNumber)
 	magicKey.key = (char *) magicNumber;
 	magicKey.keySize = UINT16_MAX;
 	magicKey.keyUSize = 0;
+	magicKey.namePrefix = UINT64_MAX / 2;
 	magicKey.flags = KEY_FLAG_MMAP_STRUCT | KEY_FLAG_MMAP_DATA | KEY_FLAG_MMAP_KEY | KEY_FLAG_SYNC;
 	magicKey.ksReference = SIZE_MAX / 2;
 	magicKey.meta = (KeySet *) ELEKTRA_MMAP_MAGIC_BOM;
@@ -642,10 +685,10 @@ static void calculateMmapDataSize (MmapHeader * mmapHeader, MmapMetaData * mmapM
 		{
 			++mmapMetaData->numKeySets;
 
-			Key * curMeta;
-			ksRewind (cur->meta);
-			while ((curMeta = ksNext (cur->meta)) != 0)
+			// iterate the array directly, the metadata might be shared with other keys
+			for (size_t i = 0; i < cur->meta->size; ++i)
 			{
+				Key * curMeta = cur->meta->array[i];
 				if (ELEKTRA_PLUGIN_FUNCTION (dynArrayFindOrInsert) (curMeta, dynArray) == 0)
 				{
 					// key was just inserted
@@ -672,10 +715,9 @@ static void calculateMmapDataSize (MmapHeader * mmapHeader, MmapMetaData * mmapM
 			{
 				++mmapMetaData->numKeySets;
 
-				Key * curMeta;
-				ksRewind (globalKey->meta);
-				while ((curMeta = ksNext (globalKey->meta)) != 0)
+				for (size_t i = 0; i < globalKey->meta->size; ++i)
 				{
+					Key * curMeta = globalKey->meta->array[i];
 					if (ELEKTRA_PLUGIN_FUNCTION (dynArrayFindOrInsert) (curMeta, dynArray) == 0)
 					{
 						// key was just inserted
@@ -697,7 +739,8 @@ static void calculateMmapDataSize (MmapHeader * mmapHeader, MmapMetaData * mmapM
 	if (opmphm)
 	{
 		if (opmphm->rUniPar) dataBlocksSize += opmphm->rUniPar * sizeof (int32_t);
-		dataBlocksSize += opmphm->size;
+		// an OPMPHM with a delta does not fit the written array anymore
+		if (!opmphm->delta) dataBlocksSize += opmphm->size;
 	}
 	OpmphmPredictor * opmphmPredictor = returned->opmphmPredictor;
 	if (opmphmPredictor)
@@ -744,6 +787,7 @@ static void writeMetaKeys (MmapAddr * mmapAddr, DynArray * dynArray)
 		Key * curMeta = dynArray->keyArray[i];	// old key location
 		Key * mmapMetaKey = (Key *) mmapAddr->keyPtr; // new key location
 		*mmapMetaKey = *curMeta;
+		clear_bit (mmapMetaKey->flags, (keyflag_t) KEY_FLAG_ARENA | KEY_FLAG_INTERNED);
 		mmapAddr->keyPtr += SIZEOF_KEY;
 
 		// move Key name
@@ -769,6 +813,7 @@ static void writeMetaKeys (MmapAddr * mmapAddr, DynArray * dynArray)
 		mmapMetaKey->flags |= KEY_FLAG_MMAP_STRUCT;
 		mmapMetaKey->meta = 0;
 		mmapMetaKey->ksReference = 0;
+		mmapMetaKey->metaCursor = 0;
 
 		dynArray->mappedKeyArray[i] = mmapMetaKey;
 	}
@@ -795,12 +840,13 @@ static KeySet * writeMetaKeySet (Key * key, MmapAddr * mmapAddr, DynArray * dynA
 	newMeta->array = (Key **) mmapAddr->metaKsArrayPtr;
 	mmapAddr->metaKsArrayPtr += SIZEOF_KEY_PTR * key->meta->alloc;
 
-	keyRewindMeta (key);
 	size_t metaKeyIndex = 0;
 	Key * mappedMetaKey = 0;
 	const Key * metaKey;
-	while ((metaKey = keyNextMeta (key)) != 0)
+	// iterate the array directly, the metadata might be shared with other keys
+	for (size_t i = 0; i < key->meta->size; ++i)
 	{
+		metaKey = key->meta->array[i];
 		// get address of mapped key and store it in the new array
 		mappedMetaKey = dynArray->mappedKeyArray[ELEKTRA_PLUGIN_FUNCTION (dynArrayFind) ((Key *) metaKey, dynArray)];
 		newMeta->array[metaKeyIndex] = (Key *) ((char *) mappedMetaKey - mmapAddr->mmapAddrInt);
@@ -814,6 +860,7 @@ static KeySet * writeMetaKeySet (Key * key, MmapAddr * mmapAddr, DynArray * dynA
 	newMeta->array = (Key **) ((char *) newMeta->array - mmapAddr->mmapAddrInt);
 	newMeta->alloc = key->meta->alloc;
 	newMeta->size = key->meta->size;
+	newMeta->metaShares = 0;
 	newMeta = (KeySet *) ((char *) newMeta - mmapAddr->mmapAddrInt);
 	return newMeta;
 }
@@ -849,6 +896,7 @@ static void writeKeys (KeySet * keySet, MmapAddr * mmapAddr, DynArray * dynArray
 		Key * mmapKey = (Key *) mmapAddr->keyPtr; // new key location
 		mmapAddr->keyPtr += SIZEOF_KEY;
 		*mmapKey = *cur;
+		clear_bit (mmapKey->flags, (keyflag_t) KEY_FLAG_ARENA);
 
 		// move Key name
 		if (cur->key)
@@ -880,6 +928,7 @@ static void writeKeys (KeySet * keySet, MmapAddr * mmapAddr, DynArray * dynArray
 		// move Key itself
 		mmapKey->flags |= KEY_FLAG_MMAP_STRUCT;
 		mmapKey->ksReference = 1;
+		mmapKey->metaCursor = 0;
 
 		// write the relative Key pointer into the KeySet array
 		ksArray[keyIndex] = (Key *) ((char *) mmapKey - mmapAddr->mmapAddrInt);
@@ -944,7 +993,7 @@ static int copyKeySetToMmap (char * const dest, KeySet * keySet, KeySet * global
 			      .metaKsArrayPtr = mmapAddr.ksArrayPtr + (SIZEOF_KEY_PTR * keySet->alloc),
 			      .keyPtr = mmapAddr.globalKsArrayPtr + (SIZEOF_KEY_PTR * mmapMetaData->ksAlloc),
 			      .dataPtr = mmapAddr.keyPtr + (SIZEOF_KEY * mmapMetaData->numKeys),
-			      .mmapAddrInt = (uintptr_t) dest };
+			      .mmapAddrInt = (uintptr_t) dest - (uintptr_t) mmapHeader->preferredAddr };
 
 	printMmapAddr (&mmapAddr);
 	printMmapMetaData (mmapMetaData);
@@ -958,6 +1007,7 @@ static int copyKeySetToMmap (char * const dest, KeySet * keySet, KeySet * global
 		mmapAddr.ksPtr->opmphm = (Opmphm *) (dest + OFFSET_OPMPHM);
 		memcpy (mmapAddr.ksPtr->opmphm, keySet->opmphm, sizeof (Opmphm));
 		mmapAddr.ksPtr->opmphm->flags = OPMPHM_FLAG_MMAP_STRUCT;
+		mmapAddr.ksPtr->opmphm->delta = 0;
 		if (keySet->opmphm->rUniPar)
 		{
 			mmapAddr.ksPtr->opmphm->hashFunctionSeeds = (int32_t *) mmapAddr.dataPtr;
@@ -968,7 +1018,13 @@ static int copyKeySetToMmap (char * const dest, KeySet * keySet, KeySet * global
 			mmapAddr.ksPtr->opmphm->hashFunctionSeeds =
 				(int32_t *) (((char *) mmapAddr.ksPtr->opmphm->hashFunctionSeeds) - mmapAddr.mmapAddrInt);
 		}
-		if (keySet->opmphm->size)
+		if (keySet->opmphm->delta)
+		{
+			// the OPMPHM gets rebuild for the written array
+			mmapAddr.ksPtr->opmphm->graph = 0;
+			mmapAddr.ksPtr->opmphm->size = 0;
+		}
+		else if (keySet->opmphm->size)
 		{
 			mmapAddr.ksPtr->opmphm->graph = (uint32_t *) mmapAddr.dataPtr;
 			memcpy (mmapAddr.ksPtr->opmphm->graph, keySet->opmphm->graph, keySet->opmphm->size);
@@ -1003,7 +1059,7 @@ static int copyKeySetToMmap (char * const dest, KeySet * keySet, KeySet * global
 		if (global->size != 0) writeKeys (global, &mmapAddr, dynArray, MODE_GLOBALCACHE);
 
 		set_bit (mmapHeader->formatFlags, MMAP_FLAG_TIMESTAMPS);
-		mmapAddr.globalKsPtr->flags = global->flags | KS_FLAG_MMAP_STRUCT | KS_FLAG_MMAP_ARRAY;
+		mmapAddr.globalKsPtr->flags = (global->flags & ~KS_FLAG_SHARED_ARRAY) | KS_FLAG_MMAP_STRUCT | KS_FLAG_MMAP_ARRAY;
 		mmapAddr.globalKsPtr->array = (Key **) mmapAddr.globalKsArrayPtr;
 		mmapAddr.globalKsPtr->array[global->size] = 0;
 		mmapAddr.globalKsPtr->array = (Key **) (mmapAddr.globalKsArrayPtr - mmapAddr.mmapAddrInt);
@@ -1017,7 +1073,8 @@ static int copyKeySetToMmap (char * const dest, KeySet * keySet, KeySet * global
 		writeKeys (keySet, &mmapAddr, dynArray, MODE_STORAGE);
 	}
 
-	mmapAddr.ksPtr->flags = keySet->flags | KS_FLAG_MMAP_STRUCT | KS_FLAG_MMAP_ARRAY;
+	// the mapped array is never shared with other KeySets
+	mmapAddr.ksPtr->flags = (keySet->flags & ~KS_FLAG_SHARED_ARRAY) | KS_FLAG_MMAP_STRUCT | KS_FLAG_MMAP_ARRAY;
 	mmapAddr.ksPtr->array = (Key **) mmapAddr.ksArrayPtr;
 	mmapAddr.ksPtr->array[keySet->size] = 0;
 	mmapAddr.ksPtr->array = (Key **) (mmapAddr.ksArrayPtr - mmapAddr.mmapAddrInt);
@@ -1063,6 +1120,7 @@ static void mmapOpmphmDel (Opmphm * opmphm)
 	{
 		elektraFree (opmphm->hashFunctionSeeds);
 	}
+	if (opmphm->delta) elektraFree (opmphm->delta);
 	if (!test_bit (opmphm->flags, OPMPHM_FLAG_MMAP_STRUCT)) elektraFree (opmphm);
 }
 
@@ -1131,16 +1189,20 @@ static void mmapToKeySet (Plugin * handle, char * mappedRegion, KeySet * returne
  * @brief Updates pointers of a mapped keyset to a new location in memory.
  *
  * After mapping a file to a new location, all pointers have to be updated
- * in order to be consistent. When the mapped keyset is written, we subtract
- * the base address. Therefore, after mapping the keyset to a new memory location,
- * we only have to add the new base address to all pointers.
+ * in order to be consistent. When the mapped keyset is written, the pointers
+ * are written as if the region was mapped to the preferred address.
+ * Therefore, after mapping the keyset to a new memory location, we only have
+ * to add the distance between the new and the preferred address to all pointers.
+ *
+ * If the file was mapped to the preferred address, this function need not be called.
  *
  * @param mmapMetaData meta-data of the old mapped region
  * @param dest new mapped memory region
+ * @param preferredAddr the address the pointers were written for
  */
-static void updatePointers (MmapMetaData * mmapMetaData, char * dest)
+static void updatePointers (MmapMetaData * mmapMetaData, char * dest, uint64_t preferredAddr)
 {
-	uintptr_t destInt = (uintptr_t) dest;
+	uintptr_t offset = (uintptr_t) dest - (uintptr_t) preferredAddr;
 
 	char * ksPtr = (dest + OFFSET_GLOBAL_KEYSET);
 	char * ksArrayPtr = ksPtr + SIZEOF_KEYSET * mmapMetaData->numKeySets;
@@ -1152,10 +1214,10 @@ static void updatePointers (MmapMetaData * mmapMetaData, char * dest)
 		ksPtr += SIZEOF_KEYSET;
 		if (ks->array)
 		{
-			ks->array = (Key **) ((char *) ks->array + destInt);
+			ks->array = (Key **) ((char *) ks->array + offset);
 			for (size_t j = 0; j < ks->size; ++j)
 			{
-				ks->array[j] = (Key *) ((char *) (ks->array[j]) + destInt);
+				ks->array[j] = (Key *) ((char *) (ks->array[j]) + offset);
 			}
 		}
 	}
@@ -1167,11 +1229,11 @@ static void updatePointers (MmapMetaData * mmapMetaData, char * dest)
 		returnedKs->opmphm = (Opmphm *) (dest + OFFSET_OPMPHM);
 		if (returnedKs->opmphm->hashFunctionSeeds)
 		{
-			returnedKs->opmphm->hashFunctionSeeds = (int32_t *) (((char *) returnedKs->opmphm->hashFunctionSeeds) + destInt);
+			returnedKs->opmphm->hashFunctionSeeds = (int32_t *) (((char *) returnedKs->opmphm->hashFunctionSeeds) + offset);
 		}
 		if (returnedKs->opmphm->graph)
 		{
-			returnedKs->opmphm->graph = (uint32_t *) (((char *) returnedKs->opmphm->graph) + destInt);
+			returnedKs->opmphm->graph = (uint32_t *) (((char *) returnedKs->opmphm->graph) + offset);
 		}
 	}
 	if (returnedKs->opmphmPredictor)
@@ -1180,7 +1242,7 @@ static void updatePointers (MmapMetaData * mmapMetaData, char * dest)
 		if (returnedKs->opmphmPredictor->patternTable)
 		{
 			returnedKs->opmphmPredictor->patternTable =
-				(uint8_t *) (((char *) returnedKs->opmphmPredictor->patternTable) + destInt);
+				(uint8_t *) (((char *) returnedKs->opmphmPredictor->patternTable) + offset);
 		}
 	}
 #endif
@@ -1191,15 +1253,15 @@ static void updatePointers (MmapMetaData * mmapMetaData, char * dest)
 		keyPtr += SIZEOF_KEY;
 		if (key->data.c)
 		{
-			key->data.c = key->data.c + destInt;
+			key->data.c = key->data.c + offset;
 		}
 		if (key->key)
 		{
-			key->key = key->key + destInt;
+			key->key = key->key + offset;
 		}
 		if (key->meta)
 		{
-			key->meta = (KeySet *) ((char *) (key->meta) + destInt);
+			key->meta = (KeySet *) ((char *) (key->meta) + offset);
 		}
 	}
 }
@@ -1224,6 +1286,7 @@ int ELEKTRA_PLUGIN_FUNCTION (open) (Plugin * handle ELEKTRA_UNUSED, Key * errorK
 	if (offsetof (MmapHeader, mmapMagicNumber) != STATIC_HEADER_OFFSETOF_MAGICNUMBER) goto error;
 	if (offsetof (MmapHeader, allocSize) != STATIC_HEADER_OFFSETOF_ALLOCSIZE) goto error;
 	if (offsetof (MmapHeader, cksumSize) != STATIC_HEADER_OFFSETOF_CHECKSUMSIZE) goto error;
+	if (offsetof (MmapHeader, preferredAddr) != STATIC_HEADER_OFFSETOF_PREFERREDADDR) goto error;
 	if (offsetof (MmapHeader, checksum) != STATIC_HEADER_OFFSETOF_CHECKSUM) goto error;
 	if (offsetof (MmapHeader, formatFlags) != STATIC_HEADER_OFFSETOF_FORMATFLAGS) goto error;
 	if (offsetof (MmapHeader, formatVersion) != STATIC_HEADER_OFFSETOF_FORMATVERSION) goto error;
@@ -1275,7 +1338,9 @@ int ELEKTRA_PLUGIN_FUNCTION (close) (Plugin * handle ELEKTRA_UNUSED, Key * error
  *
  * @param handle The plugin handle.
  * @param ks The keyset which is replaced by the mapped keyset.
- * @param parentKey Holding the filename or error message.
+ * @param parentKey Holding the filename or error message. If it has the metakey
+ *                  `mmapstorage/fd`, the file descriptor given as its value is
+ *                  read instead of opening the file again.
  *
  * @retval ELEKTRA_PLUGIN_STATUS_SUCCESS if the file was mapped successfully.
  * @retval ELEKTRA_PLUGIN_STATUS_ERROR if the file could not be mapped successfully.
@@ -1308,12 +1373,22 @@ int ELEKTRA_PLUGIN_FUNCTION (get) (Plugin * handle ELEKTRA_UNUSED, KeySet * ks,
 	char * mappedRegion = MAP_FAILED;
 	Key * initialParent = keyDup (parentKey);
 
+	const Key * fdMeta = keyGetMeta (parentKey, "mmapstorage/fd");
 	if (elektraStrCmp (keyString (parentKey), STDIN_FILENAME) == 0)
 	{
 		fd = fileno (stdin);
 		ELEKTRA_LOG_DEBUG ("MODE_NONREGULAR_FILE");
 		set_bit (mode, MODE_NONREGULAR_FILE);
 	}
+	else if (fdMeta)
+	{
+		// the caller already opened (and checked) the file, it stays owned by the caller
+		if ((fd = dup (atoi (keyString (fdMeta)))) == -1)
+		{
+			ELEKTRA_MMAP_LOG_WARNING ("could not duplicate file descriptor of %s", keyString (parentKey));
+			goto error;
+		}
+	}
 	else if ((fd = openFile (parentKey, O_RDONLY, 0, mode)) == -1)
 	{
 		goto error;
@@ -1355,7 +1430,8 @@ int ELEKTRA_PLUGIN_FUNCTION (get) (Plugin * handle ELEKTRA_UNUSED, KeySet * ks,
 		goto error;
 	}
 
-	mappedRegion = mmapFile ((void *) 0, fd, sbuf.st_size, MAP_PRIVATE, parentKey, mode);
+	// mapping the file to its preferred address avoids touching every pointer
+	mappedRegion = mmapFile (readPreferredAddress (fd), fd, sbuf.st_size, MAP_PRIVATE, parentKey, mode);
 	if (mappedRegion == MAP_FAILED)
 	{
 		ELEKTRA_MMAP_LOG_WARNING ("mappedRegion == MAP_FAILED");
@@ -1419,7 +1495,11 @@ int ELEKTRA_PLUGIN_FUNCTION (get) (Plugin * handle ELEKTRA_UNUSED, KeySet * ks,
 		goto error;
 	}
 
-	updatePointers (mmapMetaData, mappedRegion);
+	if ((uintptr_t) mappedRegion != mmapHeader->preferredAddr)
+	{
+		ELEKTRA_LOG_DEBUG ("relocating %s, preferred address was not available", keyString (parentKey));
+		updatePointers (mmapMetaData, mappedRegion, mmapHeader->preferredAddr);
+	}
 	mmapToKeySet (handle, mappedRegion, ks, mode);
 
 	if (close (fd) != 0)
@@ -1517,6 +1597,7 @@ int ELEKTRA_PLUGIN_FUNCTION (set) (Plugin * handle ELEKTRA_UNUSED, KeySet * ks,
 	MmapHeader mmapHeader;
 	MmapMetaData mmapMetaData;
 	initHeader (&mmapHeader);
+	mmapHeader.preferredAddr = preferredAddress (keyString (parentKey));
 	initMetaData (&mmapMetaData);
 	calculateMmapDataSize (&mmapHeader, &mmapMetaData, ks, global, dynArray);
 	ELEKTRA_LOG_DEBUG ("mmapsize: %" PRIu64, mmapHeader.allocSize);
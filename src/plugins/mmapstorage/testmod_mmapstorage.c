@@ -528,6 +528,63 @@ static void test_mmap_set_get (const char * tmpFile)
 	PLUGIN_CLOSE ();
 }
 
+static int isInRegion (const void * ptr, uint64_t start, uint64_t size)
+{
+	return (uintptr_t) ptr >= start && (uintptr_t) ptr < start + size;
+}
+
+static void test_mmap_preferred_address (const char * tmpFile)
+{
+	// the other tests leave files mapped to the preferred address of tmpFile
+	char preferredFile[KEY_NAME_LENGTH];
+	snprintf (preferredFile, KEY_NAME_LENGTH, "%s.preferred", tmpFile);
+	unlink (preferredFile);
+
+	Key * parentKey = keyNew (TEST_ROOT_KEY, KEY_VALUE, preferredFile, KEY_END);
+	KeySet * conf = ksNew (0, KS_END);
+	PLUGIN_OPEN ("mmapstorage");
+	KeySet * ks = metaTestKeySet ();
+	succeed_if (plugin->kdbSet (plugin, ks, parentKey) == 1, "kdbSet was not successful");
+
+	MmapHeader mmapHeader;
+	FILE * fp = fopen (preferredFile, "r");
+	exit_if_fail (fp, "could not open written file");
+	succeed_if (fread (&mmapHeader, SIZEOF_MMAPHEADER, 1, fp) == 1, "could not read header");
+	fclose (fp);
+
+	KeySet * returned = ksNew (0, KS_END);
+	succeed_if (plugin->kdbGet (plugin, returned, parentKey) == 1, "kdbGet was not successful");
+	compare_keyset (ks, returned);
+	if (mmapHeader.preferredAddr != 0)
+	{
+		succeed_if (isInRegion (returned->array, mmapHeader.preferredAddr, mmapHeader.allocSize),
+			    "file was not mapped to its preferred address");
+		succeed_if (isInRegion (returned->array[0], mmapHeader.preferredAddr, mmapHeader.allocSize),
+			    "keys do not point into the mapped file");
+	}
+	ksDel (returned);
+
+	// occupy the preferred address, the pointers must be relocated
+	int zero = open ("/dev/zero", O_RDONLY);
+	void * blocker = mmap ((void *) (uintptr_t) mmapHeader.preferredAddr, mmapHeader.allocSize, PROT_NONE, MAP_PRIVATE, zero, 0);
+	succeed_if (blocker != MAP_FAILED, "could not map blocker");
+	close (zero);
+
+	returned = ksNew (0, KS_END);
+	succeed_if (plugin->kdbGet (plugin, returned, parentKey) == 1, "kdbGet was not successful");
+	succeed_if (!isInRegion (returned->array, mmapHeader.preferredAddr, mmapHeader.allocSize),
+		    "file was mapped to the occupied address");
+	compare_keyset (ks, returned);
+	ksDel (returned);
+
+	if (blocker != MAP_FAILED) munmap (blocker, mmapHeader.allocSize);
+
+	ksDel (ks);
+	keyDel (parentKey);
+	PLUGIN_CLOSE ();
+	unlink (preferredFile);
+}
+
 static void test_mmap_get_after_reopen (const char * tmpFile)
 {
 	Key * parentKey = keyNew (TEST_ROOT_KEY, KEY_VALUE, tmpFile, KEY_END);
@@ -1159,6 +1216,8 @@ int main (int argc, char ** argv)
 	clearStorage (tmpFile);
 	test_mmap_ksCopy (tmpFile);
 
+	test_mmap_preferred_address (tmpFile);
+
 	test_mmap_open_pipe ();
 	test_mmap_bad_file_permissions (tmpFile);
 
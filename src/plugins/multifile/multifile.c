@@ -14,9 +14,11 @@
 #include <fnmatch.h>
 #include <fts.h>
 #include <glob.h>
+#include <kdbassert.h>
 #include <kdbconfig.h>
 #include <kdbhelper.h>
 #include <kdbinternal.h>
+#include <kdbio.h>
 #include <kdbmacros.h>
 #include <kdbmodule.h>
 #include <kdbplugin.h>
@@ -26,8 +28,17 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
 #include "../resolver/shared.h"
 #include <kdbinvoke.h>
 
@@ -73,6 +84,17 @@ typedef struct
 	unsigned short stayAlive;
 	unsigned short hasDeleted;
 	unsigned short recursive;
+	size_t threads;
+	short threadSafe; /*!< 1 if the storage plugin is thread-safe, -1 if not, 0 if unknown */
+	char * indexFile; /*!< where the index is persisted, NULL if it is only kept in memory */
+	KeySet * indexDirs; /*!< directories of the last scan, their values contain the stat information */
+	KeySet * indexFiles; /*!< files found by the last scan */
+	struct timespec indexTime; /*!< when the last scan started */
+	unsigned short watch;
+	unsigned short changed; /*!< set if the watch reported events */
+	int watchFd;
+	ElektraIoInterface * ioBinding;
+	ElektraIoFdOperation * watchOp;
 } MultiConfig;
 
 typedef struct
@@ -88,6 +110,12 @@ typedef struct
 	KeySet * ks;
 } SingleConfig;
 
+static void indexLoad (MultiConfig * mc);
+static void watchClose (MultiConfig * mc);
+#ifdef HAVE_SYS_INOTIFY_H
+static void watchAddToBinding (MultiConfig * mc);
+#endif
+
 static inline Codes rvToRc (int rc)
 {
 	switch (rc)
@@ -208,16 +236,20 @@ int elektraMultifileClose (Plugin * handle ELEKTRA_UNUSED, Key * errorKey ELEKTR
 	// this function is optional
 	MultiConfig * mc = elektraPluginGetData (handle);
 	if (!mc) return 1;
-	closeBackends (mc->childBackends);
+	watchClose (mc);
+	if (mc->childBackends) closeBackends (mc->childBackends);
 	if (mc->directory) elektraFree (mc->directory);
 	if (mc->pattern) elektraFree (mc->pattern);
 	if (mc->resolver) elektraFree (mc->resolver);
 	if (mc->storage) elektraFree (mc->storage);
 	if (mc->originalPath) elektraFree (mc->originalPath);
-	elektraModulesClose (mc->modules, NULL);
+	if (mc->indexFile) elektraFree (mc->indexFile);
+	if (mc->modules) elektraModulesClose (mc->modules, NULL);
 	ksDel (mc->modules);
 	ksDel (mc->childBackends);
 	ksDel (mc->childConfig);
+	ksDel (mc->indexDirs);
+	ksDel (mc->indexFiles);
 	elektraFree (mc);
 	elektraPluginSetData (handle, NULL);
 	return 1; // success
@@ -238,7 +270,12 @@ static MultiConfig * initialize (Plugin * handle, Key * parentKey)
 	Key * resolverKey = ksLookupByName (config, "/resolver", 0);
 	Key * stayAliveKey = ksLookupByName (config, "/stayalive", 0);
 	Key * recursiveKey = ksLookupByName (config, "/recursive", 0);
-	MultiConfig * mc = elektraCalloc (sizeof (MultiConfig));
+	Key * threadsKey = ksLookupByName (config, "/threads", 0);
+	Key * indexKey = ksLookupByName (config, "/index", 0);
+	Key * watchKey = ksLookupByName (config, "/watch", 0);
+	// setIoBinding may have been called before
+	MultiConfig * mc = elektraPluginGetData (handle);
+	if (!mc) mc = elektraCalloc (sizeof (MultiConfig));
 	mc->directory = elektraStrDup (keyString (parentKey));
 	mc->originalPath = elektraStrDup (keyString (origPath));
 	if (resolverKey)
@@ -267,6 +304,21 @@ static MultiConfig * initialize (Plugin * handle, Key * parentKey)
 	}
 	if (stayAliveKey) mc->stayAlive = 1;
 	if (recursiveKey) mc->recursive = 1;
+	if (threadsKey) mc->threads = strtoul (keyString (threadsKey), NULL, 10);
+	if (watchKey) mc->watch = 1;
+	mc->watchFd = -1;
+	mc->indexDirs = ksNew (0, KS_END);
+	mc->indexFiles = ksNew (0, KS_END);
+	if (indexKey && strlen (keyString (indexKey)) > 0)
+	{
+		keySetString (parentKey, keyString (indexKey));
+		if (elektraResolveFilename (parentKey, ELEKTRA_RESOLVER_TEMPFILE_NONE) != -1)
+		{
+			mc->indexFile = elektraStrDup (keyString (parentKey));
+			indexLoad (mc);
+		}
+		keySetString (parentKey, mc->directory);
+	}
 	Key * cutKey = keyNew ("/child", KEY_END);
 	KeySet * childConfig = ksCut (config, cutKey);
 	keyDel (cutKey);
@@ -335,74 +387,145 @@ static Codes resolverGet (SingleConfig * s, KeySet * returned, Key * parentKey)
 	return s->rcResolver;
 }
 
-static Codes updateFilesRecursive (Plugin * handle, MultiConfig * mc, KeySet * found, Key * parentKey)
+/**
+ * @brief Adds the file @p filename (relative to the directory) to @p found
+ *
+ * Creates a new child backend if the file was not found before.
+ *
+ * @retval SUCCESS if a new child backend was created
+ * @retval NOUPDATE if the child backend already existed or could not be created with `stayalive`
+ * @retval ERROR if the child backend could not be created
+ */
+static Codes addFile (Plugin * handle, MultiConfig * mc, KeySet * found, const char * filename, Key * parentKey)
+{
+	Codes rc = NOUPDATE;
+	Key * lookup = keyNew ("/", KEY_CASCADING_NAME, KEY_END);
+	keyAddBaseName (lookup, filename);
+	Key * k;
+	if ((k = ksLookup (mc->childBackends, lookup, KDB_O_NONE)) != NULL)
+	{
+		ksAppendKey (found, k);
+	}
+	else
+	{
+		SingleConfig * s = elektraCalloc (sizeof (SingleConfig));
+		s->filename = elektraStrDup (filename);
+		Codes r = initBackend (handle, mc, s, parentKey);
+		if (r == ERROR)
+		{
+			closeBackend (s);
+			if (!mc->stayAlive) rc = ERROR;
+		}
+		else
+		{
+			Key * childKey = keyNew (keyName (lookup), KEY_CASCADING_NAME, KEY_BINARY, KEY_SIZE, sizeof (SingleConfig *), KEY_VALUE,
+						 &s, KEY_END);
+			ksAppendKey (mc->childBackends, childKey);
+			ksAppendKey (found, childKey);
+			rc = SUCCESS;
+		}
+	}
+	keyDel (lookup);
+	return rc;
+}
+
+/**
+ * @brief Adds a key for @p path to @p index, whose value changes whenever the path changes
+ */
+static void indexAdd (KeySet * index, const char * path, const struct stat * sb)
+{
+	Key * k = keyNew ("/", KEY_CASCADING_NAME, KEY_END);
+	keyAddBaseName (k, path);
+	if (sb)
+	{
+		char * value = elektraFormat ("%llu %lld %lld %lld", (unsigned long long) sb->st_ino, (long long) ELEKTRA_STAT_SECONDS ((*sb)),
+					      (long long) ELEKTRA_STAT_NANO_SECONDS ((*sb)), (long long) sb->st_size);
+		keySetString (k, value);
+		elektraFree (value);
+	}
+	ksAppendKey (index, k);
+}
+
+/**
+ * @brief Gets the time of the file system clock, which is not later than timestamps set afterwards
+ */
+static void indexNow (struct timespec * now)
+{
+#ifdef CLOCK_REALTIME_COARSE
+	// file systems use the coarse clock, the precise one may already be ahead of it
+	if (clock_gettime (CLOCK_REALTIME_COARSE, now) == 0) return;
+#endif
+	now->tv_sec = time (NULL);
+	now->tv_nsec = 0;
+}
+
+/**
+ * @brief Finds the files below the directory
+ *
+ * Symbolic links are followed, but files outside of the directories
+ * are not watched. Thus no directories are added to @p dirs, if there
+ * are symbolic links, so the index is never used.
+ */
+static Codes updateFilesRecursive (Plugin * handle, MultiConfig * mc, KeySet * found, KeySet * dirs, KeySet * files, Key * parentKey)
 {
 	Codes rc = NOUPDATE;
-	char * dirs[2];
-	dirs[0] = mc->directory;
-	dirs[1] = (void *) NULL;
-	FTS * fts = fts_open (dirs, FTS_COMFOLLOW | FTS_LOGICAL | FTS_NOCHDIR, NULL);
+	int symlinks = 0;
+	char * paths[2];
+	paths[0] = mc->directory;
+	paths[1] = (void *) NULL;
+	FTS * fts = fts_open (paths, FTS_COMFOLLOW | FTS_PHYSICAL | FTS_NOCHDIR, NULL);
 	if (fts)
 	{
 		FTSENT * ent = NULL;
 		while ((ent = fts_read (fts)) != NULL)
 		{
-			if (ent->fts_info == FTS_F)
+			if (ent->fts_info == FTS_SL)
+			{
+				// returned again with the information of the target
+				symlinks = 1;
+				fts_set (fts, ent, FTS_FOLLOW);
+			}
+			else if (ent->fts_info == FTS_D)
+			{
+				// new files can only show up in a directory that changed
+				indexAdd (dirs, ent->fts_path, ent->fts_statp);
+			}
+			else if (ent->fts_info == FTS_F && !fnmatch (mc->pattern, ent->fts_name, 0))
 			{
-				if (!fnmatch (mc->pattern, ent->fts_name, 0))
+				const char * filename = ent->fts_path + strlen (mc->directory) + 1;
+				indexAdd (files, filename, NULL);
+				Codes r = addFile (handle, mc, found, filename, parentKey);
+				if (r == ERROR)
 				{
-					Key * lookup = keyNew ("/", KEY_CASCADING_NAME, KEY_END);
-					keyAddBaseName (lookup, (ent->fts_path + strlen (mc->directory)));
-					Key * k;
-					if ((k = ksLookup (mc->childBackends, lookup, KDB_O_NONE)) != NULL)
-					{
-						ksAppendKey (found, k);
-					}
-					else
-					{
-						SingleConfig * s = elektraCalloc (sizeof (SingleConfig));
-						s->filename = elektraStrDup ((ent->fts_path) + strlen (mc->directory) + 1);
-						Codes r = initBackend (handle, mc, s, parentKey);
-						if (r == ERROR)
-						{
-							if (!mc->stayAlive)
-							{
-								keyDel (lookup);
-								fts_close (fts);
-								return ERROR;
-							}
-							else
-							{
-								closeBackend (s);
-							}
-						}
-						else
-						{
-							Key * childKey = keyNew (keyName (lookup), KEY_CASCADING_NAME, KEY_BINARY, KEY_SIZE,
-										 sizeof (SingleConfig *), KEY_VALUE, &s, KEY_END);
-							ksAppendKey (mc->childBackends, childKey);
-							ksAppendKey (found, childKey);
-							rc = SUCCESS;
-						}
-					}
-					keyDel (lookup);
+					fts_close (fts);
+					return ERROR;
 				}
+				if (r == SUCCESS) rc = SUCCESS;
 			}
 		}
 		fts_close (fts);
 	}
+	if (symlinks) ksClear (dirs);
 	return rc;
 }
 
-static Codes updateFilesGlob (Plugin * handle, MultiConfig * mc, KeySet * found, Key * parentKey)
+static Codes updateFilesGlob (Plugin * handle, MultiConfig * mc, KeySet * found, KeySet * dirs, KeySet * files, Key * parentKey)
 {
 	Codes rc = NOUPDATE;
+	int symlinks = 0;
 	glob_t results;
 	int ret;
 
 	char pattern[strlen (mc->directory) + strlen (mc->pattern) + 2];
 	snprintf (pattern, sizeof (pattern), "%s/%s", mc->directory, mc->pattern);
 
+	// a pattern without subdirectories only depends on the directory itself
+	struct stat sb;
+	if (!strchr (mc->pattern, '/') && stat (mc->directory, &sb) == 0)
+	{
+		indexAdd (dirs, mc->directory, &sb);
+	}
+
 	ret = glob (pattern, 0, NULL, &results);
 	if (ret != 0)
 	{
@@ -420,66 +543,303 @@ static Codes updateFilesGlob (Plugin * handle, MultiConfig * mc, KeySet * found,
 		}
 		return ERROR;
 	}
-	struct stat sb;
 	for (unsigned int i = 0; i < results.gl_pathc; ++i)
 	{
+		// changes of targets outside of the directory are not noticed, see updateFilesRecursive()
+		if (lstat (results.gl_pathv[i], &sb) == 0 && S_ISLNK (sb.st_mode)) symlinks = 1;
 		ret = stat (results.gl_pathv[i], &sb);
 		if (S_ISREG (sb.st_mode))
 		{
-			Key * lookup = keyNew ("/", KEY_CASCADING_NAME, KEY_END);
-			keyAddBaseName (lookup, (results.gl_pathv[i]) + strlen (mc->directory));
-			Key * k;
-			if ((k = ksLookup (mc->childBackends, lookup, KDB_O_NONE)) != NULL)
-			{
-				ksAppendKey (found, k);
-			}
-			else
+			const char * filename = (results.gl_pathv[i]) + strlen (mc->directory) + 1;
+			indexAdd (files, filename, NULL);
+			Codes r = addFile (handle, mc, found, filename, parentKey);
+			if (r == ERROR)
 			{
-				SingleConfig * s = elektraCalloc (sizeof (SingleConfig));
-				s->filename = elektraStrDup ((results.gl_pathv[i]) + strlen (mc->directory) + 1);
-				Codes r = initBackend (handle, mc, s, parentKey);
-				if (r == ERROR)
-				{
-					if (!mc->stayAlive)
-					{
-						keyDel (lookup);
-						globfree (&results);
-						return ERROR;
-					}
-					else
-					{
-						closeBackend (s);
-					}
-				}
-				else
-				{
-					Key * childKey = keyNew (keyName (lookup), KEY_CASCADING_NAME, KEY_BINARY, KEY_SIZE,
-								 sizeof (SingleConfig *), KEY_VALUE, &s, KEY_END);
-					ksAppendKey (mc->childBackends, childKey);
-					ksAppendKey (found, childKey);
-					rc = SUCCESS;
-				}
+				globfree (&results);
+				return ERROR;
 			}
-			keyDel (lookup);
+			if (r == SUCCESS) rc = SUCCESS;
 		}
 	}
 	globfree (&results);
+	if (symlinks) ksClear (dirs);
 	return rc;
 }
 
+/**
+ * @brief Checks if the directories in the index did not change since the last scan
+ *
+ * Directories changed in the same tick of the file system clock as the scan
+ * started may have changed after they were read, without a change of their
+ * timestamp. Therefore the index is only used, if all directories are strictly
+ * older than the scan.
+ *
+ * @retval 1 if the files of the index can be used instead of a scan
+ * @retval 0 otherwise
+ */
+static int indexIsValid (MultiConfig * mc)
+{
+	if (ksGetSize (mc->indexDirs) == 0) return 0;
+
+	KeySet * current = ksNew (ksGetSize (mc->indexDirs), KS_END);
+	Key * k;
+	struct stat sb;
+	int valid = 1;
+	ksRewind (mc->indexDirs);
+	while (valid && (k = ksNext (mc->indexDirs)) != NULL)
+	{
+		const char * path = keyBaseName (k);
+		if (stat (path, &sb) != 0 || ELEKTRA_STAT_SECONDS (sb) > mc->indexTime.tv_sec ||
+		    (ELEKTRA_STAT_SECONDS (sb) == mc->indexTime.tv_sec && ELEKTRA_STAT_NANO_SECONDS (sb) >= mc->indexTime.tv_nsec))
+		{
+			valid = 0;
+			break;
+		}
+		indexAdd (current, path, &sb);
+		valid = !strcmp (keyString (k), keyString (ksLookup (current, k, 0)));
+	}
+	ksDel (current);
+	return valid;
+}
+
+/**
+ * @brief Reads the index persisted by indexSave()
+ *
+ * After the time of the scan (`t <seconds> <nanoseconds>`), every line is
+ * a directory (`d <stat> <path>`) or a file (`f <filename>`).
+ */
+static void indexLoad (MultiConfig * mc)
+{
+	FILE * fp = fopen (mc->indexFile, "r");
+	if (!fp) return;
+
+	char * line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	long long scanSec = 0, scanNsec = 0;
+	int ok = getline (&line, &size, fp) > 0 && !strcmp (line, "multifile index 2\n") && getline (&line, &size, fp) > 0 &&
+		 sscanf (line, "t %lld %lld", &scanSec, &scanNsec) == 2;
+	mc->indexTime.tv_sec = scanSec;
+	mc->indexTime.tv_nsec = scanNsec;
+	while (ok && (len = getline (&line, &size, fp)) > 0)
+	{
+		if (line[len - 1] != '\n')
+		{
+			ok = 0;
+			break;
+		}
+		line[len - 1] = '\0';
+
+		if (line[0] == 'f' && line[1] == ' ')
+		{
+			indexAdd (mc->indexFiles, line + 2, NULL);
+			continue;
+		}
+
+		unsigned long long ino;
+		long long sec, nsec, fileSize;
+		int pathStart = 0;
+		if (line[0] != 'd' || sscanf (line, "d %llu %lld %lld %lld %n", &ino, &sec, &nsec, &fileSize, &pathStart) != 4 ||
+		    !pathStart)
+		{
+			ok = 0;
+			break;
+		}
+		Key * k = keyNew ("/", KEY_CASCADING_NAME, KEY_END);
+		keyAddBaseName (k, line + pathStart);
+		char * value = elektraFormat ("%llu %lld %lld %lld", ino, sec, nsec, fileSize);
+		keySetString (k, value);
+		elektraFree (value);
+		ksAppendKey (mc->indexDirs, k);
+	}
+	elektraFree (line);
+	fclose (fp);
+
+	if (!ok)
+	{
+		ksClear (mc->indexDirs);
+		ksClear (mc->indexFiles);
+	}
+}
+
+/**
+ * @brief Persists the index to the file given by the option `index`, so other processes can skip the scan
+ */
+static void indexSave (MultiConfig * mc)
+{
+	char * tmpFile = elektraFormat ("%s.%d", mc->indexFile, (int) getpid ());
+	FILE * fp = fopen (tmpFile, "w");
+	if (!fp)
+	{
+		ELEKTRA_LOG_DEBUG ("MULTIFILE: could not write index %s", tmpFile);
+		elektraFree (tmpFile);
+		return;
+	}
+
+	int ok = fprintf (fp, "multifile index 2\nt %lld %lld\n", (long long) mc->indexTime.tv_sec, (long long) mc->indexTime.tv_nsec) > 0;
+	Key * k;
+	ksRewind (mc->indexDirs);
+	while (ok && (k = ksNext (mc->indexDirs)) != NULL)
+	{
+		ok = !strchr (keyBaseName (k), '\n') && fprintf (fp, "d %s %s\n", keyString (k), keyBaseName (k)) > 0;
+	}
+	ksRewind (mc->indexFiles);
+	while (ok && (k = ksNext (mc->indexFiles)) != NULL)
+	{
+		ok = !strchr (keyBaseName (k), '\n') && fprintf (fp, "f %s\n", keyBaseName (k)) > 0;
+	}
+
+	if (fclose (fp) != 0 || !ok || rename (tmpFile, mc->indexFile) != 0)
+	{
+		unlink (tmpFile);
+	}
+	elektraFree (tmpFile);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+/**
+ * @brief Reads all pending events of the watch
+ *
+ * @retval 1 if something changed since the last call of watchReset()
+ * @retval 0 otherwise
+ */
+static int watchChanged (MultiConfig * mc)
+{
+	char buffer[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+	while (read (mc->watchFd, buffer, sizeof (buffer)) > 0)
+	{
+		mc->changed = 1;
+	}
+	return mc->changed;
+}
+
+static void watchCallback (ElektraIoFdOperation * fdOp, int flags ELEKTRA_UNUSED)
+{
+	watchChanged (elektraIoFdGetData (fdOp));
+}
+
+static void watchAddToBinding (MultiConfig * mc)
+{
+	if (!mc->ioBinding || mc->watchFd == -1 || mc->watchOp) return;
+	mc->watchOp = elektraIoNewFdOperation (mc->watchFd, ELEKTRA_IO_READABLE, 1, watchCallback, mc);
+	if (mc->watchOp && !elektraIoBindingAddFd (mc->ioBinding, mc->watchOp))
+	{
+		elektraFree (mc->watchOp);
+		mc->watchOp = NULL;
+	}
+}
+
+static void watchClose (MultiConfig * mc)
+{
+	if (mc->watchOp)
+	{
+		elektraIoBindingRemoveFd (mc->watchOp);
+		elektraFree (mc->watchOp);
+		mc->watchOp = NULL;
+	}
+	if (mc->watchFd != -1) close (mc->watchFd);
+	mc->watchFd = -1;
+}
+
+/**
+ * @brief Watches all directories of the index with inotify
+ *
+ * Events of files are reported by the watch of their directory.
+ * Must be called before the resolvers check the files, so that no change gets lost.
+ */
+static void watchIndex (MultiConfig * mc)
+{
+	watchClose (mc);
+	mc->changed = 0;
+	if (!mc->watch || ksGetSize (mc->indexDirs) == 0) return;
+
+	mc->watchFd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+	if (mc->watchFd == -1) return;
+
+	const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+			      IN_DELETE_SELF | IN_MOVE_SELF;
+	Key * k;
+	ksRewind (mc->indexDirs);
+	while ((k = ksNext (mc->indexDirs)) != NULL)
+	{
+		if (inotify_add_watch (mc->watchFd, keyBaseName (k), mask) == -1)
+		{
+			watchClose (mc);
+			return;
+		}
+	}
+
+	// directories changed between the scan and the watch
+	if (!indexIsValid (mc)) mc->changed = 1;
+	watchAddToBinding (mc);
+}
+#else
+static int watchChanged (MultiConfig * mc ELEKTRA_UNUSED)
+{
+	return 1;
+}
+
+static void watchClose (MultiConfig * mc ELEKTRA_UNUSED)
+{
+}
+
+static void watchIndex (MultiConfig * mc ELEKTRA_UNUSED)
+{
+}
+#endif
+
 static Codes updateFiles (Plugin * handle, MultiConfig * mc, KeySet * returned, Key * parentKey)
 {
+	// nothing happened in the watched directories since the last call
+	if (mc->watchFd != -1 && !watchChanged (mc))
+	{
+		return NOUPDATE;
+	}
+
 	Codes rc = NOUPDATE;
 	KeySet * found = ksNew (0, KS_END);
 	Key * initialParent = keyDup (parentKey);
 
-	if (!mc->recursive)
+	if (indexIsValid (mc))
 	{
-		rc = updateFilesGlob (handle, mc, found, parentKey);
+		Key * k;
+		ksRewind (mc->indexFiles);
+		while (rc != ERROR && (k = ksNext (mc->indexFiles)) != NULL)
+		{
+			Codes r = addFile (handle, mc, found, keyBaseName (k), parentKey);
+			if (r != NOUPDATE) rc = r;
+		}
+		mc->changed = 0;
+		if (mc->watch && mc->watchFd == -1) watchIndex (mc);
 	}
 	else
 	{
-		rc = updateFilesRecursive (handle, mc, found, parentKey);
+		KeySet * dirs = ksNew (0, KS_END);
+		KeySet * files = ksNew (0, KS_END);
+		struct timespec scanTime;
+		indexNow (&scanTime);
+		if (!mc->recursive)
+		{
+			rc = updateFilesGlob (handle, mc, found, dirs, files, parentKey);
+		}
+		else
+		{
+			rc = updateFilesRecursive (handle, mc, found, dirs, files, parentKey);
+		}
+		ksDel (mc->indexDirs);
+		ksDel (mc->indexFiles);
+		mc->indexDirs = dirs;
+		mc->indexFiles = files;
+		mc->indexTime = scanTime;
+		if (rc == ERROR)
+		{
+			ksClear (mc->indexDirs);
+		}
+		else if (mc->indexFile && ksGetSize (mc->indexDirs) > 0)
+		{
+			indexSave (mc);
+		}
+		watchIndex (mc);
 	}
 	if (rc == ERROR)
 	{
@@ -556,8 +916,146 @@ static Codes updateFiles (Plugin * handle, MultiConfig * mc, KeySet * returned,
 	return rc;
 }
 
+/**
+ * @brief Checks if the KeySet of the last kdbGet can be used again
+ *
+ * @retval 1 if neither the file nor its Keys changed
+ * @retval 0 if the file must be parsed
+ */
+static int isUnchanged (SingleConfig * s)
+{
+	if (s->rcResolver != NOUPDATE || !s->ks) return 0;
+	Key * k;
+	ksRewind (s->ks);
+	while ((k = ksNext (s->ks)) != NULL)
+	{
+		if (keyNeedSync (k)) return 0;
+	}
+	return 1;
+}
+
+static Codes storeChildKeySet (SingleConfig * s, KeySet * readKS, int r)
+{
+	if (r > 0)
+	{
+		// hand the KeySet over to the child, it is not used anywhere else
+		if (s->ks) ksDel (s->ks);
+		s->ks = readKS;
+		return SUCCESS;
+	}
+	// parse the file again next time
+	if (s->ks) ksDel (s->ks);
+	s->ks = NULL;
+	ksDel (readKS);
+	return ERROR;
+}
+
+#ifdef HAVE_PTHREAD
+typedef struct
+{
+	SingleConfig * s;
+	KeySet * ks;
+	Key * parentKey; /*!< receives errors and warnings of this child only */
+	int ret;
+} GetJob;
+
+typedef struct
+{
+	GetJob * jobs;
+	size_t size;
+	size_t next; /*!< the next job to take, only accessed atomically */
+} GetPool;
+
+static void * getWorker (void * data)
+{
+	GetPool * pool = data;
+	size_t i;
+	while ((i = __atomic_fetch_add (&pool->next, 1, __ATOMIC_RELAXED)) < pool->size)
+	{
+		GetJob * job = &pool->jobs[i];
+		Plugin * storage = job->s->storage;
+		job->ret = storage->kdbGet (storage, job->ks, job->parentKey);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Calls the storage plugins of all resolved files with up to `mc->threads` threads
+ *
+ * Every file gets its own parent key. Afterwards, errors and warnings are
+ * added to @p parentKey in the order of the files, so the result is the
+ * same as the one of doGetStorage() without threads.
+ *
+ * @retval -2 if the storage plugin is not thread-safe or there are too few files, nothing was done
+ * @return the code of the last file otherwise
+ */
+static Codes doGetStorageParallel (MultiConfig * mc, Key * parentKey)
+{
+	size_t size = 0;
+	Key * k;
+	ksRewind (mc->childBackends);
+	while ((k = ksNext (mc->childBackends)) != NULL)
+	{
+		SingleConfig * s = *(SingleConfig **) keyValue (k);
+		if (s->rcResolver < 0 || isUnchanged (s)) continue;
+		if (mc->threadSafe == 0) mc->threadSafe = elektraPluginIsThreadSafe (s->storage) ? 1 : -1;
+		++size;
+	}
+	if (size < 2 || mc->threadSafe != 1) return EMPTY;
+
+	GetJob * jobs = elektraCalloc (size * sizeof (GetJob));
+	if (!jobs) return EMPTY;
+
+	size_t j = 0;
+	ksRewind (mc->childBackends);
+	while ((k = ksNext (mc->childBackends)) != NULL)
+	{
+		SingleConfig * s = *(SingleConfig **) keyValue (k);
+		if (s->rcResolver < 0 || isUnchanged (s)) continue;
+		jobs[j].s = s;
+		jobs[j].ks = ksNew (0, KS_END);
+		jobs[j].parentKey = keyNew (s->parentString, KEY_VALUE, s->fullPath, KEY_END);
+		++j;
+	}
+
+	GetPool pool = { .jobs = jobs, .size = size, .next = 0 };
+	size_t nrThreads = mc->threads < size ? mc->threads : size;
+	pthread_t * threads = elektraCalloc (nrThreads * sizeof (pthread_t));
+	size_t started = 0;
+	// the calling thread is one of the workers
+	while (threads && started + 1 < nrThreads && pthread_create (&threads[started], NULL, getWorker, &pool) == 0)
+	{
+		++started;
+	}
+	getWorker (&pool);
+	for (size_t t = 0; t < started; ++t)
+	{
+		pthread_join (threads[t], NULL);
+	}
+	elektraFree (threads);
+
+	Codes rc = NOUPDATE;
+	for (size_t i = 0; i < size; ++i)
+	{
+		elektraCopyErrorAndWarnings (parentKey, jobs[i].parentKey);
+		rc = storeChildKeySet (jobs[i].s, jobs[i].ks, jobs[i].ret);
+		keyDel (jobs[i].parentKey);
+	}
+	elektraFree (jobs);
+	return rc;
+}
+#endif
+
 static Codes doGetStorage (MultiConfig * mc, Key * parentKey)
 {
+#ifdef HAVE_PTHREAD
+	if (mc->threads > 1)
+	{
+		Codes rc = doGetStorageParallel (mc, parentKey);
+		if (rc != EMPTY) return rc;
+	}
+#endif
+
 	ksRewind (mc->childBackends);
 	Key * initialParent = keyDup (parentKey);
 	Codes rc = NOUPDATE;
@@ -568,22 +1066,14 @@ static Codes doGetStorage (MultiConfig * mc, Key * parentKey)
 		// When we reach this stage, we will need to load
 		// any successfully resolved files (as it is done in the kdb core)
 		if (s->rcResolver < 0) continue;
+		// unchanged files keep the KeySet of the last kdbGet
+		if (isUnchanged (s)) continue;
 		keySetName (parentKey, s->parentString);
 		keySetString (parentKey, s->fullPath);
 		Plugin * storage = s->storage;
 		KeySet * readKS = ksNew (0, KS_END);
 		int r = storage->kdbGet (storage, readKS, parentKey);
-		if (r > 0)
-		{
-			if (s->ks) ksDel (s->ks);
-			s->ks = ksDup (readKS);
-			rc = SUCCESS;
-		}
-		else
-		{
-			rc = ERROR;
-		}
-		ksDel (readKS);
+		rc = storeChildKeySet (s, readKS, r);
 	}
 	keySetName (parentKey, keyName (initialParent));
 	keySetString (parentKey, keyString (initialParent));
@@ -591,6 +1081,12 @@ static Codes doGetStorage (MultiConfig * mc, Key * parentKey)
 	return rc;
 }
 
+/**
+ * @brief Merges the KeySets of all files into @p returned
+ *
+ * The children are sorted by filename, so the result does not depend
+ * on the order in which the files were read.
+ */
 static void fillReturned (MultiConfig * mc, KeySet * returned)
 {
 	ksRewind (mc->childBackends);
@@ -619,6 +1115,7 @@ int elektraMultifileGet (Plugin * handle, KeySet * returned, Key * parentKey ELE
 			keyNew ("system/elektra/modules/multifile/exports/error", KEY_FUNC, elektraMultifileError, KEY_END),
 			keyNew ("system/elektra/modules/multifile/exports/checkconf", KEY_FUNC, elektraMultifileCheckConf, KEY_END),
 			keyNew ("system/elektra/modules/multifile/exports/checkfile", KEY_FUNC, elektraMultifileCheckFile, KEY_END),
+			keyNew ("system/elektra/modules/multifile/exports/setIoBinding", KEY_FUNC, elektraMultifileSetIoBinding, KEY_END),
 
 #include ELEKTRA_README
 			keyNew ("system/elektra/modules/multifile/infos/version", KEY_VALUE, PLUGINVERSION, KEY_END), KS_END);
@@ -629,7 +1126,7 @@ int elektraMultifileGet (Plugin * handle, KeySet * returned, Key * parentKey ELE
 	}
 	// get all keys
 	MultiConfig * mc = elektraPluginGetData (handle);
-	if (!mc)
+	if (!mc || !mc->directory)
 	{
 		mc = initialize (handle, parentKey);
 	}
@@ -658,6 +1155,8 @@ int elektraMultifileGet (Plugin * handle, KeySet * returned, Key * parentKey ELE
 		}
 		mc->getPhase = MULTI_GETRESOLVER;
 	}
+	// do not trust the watch after errors
+	if (rc == ERROR) mc->changed = 1;
 	elektraPluginSetData (handle, mc);
 	if (rc == CACHE_HIT)
 	{
@@ -838,14 +1337,16 @@ static void flagUpdateBackends (MultiConfig * mc, KeySet * returned)
 		{
 			s->rcResolver = SUCCESS;
 			if (s->ks) ksDel (s->ks);
-			s->ks = ksDup (cutKS);
+			// cutKS is not used afterwards, so it can be kept as it is
+			s->ks = cutKS;
+			cutKS = NULL;
 		}
 		else
 		{
 			s->rcResolver = NOUPDATE;
 		}
 		keyDel (cutKey);
-		ksDel (cutKS);
+		if (cutKS) ksDel (cutKS);
 	}
 }
 
@@ -924,6 +1425,35 @@ int elektraMultifileCommit (Plugin * handle ELEKTRA_UNUSED, KeySet * returned EL
 	return elektraMultifileSet (handle, returned, parentKey);
 }
 
+/**
+ * @brief Registers the watch of the option `watch` at the I/O binding
+ *
+ * Without I/O binding the watch is read at the beginning of every kdbGet().
+ */
+void elektraMultifileSetIoBinding (Plugin * handle, KeySet * parameters)
+{
+	ELEKTRA_NOT_NULL (handle);
+	ELEKTRA_NOT_NULL (parameters);
+
+	Key * ioBindingKey = ksLookupByName (parameters, "/ioBinding", 0);
+	ELEKTRA_NOT_NULL (ioBindingKey);
+	ElektraIoInterface * binding = *(ElektraIoInterface **) keyValue (ioBindingKey);
+
+	MultiConfig * mc = elektraPluginGetData (handle);
+	if (!mc)
+	{
+		// the configuration is read on the first kdbGet()
+		mc = elektraCalloc (sizeof (MultiConfig));
+		mc->watchFd = -1;
+		elektraPluginSetData (handle, mc);
+	}
+	watchClose (mc);
+	mc->ioBinding = binding;
+#ifdef HAVE_SYS_INOTIFY_H
+	if (mc->watch && ksGetSize (mc->indexDirs) > 0) mc->changed = 1;
+#endif
+}
+
 int elektraMultifileCheckConf (Key * errorKey ELEKTRA_UNUSED, KeySet * conf ELEKTRA_UNUSED)
 {
 	// validate plugin configuration
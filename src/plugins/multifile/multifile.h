@@ -20,6 +20,7 @@ int elektraMultifileSet (Plugin * handle, KeySet * ks, Key * parentKey);
 int elektraMultifileError (Plugin * handle, KeySet * ks, Key * parentKey);
 int elektraMultifileCommit (Plugin * handle, KeySet * ks, Key * parentKey);
 int elektraMultifileCheckConf (Key * errorKey, KeySet * conf);
+void elektraMultifileSetIoBinding (Plugin * handle, KeySet * parameters);
 
 Plugin * ELEKTRA_PLUGIN_EXPORT;
 
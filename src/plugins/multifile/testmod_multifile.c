@@ -0,0 +1,233 @@
+/**
+ * @file
+ *
+ * @brief Tests for multifile plugin
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ *
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <kdbconfig.h>
+#include <kdbhelper.h>
+
+#include <tests_plugin.h>
+
+static void writeFile (const char * file, const char * value)
+{
+	FILE * f = fopen (file, "w");
+	exit_if_fail (f != NULL, "could not write file");
+	fprintf (f, "key = %s\n", value);
+	fclose (f);
+}
+
+/**
+ * Does both phases of kdbGet, returns the result of the resolver phase
+ */
+static int getBoth (Plugin * plugin, KeySet * ks, Key * parentKey)
+{
+	int ret = plugin->kdbGet (plugin, ks, parentKey);
+	if (ret == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	{
+		succeed_if (plugin->kdbGet (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "storage phase failed");
+	}
+	return ret;
+}
+
+static void writeQuickdump (const char * file, const char * value)
+{
+	Key * parentKey = keyNew ("system/tests/quickdump", KEY_VALUE, file, KEY_END);
+	KeySet * conf = ksNew (0, KS_END);
+	PLUGIN_OPEN ("quickdump");
+
+	KeySet * ks = ksNew (1, keyNew ("system/tests/quickdump/key", KEY_VALUE, value, KEY_END), KS_END);
+	succeed_if (plugin->kdbSet (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not write file");
+
+	ksDel (ks);
+	keyDel (parentKey);
+	PLUGIN_CLOSE ();
+}
+
+/**
+ * Reads all files of @p directory with quickdump, returns the result of the storage phase
+ */
+static int getQuickdump (const char * directory, const char * threads, KeySet * ks, Key * parentKey)
+{
+	KeySet * conf = ksNew (5, keyNew ("system/path", KEY_VALUE, directory, KEY_END), keyNew ("system/pattern", KEY_VALUE, "*.qd", KEY_END),
+			       keyNew ("system/storage", KEY_VALUE, "quickdump", KEY_END),
+			       keyNew ("system/resolver", KEY_VALUE, "resolver", KEY_END), KS_END);
+	if (threads) ksAppendKey (conf, keyNew ("system/threads", KEY_VALUE, threads, KEY_END));
+	PLUGIN_OPEN ("multifile");
+
+	succeed_if (plugin->kdbGet (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not resolve files");
+	int ret = plugin->kdbGet (plugin, ks, parentKey);
+
+	PLUGIN_CLOSE ();
+	return ret;
+}
+
+static void test_threads (void)
+{
+	printf ("test reading files with threads\n");
+
+	char * directory = elektraFormat ("%s/threads", tempHome);
+	succeed_if (mkdir (directory, 0700) == 0, "could not create directory");
+	const char * names[] = { "a", "b", "c", "d", "e" };
+	char * files[5];
+	for (size_t i = 0; i < 5; ++i)
+	{
+		files[i] = elektraFormat ("%s/%s.qd", directory, names[i]);
+		writeQuickdump (files[i], names[i]);
+	}
+
+	Key * parentKey = keyNew ("system/tests/multifile", KEY_END);
+	KeySet * serial = ksNew (0, KS_END);
+	succeed_if (getQuickdump (directory, NULL, serial, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not read files");
+	KeySet * parallel = ksNew (0, KS_END);
+	succeed_if (getQuickdump (directory, "4", parallel, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not read files with threads");
+	compare_keyset (serial, parallel);
+	succeed_if_same_string (keyString (ksLookupByName (parallel, "system/tests/multifile/c.qd/key", 0)), "c");
+	ksDel (serial);
+	ksDel (parallel);
+	keyDel (parentKey);
+
+	// the error of b comes first, the error of d becomes a warning, like without threads
+	writeFile (files[1], "broken");
+	writeFile (files[3], "broken");
+	Key * serialKey = keyNew ("system/tests/multifile", KEY_END);
+	serial = ksNew (0, KS_END);
+	int serialRet = getQuickdump (directory, NULL, serial, serialKey);
+	Key * parallelKey = keyNew ("system/tests/multifile", KEY_END);
+	parallel = ksNew (0, KS_END);
+	succeed_if (getQuickdump (directory, "4", parallel, parallelKey) == serialRet, "threads changed the result");
+	compare_keyset (serial, parallel);
+
+	succeed_if_same_string (keyString (keyGetMeta (parallelKey, "error/configfile")), files[1]);
+	succeed_if_same_string (keyString (keyGetMeta (parallelKey, "warnings/#00/configfile")), files[3]);
+	succeed_if (keyGetMeta (parallelKey, "warnings/#01") == NULL, "unexpected warning");
+	const char * compared[] = { "error/number", "error/reason",	  "error/configfile",
+				    "warnings",	    "warnings/#00/reason", "warnings/#00/configfile" };
+	for (size_t i = 0; i < sizeof (compared) / sizeof (compared[0]); ++i)
+	{
+		succeed_if_same_string (keyString (keyGetMeta (parallelKey, compared[i])), keyString (keyGetMeta (serialKey, compared[i])));
+	}
+
+	ksDel (serial);
+	ksDel (parallel);
+	keyDel (serialKey);
+	keyDel (parallelKey);
+	for (size_t i = 0; i < 5; ++i)
+	{
+		unlink (files[i]);
+		elektraFree (files[i]);
+	}
+	rmdir (directory);
+	elektraFree (directory);
+}
+
+static void test_racilyClean (void)
+{
+	printf ("test file created in the same tick as the scan\n");
+
+	char * directory = elektraFormat ("%s/racy", tempHome);
+	char * a = elektraFormat ("%s/a.ini", directory);
+	char * b = elektraFormat ("%s/b.ini", directory);
+	succeed_if (mkdir (directory, 0700) == 0, "could not create directory");
+	writeFile (a, "a");
+
+	// a timestamp not older than the scan, as if a is still being written while scanning
+	struct timespec times[2] = { { .tv_sec = 0, .tv_nsec = UTIME_OMIT }, { .tv_sec = time (NULL) + 3600, .tv_nsec = 0 } };
+	succeed_if (utimensat (AT_FDCWD, directory, times, 0) == 0, "could not change timestamp of directory");
+
+	Key * parentKey = keyNew ("system/tests/multifile", KEY_END);
+	KeySet * conf = ksNew (4, keyNew ("system/path", KEY_VALUE, directory, KEY_END), keyNew ("system/pattern", KEY_VALUE, "*.ini", KEY_END),
+			       keyNew ("system/storage", KEY_VALUE, "mini", KEY_END),
+			       keyNew ("system/resolver", KEY_VALUE, "resolver", KEY_END), KS_END);
+	PLUGIN_OPEN ("multifile");
+
+	KeySet * ks = ksNew (0, KS_END);
+	succeed_if (getBoth (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not read directory");
+	succeed_if_same_string (keyString (ksLookupByName (ks, "system/tests/multifile/a.ini/key", 0)), "a");
+
+	// b is added in the same tick, so the timestamp of the directory stays the same
+	writeFile (b, "b");
+	succeed_if (utimensat (AT_FDCWD, directory, times, 0) == 0, "could not change timestamp of directory");
+
+	succeed_if (getBoth (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "new file not noticed");
+	succeed_if_same_string (keyString (ksLookupByName (ks, "system/tests/multifile/b.ini/key", 0)), "b");
+
+	ksDel (ks);
+	keyDel (parentKey);
+	PLUGIN_CLOSE ();
+
+	unlink (a);
+	unlink (b);
+	rmdir (directory);
+	elektraFree (a);
+	elektraFree (b);
+	elektraFree (directory);
+}
+
+static void test_symlink (void)
+{
+	printf ("test symlink to file outside of the directory\n");
+
+	char * directory = elektraFormat ("%s/symlink", tempHome);
+	char * outside = elektraFormat ("%s/outside.ini", tempHome);
+	char * link = elektraFormat ("%s/link.ini", directory);
+	succeed_if (mkdir (directory, 0700) == 0, "could not create directory");
+	writeFile (outside, "outside");
+	succeed_if (symlink (outside, link) == 0, "could not create symlink");
+
+	Key * parentKey = keyNew ("system/tests/multifile", KEY_END);
+	KeySet * conf = ksNew (6, keyNew ("system/path", KEY_VALUE, directory, KEY_END), keyNew ("system/pattern", KEY_VALUE, "*.ini", KEY_END),
+			       keyNew ("system/storage", KEY_VALUE, "mini", KEY_END), keyNew ("system/resolver", KEY_VALUE, "resolver", KEY_END),
+			       keyNew ("system/recursive", KEY_END), keyNew ("system/watch", KEY_END), KS_END);
+	PLUGIN_OPEN ("multifile");
+
+	KeySet * ks = ksNew (0, KS_END);
+	succeed_if (getBoth (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "could not read directory");
+	succeed_if_same_string (keyString (ksLookupByName (ks, "system/tests/multifile/link.ini/key", 0)), "outside");
+
+	// the watch of the directory does not report changes of the target
+	writeFile (outside, "changed");
+	struct timespec times[2] = { { .tv_sec = 0, .tv_nsec = UTIME_OMIT }, { .tv_sec = time (NULL) + 3600, .tv_nsec = 0 } };
+	succeed_if (utimensat (AT_FDCWD, outside, times, 0) == 0, "could not change timestamp of file");
+
+	succeed_if (getBoth (plugin, ks, parentKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "change of target not noticed");
+	succeed_if_same_string (keyString (ksLookupByName (ks, "system/tests/multifile/link.ini/key", 0)), "changed");
+
+	ksDel (ks);
+	keyDel (parentKey);
+	PLUGIN_CLOSE ();
+
+	unlink (link);
+	unlink (outside);
+	rmdir (directory);
+	elektraFree (link);
+	elektraFree (outside);
+	elektraFree (directory);
+}
+
+int main (int argc, char ** argv)
+{
+	printf ("MULTIFILE     TESTS\n");
+	printf ("==================\n\n");
+
+	init (argc, argv);
+
+	test_racilyClean ();
+	test_symlink ();
+	test_threads ();
+
+	print_result ("testmod_multifile");
+
+	return nbError;
+}
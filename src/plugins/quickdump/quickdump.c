@@ -7,25 +7,59 @@
  *
  */
 
+#ifdef HAVE_KDBCONFIG_H
+#include "kdbconfig.h"
+#endif
+
 #include "quickdump.h"
 
 #include <kdbendian.h>
 #include <kdbhelper.h>
 
 #include <kdberrors.h>
+#include <kdbprivate.h>
 #include <stdio.h>
 
+#include <sys/stat.h>
+
 #define MAGIC_NUMBER_BASE (0x454b444200000000UL) // EKDB (in ASCII) + Version placeholder
 
 #define MAGIC_NUMBER_V1 ((kdb_unsigned_long_long_t) (MAGIC_NUMBER_BASE + 1))
 #define MAGIC_NUMBER_V2 ((kdb_unsigned_long_long_t) (MAGIC_NUMBER_BASE + 2))
 #define MAGIC_NUMBER_V3 ((kdb_unsigned_long_long_t) (MAGIC_NUMBER_BASE + 3))
+#define MAGIC_NUMBER_V4 ((kdb_unsigned_long_long_t) (MAGIC_NUMBER_BASE + 4))
+
+// the footer of v4 consists of: index offset, entries offset, number of entries, magic number
+#define FOOTER_SIZE (4 * sizeof (kdb_unsigned_long_long_t))
+// an index entry consists of: offset of the key, offset of its name inside of the index
+#define INDEX_ENTRY_SIZE (2 * sizeof (kdb_unsigned_long_long_t))
 
 struct metaLink
 {
 	const void * meta;
+	kdb_unsigned_long_long_t offset; // where the metakey was written first (v4)
+	const char * keyName;		 // name of the key the metakey was written with first (v3)
 	size_t keyNameSize;
-	const char * keyName;
+};
+
+struct indexEntry
+{
+	kdb_unsigned_long_long_t offset; // offset of the key in the file
+	const char * name;		 // unescaped name relative to the parent key
+	size_t nameSize;
+};
+
+/**
+ * The footer of a v4 file. The index consists of the unescaped names of all keys relative to
+ * the parent key (starting at indexOffset) followed by one entry per key (starting at
+ * entriesOffset). Entries are sorted like the keys, therefore each subtree is a contiguous
+ * range of entries and of keys in the file.
+ */
+struct footer
+{
+	kdb_unsigned_long_long_t indexOffset;	// end of the keys, start of the names in the index
+	kdb_unsigned_long_long_t entriesOffset; // start of the index entries
+	kdb_unsigned_long_long_t count;		// number of index entries, 0 if the file has no index
 };
 
 struct list
@@ -43,7 +77,8 @@ struct stringbuffer
 };
 
 static ssize_t findMetaLink (struct list * list, const Key * meta);
-static void insertMetaLink (struct list * list, size_t index, const Key * meta, Key * key, size_t parentOffset);
+static void insertMetaLink (struct list * list, size_t index, const Key * meta, kdb_unsigned_long_long_t offset, const char * keyName,
+			    size_t keyNameSize);
 
 static void setupBuffer (struct stringbuffer * buffer, size_t initialAlloc);
 static void ensureBufferSize (struct stringbuffer * buffer, size_t minSize);
@@ -57,9 +92,11 @@ static void ensureBufferSize (struct stringbuffer * buffer, size_t minSize);
 
 #include "varint.c"
 
-static inline bool writeData (FILE * file, const char * data, kdb_unsigned_long_long_t size, Key * errorKey)
+static inline bool writeData (FILE * file, const char * data, kdb_unsigned_long_long_t size, kdb_unsigned_long_long_t * offset,
+			      Key * errorKey)
 {
-	if (!varintWrite (file, size))
+	size_t varintSize = varintWrite (file, size);
+	if (varintSize == 0)
 	{
 		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, feof (file) ? "Premature end of file" : "Unknown error");
 		return false;
@@ -73,6 +110,36 @@ static inline bool writeData (FILE * file, const char * data, kdb_unsigned_long_
 			return false;
 		}
 	}
+	*offset += varintSize + size;
+	return true;
+}
+
+static inline bool writeByte (FILE * file, char c, kdb_unsigned_long_long_t * offset, Key * errorKey)
+{
+	if (fputc (c, file) == EOF)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (errorKey, "Could not write file");
+		return false;
+	}
+	*offset += 1;
+	return true;
+}
+
+// since v4 strings are written with a null terminator, which is not included in the size
+static inline bool writeString (FILE * file, const char * data, kdb_unsigned_long_long_t size, kdb_unsigned_long_long_t * offset,
+				Key * errorKey)
+{
+	return writeData (file, data, size, offset, errorKey) && writeByte (file, '\0', offset, errorKey);
+}
+
+static inline bool writeUInt64 (FILE * file, kdb_unsigned_long_long_t value, kdb_unsigned_long_long_t * offset, Key * errorKey)
+{
+	if (fwrite (&value, sizeof (kdb_unsigned_long_long_t), 1, file) < 1)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (errorKey, "Could not write file");
+		return false;
+	}
+	*offset += sizeof (kdb_unsigned_long_long_t);
 	return true;
 }
 
@@ -131,97 +198,216 @@ static inline bool readStringIntoBufferV2 (FILE * file, struct stringbuffer * bu
 	return true;
 }
 
-// for v3 reading
-static inline bool readStringIntoBuffer (FILE * file, struct stringbuffer * buffer, Key * errorKey)
+#include "readv1.c"
+
+#define readStringIntoBuffer readStringIntoBufferV2
+#include "readv2.c"
+#undef readStringIntoBuffer
+
+/**
+ * Reads the remaining contents of @p file (after the magic number) into a single buffer.
+ *
+ * The buffer is handed over to the arena of @p keys, so that the values of the keys can
+ * point directly into it. It is freed together with the arena.
+ *
+ * @retval true if @c reader is set up to decode the contents
+ * @retval false on error
+ */
+static bool readContents (FILE * file, KeySet * keys, struct reader * reader)
 {
-	kdb_unsigned_long_long_t size = 0;
-	if (!varintRead (file, &size))
+	struct stringbuffer buffer;
+
+	// regular files are read at once, otherwise (e.g. pipes) the buffer grows as needed
+	struct stat st;
+	size_t sizeHint = 4096;
+	if (fstat (fileno (file), &st) == 0 && S_ISREG (st.st_mode) && (size_t) st.st_size > sizeHint)
 	{
-		ELEKTRA_SET_RESOURCE_ERROR (errorKey, feof (file) ? "Premature end of file" : "Unknown error");
-		return false;
+		sizeHint = st.st_size;
 	}
+	setupBuffer (&buffer, sizeHint);
 
-	size_t newSize = buffer->offset + size + 1;
-	ensureBufferSize (buffer, newSize);
+	size_t bytesRead;
+	while ((bytesRead = fread (&buffer.string[buffer.offset], sizeof (char), buffer.alloc - buffer.offset, file)) > 0)
+	{
+		buffer.offset += bytesRead;
+		ensureBufferSize (&buffer, buffer.offset + 1);
+	}
 
-	if (fread (&buffer->string[buffer->offset], sizeof (char), size, file) < size)
+	if (ferror (file) || ksArenaAdoptBuffer (keys, buffer.string) != 1)
 	{
-		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, feof (file) ? "Premature end of file" : "Unknown error");
+		elektraFree (buffer.string);
 		return false;
 	}
-	buffer->string[newSize - 1] = '\0';
+
+	reader->cur = buffer.string;
+	reader->end = buffer.string + buffer.offset;
+	reader->savedAt = NULL;
+	reader->saved = 0;
 	return true;
 }
 
-#include "readv1.c"
+/**
+ * Creates a new key in the arena of @p keys.
+ *
+ * The value of the key points directly into the buffer owned by the arena,
+ * it is only copied once it is changed.
+ */
+static inline Key * newKey (KeySet * keys, const char * name, bool binary, char * value, size_t valueSize)
+{
+	Key * k = binary ? ksArenaKeyNew (keys, name, KEY_BINARY, KEY_END) : ksArenaKeyNew (keys, name, KEY_END);
+	if (k == NULL || (binary && valueSize == 0))
+	{
+		return k;
+	}
 
-#define readStringIntoBuffer readStringIntoBufferV2
-#include "readv2.c"
-#undef readStringIntoBuffer
+	k->data.v = value;
+	k->dataSize = binary ? valueSize : valueSize + 1;
+	set_bit (k->flags, KEY_FLAG_MMAP_DATA);
+	return k;
+}
 
-int elektraQuickdumpGet (Plugin * handle ELEKTRA_UNUSED, KeySet * returned, Key * parentKey)
+#include "readv3.c"
+
+/**
+ * A part of a v4 file, which was read into memory.
+ */
+struct range
 {
-	if (!elektraStrCmp (keyName (parentKey), "system/elektra/modules/quickdump"))
+	char * start;			 // contents of the file starting at offset
+	char * end;			 // end of the contents in memory
+	kdb_unsigned_long_long_t offset; // offset of start inside of the file
+	FILE * file;			 // file to read metadata outside of the range from, NULL if not needed
+	struct stringbuffer metaBuffer;	 // buffer for metadata read from file
+};
+
+// for v4 reading, strings are stored with a null terminator
+static inline const char * readTerminatedString (struct reader * reader, size_t * sizePtr, Key * errorKey)
+{
+	kdb_unsigned_long_long_t size = 0;
+	if (!varintRead (reader, &size) || size >= (kdb_unsigned_long_long_t) (reader->end - reader->cur) || reader->cur[size] != '\0')
 	{
-		KeySet * contract = ksNew (
-			30, keyNew ("system/elektra/modules/quickdump", KEY_VALUE, "quickdump plugin waits for your orders", KEY_END),
-			keyNew ("system/elektra/modules/quickdump/exports", KEY_END),
-			keyNew ("system/elektra/modules/quickdump/exports/get", KEY_FUNC, elektraQuickdumpGet, KEY_END),
-			keyNew ("system/elektra/modules/quickdump/exports/set", KEY_FUNC, elektraQuickdumpSet, KEY_END),
-#include ELEKTRA_README
-			keyNew ("system/elektra/modules/quickdump/infos/version", KEY_VALUE, PLUGINVERSION, KEY_END), KS_END);
-		ksAppend (returned, contract);
-		ksDel (contract);
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, "Premature end of file");
+		return NULL;
+	}
 
-		return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+	const char * string = reader->cur;
+	reader->cur += size + 1;
+
+	if (sizePtr != NULL)
+	{
+		*sizePtr = size;
 	}
-	// get all keys
+	return string;
+}
 
-	FILE * file = fopen (keyString (parentKey), "rb");
+// for v4 reading, appends a null terminated string of the file to the buffer
+static bool readTerminatedStringFromFile (FILE * file, struct stringbuffer * buffer, Key * errorKey)
+{
+	kdb_unsigned_long_long_t size = 0;
+	if (!varintReadFile (file, &size))
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, "Premature end of file");
+		return false;
+	}
 
-	if (file == NULL)
+	ensureBufferSize (buffer, buffer->offset + size + 1);
+	if (fread (&buffer->string[buffer->offset], sizeof (char), size + 1, file) < size + 1 || buffer->string[buffer->offset + size] != '\0')
 	{
-		ELEKTRA_SET_ERROR_GET (parentKey);
-		return ELEKTRA_PLUGIN_STATUS_ERROR;
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, "Premature end of file");
+		return false;
 	}
+	buffer->offset += size + 1;
+	return true;
+}
 
-	kdb_unsigned_long_long_t magic;
-	if (fread (&magic, sizeof (kdb_unsigned_long_long_t), 1, file) < 1)
+/**
+ * Reads name and value of the metakey, which was written at @p offset of the file.
+ *
+ * The metakey is read from memory, if it lies within @p range, otherwise from the file.
+ */
+static bool readMetaAt (struct range * range, kdb_unsigned_long_long_t offset, const char ** name, const char ** value, Key * errorKey)
+{
+	if (offset >= range->offset && offset - range->offset < (kdb_unsigned_long_long_t) (range->end - range->start))
+	{
+		struct reader reader = { .cur = range->start + (offset - range->offset), .end = range->end, .savedAt = NULL, .saved = 0 };
+		*name = readTerminatedString (&reader, NULL, errorKey);
+		*value = *name == NULL ? NULL : readTerminatedString (&reader, NULL, errorKey);
+		return *value != NULL;
+	}
+
+	if (range->file == NULL || fseek (range->file, offset, SEEK_SET) != 0)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERRORF (errorKey, "Invalid offset " ELEKTRA_UNSIGNED_LONG_LONG_F " of copied metakey", offset);
+		return false;
+	}
+
+	range->metaBuffer.offset = 0;
+	if (!readTerminatedStringFromFile (range->file, &range->metaBuffer, errorKey))
+	{
+		return false;
+	}
+	size_t valueOffset = range->metaBuffer.offset;
+	if (!readTerminatedStringFromFile (range->file, &range->metaBuffer, errorKey))
+	{
+		return false;
+	}
+
+	*name = range->metaBuffer.string;
+	*value = &range->metaBuffer.string[valueOffset];
+	return true;
+}
+
+/**
+ * The key, which a metakey was read with first. Used to share the metakey with the keys copying it.
+ */
+struct metaSource
+{
+	kdb_unsigned_long_long_t offset; // where the metakey was written
+	Key * key;			 // key the metakey was read with
+};
+
+struct metaSources
+{
+	size_t alloc;
+	size_t size;
+	struct metaSource * array;
+};
+
+static void addMetaSource (struct metaSources * sources, kdb_unsigned_long_long_t offset, Key * key)
+{
+	if (sources->size == sources->alloc)
+	{
+		sources->alloc = sources->alloc == 0 ? 16 : sources->alloc * 2;
+		elektraRealloc ((void **) &sources->array, sources->alloc * sizeof (struct metaSource));
+	}
+	sources->array[sources->size].offset = offset;
+	sources->array[sources->size].key = key;
+	++sources->size;
+}
+
+// metakeys are read in the order of the file, therefore the offsets are sorted
+static Key * findMetaSource (struct metaSources * sources, kdb_unsigned_long_long_t offset)
+{
+	size_t low = 0;
+	size_t high = sources->size;
+	while (low < high)
 	{
-		if (feof (file) && ftell (file) == 0)
+		size_t mid = low + (high - low) / 2;
+		if (sources->array[mid].offset < offset)
 		{
-			fclose (file);
-			return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+			low = mid + 1;
 		}
 		else
 		{
-			fclose (file);
-			return ELEKTRA_PLUGIN_STATUS_ERROR;
+			high = mid;
 		}
 	}
-	magic = be64toh (magic); // magic number is written big endian so EKDB magic string is readable
-
-	switch (magic)
-	{
-	case MAGIC_NUMBER_V1:
-		return readVersion1 (file, returned, parentKey);
-	case MAGIC_NUMBER_V2:
-		return readVersion2 (file, returned, parentKey);
-	case MAGIC_NUMBER_V3:
-		// break, current version implemented below
-		break;
-	default:
-		fclose (file);
-		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERRORF (parentKey, "Unknown magic number " ELEKTRA_UNSIGNED_LONG_LONG_F, magic);
-		return ELEKTRA_PLUGIN_STATUS_ERROR;
-	}
-
-	// setup buffers
-	struct stringbuffer valueBuffer;
-	setupBuffer (&valueBuffer, 4);
+	return low < sources->size && sources->array[low].offset == offset ? sources->array[low].key : NULL;
+}
 
-	struct stringbuffer metaNameBuffer;
-	setupBuffer (&metaNameBuffer, 4);
+static int readVersion4 (struct range * range, KeySet * keys, Key * parentKey)
+{
+	struct reader reader = { .cur = range->start, .end = range->end, .savedAt = NULL, .saved = 0 };
 
 	// setup name buffer with parent key
 	struct stringbuffer nameBuffer;
@@ -234,384 +420,740 @@ int elektraQuickdumpGet (Plugin * handle ELEKTRA_UNUSED, KeySet * returned, Key
 	nameBuffer.string[parentSize] = '\0';    // set new null terminator
 	nameBuffer.offset = parentSize;		 // set offset to null terminator
 
-	char c;
-	while ((c = fgetc (file)) != EOF)
-	{
-		ungetc (c, file);
+	setupBuffer (&range->metaBuffer, 4);
 
-		if (!readStringIntoBuffer (file, &nameBuffer, parentKey))
-		{
-			elektraFree (nameBuffer.string);
-			elektraFree (metaNameBuffer.string);
-			elektraFree (valueBuffer.string);
-			fclose (file);
-			return ELEKTRA_PLUGIN_STATUS_ERROR;
-		}
+	struct metaSources sources = { .alloc = 0, .size = 0, .array = NULL };
 
-		char type = fgetc (file);
-		if (type == EOF)
+	int result = ELEKTRA_PLUGIN_STATUS_SUCCESS;
+	while (reader.cur < reader.end && result == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	{
+		size_t nameSize;
+		const char * name = readTerminatedString (&reader, &nameSize, parentKey);
+		if (name == NULL)
 		{
-			elektraFree (nameBuffer.string);
-			elektraFree (metaNameBuffer.string);
-			elektraFree (valueBuffer.string);
-			fclose (file);
-			ELEKTRA_SET_VALIDATION_SEMANTIC_ERROR (parentKey, "Missing key type");
-			return ELEKTRA_PLUGIN_STATUS_ERROR;
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+			break;
 		}
+		ensureBufferSize (&nameBuffer, nameBuffer.offset + nameSize + 1);
+		memcpy (&nameBuffer.string[nameBuffer.offset], name, nameSize + 1);
 
-		Key * k;
+		int type = readerGetc (&reader);
+		char * value = NULL;
+		size_t valueSize = 0;
 
 		switch (type)
 		{
 		case 'b':
-		{
 			// binary key value
-			kdb_unsigned_long_long_t valueSize = 0;
-			if (!varintRead (file, &valueSize))
-			{
-				ELEKTRA_SET_RESOURCE_ERROR (parentKey, feof (file) ? "Premature end of file" : "Unknown error");
-				elektraFree (nameBuffer.string);
-				elektraFree (metaNameBuffer.string);
-				elektraFree (valueBuffer.string);
-				fclose (file);
-				return ELEKTRA_PLUGIN_STATUS_ERROR;
-			}
-
-			if (valueSize == 0)
-			{
-				k = keyNew (nameBuffer.string, KEY_BINARY, KEY_SIZE, valueSize, KEY_END);
-			}
-			else
-			{
-				void * value = elektraMalloc (valueSize);
-				if (fread (value, sizeof (char), valueSize, file) < valueSize)
-				{
-					elektraFree (nameBuffer.string);
-					elektraFree (metaNameBuffer.string);
-					fclose (file);
-					ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Error while reading file");
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
-				k = keyNew (nameBuffer.string, KEY_BINARY, KEY_SIZE, (size_t) valueSize, KEY_VALUE, value, KEY_END);
-				elektraFree (value);
-			}
+			value = readBinary (&reader, &valueSize, parentKey);
 			break;
-		}
 		case 's':
-		{
 			// string key value
-			if (!readStringIntoBuffer (file, &valueBuffer, parentKey))
-			{
-				elektraFree (nameBuffer.string);
-				elektraFree (metaNameBuffer.string);
-				elektraFree (valueBuffer.string);
-				fclose (file);
-				return ELEKTRA_PLUGIN_STATUS_ERROR;
-			}
-			k = keyNew (nameBuffer.string, KEY_VALUE, valueBuffer.string, KEY_END);
+			value = (char *) readTerminatedString (&reader, &valueSize, parentKey);
+			break;
+		case EOF:
+			ELEKTRA_SET_VALIDATION_SEMANTIC_ERROR (parentKey, "Missing key type");
 			break;
-		}
 		default:
-			elektraFree (nameBuffer.string);
-			elektraFree (metaNameBuffer.string);
-			elektraFree (valueBuffer.string);
-			fclose (file);
 			ELEKTRA_SET_VALIDATION_SEMANTIC_ERRORF (parentKey, "Unknown key type %c", type);
-			return ELEKTRA_PLUGIN_STATUS_ERROR;
+			break;
 		}
 
-		while ((c = fgetc (file)) != 0)
+		if (value == NULL)
 		{
-			if (c == EOF)
-			{
-				keyDel (k);
-				fclose (file);
-				ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Missing key end");
-				return ELEKTRA_PLUGIN_STATUS_ERROR;
-			}
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+			break;
+		}
 
-			switch (c)
-			{
-			case 'm':
-			{
-				// meta key
-				if (!readStringIntoBuffer (file, &metaNameBuffer, parentKey))
-				{
-					keyDel (k);
-					elektraFree (nameBuffer.string);
-					elektraFree (metaNameBuffer.string);
-					elektraFree (valueBuffer.string);
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
+		Key * k = newKey (keys, nameBuffer.string, type == 'b', value, valueSize);
+		if (k == NULL)
+		{
+			ELEKTRA_SET_VALIDATION_SEMANTIC_ERRORF (parentKey, "Invalid key name '%s'", nameBuffer.string);
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+			break;
+		}
 
-				if (!readStringIntoBuffer (file, &valueBuffer, parentKey))
-				{
-					keyDel (k);
-					elektraFree (nameBuffer.string);
-					elektraFree (metaNameBuffer.string);
-					elektraFree (valueBuffer.string);
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
-				const char * metaValue = valueBuffer.string;
+		int c;
+		while ((c = readerGetc (&reader)) != 0)
+		{
+			const char * metaName = NULL;
+			const char * metaValue = NULL;
+			Key * source = NULL;
 
-				keySetMeta (k, metaNameBuffer.string, metaValue);
-				break;
+			if (c == 'm')
+			{
+				// meta key
+				addMetaSource (&sources, range->offset + (reader.cur - range->start), k);
+				metaName = readTerminatedString (&reader, NULL, parentKey);
+				metaValue = metaName == NULL ? NULL : readTerminatedString (&reader, NULL, parentKey);
 			}
-			case 'c':
+			else if (c == 'c')
 			{
-				// copy meta
-				if (!readStringIntoBuffer (file, &nameBuffer, parentKey))
+				// copy meta, stored as offset of the metakey written first
+				kdb_unsigned_long_long_t offset;
+				if (!varintRead (&reader, &offset))
 				{
-					keyDel (k);
-					elektraFree (nameBuffer.string);
-					elektraFree (metaNameBuffer.string);
-					elektraFree (valueBuffer.string);
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
+					ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Premature end of file");
 				}
-
-				if (!readStringIntoBuffer (file, &metaNameBuffer, parentKey))
-				{
-					keyDel (k);
-					elektraFree (nameBuffer.string);
-					elektraFree (metaNameBuffer.string);
-					elektraFree (valueBuffer.string);
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
-
-				const Key * sourceKey = ksLookupByName (returned, nameBuffer.string, 0);
-				if (sourceKey == NULL)
+				else
 				{
-					ELEKTRA_SET_RESOURCE_ERRORF (parentKey, "Could not copy meta data from key '%s': Key not found",
-								     nameBuffer.string);
-					keyDel (k);
-					elektraFree (nameBuffer.string);
-					elektraFree (metaNameBuffer.string);
-					elektraFree (valueBuffer.string);
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
+					source = findMetaSource (&sources, offset);
+					readMetaAt (range, offset, &metaName, &metaValue, parentKey);
 				}
+			}
+			else if (c == EOF)
+			{
+				ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Missing key end");
+			}
+			else
+			{
+				ELEKTRA_SET_VALIDATION_SYNTACTIC_ERRORF (parentKey, "Unknown meta type %c", c);
+			}
 
-				if (keyCopyMeta (k, sourceKey, metaNameBuffer.string) != 1)
-				{
-					ELEKTRA_SET_INTERNAL_ERRORF (parentKey, "Could not copy meta data from key '%s': Error during copy",
-								     &nameBuffer.string[nameBuffer.offset]);
-					keyDel (k);
-					elektraFree (nameBuffer.string);
-					elektraFree (metaNameBuffer.string);
-					elektraFree (valueBuffer.string);
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
+			if (metaValue == NULL)
+			{
+				result = ELEKTRA_PLUGIN_STATUS_ERROR;
 				break;
 			}
-			default:
-				keyDel (k);
-				elektraFree (nameBuffer.string);
-				elektraFree (metaNameBuffer.string);
-				elektraFree (valueBuffer.string);
-				fclose (file);
-				ELEKTRA_SET_VALIDATION_SYNTACTIC_ERRORF (parentKey, "Unknown meta type %c", type);
-				return ELEKTRA_PLUGIN_STATUS_ERROR;
+
+			// copied metakeys are shared, unless the key they were written with is outside of the range
+			if (source != NULL)
+			{
+				keyCopyMeta (k, source, metaName);
+			}
+			else
+			{
+				keySetMeta (k, metaName, metaValue);
 			}
 		}
 
-		ksAppendKey (returned, k);
+		if (result == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+		{
+			ksBuilderAdd (keys, k);
+		}
+		else
+		{
+			keyDel (k);
+		}
 	}
 
 	elektraFree (nameBuffer.string);
-	elektraFree (metaNameBuffer.string);
-	elektraFree (valueBuffer.string);
-
-	fclose (file);
-
-	return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+	elektraFree (range->metaBuffer.string);
+	elektraFree (sources.array);
+	return result;
 }
 
-int elektraQuickdumpSet (Plugin * handle, KeySet * returned, Key * parentKey)
+static bool decodeFooter (const char * data, kdb_unsigned_long_long_t fileSize, struct footer * footer, Key * errorKey)
 {
-	cursor_t cursor = ksGetCursor (returned);
-	ksRewind (returned);
+	kdb_unsigned_long_long_t values[4];
+	memcpy (values, data, FOOTER_SIZE);
 
-	FILE * file;
+	footer->indexOffset = le64toh (values[0]);
+	footer->entriesOffset = le64toh (values[1]);
+	footer->count = le64toh (values[2]);
 
-	// cannot open stdout for writing, because its already open
-	if (elektraStrCmp (keyString (parentKey), STDOUT_FILENAME) == 0)
-	{
-		file = stdout;
-	}
-	else
+	if (be64toh (values[3]) != MAGIC_NUMBER_V4 || footer->indexOffset < sizeof (kdb_unsigned_long_long_t) ||
+	    footer->indexOffset > footer->entriesOffset || footer->count > fileSize / INDEX_ENTRY_SIZE ||
+	    footer->entriesOffset + footer->count * INDEX_ENTRY_SIZE + FOOTER_SIZE != fileSize)
 	{
-		file = fopen (keyString (parentKey), "wb");
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, "Invalid index at the end of the file");
+		return false;
 	}
+	return true;
+}
+
+
+/**
+ * Opens the file of @p parentKey and reads its magic number.
+ *
+ * @return the file positioned after the magic number
+ * @retval NULL if the file is empty (@p status is success) or on error (@p status is error)
+ */
+static FILE * openFile (Key * parentKey, kdb_unsigned_long_long_t * magic, int * status)
+{
+	FILE * file = fopen (keyString (parentKey), "rb");
 
 	if (file == NULL)
 	{
-		ELEKTRA_SET_ERROR_SET (parentKey);
+		ELEKTRA_SET_ERROR_GET (parentKey);
+		*status = ELEKTRA_PLUGIN_STATUS_ERROR;
+		return NULL;
+	}
+
+	if (fread (magic, sizeof (kdb_unsigned_long_long_t), 1, file) < 1)
+	{
+		*status = feof (file) && ftell (file) == 0 ? ELEKTRA_PLUGIN_STATUS_SUCCESS : ELEKTRA_PLUGIN_STATUS_ERROR;
+		fclose (file);
+		return NULL;
+	}
+	*magic = be64toh (*magic); // magic number is written big endian so EKDB magic string is readable
+
+	return file;
+}
+
+int elektraQuickdumpGet (Plugin * handle ELEKTRA_UNUSED, KeySet * returned, Key * parentKey)
+{
+	if (!elektraStrCmp (keyName (parentKey), "system/elektra/modules/quickdump"))
+	{
+		KeySet * contract = ksNew (
+			30, keyNew ("system/elektra/modules/quickdump", KEY_VALUE, "quickdump plugin waits for your orders", KEY_END),
+			keyNew ("system/elektra/modules/quickdump/exports", KEY_END),
+			keyNew ("system/elektra/modules/quickdump/exports/get", KEY_FUNC, elektraQuickdumpGet, KEY_END),
+			keyNew ("system/elektra/modules/quickdump/exports/set", KEY_FUNC, elektraQuickdumpSet, KEY_END),
+			keyNew ("system/elektra/modules/quickdump/exports/getSubtree", KEY_FUNC, elektraQuickdumpGetSubtree, KEY_END),
+#include ELEKTRA_README
+			keyNew ("system/elektra/modules/quickdump/infos/version", KEY_VALUE, PLUGINVERSION, KEY_END), KS_END);
+		ksAppend (returned, contract);
+		ksDel (contract);
+
+		return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+	}
+	// get all keys
+
+	kdb_unsigned_long_long_t magic;
+	int status;
+	FILE * file = openFile (parentKey, &magic, &status);
+	if (file == NULL)
+	{
+		return status;
+	}
+
+	switch (magic)
+	{
+	case MAGIC_NUMBER_V1:
+		return readVersion1 (file, returned, parentKey);
+	case MAGIC_NUMBER_V2:
+		return readVersion2 (file, returned, parentKey);
+	case MAGIC_NUMBER_V3:
+	case MAGIC_NUMBER_V4:
+		// break, implemented below
+		break;
+	default:
+		fclose (file);
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERRORF (parentKey, "Unknown magic number " ELEKTRA_UNSIGNED_LONG_LONG_F, magic);
 		return ELEKTRA_PLUGIN_STATUS_ERROR;
 	}
 
-	// magic number is written big endian so EKDB magic string is readable
-	kdb_unsigned_long_long_t magic = htobe64 (MAGIC_NUMBER_V3);
-	if (fwrite (&magic, sizeof (kdb_unsigned_long_long_t), 1, file) < 1)
+	// keys are allocated in bulk from an arena, which lives as long as the keys,
+	// and are sorted only once at the end
+	KeySet * keys = ksNewArena (0);
+
+	// the file is decoded directly from memory, without copying names and values into buffers
+	struct reader reader;
+	if (!readContents (file, keys, &reader))
 	{
 		fclose (file);
+		ksDel (keys);
+		ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not read file");
 		return ELEKTRA_PLUGIN_STATUS_ERROR;
 	}
+	fclose (file);
 
-	struct list metaKeys;
-	metaKeys.alloc = 16;
-	metaKeys.size = 0;
-	metaKeys.array = elektraMalloc (metaKeys.alloc * sizeof (struct metaLink *));
+	int result;
+	if (magic == MAGIC_NUMBER_V3)
+	{
+		result = readVersion3 (&reader, keys, parentKey);
+	}
+	else
+	{
+		// the whole file is in memory, the footer is only needed to find the end of the keys
+		kdb_unsigned_long_long_t fileSize = sizeof (kdb_unsigned_long_long_t) + (reader.end - reader.cur);
+		struct footer footer;
+		if (fileSize < sizeof (kdb_unsigned_long_long_t) + FOOTER_SIZE)
+		{
+			ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Missing index at the end of the file");
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+		}
+		else if (!decodeFooter (reader.end - FOOTER_SIZE, fileSize, &footer, parentKey))
+		{
+			result = ELEKTRA_PLUGIN_STATUS_ERROR;
+		}
+		else
+		{
+			struct range range = { .start = reader.cur,
+					       .end = reader.cur + (footer.indexOffset - sizeof (kdb_unsigned_long_long_t)),
+					       .offset = sizeof (kdb_unsigned_long_long_t),
+					       .file = NULL };
+			result = readVersion4 (&range, keys, parentKey);
+		}
+	}
 
-	// we assume all keys in returned are below parentKey
-	size_t parentOffset = keyGetNameSize (parentKey);
+	if (result == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	{
+		ksBuilderFinish (keys);
+		ksAppend (returned, keys);
+	}
+	ksDel (keys);
 
-	// ... unless /noparent is in config, then we just take the full
-	// (cascading) keynames as relative to the parentKey
-	KeySet * config = elektraPluginGetConfig (handle);
-	if (ksLookupByName (config, "/noparent", 0) != NULL)
+	return result;
+}
+
+/**
+ * Compares the unescaped @p name of a key with the unescaped name of a @p subtree.
+ *
+ * @retval <0 if the key is sorted before the subtree
+ * @retval 0 if the key is inside of the subtree
+ * @retval >0 if the key is sorted after the subtree
+ */
+static int compareSubtree (const char * name, size_t nameSize, const char * subtree, size_t subtreeSize)
+{
+	int ret = memcmp (name, subtree, nameSize < subtreeSize ? nameSize : subtreeSize);
+	if (ret != 0)
 	{
-		parentOffset = 1;
+		return ret;
 	}
+	return nameSize < subtreeSize ? -1 : 0;
+}
 
-	Key * cur;
-	while ((cur = ksNext (returned)) != NULL)
+/**
+ * Reads the index entry @p i and compares its name with @p subtree.
+ *
+ * @retval false on error
+ */
+static bool compareIndexEntry (FILE * file, const struct footer * footer, kdb_unsigned_long_long_t i, const char * subtree,
+			       size_t subtreeSize, struct stringbuffer * nameBuffer, int * cmp, Key * errorKey)
+{
+	// the name ends where the name of the next entry starts
+	kdb_unsigned_long_long_t entries[4];
+	size_t entriesSize = i + 1 < footer->count ? 4 : 2;
+	if (fseek (file, footer->entriesOffset + i * INDEX_ENTRY_SIZE, SEEK_SET) != 0 ||
+	    fread (entries, sizeof (kdb_unsigned_long_long_t), entriesSize, file) < entriesSize)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (errorKey, "Could not read index");
+		return false;
+	}
+
+	kdb_unsigned_long_long_t nameOffset = le64toh (entries[1]);
+	kdb_unsigned_long_long_t nameEnd = i + 1 < footer->count ? le64toh (entries[3]) : footer->entriesOffset;
+
+	if (nameOffset < footer->indexOffset || nameOffset > nameEnd || nameEnd > footer->entriesOffset)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, "Invalid index at the end of the file");
+		return false;
+	}
+
+	size_t nameSize = nameEnd - nameOffset;
+	ensureBufferSize (nameBuffer, nameSize + 1);
+	if (fseek (file, nameOffset, SEEK_SET) != 0 || fread (nameBuffer->string, sizeof (char), nameSize, file) < nameSize)
 	{
-		size_t fullNameSize = keyGetNameSize (cur);
-		if (fullNameSize < parentOffset)
+		ELEKTRA_SET_RESOURCE_ERROR (errorKey, "Could not read index");
+		return false;
+	}
+
+	*cmp = compareSubtree (nameBuffer->string, nameSize, subtree, subtreeSize);
+	return true;
+}
+
+/**
+ * Binary search for the first index entry, which is not sorted before the subtree (@p inside true)
+ * or which is sorted after the subtree (@p inside false).
+ */
+static bool findIndexEntry (FILE * file, const struct footer * footer, const char * subtree, size_t subtreeSize, bool inside,
+			    struct stringbuffer * nameBuffer, kdb_unsigned_long_long_t * result, Key * errorKey)
+{
+	kdb_unsigned_long_long_t left = 0;
+	kdb_unsigned_long_long_t right = footer->count;
+	while (left < right)
+	{
+		kdb_unsigned_long_long_t middle = left + (right - left) / 2;
+		int cmp;
+		if (!compareIndexEntry (file, footer, middle, subtree, subtreeSize, nameBuffer, &cmp, errorKey))
+		{
+			return false;
+		}
+
+		if (cmp < 0 || (!inside && cmp == 0))
+		{
+			left = middle + 1;
+		}
+		else
+		{
+			right = middle;
+		}
+	}
+	*result = left;
+	return true;
+}
+
+static bool readKeyOffset (FILE * file, const struct footer * footer, kdb_unsigned_long_long_t i, kdb_unsigned_long_long_t * offset,
+			   Key * errorKey)
+{
+	if (i == footer->count)
+	{
+		*offset = footer->indexOffset;
+		return true;
+	}
+
+	if (fseek (file, footer->entriesOffset + i * INDEX_ENTRY_SIZE, SEEK_SET) != 0 ||
+	    fread (offset, sizeof (kdb_unsigned_long_long_t), 1, file) < 1)
+	{
+		ELEKTRA_SET_RESOURCE_ERROR (errorKey, "Could not read index");
+		return false;
+	}
+	*offset = le64toh (*offset);
+
+	if (*offset < sizeof (kdb_unsigned_long_long_t) || *offset > footer->indexOffset)
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, "Invalid index at the end of the file");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Reads the keys below @p subtree (including @p subtree) from a seekable v4 @p file.
+ *
+ * Only the index entries visited by two binary searches and the keys of the subtree are read.
+ */
+static int readSubtreeVersion4 (FILE * file, const struct footer * footer, KeySet * returned, Key * parentKey, const char * subtree,
+				size_t subtreeSize)
+{
+	// the keys of the subtree are a contiguous range of the file
+	struct stringbuffer nameBuffer;
+	setupBuffer (&nameBuffer, 64);
+
+	kdb_unsigned_long_long_t first, last, start, end;
+	bool found = findIndexEntry (file, footer, subtree, subtreeSize, true, &nameBuffer, &first, parentKey) &&
+		     findIndexEntry (file, footer, subtree, subtreeSize, false, &nameBuffer, &last, parentKey) &&
+		     readKeyOffset (file, footer, first, &start, parentKey) && readKeyOffset (file, footer, last, &end, parentKey);
+	elektraFree (nameBuffer.string);
+
+	if (!found)
+	{
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	if (start >= end)
+	{
+		return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+	}
+
+	KeySet * keys = ksNewArena (0);
+	char * contents = elektraMalloc (end - start);
+	if (contents == NULL || ksArenaAdoptBuffer (keys, contents) != 1)
+	{
+		elektraFree (contents);
+		ksDel (keys);
+		ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not read file");
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	// the buffer is freed together with the arena
+	if (fseek (file, start, SEEK_SET) != 0 || fread (contents, sizeof (char), end - start, file) < end - start)
+	{
+		ksDel (keys);
+		ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not read file");
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	struct range range = { .start = contents, .end = contents + (end - start), .offset = start, .file = file };
+	int result = readVersion4 (&range, keys, parentKey);
+
+	if (result == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	{
+		ksBuilderFinish (keys);
+		ksAppend (returned, keys);
+	}
+	ksDel (keys);
+
+	return result;
+}
+
+/**
+ * @brief Reads only the keys below @p subtree (including @p subtree itself) from the file of @p parentKey.
+ *
+ * For files in the current format, which contain an index, only the part of the file
+ * containing the subtree is read. Otherwise the whole file is read and the subtree is cut out.
+ *
+ * @note kdbGet() always reads whole files, because kdbSet() would remove all keys not read.
+ * Use this function only for read-only access, e.g. via elektraInvoke.
+ *
+ * @param handle the quickdump plugin
+ * @param returned receives the keys of the subtree
+ * @param parentKey the parent key used with kdbGet(), its value is the filename
+ * @param subtree the root of the subtree, must be below or same as @p parentKey
+ *
+ * @retval #ELEKTRA_PLUGIN_STATUS_SUCCESS on success
+ * @retval #ELEKTRA_PLUGIN_STATUS_ERROR on error, an error is set on @p parentKey
+ */
+int elektraQuickdumpGetSubtree (Plugin * handle, KeySet * returned, Key * parentKey, const Key * subtree)
+{
+	const char * parentName = keyUnescapedName (parentKey);
+	size_t parentSize = keyGetUnescapedNameSize (parentKey);
+	const char * subtreeName = keyUnescapedName (subtree);
+	size_t subtreeSize = keyGetUnescapedNameSize (subtree);
+
+	if (subtreeSize < parentSize || memcmp (parentName, subtreeName, parentSize) != 0)
+	{
+		ELEKTRA_SET_INTERFACE_ERRORF (parentKey, "The subtree '%s' is not below the parent key '%s'", keyName (subtree),
+					      keyName (parentKey));
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	kdb_unsigned_long_long_t magic;
+	int status;
+	FILE * file = openFile (parentKey, &magic, &status);
+	if (file == NULL)
+	{
+		return status;
+	}
+
+	// with /noparent the names in the index are not relative to the parent key
+	bool noparent = ksLookupByName (elektraPluginGetConfig (handle), "/noparent", 0) != NULL;
+
+	struct stat st;
+	if (magic == MAGIC_NUMBER_V4 && !noparent && fstat (fileno (file), &st) == 0 && S_ISREG (st.st_mode))
+	{
+		char footerData[FOOTER_SIZE];
+		struct footer footer;
+		if (fseek (file, -(long) FOOTER_SIZE, SEEK_END) != 0 || fread (footerData, sizeof (char), FOOTER_SIZE, file) < FOOTER_SIZE ||
+		    !decodeFooter (footerData, st.st_size, &footer, parentKey))
 		{
 			fclose (file);
 			return ELEKTRA_PLUGIN_STATUS_ERROR;
 		}
 
-		kdb_unsigned_long_long_t nameSize = fullNameSize == parentOffset ? 0 : fullNameSize - 1 - parentOffset;
-		if (!writeData (file, keyName (cur) + parentOffset, nameSize, parentKey))
+		// files with keys, but without index, are handled below
+		if (footer.count > 0 || footer.indexOffset == sizeof (kdb_unsigned_long_long_t))
 		{
+			// names in the index are relative to the parent key
+			int result = readSubtreeVersion4 (file, &footer, returned, parentKey, subtreeName + parentSize, subtreeSize - parentSize);
 			fclose (file);
-			return ELEKTRA_PLUGIN_STATUS_ERROR;
+			return result;
+		}
+	}
+	fclose (file);
+
+	// old formats, pipes or files without index
+	KeySet * all = ksNew (0, KS_END);
+	int result = elektraQuickdumpGet (handle, all, parentKey);
+	if (result == ELEKTRA_PLUGIN_STATUS_SUCCESS)
+	{
+		KeySet * cut = ksCut (all, subtree);
+		ksAppend (returned, cut);
+		ksDel (cut);
+	}
+	ksDel (all);
+	return result;
+}
+
+/**
+ * Writes @p cur in version 4 of the format, if @p indexed is true, otherwise in version 3.
+ *
+ * Version 3 writes strings without null terminator and refers to copied metakeys by the name
+ * of the key they were written with.
+ */
+static bool writeKey (FILE * file, Key * cur, size_t parentOffset, struct list * metaKeys, bool indexed, kdb_unsigned_long_long_t * offset,
+		      Key * parentKey)
+{
+	size_t fullNameSize = keyGetNameSize (cur);
+	if (fullNameSize < parentOffset)
+	{
+		ELEKTRA_SET_INTERFACE_ERRORF (parentKey, "The key '%s' is not below the parent key", keyName (cur));
+		return false;
+	}
+
+	kdb_unsigned_long_long_t nameSize = fullNameSize == parentOffset ? 0 : fullNameSize - 1 - parentOffset;
+	const char * name = keyName (cur) + parentOffset;
+	if (!(indexed ? writeString : writeData) (file, name, nameSize, offset, parentKey))
+	{
+		return false;
+	}
+
+	if (keyIsBinary (cur))
+	{
+		// binary values are written as they are, without null terminator
+		if (!writeByte (file, 'b', offset, parentKey) ||
+		    !writeData (file, keyValue (cur), keyGetValueSize (cur), offset, parentKey))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if (!writeByte (file, 's', offset, parentKey) ||
+		    !(indexed ? writeString : writeData) (file, keyString (cur), keyGetValueSize (cur) - 1, offset, parentKey))
+		{
+			return false;
 		}
+	}
 
-		if (keyIsBinary (cur))
+	keyRewindMeta (cur);
+	const Key * meta;
+	while ((meta = keyNextMeta (cur)) != NULL)
+	{
+		ssize_t result = findMetaLink (metaKeys, meta);
+		if (result < 0)
 		{
-			if (fputc ('b', file) == EOF)
+			if (!writeByte (file, 'm', offset, parentKey))
 			{
-				fclose (file);
-				return ELEKTRA_PLUGIN_STATUS_ERROR;
+				return false;
 			}
 
-			kdb_unsigned_long_long_t valueSize = keyGetValueSize (cur);
-
-			char * value = NULL;
-			if (valueSize > 0)
+			// later keys refer to the metakey by this offset
+			kdb_unsigned_long_long_t metaOffset = *offset;
+			if (!(indexed ? writeString : writeData) (file, keyName (meta), keyGetNameSize (meta) - 1, offset, parentKey) ||
+			    !(indexed ? writeString : writeData) (file, keyString (meta), keyGetValueSize (meta) - 1, offset, parentKey))
 			{
-				value = elektraMalloc (valueSize);
-				if (keyGetBinary (cur, value, valueSize) == -1)
-				{
-					fclose (file);
-					elektraFree (value);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
+				return false;
 			}
 
-			if (!writeData (file, value, valueSize, parentKey))
+			insertMetaLink (metaKeys, -result - 1, meta, metaOffset, name, nameSize);
+		}
+		else if (!indexed)
+		{
+			// refer to the metakey by the name of the key and its name
+			struct metaLink * link = metaKeys->array[result];
+			if (!writeByte (file, 'c', offset, parentKey) || !writeData (file, link->keyName, link->keyNameSize, offset, parentKey) ||
+			    !writeData (file, keyName (meta), keyGetNameSize (meta) - 1, offset, parentKey))
 			{
-				fclose (file);
-				elektraFree (value);
-				return ELEKTRA_PLUGIN_STATUS_ERROR;
+				return false;
 			}
-			elektraFree (value);
 		}
 		else
 		{
-			if (fputc ('s', file) == EOF)
+			if (!writeByte (file, 'c', offset, parentKey))
 			{
-				fclose (file);
-				return ELEKTRA_PLUGIN_STATUS_ERROR;
+				return false;
 			}
 
-			kdb_unsigned_long_long_t valueSize = keyGetValueSize (cur) - 1;
-			if (!writeData (file, keyString (cur), valueSize, parentKey))
+			size_t varintSize = varintWrite (file, metaKeys->array[result]->offset);
+			if (varintSize == 0)
 			{
-				fclose (file);
-				return ELEKTRA_PLUGIN_STATUS_ERROR;
+				ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not write file");
+				return false;
 			}
+			*offset += varintSize;
 		}
+	}
 
-		keyRewindMeta (cur);
-		const Key * meta;
-		while ((meta = keyNextMeta (cur)) != NULL)
+	return writeByte (file, 0, offset, parentKey);
+}
+
+static bool writeIndex (FILE * file, struct indexEntry * index, size_t count, kdb_unsigned_long_long_t * offset, Key * parentKey)
+{
+	kdb_unsigned_long_long_t indexOffset = *offset;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (index[i].nameSize > 0 && fwrite (index[i].name, sizeof (char), index[i].nameSize, file) < index[i].nameSize)
 		{
-			ssize_t result = findMetaLink (&metaKeys, meta);
-			if (result < 0)
-			{
-				if (fputc ('m', file) == EOF)
-				{
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
+			ELEKTRA_SET_RESOURCE_ERROR (parentKey, "Could not write file");
+			return false;
+		}
+		// from now on name offsets are stored instead of the names
+		index[i].name = NULL;
+		kdb_unsigned_long_long_t nameOffset = *offset;
+		*offset += index[i].nameSize;
+		index[i].nameSize = nameOffset;
+	}
 
-				kdb_unsigned_long_long_t metaNameSize = keyGetNameSize (meta) - 1;
-				if (!writeData (file, keyName (meta), metaNameSize, parentKey))
-				{
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
+	kdb_unsigned_long_long_t entriesOffset = *offset;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!writeUInt64 (file, htole64 (index[i].offset), offset, parentKey) ||
+		    !writeUInt64 (file, htole64 ((kdb_unsigned_long_long_t) index[i].nameSize), offset, parentKey))
+		{
+			return false;
+		}
+	}
 
-				kdb_unsigned_long_long_t metaValueSize = keyGetValueSize (meta) - 1;
-				if (!writeData (file, keyString (meta), metaValueSize, parentKey))
-				{
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
+	return writeUInt64 (file, htole64 (indexOffset), offset, parentKey) && writeUInt64 (file, htole64 (entriesOffset), offset, parentKey) &&
+	       writeUInt64 (file, htole64 ((kdb_unsigned_long_long_t) count), offset, parentKey) &&
+	       writeUInt64 (file, htobe64 (MAGIC_NUMBER_V4), offset, parentKey);
+}
 
-				insertMetaLink (&metaKeys, -result - 1, meta, cur, parentOffset);
-			}
-			else
-			{
-				if (fputc ('c', file) == EOF)
-				{
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
+int elektraQuickdumpSet (Plugin * handle, KeySet * returned, Key * parentKey)
+{
+	cursor_t cursor = ksGetCursor (returned);
+	ksRewind (returned);
 
-				kdb_unsigned_long_long_t keyNameSize = metaKeys.array[result]->keyNameSize;
-				if (!writeData (file, metaKeys.array[result]->keyName, keyNameSize, parentKey))
-				{
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
+	FILE * file;
 
-				kdb_unsigned_long_long_t metaNameSize = keyGetNameSize (meta) - 1;
-				if (!writeData (file, keyName (meta), metaNameSize, parentKey))
-				{
-					fclose (file);
-					return ELEKTRA_PLUGIN_STATUS_ERROR;
-				}
-			}
-		}
+	// cannot open stdout for writing, because its already open
+	if (elektraStrCmp (keyString (parentKey), STDOUT_FILENAME) == 0)
+	{
+		file = stdout;
+	}
+	else
+	{
+		file = fopen (keyString (parentKey), "wb");
+	}
 
-		if (fputc (0, file) == EOF)
+	if (file == NULL)
+	{
+		ELEKTRA_SET_ERROR_SET (parentKey);
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	// version 4 (with index) is only written, if /index is in config,
+	// because older versions of quickdump cannot read it
+	KeySet * config = elektraPluginGetConfig (handle);
+	bool indexed = ksLookupByName (config, "/index", 0) != NULL;
+
+	// offsets are counted, because stdout may not be seekable
+	kdb_unsigned_long_long_t offset = 0;
+
+	// magic number is written big endian so EKDB magic string is readable
+	if (!writeUInt64 (file, htobe64 (indexed ? MAGIC_NUMBER_V4 : MAGIC_NUMBER_V3), &offset, parentKey))
+	{
+		fclose (file);
+		return ELEKTRA_PLUGIN_STATUS_ERROR;
+	}
+
+	struct list metaKeys;
+	metaKeys.alloc = 16;
+	metaKeys.size = 0;
+	metaKeys.array = elektraMalloc (metaKeys.alloc * sizeof (struct metaLink *));
+
+	// we assume all keys in returned are below parentKey
+	size_t parentOffset = keyGetNameSize (parentKey);
+	size_t parentUnescapedOffset = keyGetUnescapedNameSize (parentKey);
+
+	// ... unless /noparent is in config, then we just take the full
+	// (cascading) keynames as relative to the parentKey
+	if (ksLookupByName (config, "/noparent", 0) != NULL)
+	{
+		parentOffset = 1;
+		parentUnescapedOffset = 1;
+	}
+
+	size_t count = 0;
+	struct indexEntry * index = elektraMalloc ((ksGetSize (returned) + 1) * sizeof (struct indexEntry));
+	bool sorted = true;
+	bool success = true;
+
+	Key * cur;
+	while (success && (cur = ksNext (returned)) != NULL)
+	{
+		struct indexEntry * entry = &index[count++];
+		entry->offset = offset;
+		entry->name = (const char *) keyUnescapedName (cur) + parentUnescapedOffset;
+		entry->nameSize = (size_t) keyGetUnescapedNameSize (cur) > parentUnescapedOffset ? keyGetUnescapedNameSize (cur) - parentUnescapedOffset : 0;
+
+		// the index can only be searched, if the relative names are in the same order as the keys
+		if (count > 1 && compareSubtree (entry[-1].name, entry[-1].nameSize, entry->name, entry->nameSize) >= 0)
 		{
-			fclose (file);
-			return ELEKTRA_PLUGIN_STATUS_ERROR;
+			sorted = false;
 		}
+
+		success = writeKey (file, cur, parentOffset, &metaKeys, indexed, &offset, parentKey);
 	}
 
+	success = success && (!indexed || writeIndex (file, index, sorted ? count : 0, &offset, parentKey));
+
 	for (size_t i = 0; i < metaKeys.size; ++i)
 	{
 		elektraFree (metaKeys.array[i]);
 	}
 	elektraFree (metaKeys.array);
+	elektraFree (index);
 
 	fclose (file);
 
 	ksSetCursor (returned, cursor);
 
-	return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+	return success ? ELEKTRA_PLUGIN_STATUS_SUCCESS : ELEKTRA_PLUGIN_STATUS_ERROR;
 }
 
 ssize_t findMetaLink (struct list * list, const Key * meta)
@@ -656,7 +1198,8 @@ ssize_t findMetaLink (struct list * list, const Key * meta)
 	return -insertpos - 1;
 }
 
-void insertMetaLink (struct list * list, size_t index, const Key * meta, Key * key, size_t parentOffset)
+void insertMetaLink (struct list * list, size_t index, const Key * meta, kdb_unsigned_long_long_t offset, const char * keyName,
+		     size_t keyNameSize)
 {
 	if (list->size + 1 >= list->alloc)
 	{
@@ -666,9 +1209,9 @@ void insertMetaLink (struct list * list, size_t index, const Key * meta, Key * k
 
 	struct metaLink * link = elektraMalloc (sizeof (struct metaLink));
 	link->meta = meta;
-	size_t fullNameSize = keyGetNameSize (key);
-	link->keyNameSize = fullNameSize <= parentOffset ? 0 : fullNameSize - 1 - parentOffset;
-	link->keyName = keyName (key) + parentOffset;
+	link->offset = offset;
+	link->keyName = keyName;
+	link->keyNameSize = keyNameSize;
 
 	if (index < list->size)
 	{
@@ -16,6 +16,9 @@
 int elektraQuickdumpGet (Plugin * handle, KeySet * ks, Key * parentKey);
 int elektraQuickdumpSet (Plugin * handle, KeySet * ks, Key * parentKey);
 
+int elektraQuickdumpGetSubtree (Plugin * handle, KeySet * ks, Key * parentKey, const Key * subtree);
+typedef int (*ElektraQuickdumpGetSubtree) (Plugin * handle, KeySet * ks, Key * parentKey, const Key * subtree);
+
 Plugin * ELEKTRA_PLUGIN_EXPORT;
 
 #endif
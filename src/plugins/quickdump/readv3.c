@@ -0,0 +1,213 @@
+/**
+ * @file
+ *
+ * @brief Source for quickdump plugin
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ *
+ */
+
+static inline char * readStringInPlace (struct reader * reader, size_t * sizePtr, Key * errorKey)
+{
+	kdb_unsigned_long_long_t size = 0;
+	// one more byte is needed for the null terminator, a valid file always has one
+	if (!varintRead (reader, &size) || size >= (kdb_unsigned_long_long_t) (reader->end - reader->cur))
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, "Premature end of file");
+		return NULL;
+	}
+
+	char * string = reader->cur;
+	reader->cur += size;
+
+	// terminate the string in place, the overwritten byte is returned by the next readerGetc()
+	reader->savedAt = reader->cur;
+	reader->saved = *reader->cur;
+	*reader->cur = '\0';
+
+	if (sizePtr != NULL)
+	{
+		*sizePtr = size;
+	}
+	return string;
+}
+
+static inline char * readBinary (struct reader * reader, size_t * sizePtr, Key * errorKey)
+{
+	kdb_unsigned_long_long_t size = 0;
+	if (!varintRead (reader, &size) || size > (kdb_unsigned_long_long_t) (reader->end - reader->cur))
+	{
+		ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (errorKey, "Premature end of file");
+		return NULL;
+	}
+
+	char * value = reader->cur;
+	reader->cur += size;
+	*sizePtr = size;
+	return value;
+}
+
+static inline bool readNameIntoBuffer (struct reader * reader, struct stringbuffer * buffer, Key * errorKey)
+{
+	size_t size;
+	const char * name = readStringInPlace (reader, &size, errorKey);
+	if (name == NULL)
+	{
+		return false;
+	}
+
+	ensureBufferSize (buffer, buffer->offset + size + 1);
+	memcpy (&buffer->string[buffer->offset], name, size + 1);
+	return true;
+}
+
+static int readVersion3 (struct reader * reader, KeySet * keys, Key * parentKey)
+{
+	// setup name buffer with parent key
+	struct stringbuffer nameBuffer;
+
+	size_t parentSize = keyGetNameSize (parentKey); // includes null terminator
+	setupBuffer (&nameBuffer, parentSize + 4);
+
+	keyGetName (parentKey, nameBuffer.string, parentSize);
+	nameBuffer.string[parentSize - 1] = '/'; // replaces null terminator
+	nameBuffer.string[parentSize] = '\0';    // set new null terminator
+	nameBuffer.offset = parentSize;		 // set offset to null terminator
+
+	while (reader->cur < reader->end)
+	{
+		if (!readNameIntoBuffer (reader, &nameBuffer, parentKey))
+		{
+			elektraFree (nameBuffer.string);
+			return ELEKTRA_PLUGIN_STATUS_ERROR;
+		}
+
+		int type = readerGetc (reader);
+		if (type == EOF)
+		{
+			elektraFree (nameBuffer.string);
+			ELEKTRA_SET_VALIDATION_SEMANTIC_ERROR (parentKey, "Missing key type");
+			return ELEKTRA_PLUGIN_STATUS_ERROR;
+		}
+
+		char * value;
+		size_t valueSize;
+
+		switch (type)
+		{
+		case 'b':
+			// binary key value
+			value = readBinary (reader, &valueSize, parentKey);
+			break;
+		case 's':
+			// string key value
+			value = readStringInPlace (reader, &valueSize, parentKey);
+			break;
+		default:
+			elektraFree (nameBuffer.string);
+			ELEKTRA_SET_VALIDATION_SEMANTIC_ERRORF (parentKey, "Unknown key type %c", type);
+			return ELEKTRA_PLUGIN_STATUS_ERROR;
+		}
+
+		if (value == NULL)
+		{
+			elektraFree (nameBuffer.string);
+			return ELEKTRA_PLUGIN_STATUS_ERROR;
+		}
+
+		Key * k = newKey (keys, nameBuffer.string, type == 'b', value, valueSize);
+		if (k == NULL)
+		{
+			ELEKTRA_SET_VALIDATION_SEMANTIC_ERRORF (parentKey, "Invalid key name '%s'", nameBuffer.string);
+			elektraFree (nameBuffer.string);
+			return ELEKTRA_PLUGIN_STATUS_ERROR;
+		}
+
+		int c;
+		while ((c = readerGetc (reader)) != 0)
+		{
+			if (c == EOF)
+			{
+				keyDel (k);
+				elektraFree (nameBuffer.string);
+				ELEKTRA_SET_VALIDATION_SYNTACTIC_ERROR (parentKey, "Missing key end");
+				return ELEKTRA_PLUGIN_STATUS_ERROR;
+			}
+
+			switch (c)
+			{
+			case 'm':
+			{
+				// meta key
+				const char * metaName = readStringInPlace (reader, NULL, parentKey);
+				if (metaName == NULL)
+				{
+					keyDel (k);
+					elektraFree (nameBuffer.string);
+					return ELEKTRA_PLUGIN_STATUS_ERROR;
+				}
+
+				// the terminator of the value is written behind it, so the meta name stays terminated
+				const char * metaValue = readStringInPlace (reader, NULL, parentKey);
+				if (metaValue == NULL)
+				{
+					keyDel (k);
+					elektraFree (nameBuffer.string);
+					return ELEKTRA_PLUGIN_STATUS_ERROR;
+				}
+
+				keySetMeta (k, metaName, metaValue);
+				break;
+			}
+			case 'c':
+			{
+				// copy meta
+				if (!readNameIntoBuffer (reader, &nameBuffer, parentKey))
+				{
+					keyDel (k);
+					elektraFree (nameBuffer.string);
+					return ELEKTRA_PLUGIN_STATUS_ERROR;
+				}
+
+				const char * metaName = readStringInPlace (reader, NULL, parentKey);
+				if (metaName == NULL)
+				{
+					keyDel (k);
+					elektraFree (nameBuffer.string);
+					return ELEKTRA_PLUGIN_STATUS_ERROR;
+				}
+
+				const Key * sourceKey = ksLookupByName (keys, nameBuffer.string, 0);
+				if (sourceKey == NULL)
+				{
+					ELEKTRA_SET_RESOURCE_ERRORF (parentKey, "Could not copy meta data from key '%s': Key not found",
+								     nameBuffer.string);
+					keyDel (k);
+					elektraFree (nameBuffer.string);
+					return ELEKTRA_PLUGIN_STATUS_ERROR;
+				}
+
+				if (keyCopyMeta (k, sourceKey, metaName) != 1)
+				{
+					ELEKTRA_SET_INTERNAL_ERRORF (parentKey, "Could not copy meta data from key '%s': Error during copy",
+								     &nameBuffer.string[nameBuffer.offset]);
+					keyDel (k);
+					elektraFree (nameBuffer.string);
+					return ELEKTRA_PLUGIN_STATUS_ERROR;
+				}
+				break;
+			}
+			default:
+				keyDel (k);
+				elektraFree (nameBuffer.string);
+				ELEKTRA_SET_VALIDATION_SYNTACTIC_ERRORF (parentKey, "Unknown meta type %c", c);
+				return ELEKTRA_PLUGIN_STATUS_ERROR;
+			}
+		}
+
+		ksBuilderAdd (keys, k);
+	}
+
+	elektraFree (nameBuffer.string);
+	return ELEKTRA_PLUGIN_STATUS_SUCCESS;
+}
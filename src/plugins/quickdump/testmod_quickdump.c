@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include "quickdump.h"
 #include "quickdump/test.quickdump.h"
 
 static int compare_binary_files (const char * filename1, const char * filename2)
@@ -272,6 +273,73 @@ static void test_readV2 (void)
 	ksDel (ks);
 }
 
+static void test_readV4 (void)
+{
+	printf ("test read v4 and write with and without index\n");
+
+	KeySet * ks = ksNew (0, KS_END);
+	char * infile = elektraStrDup (srcdir_file ("quickdump/test.v4.quickdump"));
+	char * infileV3 = elektraStrDup (srcdir_file ("quickdump/test.quickdump"));
+	char * outfile = elektraStrDup (srcdir_file ("quickdump/test.quickdump.out"));
+
+	{
+		Key * getKey = keyNew ("dir/tests/bench", KEY_VALUE, infile, KEY_END);
+
+		KeySet * conf = ksNew (0, KS_END);
+		PLUGIN_OPEN ("quickdump");
+
+		KeySet * expected = test_quickdump_expected ();
+
+		succeed_if (plugin->kdbGet (plugin, ks, getKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbGet was not successful");
+		compare_keyset (expected, ks);
+
+		Key * k1 = ksLookupByName (ks, "dir/tests/bench/__112", 0);
+		Key * k8 = ksLookupByName (ks, "dir/tests/bench/__911", 0);
+		succeed_if (keyGetMeta (k1, "meta/_35") == keyGetMeta (k8, "meta/_35"), "copy meta failed");
+
+		ksDel (expected);
+
+		keyDel (getKey);
+		PLUGIN_CLOSE ();
+	}
+
+	{
+		Key * setKey = keyNew ("dir/tests/bench", KEY_VALUE, outfile, KEY_END);
+
+		// without index, version 3 is written
+		KeySet * conf = ksNew (0, KS_END);
+		PLUGIN_OPEN ("quickdump");
+
+		succeed_if (plugin->kdbSet (plugin, ks, setKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbSet was not successful");
+
+		succeed_if (compare_binary_files (infileV3, outfile) == 0, "files differ");
+		remove (outfile);
+
+		keyDel (setKey);
+		PLUGIN_CLOSE ();
+	}
+
+	{
+		Key * setKey = keyNew ("dir/tests/bench", KEY_VALUE, outfile, KEY_END);
+
+		KeySet * conf = ksNew (1, keyNew ("user/index", KEY_END), KS_END);
+		PLUGIN_OPEN ("quickdump");
+
+		succeed_if (plugin->kdbSet (plugin, ks, setKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbSet was not successful");
+
+		succeed_if (compare_binary_files (infile, outfile) == 0, "files differ");
+		remove (outfile);
+
+		keyDel (setKey);
+		PLUGIN_CLOSE ();
+	}
+
+	elektraFree (infile);
+	elektraFree (infileV3);
+	elektraFree (outfile);
+	ksDel (ks);
+}
+
 static void test_parentKeyValue (void)
 {
 	printf ("test parent key value\n");
@@ -318,6 +386,133 @@ static void test_parentKeyValue (void)
 	ksDel (expected);
 }
 
+static KeySet * test_subtree_keys (void)
+{
+	Key * a = keyNew ("dir/tests/bench/a", KEY_VALUE, "a", KEY_META, "meta/shared", "x", KEY_END);
+	Key * abc = keyNew ("dir/tests/bench/a/b/c", KEY_VALUE, "abc", KEY_END);
+	keyCopyMeta (abc, a, "meta/shared");
+	Key * c = keyNew ("dir/tests/bench/c", KEY_BINARY, KEY_SIZE, 3, KEY_VALUE, "c\0c", KEY_END);
+	keyCopyMeta (c, a, "meta/shared");
+
+	return ksNew (8, keyNew ("dir/tests/bench", KEY_VALUE, "parent", KEY_END), a,
+		      keyNew ("dir/tests/bench/a/b", KEY_VALUE, "ab", KEY_META, "meta/other", "y", KEY_END), abc,
+		      keyNew ("dir/tests/bench/a\\/b", KEY_VALUE, "escaped", KEY_END), keyNew ("dir/tests/bench/ab", KEY_VALUE, "ab", KEY_END),
+		      keyNew ("dir/tests/bench/b/x", KEY_VALUE, "bx", KEY_END), c, KS_END);
+}
+
+static void test_subtree_check (Plugin * plugin, const char * filename, const char * subtreeName, ssize_t expectedSize)
+{
+	ElektraQuickdumpGetSubtree getSubtree = (ElektraQuickdumpGetSubtree) elektraPluginGetFunction (plugin, "getSubtree");
+	exit_if_fail (getSubtree != NULL, "could not get function getSubtree");
+
+	Key * parentKey = keyNew ("dir/tests/bench", KEY_VALUE, filename, KEY_END);
+	Key * subtree = keyNew (subtreeName, KEY_END);
+
+	KeySet * all = test_subtree_keys ();
+	KeySet * expected = ksCut (all, subtree);
+	ksDel (all);
+
+	KeySet * actual = ksNew (0, KS_END);
+	succeed_if (getSubtree (plugin, actual, parentKey, subtree) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to getSubtree was not successful");
+	succeed_if (ksGetSize (actual) == expectedSize, "wrong number of keys in subtree");
+	compare_keyset (expected, actual);
+
+	ksDel (actual);
+	ksDel (expected);
+	keyDel (subtree);
+	keyDel (parentKey);
+}
+
+static void test_subtree (void)
+{
+	printf ("test subtree\n");
+
+	char * outfile = elektraStrDup (srcdir_file ("quickdump/test.quickdump.out"));
+
+	{
+		Key * setKey = keyNew ("dir/tests/bench", KEY_VALUE, outfile, KEY_END);
+
+		KeySet * conf = ksNew (1, keyNew ("user/index", KEY_END), KS_END);
+		PLUGIN_OPEN ("quickdump");
+
+		KeySet * ks = test_subtree_keys ();
+		succeed_if (plugin->kdbSet (plugin, ks, setKey) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to kdbSet was not successful");
+		ksDel (ks);
+
+		keyDel (setKey);
+		PLUGIN_CLOSE ();
+	}
+
+	{
+		KeySet * conf = ksNew (0, KS_END);
+		PLUGIN_OPEN ("quickdump");
+
+		test_subtree_check (plugin, outfile, "dir/tests/bench", 8);
+		test_subtree_check (plugin, outfile, "dir/tests/bench/a", 3);
+		// meta/shared of a/b/c was written with a, outside of the subtree
+		test_subtree_check (plugin, outfile, "dir/tests/bench/a/b", 2);
+		test_subtree_check (plugin, outfile, "dir/tests/bench/a\\/b", 1);
+		// subtree without root key
+		test_subtree_check (plugin, outfile, "dir/tests/bench/b", 1);
+		test_subtree_check (plugin, outfile, "dir/tests/bench/c", 1);
+		test_subtree_check (plugin, outfile, "dir/tests/bench/d", 0);
+
+		ElektraQuickdumpGetSubtree getSubtree = (ElektraQuickdumpGetSubtree) elektraPluginGetFunction (plugin, "getSubtree");
+		Key * parentKey = keyNew ("dir/tests/bench", KEY_VALUE, outfile, KEY_END);
+
+		KeySet * actual = ksNew (0, KS_END);
+		Key * subtree = keyNew ("dir/tests/bench/a", KEY_END);
+		succeed_if (getSubtree (plugin, actual, parentKey, subtree) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to getSubtree was not successful");
+		Key * a = ksLookupByName (actual, "dir/tests/bench/a", 0);
+		Key * abc = ksLookupByName (actual, "dir/tests/bench/a/b/c", 0);
+		succeed_if (a != NULL && abc != NULL && keyGetMeta (a, "meta/shared") == keyGetMeta (abc, "meta/shared"), "copy meta failed");
+		keyDel (subtree);
+		ksDel (actual);
+
+		actual = ksNew (0, KS_END);
+		subtree = keyNew ("dir/tests/other", KEY_END);
+		succeed_if (getSubtree (plugin, actual, parentKey, subtree) == ELEKTRA_PLUGIN_STATUS_ERROR, "subtree not below parent accepted");
+		succeed_if (ksGetSize (actual) == 0, "keys returned on error");
+		keyDel (subtree);
+		ksDel (actual);
+
+		keyDel (parentKey);
+		PLUGIN_CLOSE ();
+	}
+
+	remove (outfile);
+	elektraFree (outfile);
+}
+
+static void test_subtreeV3 (void)
+{
+	printf ("test subtree v3\n");
+
+	char * infile = elektraStrDup (srcdir_file ("quickdump/test.quickdump"));
+
+	KeySet * conf = ksNew (0, KS_END);
+	PLUGIN_OPEN ("quickdump");
+
+	ElektraQuickdumpGetSubtree getSubtree = (ElektraQuickdumpGetSubtree) elektraPluginGetFunction (plugin, "getSubtree");
+	exit_if_fail (getSubtree != NULL, "could not get function getSubtree");
+
+	Key * parentKey = keyNew ("dir/tests/bench", KEY_VALUE, infile, KEY_END);
+	Key * subtree = keyNew ("dir/tests/bench/__112", KEY_END);
+
+	// files without index are read completely
+	KeySet * actual = ksNew (0, KS_END);
+	succeed_if (getSubtree (plugin, actual, parentKey, subtree) == ELEKTRA_PLUGIN_STATUS_SUCCESS, "call to getSubtree was not successful");
+	succeed_if (ksGetSize (actual) == 1, "wrong number of keys in subtree");
+	succeed_if (ksLookupByName (actual, "dir/tests/bench/__112", 0) != NULL, "subtree root missing");
+
+	ksDel (actual);
+	keyDel (subtree);
+	keyDel (parentKey);
+	PLUGIN_CLOSE ();
+
+	elektraFree (infile);
+}
+
 #include "varint.c"
 
 static void test_varint (void)
@@ -359,12 +554,26 @@ static void test_varint (void)
 		fclose (f);
 
 		f = fopen (elektraFilename (), "rb");
-		kdb_unsigned_long_long_t result = 0;
-		succeed_if (varintRead (f, &result), "read error");
+		char buffer[16];
+		size_t size = fread (buffer, sizeof (char), sizeof (buffer), f);
 		fclose (f);
 
+		struct reader reader = { .cur = buffer, .end = buffer + size, .savedAt = NULL, .saved = 0 };
+		kdb_unsigned_long_long_t result = 0;
+		succeed_if (varintRead (&reader, &result), "read error");
+		succeed_if (reader.cur == reader.end, "varint not consumed completely");
+
 		snprintf (errorBuf, sizeof (errorBuf), "conversion for %" PRIX64 " wrong, got %" PRIX64, testNumbers[i], result);
 		succeed_if (testNumbers[i] == result, errorBuf);
+
+		f = fopen (elektraFilename (), "rb");
+		result = 0;
+		succeed_if (varintReadFile (f, &result), "read error");
+		succeed_if (fgetc (f) == EOF, "varint not consumed completely");
+		fclose (f);
+
+		snprintf (errorBuf, sizeof (errorBuf), "conversion from file for %" PRIX64 " wrong, got %" PRIX64, testNumbers[i], result);
+		succeed_if (testNumbers[i] == result, errorBuf);
 	}
 }
 
@@ -381,7 +590,10 @@ int main (int argc, char ** argv)
 	test_noParent ();
 	test_readV1 ();
 	test_readV2 ();
+	test_readV4 ();
 	test_parentKeyValue ();
+	test_subtree ();
+	test_subtreeV3 ();
 
 	print_result ("testmod_quickdump");
 
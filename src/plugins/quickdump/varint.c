@@ -7,64 +7,116 @@
  *
  */
 
-static bool varintRead (FILE * file, kdb_unsigned_long_long_t * result)
+/**
+ * Decodes the current version directly from the file contents in memory.
+ *
+ * Strings are terminated in place, i.e. the byte following a string is
+ * remembered in @c saved and overwritten with a null terminator. That way
+ * names and values can be used without copying them into buffers first.
+ */
+struct reader
 {
-	kdb_octet_t varintBuf[9];
-	kdb_octet_t * varint = varintBuf;
+	char * cur;	// next byte to decode
+	char * end;	// end of the file contents
+	char * savedAt; // position of the last null terminator written in place
+	char saved;	// original byte at savedAt
+};
 
-	int c = fgetc (file);
-	if (c == EOF)
+static inline int readerGetc (struct reader * reader)
+{
+	if (reader->cur >= reader->end)
 	{
-		return -1;
+		return EOF;
 	}
 
-	varintBuf[0] = c;
+	char c = reader->cur == reader->savedAt ? reader->saved : *reader->cur;
+	++reader->cur;
+	return (unsigned char) c;
+}
 
-	unsigned int ctz = ffs (varint[0]);
-	unsigned int len, cnt, i;
+/**
+ * Decodes a varint, whose first byte @p first was already read.
+ *
+ * @param rest the remaining varintRestSize() bytes
+ */
+static inline kdb_unsigned_long_long_t varintDecode (kdb_octet_t first, const kdb_octet_t * rest)
+{
+	unsigned int ctz = ffs (first);
 	kdb_unsigned_long_long_t num;
 
 	if (ctz == 0)
 	{
-		len = 8;
-		cnt = 8;
-		i = 0;
+		num = 0;
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			num |= (kdb_unsigned_long_long_t) rest[i] << (i * 8u);
+		}
 	}
 	else
 	{
-		len = ctz;
-		cnt = len - 1;
-		i = 1;
+		num = first >> ctz;
+		for (unsigned int i = 1; i < ctz; ++i)
+		{
+			unsigned int shift = i * 8u - ctz;
+			num |= (kdb_unsigned_long_long_t) rest[i - 1] << shift;
+		}
 	}
 
+	return num;
+}
+
+/**
+ * @return the number of bytes following the first byte @p first of a varint
+ */
+static inline unsigned int varintRestSize (kdb_octet_t first)
+{
+	unsigned int ctz = ffs (first);
+	return ctz == 0 ? 8 : ctz - 1;
+}
 
-	if (fread (&varintBuf[1], sizeof (kdb_octet_t), cnt, file) < cnt)
+static bool varintRead (struct reader * reader, kdb_unsigned_long_long_t * result)
+{
+	int c = readerGetc (reader);
+	if (c == EOF)
 	{
 		return false;
 	}
 
-	if (ctz == 0)
+	unsigned int cnt = varintRestSize (c);
+	if ((size_t) (reader->end - reader->cur) < cnt)
 	{
-		varint++;
-		num = 0;
+		return false;
 	}
-	else
+
+	// all following bytes lie behind any null terminator written in place
+	*result = varintDecode (c, (const kdb_octet_t *) reader->cur);
+	reader->cur += cnt;
+	return true;
+}
+
+static bool varintReadFile (FILE * file, kdb_unsigned_long_long_t * result)
+{
+	int c = fgetc (file);
+	if (c == EOF)
 	{
-		num = varint[0] >> len;
+		return false;
 	}
 
-
-	for (; i < len; ++i)
+	kdb_octet_t rest[8];
+	unsigned int cnt = varintRestSize (c);
+	if (fread (rest, sizeof (kdb_octet_t), cnt, file) < cnt)
 	{
-		unsigned int shift = i * 8u - ctz;
-		num |= (kdb_unsigned_long_long_t) varint[i] << shift;
+		return false;
 	}
 
-	*result = num;
+	*result = varintDecode (c, rest);
 	return true;
 }
 
-static bool varintWrite (FILE * file, kdb_unsigned_long_long_t num)
+/**
+ * @return the number of bytes written, 0 on error
+ */
+static size_t varintWrite (FILE * file, kdb_unsigned_long_long_t num)
 {
 	kdb_octet_t varint[9];
 
@@ -89,5 +141,5 @@ static bool varintWrite (FILE * file, kdb_unsigned_long_long_t num)
 		num >>= 8u;
 	}
 
-	return fwrite (varint, sizeof (kdb_octet_t), len, file) == len;
+	return fwrite (varint, sizeof (kdb_octet_t), len, file) == len ? len : 0;
 }
@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -42,18 +43,34 @@
 #endif
 
 #ifdef ELEKTRA_LOCK_MUTEX
-#if defined(PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP)
-static pthread_mutex_t elektraResolverMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-#elif defined(PTHREAD_RECURSIVE_MUTEX_INITIALIZER)
-static pthread_mutex_t elektraResolverMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
-#else
-static pthread_mutex_t elektraResolverMutex;
-static pthread_mutex_t elektraResolverInitMutex = PTHREAD_MUTEX_INITIALIZER;
-static unsigned char elektraResolverMutexInitialized = 0;
-#define ELEKTRA_RESOLVER_RECURSIVE_MUTEX_INITIALIZATION
-#endif
+/** Number of buckets in the lock table, locked files are hashed onto them */
+#define ELEKTRA_RESOLVER_LOCK_SLOTS 64
+
+/**
+ * A file locked by a thread of this process.
+ *
+ * Only files between the prepare and the commit phase of kdbSet()
+ * are in the lock table, so that threads writing other files do not
+ * conflict.
+ */
+struct _ElektraResolverLock
+{
+	dev_t dev;		    ///< device of the locked file
+	ino_t ino;		    ///< inode of the locked file
+	pthread_t owner;	    ///< the thread that locked the file
+	size_t depth;		    ///< how often the owner locked the file, e.g. for several mountpoints
+	ElektraResolverLock * next; ///< next entry in the same bucket
+};
+
+static pthread_mutex_t elektraResolverLocksMutex = PTHREAD_MUTEX_INITIALIZER;
+static ElektraResolverLock * elektraResolverLocks[ELEKTRA_RESOLVER_LOCK_SLOTS];
 #endif
 
+/** Default location of the generation table, see README */
+#define ELEKTRA_RESOLVER_GENERATION_FILE "/dev/shm/elektra-generation"
+/** Number of counters in the generation table, files are hashed onto them */
+#define ELEKTRA_RESOLVER_GENERATION_SLOTS 512
+
 static void resolverInit (resolverHandle * p, const char * path)
 {
 	p->fd = -1;
@@ -73,6 +90,12 @@ static void resolverInit (resolverHandle * p, const char * path)
 
 	p->uid = 0;
 	p->gid = 0;
+
+	p->generation = NULL;
+	p->lastGeneration = 0;
+	p->generationValid = 0;
+
+	p->lock = NULL;
 }
 
 static resolverHandle * elektraGetResolverHandle (Plugin * handle, Key * parentKey)
@@ -119,9 +142,110 @@ static void resolverClose (resolverHandles * p)
 	resolverCloseOne (&p->dir);
 	resolverCloseOne (&p->user);
 	resolverCloseOne (&p->system);
+	if (p->generations)
+	{
+		munmap (p->generations, p->generationsSize);
+	}
 	elektraFree (p);
 }
 
+/**
+ * @brief Map the shared generation table
+ *
+ * The table is a file of ELEKTRA_RESOLVER_GENERATION_SLOTS counters, which is
+ * created if it does not exist. Every successful commit increments the counter
+ * of the written file.
+ *
+ * Everyone able to write the table can make others skip updates, so it is only
+ * used if it is a regular file (symlinks are not followed), owned by the current
+ * user or root and not writable by group or others.
+ *
+ * @param path the file of the table
+ *
+ * @return the mapped table
+ * @retval NULL if the table cannot be used, then stat() is used for every kdbGet()
+ */
+static kdb_unsigned_long_long_t * elektraMapGenerations (const char * path)
+{
+	size_t size = ELEKTRA_RESOLVER_GENERATION_SLOTS * sizeof (kdb_unsigned_long_long_t);
+
+	// the table must be writable, otherwise our commits would not be seen by others
+	int fd = open (path, O_RDWR | O_CREAT | O_NOFOLLOW, 0644);
+	if (fd == -1)
+	{
+		ELEKTRA_LOG_WARNING ("could not open generation table %s: %s", path, strerror (errno));
+		return NULL;
+	}
+
+	struct stat buf;
+	if (fstat (fd, &buf) == -1)
+	{
+		ELEKTRA_LOG_WARNING ("could not stat generation table %s: %s", path, strerror (errno));
+		close (fd);
+		return NULL;
+	}
+
+	if (!S_ISREG (buf.st_mode) || (buf.st_uid != geteuid () && buf.st_uid != 0) || (buf.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+	{
+		ELEKTRA_LOG_WARNING ("generation table %s is not a regular file owned by us or root and writable only by its owner", path);
+		close (fd);
+		return NULL;
+	}
+
+	if ((size_t) buf.st_size < size && ftruncate (fd, size) == -1)
+	{
+		ELEKTRA_LOG_WARNING ("could not resize generation table %s: %s", path, strerror (errno));
+		close (fd);
+		return NULL;
+	}
+
+	void * table = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+
+	if (table == MAP_FAILED)
+	{
+		ELEKTRA_LOG_WARNING ("could not map generation table %s: %s", path, strerror (errno));
+		return NULL;
+	}
+	return table;
+}
+
+/**
+ * @brief Assign the slot of the generation table to the resolved file
+ */
+static void elektraInitGeneration (resolverHandle * p, kdb_unsigned_long_long_t * table)
+{
+	if (table == NULL || p->filename == NULL)
+	{
+		return;
+	}
+
+	// FNV-1a
+	kdb_unsigned_long_long_t hash = 14695981039346656037ULL;
+	for (const char * c = p->filename; *c != '\0'; ++c)
+	{
+		hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+	}
+	p->generation = &table[hash % ELEKTRA_RESOLVER_GENERATION_SLOTS];
+}
+
+/**
+ * @brief Tell other processes that the file of @p pk changed
+ *
+ * Must be called after the file was renamed or removed.
+ */
+static void elektraBumpGeneration (resolverHandle * pk)
+{
+	if (pk->generation == NULL)
+	{
+		return;
+	}
+
+	__atomic_add_fetch (pk->generation, 1, __ATOMIC_SEQ_CST);
+	// others might have written in between, so stat() again next time
+	pk->generationValid = 0;
+}
+
 /**
  * Locks file for exclusive read/write mode.
  *
@@ -198,31 +322,83 @@ static int elektraUnlockFile (int fd ELEKTRA_UNUSED, Key * parentKey ELEKTRA_UNU
 #endif
 }
 
+#ifdef ELEKTRA_LOCK_MUTEX
+static ElektraResolverLock ** elektraLockSlot (dev_t dev, ino_t ino)
+{
+	return &elektraResolverLocks[((size_t) ino ^ ((size_t) dev << 7)) % ELEKTRA_RESOLVER_LOCK_SLOTS];
+}
+#endif
+
 /**
  * @brief mutex lock for multithread-safety
  *
+ * Locks the file opened in pk->fd in the lock table of the process.
+ * fcntl() locks do not conflict between threads of the same process,
+ * so another thread having the same file (device and inode) locked is
+ * a conflict. Files are locked recursively by the same thread.
+ *
+ * @param pk resolver information with an open file
+ * @param parentKey the key to write errors to
+ *
  * @retval 0 on success
  * @retval -1 on error
  */
-static int elektraLockMutex (Key * parentKey ELEKTRA_UNUSED)
+static int elektraLockMutex (resolverHandle * pk ELEKTRA_UNUSED, Key * parentKey ELEKTRA_UNUSED)
 {
 #ifdef ELEKTRA_LOCK_MUTEX
-	int ret = pthread_mutex_trylock (&elektraResolverMutex);
+	struct stat buf;
+	if (fstat (pk->fd, &buf) == -1)
+	{
+		ELEKTRA_SET_CONFLICTING_STATE_ERRORF (parentKey, "Assuming conflict because of failed stat of file '%s'. Reason: %s",
+						      pk->filename, strerror (errno));
+		return -1;
+	}
+
+	int ret = pthread_mutex_lock (&elektraResolverLocksMutex);
 	if (ret != 0)
 	{
-		if (errno == EBUSY       // for trylock
-		    || errno == EDEADLK) // for error checking mutex, if enabled
-		{
-			ELEKTRA_SET_CONFLICTING_STATE_ERROR (
-				parentKey, "Conflict because other thread writes to configuration indicated by mutex lock");
-		}
-		else
+		ELEKTRA_SET_CONFLICTING_STATE_ERRORF (parentKey, "Assuming conflict because of failed mutex lock. Reason: %s",
+						      strerror (ret));
+		return -1;
+	}
+
+	pthread_t self = pthread_self ();
+	ElektraResolverLock ** slot = elektraLockSlot (buf.st_dev, buf.st_ino);
+	ElektraResolverLock * lock = *slot;
+	while (lock && (lock->dev != buf.st_dev || lock->ino != buf.st_ino))
+	{
+		lock = lock->next;
+	}
+
+	if (lock && !pthread_equal (lock->owner, self))
+	{
+		pthread_mutex_unlock (&elektraResolverLocksMutex);
+		ELEKTRA_SET_CONFLICTING_STATE_ERRORF (
+			parentKey, "Conflict because other thread writes to configuration file '%s' indicated by mutex lock",
+			pk->filename);
+		return -1;
+	}
+
+	if (!lock)
+	{
+		lock = elektraMalloc (sizeof (ElektraResolverLock));
+		if (!lock)
 		{
-			ELEKTRA_SET_CONFLICTING_STATE_ERRORF (parentKey, "Assuming conflict because of failed mutex lock. Reason: %s",
-							      strerror (errno));
+			pthread_mutex_unlock (&elektraResolverLocksMutex);
+			ELEKTRA_SET_OUT_OF_MEMORY_ERROR (parentKey);
+			return -1;
 		}
-		return -1;
+		lock->dev = buf.st_dev;
+		lock->ino = buf.st_ino;
+		lock->owner = self;
+		lock->depth = 0;
+		lock->next = *slot;
+		*slot = lock;
 	}
+	++lock->depth;
+	pk->lock = lock;
+
+	pthread_mutex_unlock (&elektraResolverLocksMutex);
 	return 0;
 #else
 	return 0;
@@ -232,18 +408,38 @@ static int elektraLockMutex (Key * parentKey ELEKTRA_UNUSED)
 /**
  * @brief mutex unlock for multithread-safety
  *
+ * Removes the file locked by elektraLockMutex() from the lock table,
+ * once its owner unlocked it as often as it locked it.
+ *
  * @retval 0 on success
  * @retval -1 on error
  */
-static int elektraUnlockMutex (Key * parentKey ELEKTRA_UNUSED)
+static int elektraUnlockMutex (resolverHandle * pk ELEKTRA_UNUSED, Key * parentKey ELEKTRA_UNUSED)
 {
 #ifdef ELEKTRA_LOCK_MUTEX
-	int ret = pthread_mutex_unlock (&elektraResolverMutex);
+	ElektraResolverLock * lock = pk->lock;
+	if (!lock) return 0;
+	pk->lock = NULL;
+
+	int ret = pthread_mutex_lock (&elektraResolverLocksMutex);
 	if (ret != 0)
 	{
-		ELEKTRA_ADD_RESOURCE_WARNINGF (parentKey, "Mutex unlock failed. Reason: %s", strerror (errno));
+		ELEKTRA_ADD_RESOURCE_WARNINGF (parentKey, "Mutex unlock failed. Reason: %s", strerror (ret));
 		return -1;
 	}
+
+	if (--lock->depth == 0)
+	{
+		ElektraResolverLock ** cur = elektraLockSlot (lock->dev, lock->ino);
+		while (*cur != lock)
+		{
+			cur = &(*cur)->next;
+		}
+		*cur = lock->next;
+		elektraFree (lock);
+	}
+
+	pthread_mutex_unlock (&elektraResolverLocksMutex);
 	return 0;
 #else
 	return 0;
@@ -449,42 +645,6 @@ int ELEKTRA_PLUGIN_FUNCTION (open) (Plugin * handle, Key * errorKey)
 	resolverInit (&p->user, path);
 	resolverInit (&p->system, path);
 
-#if defined(ELEKTRA_RESOLVER_RECURSIVE_MUTEX_INITIALIZATION)
-	// PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP is available in glibc only
-	// so we use another mutex for the initialization of the recursive mutex,
-	// since this section must be thread safe.
-	pthread_mutex_lock (&elektraResolverInitMutex);
-	if (!elektraResolverMutexInitialized)
-	{
-		pthread_mutexattr_t mutexAttr;
-		int mutexError;
-
-		if ((mutexError = pthread_mutexattr_init (&mutexAttr)) != 0)
-		{
-			ELEKTRA_SET_RESOURCE_ERRORF (errorKey, "Could not initialize recursive mutex: pthread_mutexattr_init returned %d",
-						     mutexError);
-			pthread_mutex_unlock (&elektraResolverInitMutex);
-			return -1;
-		}
-		if ((mutexError = pthread_mutexattr_settype (&mutexAttr, PTHREAD_MUTEX_RECURSIVE)) != 0)
-		{
-			ELEKTRA_SET_RESOURCE_ERRORF (
-				errorKey, "Could not initialize recursive mutex: pthread_mutexattr_settype returned %d", mutexError);
-			pthread_mutex_unlock (&elektraResolverInitMutex);
-			return -1;
-		}
-		if ((mutexError = pthread_mutex_init (&elektraResolverMutex, &mutexAttr)) != 0)
-		{
-			ELEKTRA_SET_RESOURCE_ERRORF (errorKey, "Could not initialize recursive mutex: pthread_mutex_init returned %d",
-						     mutexError);
-			pthread_mutex_unlock (&elektraResolverInitMutex);
-			return -1;
-		}
-		elektraResolverMutexInitialized = 1;
-	}
-	pthread_mutex_unlock (&elektraResolverInitMutex);
-#endif
-
 	// system and spec files need to be world-readable, otherwise they are
 	// useless
 	p->system.filemode = 0644;
@@ -492,10 +652,30 @@ int ELEKTRA_PLUGIN_FUNCTION (open) (Plugin * handle, Key * errorKey)
 	p->spec.filemode = 0644;
 	p->spec.dirmode = 0755;
 
+	p->generations = NULL;
+	p->generationsSize = 0;
+
 	int ret = mapFilesForNamespaces (p, errorKey);
 
 	if (ret != -1)
 	{
+		Key * generationKey = ksLookupByName (resolverConfig, "/generation", 0);
+		if (generationKey)
+		{
+			const char * generationFile = keyGetValueSize (generationKey) > 1 ? keyString (generationKey)
+											   : ELEKTRA_RESOLVER_GENERATION_FILE;
+			kdb_unsigned_long_long_t * table = elektraMapGenerations (generationFile);
+			if (table != NULL)
+			{
+				p->generations = table;
+				p->generationsSize = ELEKTRA_RESOLVER_GENERATION_SLOTS * sizeof (kdb_unsigned_long_long_t);
+			}
+			elektraInitGeneration (&p->spec, table);
+			elektraInitGeneration (&p->dir, table);
+			elektraInitGeneration (&p->user, table);
+			elektraInitGeneration (&p->system, table);
+		}
+
 		elektraPluginSetData (handle, p);
 	}
 
@@ -534,6 +714,20 @@ int ELEKTRA_PLUGIN_FUNCTION (get) (Plugin * handle, KeySet * returned, Key * par
 	resolverHandle * pk = elektraGetResolverHandle (handle, parentKey);
 	keySetString (parentKey, pk->filename);
 
+	if (pk->generation != NULL)
+	{
+		kdb_unsigned_long_long_t generation = __atomic_load_n (pk->generation, __ATOMIC_ACQUIRE);
+		if (pk->generationValid && generation == pk->lastGeneration)
+		{
+			// nobody committed this file since we last checked it, so storage has no job
+			return 0;
+		}
+
+		// read before stat(), so that commits during the check are seen next time
+		pk->lastGeneration = generation;
+		pk->generationValid = 1;
+	}
+
 	int errnoSave = errno;
 	struct stat buf;
 
@@ -873,7 +1067,7 @@ static int elektraSetPrepare (resolverHandle * pk, Key * parentKey)
 		pk->removalNeeded = 1;
 	}
 
-	if (elektraLockMutex (parentKey) != 0)
+	if (elektraLockMutex (pk, parentKey) != 0)
 	{
 		elektraCloseFile (pk->fd, parentKey);
 		pk->fd = -1;
@@ -884,7 +1078,7 @@ static int elektraSetPrepare (resolverHandle * pk, Key * parentKey)
 	if (elektraLockFile (pk->fd, parentKey) == -1)
 	{
 		elektraCloseFile (pk->fd, parentKey);
-		elektraUnlockMutex (parentKey);
+		elektraUnlockMutex (pk, parentKey);
 		pk->fd = -1;
 		return -1;
 	}
@@ -893,7 +1087,7 @@ static int elektraSetPrepare (resolverHandle * pk, Key * parentKey)
 	{
 		elektraUnlockFile (pk->fd, parentKey);
 		elektraCloseFile (pk->fd, parentKey);
-		elektraUnlockMutex (parentKey);
+		elektraUnlockMutex (pk, parentKey);
 		pk->fd = -1;
 		return -1;
 	}
@@ -994,6 +1188,10 @@ static int elektraSetCommit (resolverHandle * pk, Key * parentKey)
 		ELEKTRA_SET_RESOURCE_ERRORF (parentKey, "Could not rename file '%s'. Reason: %s", pk->tempfile, strerror (errno));
 		ret = -1;
 	}
+	else
+	{
+		elektraBumpGeneration (pk);
+	}
 
 	ELEKTRA_LOG_DEBUG ("old.tv_sec:\t%ld", pk->mtime.tv_sec);
 	ELEKTRA_LOG_DEBUG ("old.tv_nsec:\t%ld", pk->mtime.tv_nsec);
@@ -1066,7 +1264,7 @@ static int elektraSetCommit (resolverHandle * pk, Key * parentKey)
 	elektraCloseFile (pk->fd, parentKey);
 	elektraUnlockFile (fd, parentKey);
 	elektraCloseFile (fd, parentKey);
-	elektraUnlockMutex (parentKey);
+	elektraUnlockMutex (pk, parentKey);
 
 	return ret;
 }
@@ -1119,6 +1317,10 @@ int ELEKTRA_PLUGIN_FUNCTION (set) (Plugin * handle, KeySet * ks, Key * parentKey
 			ELEKTRA_SET_RESOURCE_ERRORF (parentKey, "Could not remove file '%s'. Reason: %s", pk->filename, strerror (errno));
 			ret = -1;
 		}
+		else
+		{
+			elektraBumpGeneration (pk);
+		}
 
 		// reset for the next time
 		pk->fd = -1;
@@ -1177,7 +1379,7 @@ int ELEKTRA_PLUGIN_FUNCTION (error) (Plugin * handle, KeySet * r ELEKTRA_UNUSED,
 		{ // removal needed state (= resolver created file, but error)
 			elektraUnlinkFile (pk->filename, parentKey);
 		}
-		elektraUnlockMutex (parentKey);
+		elektraUnlockMutex (pk, parentKey);
 	}
 
 	// reset for next time
@@ -17,12 +17,14 @@
 
 #include <kdberrors.h>
 #include <kdbplugin.h>
+#include <kdbtypes.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #define ERROR_SIZE 1024
 
 typedef struct _resolverHandle resolverHandle;
+typedef struct _ElektraResolverLock ElektraResolverLock;
 
 struct _resolverHandle
 {
@@ -44,6 +46,12 @@ struct _resolverHandle
 
 	gid_t gid;
 	uid_t uid;
+
+	kdb_unsigned_long_long_t * generation;	///< slot of the file in the generation table, NULL if not used
+	kdb_unsigned_long_long_t lastGeneration; ///< value of the slot before the file was last checked
+	unsigned int generationValid : 1;	///< lastGeneration was set by kdbGet() and not invalidated by kdbSet()
+
+	ElektraResolverLock * lock; ///< entry of the file in the lock table between prepare and commit, NULL otherwise
 };
 
 typedef struct _resolverHandles resolverHandles;
@@ -54,6 +62,9 @@ struct _resolverHandles
 	resolverHandle dir;
 	resolverHandle user;
 	resolverHandle system;
+
+	void * generations;	///< mapped generation table, NULL if not used
+	size_t generationsSize; ///< size of the mapping
 };
 
 void ELEKTRA_PLUGIN_FUNCTION (freeHandle) (ElektraResolved *);
@@ -11,6 +11,12 @@
 #include <kdbinternal.h>
 
 #include <langinfo.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef ELEKTRA_LOCK_MUTEX
+#include <pthread.h>
+#endif
 
 #include "resolver.h"
 
@@ -298,6 +304,194 @@ void test_checkfile (void)
 	ksDel (modules);
 }
 
+static void test_generation (void)
+{
+	printf ("Generation Table\n");
+
+	char file[1024];
+	char table[1024];
+	snprintf (file, sizeof (file), "%s/generation.ecf", tempHome);
+	snprintf (table, sizeof (table), "%s/generation.table", tempHome);
+
+	KeySet * modules = ksNew (0, KS_END);
+	elektraModulesInit (modules, 0);
+
+	KeySet * conf = ksNew (2, keyNew ("system/path", KEY_VALUE, file, KEY_END), keyNew ("system/generation", KEY_VALUE, table, KEY_END),
+			       KS_END);
+	Plugin * reader = elektraPluginOpen ("resolver", modules, ksDup (conf), 0);
+	Plugin * writer = elektraPluginOpen ("resolver", modules, conf, 0);
+	exit_if_fail (reader && writer, "could not load resolver plugin");
+
+	resolverHandles * h = elektraPluginGetData (reader);
+	exit_if_fail (h != 0, "no plugin handle");
+	succeed_if (h->generations != NULL, "generation table not mapped");
+	succeed_if (h->system.generation != NULL, "no slot in generation table");
+
+	Key * parentKey = keyNew ("system/tests/generation", KEY_END);
+	KeySet * ks = ksNew (0, KS_END);
+
+	succeed_if (reader->kdbGet (reader, ks, parentKey) == 0, "missing file should not need update");
+
+	// changes without Elektra are not noticed
+	FILE * f = fopen (file, "w");
+	exit_if_fail (f != NULL, "could not create file");
+	fclose (f);
+	succeed_if (reader->kdbGet (reader, ks, parentKey) == 0, "generation unchanged, stat should be skipped");
+
+	// a commit of another plugin increments the generation
+	ksAppendKey (ks, keyNew ("system/tests/generation/key", KEY_END));
+	succeed_if (writer->kdbGet (writer, ks, parentKey) == 1, "writer should read existing file");
+	succeed_if (writer->kdbSet (writer, ks, parentKey) == 1, "prepare failed");
+	f = fopen (keyString (parentKey), "w");
+	exit_if_fail (f != NULL, "could not write temporary file");
+	fclose (f);
+	succeed_if (writer->kdbCommit (writer, ks, parentKey) == 1, "commit failed");
+	succeed_if (h->system.generation != NULL && *h->system.generation != h->system.lastGeneration, "generation not incremented");
+
+	succeed_if (reader->kdbGet (reader, ks, parentKey) == 1, "commit not noticed");
+	succeed_if (reader->kdbGet (reader, ks, parentKey) == 0, "generation unchanged, no update needed");
+
+	// without table the file is checked by stat
+	KeySet * noTableConf = ksNew (2, keyNew ("system/path", KEY_VALUE, file, KEY_END),
+				      keyNew ("system/generation", KEY_VALUE, "/nonexistent/generation.table", KEY_END), KS_END);
+	Plugin * fallback = elektraPluginOpen ("resolver", modules, noTableConf, 0);
+	exit_if_fail (fallback, "could not load resolver plugin");
+	h = elektraPluginGetData (fallback);
+	succeed_if (h->generations == NULL && h->system.generation == NULL, "generation table should not be available");
+	succeed_if (fallback->kdbGet (fallback, ks, parentKey) == 1, "fallback should read file");
+	succeed_if (fallback->kdbGet (fallback, ks, parentKey) == 0, "fallback should not need update");
+	elektraPluginClose (fallback, 0);
+
+	// tables writable by others are not trusted
+	char link[1024];
+	snprintf (link, sizeof (link), "%s/generation.link", tempHome);
+	succeed_if (symlink (table, link) == 0, "could not create symlink");
+	succeed_if (chmod (table, 0666) == 0, "could not change mode of table");
+	const char * untrusted[] = { table, link };
+	for (size_t i = 0; i < sizeof (untrusted) / sizeof (untrusted[0]); ++i)
+	{
+		KeySet * untrustedConf = ksNew (2, keyNew ("system/path", KEY_VALUE, file, KEY_END),
+						keyNew ("system/generation", KEY_VALUE, untrusted[i], KEY_END), KS_END);
+		Plugin * untrustedPlugin = elektraPluginOpen ("resolver", modules, untrustedConf, 0);
+		exit_if_fail (untrustedPlugin, "could not load resolver plugin");
+		h = elektraPluginGetData (untrustedPlugin);
+		succeed_if (h->generations == NULL && h->system.generation == NULL, "untrusted generation table used");
+		elektraPluginClose (untrustedPlugin, 0);
+		// a symlink to a trusted table is not followed either
+		succeed_if (chmod (table, 0600) == 0, "could not change mode of table");
+	}
+
+	keyDel (parentKey);
+	ksDel (ks);
+	elektraPluginClose (reader, 0);
+	elektraPluginClose (writer, 0);
+	elektraModulesClose (modules, 0);
+	ksDel (modules);
+
+	unlink (file);
+	unlink (link);
+	unlink (table);
+}
+
+#ifdef ELEKTRA_LOCK_MUTEX
+static Plugin * openLockPlugin (KeySet * modules, const char * file)
+{
+	return elektraPluginOpen ("resolver", modules, ksNew (1, keyNew ("system/path", KEY_VALUE, file, KEY_END), KS_END), 0);
+}
+
+static int prepareLockPlugin (Plugin * plugin, Key * parentKey)
+{
+	KeySet * ks = ksNew (1, keyNew ("system/tests/lock/key", KEY_END), KS_END);
+	plugin->kdbGet (plugin, ks, parentKey);
+	int ret = plugin->kdbSet (plugin, ks, parentKey);
+	ksDel (ks);
+	return ret;
+}
+
+static int commitLockPlugin (Plugin * plugin, Key * parentKey)
+{
+	FILE * f = fopen (keyString (parentKey), "w");
+	if (!f) return -1;
+	fclose (f);
+	KeySet * ks = ksNew (0, KS_END);
+	int ret = plugin->kdbCommit (plugin, ks, parentKey);
+	ksDel (ks);
+	return ret;
+}
+
+struct lockThreadData
+{
+	Plugin * other;
+	Plugin * same;
+	int otherPrepared;
+	int otherCommitted;
+	int sameConflicts;
+};
+
+static void * lockThread (void * arg)
+{
+	struct lockThreadData * data = arg;
+	Key * otherKey = keyNew ("system/tests/lock", KEY_END);
+	Key * sameKey = keyNew ("system/tests/lock", KEY_END);
+
+	data->otherPrepared = prepareLockPlugin (data->other, otherKey);
+	data->sameConflicts = prepareLockPlugin (data->same, sameKey) == -1 && keyGetMeta (sameKey, "error");
+	data->same->kdbError (data->same, 0, sameKey);
+	data->otherCommitted = commitLockPlugin (data->other, otherKey);
+
+	keyDel (otherKey);
+	keyDel (sameKey);
+	return 0;
+}
+
+static void test_lockTable (void)
+{
+	printf ("Lock Table\n");
+
+	char fileA[1024];
+	char fileB[1024];
+	snprintf (fileA, sizeof (fileA), "%s/lockA.ecf", tempHome);
+	snprintf (fileB, sizeof (fileB), "%s/lockB.ecf", tempHome);
+
+	KeySet * modules = ksNew (0, KS_END);
+	elektraModulesInit (modules, 0);
+	Plugin * a = openLockPlugin (modules, fileA);
+	Plugin * b = openLockPlugin (modules, fileB);
+	Plugin * sameAsA = openLockPlugin (modules, fileA);
+	exit_if_fail (a && b && sameAsA, "could not load resolver plugin");
+
+	Key * parentKey = keyNew ("system/tests/lock", KEY_END);
+	succeed_if (prepareLockPlugin (a, parentKey) == 1, "prepare failed");
+
+	// while file A is locked, another thread can write file B but not file A
+	struct lockThreadData data = { .other = b, .same = sameAsA };
+	pthread_t thread;
+	exit_if_fail (pthread_create (&thread, NULL, lockThread, &data) == 0, "could not create thread");
+	pthread_join (thread, NULL);
+	succeed_if (data.otherPrepared == 1, "writing another file should not conflict");
+	succeed_if (data.otherCommitted == 1, "commit of another file failed");
+	succeed_if (data.sameConflicts, "writing the same file should conflict");
+
+	succeed_if (commitLockPlugin (a, parentKey) == 1, "commit failed");
+
+	// after the commit the file is unlocked again
+	Key * sameKey = keyNew ("system/tests/lock", KEY_END);
+	succeed_if (prepareLockPlugin (sameAsA, sameKey) == 1, "file still locked after commit");
+	sameAsA->kdbError (sameAsA, 0, sameKey);
+	keyDel (sameKey);
+
+	keyDel (parentKey);
+	elektraPluginClose (a, 0);
+	elektraPluginClose (b, 0);
+	elektraPluginClose (sameAsA, 0);
+	elektraModulesClose (modules, 0);
+	ksDel (modules);
+
+	unlink (fileA);
+	unlink (fileB);
+}
+#endif
+
 static void check_xdg (void)
 {
 	KeySet * modules = ksNew (0, KS_END);
@@ -338,6 +532,10 @@ int main (int argc, char ** argv)
 	test_name ();
 	test_lockname ();
 	test_tempname ();
+	test_generation ();
+#ifdef ELEKTRA_LOCK_MUTEX
+	test_lockTable ();
+#endif
 
 
 	print_result ("testmod_resolver");
@@ -16,6 +16,7 @@
 #include <kdbhelper.h>
 #include <kdblogger.h>
 #include <kdbmeta.h>
+#include <kdbproposal.h>
 #include <kdbtypes.h>
 
 #include <fnmatch.h>
@@ -418,10 +419,7 @@ static void validateEmptyArray (KeySet * ks, Key * arraySpecParent, Key * parent
 		arrayParent = keyNew (keyName (parentLookup), KEY_END);
 	}
 
-	// TODO: [improvement] ksExtract?, like ksCut, but doesn't remove -> no need for ksDup
-	KeySet * ksCopy = ksDup (ks);
-	KeySet * subKeys = ksCut (ksCopy, parentLookup);
-	ksDel (ksCopy);
+	KeySet * subKeys = ksView (ks, parentLookup);
 
 	ssize_t parentLen = keyGetUnescapedNameSize (parentLookup);
 
@@ -491,10 +489,7 @@ static void validateArrayMembers (KeySet * ks, Key * arraySpec)
 		return;
 	}
 
-	// TODO: [improvement] ksExtract?, like ksCut, but doesn't remove -> no need for ksDup
-	KeySet * ksCopy = ksDup (ks);
-	KeySet * subKeys = ksCut (ksCopy, parentLookup);
-	ksDel (ksCopy);
+	KeySet * subKeys = ksView (ks, parentLookup);
 
 	ssize_t parentLen = keyGetUnescapedNameSize (parentLookup);
 
@@ -692,10 +687,7 @@ static void validateWildcardSubs (KeySet * ks, Key * key)
 	Key * parent = keyDup (key);
 	keySetBaseName (parent, NULL);
 
-	// TODO: [improvement] ksExtract?, like ksCut, but doesn't remove -> no need for ksDup
-	KeySet * ksCopy = ksDup (ks);
-	KeySet * subKeys = ksCut (ksCopy, parent);
-	ksDel (ksCopy);
+	KeySet * subKeys = ksView (ks, parent);
 
 	Key * cur;
 	while ((cur = ksNext (subKeys)) != NULL)
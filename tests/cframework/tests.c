@@ -342,20 +342,14 @@ void output_backend (Backend * backend)
 
 void output_trie (Trie * trie)
 {
-	int i;
-	for (i = 0; i < KDB_MAX_UCHAR; ++i)
+	if (trie->value)
 	{
-		if (trie->value[i])
-		{
-			printf ("output_trie: %p, mp: %s %s [%d]\n", (void *) trie->value[i], keyName (trie->value[i]->mountpoint),
-				keyString (trie->value[i]->mountpoint), i);
-		}
-		if (trie->children[i]) output_trie (trie->children[i]);
+		printf ("output_trie: %p, mp: %s %s [%s]\n", (void *) trie->value, keyName (trie->value->mountpoint),
+			keyString (trie->value->mountpoint), trie->text);
 	}
-	if (trie->empty_value)
+	for (size_t i = 0; i < trie->alloc; ++i)
 	{
-		printf ("empty_value: %p, mp: %s %s\n", (void *) trie->empty_value, keyName (trie->empty_value->mountpoint),
-			keyString (trie->empty_value->mountpoint));
+		if (trie->children[i]) output_trie (trie->children[i]);
 	}
 }
 
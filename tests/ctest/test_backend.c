@@ -250,6 +250,81 @@ static void test_backref (void)
 	ksDel (global);
 }
 
+static void test_delta (void)
+{
+	printf ("Test delta of backend\n");
+
+	Backend * backend = elektraBackendAllocate ();
+	Key * parent = keyNew ("user/tests/backend/delta", KEY_END);
+	KeySet * added = ksNew (0, KS_END);
+	KeySet * changed = ksNew (0, KS_END);
+	KeySet * removed = ksNew (0, KS_END);
+
+	KeySet * ks = ksNew (5, keyNew ("user/tests/backend/delta/a", KEY_VALUE, "a", KEY_END),
+			     keyNew ("user/tests/backend/delta/b", KEY_VALUE, "b", KEY_END),
+			     keyNew ("user/tests/backend/delta/c", KEY_VALUE, "c", KEY_END), KS_END);
+
+	backend->delta = -1;
+	backendUpdateState (backend, parent, backendStateNew (ks));
+	succeed_if (backend->userstate == 0, "state kept without setDelta");
+
+	backend->delta = 1;
+	succeed_if (backendDelta (backend, parent, ks, added, changed, removed) == 0, "delta without state");
+	backendUpdateState (backend, parent, backendStateNew (ks));
+	exit_if_fail (backend->userstate != 0, "no state kept");
+	succeed_if (ksGetSize (backend->userstate) == 3, "wrong size of state");
+	succeed_if (backend->specstate == 0 && backend->systemstate == 0 && backend->dirstate == 0, "state in wrong namespace");
+	Key * name = ksLookupByName (backend->userstate, "user/tests/backend/delta/b", 0);
+	exit_if_fail (name, "name not in state");
+	succeed_if (keyGetValueSize (name) <= 1, "value copied into state");
+
+	for (size_t i = 0; i < ks->size; ++i)
+	{
+		keyClearSync (ks->array[i]);
+	}
+	keySetString (ksLookupByName (ks, "user/tests/backend/delta/b", 0), "changed");
+	keyDel (ksLookupByName (ks, "user/tests/backend/delta/a", KDB_O_POP));
+	ksAppendKey (ks, keyNew ("user/tests/backend/delta/d", KEY_VALUE, "d", KEY_END));
+
+	KeySet * state = backendDelta (backend, parent, ks, added, changed, removed);
+	exit_if_fail (state, "no delta");
+	KeySet * expected = ksNew (1, keyNew ("user/tests/backend/delta/d", KEY_VALUE, "d", KEY_END), KS_END);
+	compare_keyset (added, expected);
+	ksDel (expected);
+	expected = ksNew (1, keyNew ("user/tests/backend/delta/b", KEY_VALUE, "changed", KEY_END), KS_END);
+	compare_keyset (changed, expected);
+	ksDel (expected);
+	expected = ksNew (1, keyNew ("user/tests/backend/delta/a", KEY_END), KS_END);
+	compare_keyset (removed, expected);
+	ksDel (expected);
+	succeed_if (ksLookupByName (added, "user/tests/backend/delta/d", 0) == ksLookupByName (ks, "user/tests/backend/delta/d", 0),
+		    "added should contain the keys to be written");
+
+	succeed_if (ksGetSize (state) == 3, "wrong size of next state");
+	succeed_if (ksLookupByName (state, "user/tests/backend/delta/a", 0) == 0, "removed key still in state");
+	succeed_if (ksLookupByName (state, "user/tests/backend/delta/d", 0) != 0, "added key not in state");
+	succeed_if (ksLookupByName (state, "user/tests/backend/delta/b", 0) == name, "unchanged names should be reused");
+
+	backendUpdateState (backend, parent, state);
+	ksDel (ks);
+	ksClear (added);
+	ksClear (changed);
+	ksClear (removed);
+
+	ks = ksDup (state);
+	succeed_if (ksGetSize (ks) == 3, "state should stay usable");
+	state = backendDelta (backend, parent, ks, added, changed, removed);
+	succeed_if (state && ksGetSize (added) == 0 && ksGetSize (changed) == 0 && ksGetSize (removed) == 0, "delta of same keys");
+	ksDel (state);
+	ksDel (ks);
+
+	ksDel (added);
+	ksDel (changed);
+	ksDel (removed);
+	keyDel (parent);
+	backendClose (backend, 0);
+}
+
 int main (int argc, char ** argv)
 {
 	printf ("  BACKEND   TESTS\n");
@@ -260,6 +335,7 @@ int main (int argc, char ** argv)
 	test_simple ();
 	test_default ();
 	test_backref ();
+	test_delta ();
 
 	printf ("\ntest_backend RESULTS: %d test(s) done. %d error(s).\n", nbTest, nbError);
 
@@ -205,6 +205,300 @@ static void test_ksNoAlloc (void)
 	ksDel (ks);
 }
 
+static void test_ksBuilder (void)
+{
+	printf ("test builder\n");
+
+	KeySet * ks = ksNew (0, KS_END);
+	Key * a = keyNew ("user/a", KEY_VALUE, "first a", KEY_END);
+	Key * c = keyNew ("user/c", KEY_END);
+	Key * b = keyNew ("user/b", KEY_END);
+	Key * a2 = keyNew ("user/a", KEY_VALUE, "second a", KEY_END);
+	Key * d = keyNew ("user/d", KEY_END);
+
+	succeed_if (ksBuilderAdd (ks, a) == 1, "wrong size");
+	succeed_if (ksBuilderAdd (ks, c) == 2, "wrong size");
+	succeed_if (!test_bit (ks->flags, KS_FLAG_UNSORTED), "sorted keys marked as unsorted");
+	succeed_if (ksBuilderAdd (ks, b) == 3, "wrong size");
+	succeed_if (test_bit (ks->flags, KS_FLAG_UNSORTED), "unsorted keys not marked");
+	succeed_if (ksBuilderAdd (ks, a2) == 4, "wrong size");
+	succeed_if (ksBuilderAdd (ks, d) == 5, "wrong size");
+	succeed_if (ksBuilderAdd (ks, d) == 5, "adding same key again should not change size");
+	succeed_if (ksBuilderAdd (ks, keyNew (0)) == -1, "key without name added");
+
+	succeed_if (ksBuilderFinish (ks) == 4, "duplicate not removed");
+	succeed_if (!test_bit (ks->flags, KS_FLAG_UNSORTED), "unsorted flag not cleared");
+	succeed_if (ks->array[0] == a2, "last added key did not win");
+	succeed_if (ks->array[1] == b, "not sorted");
+	succeed_if (ks->array[2] == c, "not sorted");
+	succeed_if (ks->array[3] == d, "not sorted");
+	succeed_if (ks->array[4] == 0, "not null terminated");
+	succeed_if (keyGetRef (d) == 1, "wrong reference counter");
+	succeed_if (ksLookupByName (ks, "user/c", 0) == c, "lookup failed");
+	succeed_if (ksBuilderFinish (ks) == 4, "finish of sorted keyset failed");
+
+	ksDel (ks);
+
+	// lookup finishes implicitly
+	ks = ksNew (0, KS_END);
+	ksBuilderAdd (ks, keyNew ("user/z", KEY_END));
+	ksBuilderAdd (ks, keyNew ("user/y", KEY_END));
+	ksBuilderAdd (ks, keyNew ("user/z", KEY_VALUE, "last", KEY_END));
+	succeed_if_same_string (keyString (ksLookupByName (ks, "user/z", 0)), "last");
+	succeed_if (ksGetSize (ks) == 2, "wrong size after implicit finish");
+	ksDel (ks);
+
+	// readers never see unsorted keys
+	ks = ksNew (0, KS_END);
+	ksBuilderAdd (ks, keyNew ("user/c", KEY_END));
+	ksBuilderAdd (ks, keyNew ("user/a", KEY_END));
+	succeed_if_same_string (keyName (ksHead (ks)), "user/a");
+	ksBuilderAdd (ks, keyNew ("user/b", KEY_END));
+	succeed_if_same_string (keyName (ksAtCursor (ks, 1)), "user/b");
+	ksBuilderAdd (ks, keyNew ("user/0", KEY_END));
+	ksRewind (ks);
+	succeed_if_same_string (keyName (ksNext (ks)), "user/0");
+	ksBuilderAdd (ks, keyNew ("user/d", KEY_END));
+	ksBuilderAdd (ks, keyNew ("user/0", KEY_VALUE, "last", KEY_END));
+	KeySet * dup = ksDup (ks);
+	succeed_if (ksGetSize (dup) == 5, "duplicate not removed before ksDup");
+	succeed_if_same_string (keyString (ksHead (dup)), "last");
+	succeed_if_same_string (keyName (ksTail (dup)), "user/d");
+	ksDel (dup);
+	ksBuilderAdd (ks, keyNew ("user/1", KEY_END));
+	dup = ksNew (0, KS_END);
+	ksAppend (dup, ks);
+	succeed_if_same_string (keyName (ksAtCursor (dup, 1)), "user/1");
+	succeed_if (!test_bit (ks->flags, KS_FLAG_UNSORTED), "source of ksAppend not finished");
+	ksDel (dup);
+	ksDel (ks);
+
+	// many keys in reverse order
+	ks = ksNew (0, KS_END);
+	KeySet * cmp = ksNew (0, KS_END);
+	for (int i = 999; i >= 0; --i)
+	{
+		char name[32];
+		snprintf (name, sizeof (name), "user/many/%03d", i);
+		ksBuilderAdd (ks, keyNew (name, KEY_END));
+		ksAppendKey (cmp, keyNew (name, KEY_END));
+	}
+	ksBuilderFinish (ks);
+	compare_keyset (ks, cmp);
+	ksDel (cmp);
+	ksDel (ks);
+}
+
+static void test_ksView (void)
+{
+	printf ("test view\n");
+
+	Key * b = keyNew ("user/view/b", KEY_END);
+	KeySet * ks = ksNew (10, keyNew ("user/a", KEY_END), keyNew ("user/view", KEY_END), keyNew ("user/view/a", KEY_END), b,
+			     keyNew ("user/view/b/c", KEY_END), keyNew ("user/viewer", KEY_END), keyNew ("user/z", KEY_END), KS_END);
+	Key * cutpoint = keyNew ("user/view", KEY_END);
+
+	ksLookupByName (ks, "user/z", 0);
+	Key * current = ksCurrent (ks);
+
+	KeySet * view = ksView (ks, cutpoint);
+	exit_if_fail (view, "could not create view");
+	succeed_if (test_bit (view->flags, KS_FLAG_VIEW), "view flag not set");
+	succeed_if (view->array == ks->array + 1, "view does not share the array");
+	succeed_if (ksGetSize (view) == 4, "wrong size of view");
+	succeed_if (ksGetSize (ks) == 7, "viewed keyset changed");
+	succeed_if (ksCurrent (ks) == current, "cursor of viewed keyset changed");
+	succeed_if (keyGetRef (b) == 1, "view must not reference keys");
+
+	Key * cur;
+	int count = 0;
+	ksRewind (view);
+	while ((cur = ksNext (view)) != 0)
+	{
+		succeed_if (keyIsBelowOrSame (cutpoint, cur) == 1, "key not below cutpoint");
+		++count;
+	}
+	succeed_if (count == 4, "iteration did not stop at the end of the view");
+	succeed_if (ksAtCursor (view, 4) == 0, "key behind the view returned");
+	succeed_if (ksLookupByName (view, "user/view/b", 0) == b, "lookup in view failed");
+	succeed_if (ksLookupByName (view, "user/viewer", 0) == 0, "found key behind the view");
+	succeed_if (ksLookupByName (view, "user/a", 0) == 0, "found key before the view");
+
+	KeySet * copy = ksDup (view);
+	succeed_if (ksGetSize (copy) == 4, "wrong size of copy");
+	succeed_if (!test_bit (copy->flags, KS_FLAG_VIEW), "copy must not be a view");
+	succeed_if (keyGetRef (b) == 2, "copy must reference keys");
+	ksDel (copy);
+
+	ksDel (view);
+	succeed_if (ksGetSize (ks) == 7, "deleting view changed keyset");
+	succeed_if (keyGetRef (b) == 1, "deleting view changed reference counter");
+	succeed_if_same_string (keyName (ksLookupByName (ks, "user/view/b/c", 0)), "user/view/b/c");
+
+	// changes promote the view to a normal keyset
+	view = ksView (ks, cutpoint);
+	succeed_if (ksAppendKey (view, keyNew ("user/view/new", KEY_END)) == 5, "could not append to view");
+	succeed_if (!test_bit (view->flags, KS_FLAG_VIEW), "changed keyset still a view");
+	succeed_if (view->array != ks->array + 1, "changed view still shares the array");
+	succeed_if (view->array[5] == 0, "promoted array not null terminated");
+	succeed_if (keyGetRef (b) == 2, "promoted view must reference keys");
+	succeed_if (ksGetSize (ks) == 7, "appending to view changed keyset");
+	succeed_if (ksLookupByName (ks, "user/view/new", 0) == 0, "key appended to view is in keyset");
+	ksDel (view);
+	succeed_if (keyGetRef (b) == 1, "wrong reference counter after deleting promoted view");
+
+	view = ksView (ks, cutpoint);
+	Key * popped = ksPop (view);
+	succeed_if_same_string (keyName (popped), "user/view/b/c");
+	succeed_if (ksGetSize (view) == 3, "wrong size after pop");
+	succeed_if (keyGetRef (popped) == 1, "popped key still referenced by keyset");
+	succeed_if (ksGetSize (ks) == 7, "pop from view changed keyset");
+	ksDel (view);
+
+	view = ksView (ks, cutpoint);
+	popped = ksLookupByName (view, "user/view/a", KDB_O_POP);
+	succeed_if_same_string (keyName (popped), "user/view/a");
+	succeed_if (ksGetSize (view) == 3, "wrong size after lookup with pop");
+	succeed_if_same_string (keyName (ksAtCursor (ks, 2)), "user/view/a");
+	succeed_if (ksGetSize (ks) == 7, "lookup with pop from view changed keyset");
+	ksDel (view);
+
+	view = ksView (ks, cutpoint);
+	KeySet * cut = ksCut (view, b);
+	succeed_if (ksGetSize (cut) == 2, "wrong size of cut");
+	succeed_if (ksGetSize (view) == 2, "wrong size of view after cut");
+	succeed_if (ksGetSize (ks) == 7, "cut from view changed keyset");
+	ksDel (cut);
+	ksDel (view);
+
+	// popping in the middle of a view must not move the keys of the viewed keyset
+	view = ksView (ks, cutpoint);
+	popped = ksLookupByName (view, "user/view/a", KDB_O_POP);
+	succeed_if_same_string (keyName (popped), "user/view/a");
+	succeed_if (ksGetSize (view) == 3, "wrong size after pop from view");
+	succeed_if (!test_bit (view->flags, KS_FLAG_VIEW), "changed keyset still a view");
+	keyDel (popped);
+	ksDel (view);
+	succeed_if (ksGetSize (ks) == 7, "pop from view changed keyset");
+	succeed_if_same_string (keyName (ksAtCursor (ks, 2)), "user/view/a");
+	succeed_if_same_string (keyName (ksLookupByName (ks, "user/view/a", 0)), "user/view/a");
+
+	// views of views and empty views
+	view = ksView (ks, cutpoint);
+	KeySet * inner = ksView (view, b);
+	succeed_if (ksGetSize (inner) == 2, "wrong size of view of view");
+	succeed_if (inner->array == ks->array + 3, "view of view does not share the array");
+	ksDel (view);
+	ksDel (inner);
+
+	Key * missing = keyNew ("user/missing", KEY_END);
+	view = ksView (ks, missing);
+	succeed_if (ksGetSize (view) == 0, "view of missing keys not empty");
+	succeed_if (ksNext (view) == 0, "empty view has keys");
+	ksDel (view);
+	keyDel (missing);
+
+	keyDel (cutpoint);
+	ksDel (ks);
+}
+
+static void test_ksViewCascading (void)
+{
+	printf ("test cascading view\n");
+
+	KeySet * ks = ksNew (10, keyNew ("/view/a", KEY_END), keyNew ("spec/view/a", KEY_END), keyNew ("dir/view/b", KEY_END),
+			     keyNew ("user/other", KEY_END), keyNew ("user/view", KEY_END), keyNew ("user/view/b", KEY_END),
+			     keyNew ("system/view/c", KEY_END), keyNew ("system/viewer", KEY_END), KS_END);
+	Key * cutpoint = keyNew ("/view", KEY_END);
+
+	KeySet * view = ksView (ks, cutpoint);
+	exit_if_fail (view, "could not create cascading view");
+	succeed_if (ksGetSize (ks) == 8, "viewed keyset changed");
+
+	KeySet * copy = ksDup (ks);
+	KeySet * cut = ksCut (copy, cutpoint);
+	compare_keyset (view, cut);
+	succeed_if (ksGetSize (view) == 6, "wrong size of cascading view");
+
+	ksDel (cut);
+	ksDel (copy);
+	ksDel (view);
+	keyDel (cutpoint);
+	ksDel (ks);
+}
+
+static void test_ksShare (void)
+{
+	printf ("test share\n");
+
+	Key * a = keyNew ("user/share/a", KEY_VALUE, "a", KEY_END);
+	Key * b = keyNew ("user/share/b", KEY_END);
+	KeySet * ks = ksNew (10, a, b, keyNew ("user/share/c", KEY_END), KS_END);
+	succeed_if (ksShare (ks) == 0, "could not share keyset");
+	succeed_if (ksShare (0) == -1, "could share null pointer");
+
+	KeySet * copy = ksDup (ks);
+	exit_if_fail (copy, "could not duplicate shared keyset");
+	succeed_if (test_bit (ks->flags, KS_FLAG_SHARED_ARRAY), "array of keyset not shared");
+	succeed_if (test_bit (copy->flags, KS_FLAG_SHARED | KS_FLAG_SHARED_ARRAY), "copy does not share the array");
+	succeed_if (copy->array == ks->array, "copy does not use the array of the keyset");
+	succeed_if (keyGetRef (a) == 1, "shared array must reference keys once");
+	succeed_if (ksGetSize (copy) == 3, "wrong size of copy");
+	succeed_if (ksLookupByName (copy, "user/share/b", 0) == b, "lookup in copy failed");
+
+	KeySet * second = ksDup (copy);
+	succeed_if (second->array == ks->array, "duplicate of copy does not share the array");
+	ksDel (second);
+	succeed_if (keyGetRef (a) == 1, "deleting a copy changed reference counter");
+
+	// changes copy the array, the other keysets stay the same
+	succeed_if (ksAppendKey (copy, keyNew ("user/share/d", KEY_END)) == 4, "could not append to copy");
+	succeed_if (!test_bit (copy->flags, KS_FLAG_SHARED_ARRAY), "changed copy still shares the array");
+	succeed_if (test_bit (copy->flags, KS_FLAG_SHARED), "changed copy lost shared mode");
+	succeed_if (copy->array != ks->array, "changed copy still uses the array");
+	succeed_if (copy->array[4] == 0, "copied array not null terminated");
+	succeed_if (keyGetRef (a) == 2, "copied array must reference keys");
+	succeed_if (ksGetSize (ks) == 3, "appending to copy changed keyset");
+	succeed_if (ksLookupByName (ks, "user/share/d", 0) == 0, "key appended to copy is in keyset");
+
+	// keys are not duplicated, as with any ksDup()
+	keySetString (ksLookupByName (copy, "user/share/a", 0), "changed");
+	succeed_if_same_string (keyString (a), "changed");
+	ksDel (copy);
+	succeed_if (keyGetRef (a) == 1, "wrong reference counter after deleting copy");
+
+	// the last keyset using the array gets it without copying the keys
+	copy = ksDup (ks);
+	Key * popped = ksLookupByName (ks, "user/share/b", KDB_O_POP);
+	succeed_if (popped == b, "could not pop key");
+	succeed_if (keyGetRef (b) == 1, "popped key still referenced by shared array");
+	succeed_if (ksGetSize (ks) == 2, "wrong size after pop");
+	succeed_if (ksLookupByName (copy, "user/share/b", 0) == b, "pop changed copy");
+	ksDel (copy); // deletes b, as it would without ksShare()
+
+	copy = ksDup (ks);
+	ksDel (ks);
+	succeed_if (keyGetRef (a) == 1, "deleting keyset released keys of copy");
+	Key * cutpoint = keyNew ("user/share/c", KEY_END);
+	KeySet * cut = ksCut (copy, cutpoint);
+	succeed_if (ksGetSize (cut) == 1, "wrong size of cut");
+	succeed_if (ksGetSize (copy) == 1, "wrong size after cut");
+	succeed_if (!test_bit (copy->flags, KS_FLAG_SHARED_ARRAY), "cut keyset still shares the array");
+	succeed_if (keyGetRef (a) == 1, "last keyset must take over the references");
+	keyDel (cutpoint);
+	ksDel (cut);
+	ksDel (copy);
+
+	// keysets without ksShare() are copied as before
+	a = keyNew ("user/share/a", KEY_END);
+	ks = ksNew (1, a, KS_END);
+	copy = ksDup (ks);
+	succeed_if (copy->array != ks->array, "keyset without ksShare() shares the array");
+	succeed_if (keyGetRef (a) == 2, "copy must reference keys");
+	ksDel (copy);
+	ksDel (ks);
+}
+
 int main (int argc, char ** argv)
 {
 	printf ("KS         TESTS\n");
@@ -218,6 +512,10 @@ int main (int argc, char ** argv)
 	test_cascadingLookup ();
 	test_creatingLookup ();
 	test_ksNoAlloc ();
+	test_ksBuilder ();
+	test_ksView ();
+	test_ksViewCascading ();
+	test_ksShare ();
 
 	printf ("\ntest_ks RESULTS: %d test(s) done. %d error(s).\n", nbTest, nbError);
 
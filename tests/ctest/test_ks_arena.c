@@ -0,0 +1,224 @@
+/**
+ * @file
+ *
+ * @brief Tests for KeySets with arena allocation
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ */
+
+#include <tests_internal.h>
+
+static void test_arenaKeyNew (void)
+{
+	printf ("test arena key new\n");
+
+	KeySet * ks = ksNewArena (0);
+	exit_if_fail (ks, "could not create arena keyset");
+	succeed_if (ks->arena != 0, "arena keyset has no arena");
+
+	Key * k = ksArenaKeyNew (ks, "user/tests/arena/key", KEY_VALUE, "value", KEY_META, "comment", "a comment", KEY_END);
+	exit_if_fail (k, "could not create arena key");
+	succeed_if (test_bit (k->flags, KEY_FLAG_ARENA), "arena flag not set");
+	succeed_if (test_bit (k->flags, KEY_FLAG_MMAP_STRUCT), "struct not marked as not freeable");
+	succeed_if (test_bit (k->flags, KEY_FLAG_MMAP_KEY), "name not inside arena");
+	succeed_if (test_bit (k->flags, KEY_FLAG_MMAP_DATA), "value not inside arena");
+	succeed_if (test_bit (k->meta->flags, KS_FLAG_MMAP_STRUCT), "meta keyset not inside arena");
+
+	succeed_if_same_string (keyName (k), "user/tests/arena/key");
+	succeed_if_same_string (keyBaseName (k), "key");
+	succeed_if_same_string (keyString (k), "value");
+	succeed_if_same_string (keyString (keyGetMeta (k, "comment")), "a comment");
+	succeed_if (test_bit (keyGetMeta (k, "comment")->flags, KEY_FLAG_INTERNED), "metakey not interned");
+
+	ksAppendKey (ks, k);
+	succeed_if (ksLookupByName (ks, "user/tests/arena/key", 0) == k, "could not lookup arena key");
+
+	// names are canonicalized in place
+	const char * names[] = { "system//tests/./arena/../arena/\\/x///", "/tests/arena", "user:owner/tests/arena", "system", "/" };
+	const char * expected[] = { "system/tests/arena/\\/x", "/tests/arena", "user/tests/arena", "system", "/" };
+	for (size_t i = 0; i < sizeof (names) / sizeof (names[0]); ++i)
+	{
+		Key * n = ksArenaKeyNew (ks, names[i], KEY_END);
+		exit_if_fail (n, "could not create arena key");
+		succeed_if (test_bit (n->flags, KEY_FLAG_MMAP_KEY), "name not inside arena");
+		succeed_if_same_string (keyName (n), expected[i]);
+		Key * heap = keyNew (names[i], KEY_END);
+		succeed_if (keyCmp (n, heap) == 0 && n->namePrefix == heap->namePrefix, "arena name differs from name on heap");
+		keyDel (heap);
+		keyDel (n);
+	}
+
+	ksDel (ks);
+}
+
+static void test_arenaModify (void)
+{
+	printf ("test modify arena keys\n");
+
+	KeySet * ks = ksNewArena (0);
+	Key * k = ksArenaKeyNew (ks, "user/tests/arena/key", KEY_VALUE, "value", KEY_END);
+	ksAppendKey (ks, k);
+
+	// values and names move out of the arena on change
+	succeed_if (keySetString (k, "a much longer value than before") > 0, "could not set value");
+	succeed_if (!test_bit (k->flags, KEY_FLAG_MMAP_DATA), "changed value still marked as inside arena");
+	succeed_if_same_string (keyString (k), "a much longer value than before");
+
+	Key * n = ksArenaKeyNew (ks, "user/tests/arena/other", KEY_END);
+	succeed_if (keyAddBaseName (n, "deeper") > 0, "could not add base name");
+	succeed_if (!test_bit (n->flags, KEY_FLAG_MMAP_KEY), "changed name still marked as inside arena");
+	succeed_if_same_string (keyName (n), "user/tests/arena/other/deeper");
+	ksAppendKey (ks, n);
+
+	succeed_if (keySetMeta (k, "order", "1") > 0, "could not set meta");
+	succeed_if (keySetMeta (k, "order", "2") > 0, "could not overwrite meta");
+	succeed_if (keySetMeta (k, "other", "3") > 0, "could not add meta");
+	succeed_if (keySetMeta (k, "other", 0) == 0, "could not remove meta");
+	succeed_if_same_string (keyString (keyGetMeta (k, "order")), "2");
+	succeed_if (keyGetMeta (k, "other") == 0, "meta not removed");
+
+	Key * c = keyNew ("user/tests/copy", KEY_END);
+	succeed_if (keyCopy (c, k) == 1, "could not copy arena key");
+	succeed_if (!test_bit (c->flags, KEY_FLAG_ARENA), "copy must not be an arena key");
+	succeed_if_same_string (keyString (keyGetMeta (c, "order")), "2");
+
+	succeed_if (keyCopy (k, c) == -1, "arena key in keyset has read only name");
+	keyDel (c);
+
+	Key * d = keyDup (k);
+	succeed_if (!test_bit (d->flags, KEY_FLAG_ARENA | KEY_FLAG_MMAP_STRUCT | KEY_FLAG_MMAP_KEY), "dup must not be inside arena");
+	succeed_if_same_string (keyName (d), "user/tests/arena/key");
+	keyDel (d);
+
+	ksDel (ks);
+}
+
+static void test_arenaOutlivesKeySet (void)
+{
+	printf ("test arena outlives keyset\n");
+
+	KeySet * arena = ksNewArena (0);
+	KeySet * ks = ksNew (0, KS_END);
+
+	for (int i = 0; i < 2000; ++i)
+	{
+		char name[64];
+		snprintf (name, sizeof (name), "user/tests/arena/#%d", i);
+		Key * k = ksArenaKeyNew (arena, name, KEY_VALUE, name, KEY_META, "meta", name, KEY_END);
+		ksAppendKey (ks, k);
+	}
+
+	// the arena stays alive as long as its keys do
+	ksDel (arena);
+
+	succeed_if (ksGetSize (ks) == 2000, "wrong size");
+	Key * found = ksLookupByName (ks, "user/tests/arena/#1999", 0);
+	exit_if_fail (found, "could not find key");
+	succeed_if_same_string (keyString (found), "user/tests/arena/#1999");
+	succeed_if_same_string (keyString (keyGetMeta (found, "meta")), "user/tests/arena/#1999");
+
+	// keys may be deleted one by one
+	Key * popped = ksLookupByName (ks, "user/tests/arena/#42", KDB_O_POP);
+	exit_if_fail (popped, "could not pop key");
+	succeed_if (keyDel (popped) == 0, "could not delete popped key");
+
+	KeySet * dup = ksDup (ks);
+	ksDel (ks);
+	compare_keyset (dup, dup);
+	succeed_if (ksGetSize (dup) == 1999, "wrong size of dup");
+
+	ksDel (dup);
+}
+
+static void test_arenaLargeValues (void)
+{
+	printf ("test large values in arena\n");
+
+	KeySet * ks = ksNewArena (0);
+	size_t size = 100 * 1024;
+	char * value = elektraMalloc (size);
+	memset (value, 'x', size - 1);
+	value[size - 1] = '\0';
+
+	Key * k = ksArenaKeyNew (ks, "user/tests/arena/large", KEY_VALUE, value, KEY_END);
+	Key * s = ksArenaKeyNew (ks, "user/tests/arena/small", KEY_VALUE, "small", KEY_END);
+	ksAppendKey (ks, k);
+	ksAppendKey (ks, s);
+
+	succeed_if (keyGetValueSize (k) == (ssize_t) size, "wrong value size");
+	succeed_if_same_string (keyString (k), value);
+	succeed_if_same_string (keyString (s), "small");
+
+	elektraFree (value);
+	ksDel (ks);
+}
+
+static void test_arenaNoArena (void)
+{
+	printf ("test arena key new without arena\n");
+
+	KeySet * ks = ksNew (0, KS_END);
+	Key * k = ksArenaKeyNew (ks, "user/tests/arena/key", KEY_VALUE, "value", KEY_END);
+	succeed_if (!test_bit (k->flags, KEY_FLAG_ARENA), "key of normal keyset must not be in an arena");
+	succeed_if_same_string (keyString (k), "value");
+	keyDel (k);
+	ksDel (ks);
+
+	ks = ksNewArena (0);
+	k = ksArenaKeyNew (ks, 0);
+	succeed_if (k != 0, "could not create empty key");
+	succeed_if (keySetName (k, "user/tests/arena/later") > 0, "could not set name");
+	succeed_if_same_string (keyName (k), "user/tests/arena/later");
+	succeed_if (keyDel (k) == 0, "could not delete key");
+	ksDel (ks);
+}
+
+static void test_arenaAdoptBuffer (void)
+{
+	printf ("test arena adopt buffer\n");
+
+	char * buffer = elektraStrDup ("buffered");
+
+	KeySet * ks = ksNew (0, KS_END);
+	succeed_if (ksArenaAdoptBuffer (ks, buffer) == -1, "keyset without arena must not adopt buffers");
+	ksDel (ks);
+
+	ks = ksNewArena (0);
+	succeed_if (ksArenaAdoptBuffer (ks, buffer) == 1, "could not adopt buffer");
+
+	Key * k = ksArenaKeyNew (ks, "user/tests/arena/buffered", KEY_END);
+	k->data.v = buffer;
+	k->dataSize = sizeof ("buffered");
+	set_bit (k->flags, KEY_FLAG_MMAP_DATA);
+	ksAppendKey (ks, k);
+
+	// the key keeps the arena and thus the buffer alive
+	keyIncRef (k);
+	ksDel (ks);
+	succeed_if_same_string (keyString (k), "buffered");
+
+	keySetString (k, "changed");
+	succeed_if (!test_bit (k->flags, KEY_FLAG_MMAP_DATA), "changed value still marked as inside buffer");
+	succeed_if_same_string (keyString (k), "changed");
+	keyDecRef (k);
+	keyDel (k);
+}
+
+int main (int argc, char ** argv)
+{
+	printf ("KS ARENA   TESTS\n");
+	printf ("==================\n\n");
+
+	init (argc, argv);
+
+	test_arenaKeyNew ();
+	test_arenaModify ();
+	test_arenaOutlivesKeySet ();
+	test_arenaLargeValues ();
+	test_arenaNoArena ();
+	test_arenaAdoptBuffer ();
+
+	printf ("\ntest_ks_arena RESULTS: %d test(s) done. %d error(s).\n", nbTest, nbError);
+
+	return nbError;
+}
@@ -209,10 +209,12 @@ void test_Invalidate (void)
 		succeed_if (opmphmIsBuild (ks->opmphm), "build opmphm");
 
 		// insert new one
-		succeed_if (ksAppendKey (ks, keyNew ("/k", KEY_END)) > 0, "invalidate");
+		succeed_if (ksAppendKey (ks, keyNew ("/k", KEY_END)) > 0, "delta");
 
 		exit_if_fail (ks->opmphm, "build opmphm");
-		succeed_if (!opmphmIsBuild (ks->opmphm), "empty opmphm");
+		succeed_if (opmphmIsBuild (ks->opmphm), "build opmphm");
+		succeed_if (ks->opmphm->delta, "delta");
+		succeed_if (ksLookupByName (ks, "/k", KDB_O_OPMPHM) == ks->array[10], "key found");
 
 		// cleanup
 		ksDel (ks);
@@ -244,10 +246,11 @@ void test_Invalidate (void)
 		exit_if_fail (ks->opmphm, "build opmphm");
 		succeed_if (opmphmIsBuild (ks->opmphm), "build opmphm");
 
-		succeed_if (ksAppend (ks, appendSuper) > 0, "invalidate");
+		succeed_if (ksAppend (ks, appendSuper) > 0, "delta");
 
 		exit_if_fail (ks->opmphm, "build opmphm");
-		succeed_if (!opmphmIsBuild (ks->opmphm), "empty opmphm");
+		succeed_if (opmphmIsBuild (ks->opmphm), "build opmphm");
+		succeed_if (ks->opmphm->delta, "delta");
 
 		// cleanup
 		ksDel (ks);
@@ -314,10 +317,11 @@ void test_Invalidate (void)
 		succeed_if (opmphmIsBuild (ks->opmphm), "build opmphm");
 
 		Key * popKey = ksPop (ks);
-		succeed_if (popKey, "invalidate");
+		succeed_if (popKey, "delta");
 
 		exit_if_fail (ks->opmphm, "build opmphm");
-		succeed_if (!opmphmIsBuild (ks->opmphm), "empty opmphm");
+		succeed_if (opmphmIsBuild (ks->opmphm), "build opmphm");
+		succeed_if (!ksLookupByName (ks, "/j", KDB_O_OPMPHM), "popped key found");
 
 		// cleanup
 		ksDel (ks);
@@ -337,10 +341,12 @@ void test_Invalidate (void)
 		succeed_if (opmphmIsBuild (ks->opmphm), "build opmphm");
 
 		Key * popKey = elektraKsPopAtCursor (ks, 1);
-		succeed_if (popKey, "invalidate");
+		succeed_if (popKey, "delta");
 
 		exit_if_fail (ks->opmphm, "build opmphm");
-		succeed_if (!opmphmIsBuild (ks->opmphm), "empty opmphm");
+		succeed_if (opmphmIsBuild (ks->opmphm), "build opmphm");
+		succeed_if (!ksLookupByName (ks, "/b", KDB_O_OPMPHM), "popped key found");
+		succeed_if (ksLookupByName (ks, "/c", KDB_O_OPMPHM) == ks->array[1], "key found");
 
 		// cleanup
 		ksDel (ks);
@@ -348,6 +354,143 @@ void test_Invalidate (void)
 	}
 }
 
+static void checkLookups (KeySet * ks, KeySet * removed)
+{
+	Key * iter;
+	for (size_t i = 0; i < (size_t) ksGetSize (ks); ++i)
+	{
+		iter = ks->array[i];
+		Key * found = ksLookup (ks, iter, KDB_O_OPMPHM);
+		succeed_if (found == iter, "key not found");
+		succeed_if (ksGetCursor (ks) == (cursor_t) i, "wrong cursor");
+	}
+	ksRewind (removed);
+	while ((iter = ksNext (removed)))
+	{
+		succeed_if (!ksLookup (ks, iter, KDB_O_OPMPHM), "removed key found");
+	}
+}
+
+void test_Delta (void)
+{
+	char name[32];
+	KeySet * ks = ksNew (0, KS_END);
+	for (int i = 0; i < 100; i += 2)
+	{
+		snprintf (name, sizeof (name), "/%03d", i);
+		ksAppendKey (ks, keyNew (name, KEY_END));
+	}
+
+	// trigger build
+	Key * found = ksLookupByName (ks, "/000", KDB_O_OPMPHM);
+	succeed_if (found, "key found");
+	exit_if_fail (opmphmIsBuild (ks->opmphm), "build opmphm");
+
+	KeySet * removed = ksNew (0, KS_END);
+	// mix of insertions in front, in between and behind and removals of both old and new keys
+	const char * changes[] = { "+001", "+051", "+099", "-002", "-051", "+003", "-010", "+005", "+007", "-000",
+				   "+009", "-098", "+097", "-003", "+011", "-050", "+050", "+013", "-013", "+015" };
+	for (size_t i = 0; i < sizeof (changes) / sizeof (changes[0]); ++i)
+	{
+		snprintf (name, sizeof (name), "/%s", changes[i] + 1);
+		if (changes[i][0] == '+')
+		{
+			ksAppendKey (ks, keyNew (name, KEY_END));
+			keyDel (ksLookupByName (removed, name, KDB_O_POP));
+		}
+		else
+		{
+			Key * r = ksLookupByName (ks, name, KDB_O_POP);
+			succeed_if (r, "key to remove not found");
+			ksAppendKey (removed, r);
+		}
+		exit_if_fail (opmphmIsBuild (ks->opmphm), "opmphm not build anymore");
+		succeed_if (ks->opmphm->delta, "no delta");
+		checkLookups (ks, removed);
+	}
+
+	// the delta is compacted once it is full
+	for (int i = 100; opmphmIsBuild (ks->opmphm); ++i)
+	{
+		succeed_if (ks->opmphm->delta->insertedSize + ks->opmphm->delta->removedSize <= OPMPHM_DELTA_MAX, "delta too large");
+		snprintf (name, sizeof (name), "/%03d", i);
+		ksAppendKey (ks, keyNew (name, KEY_END));
+	}
+	succeed_if (!ks->opmphm->delta, "delta not dropped");
+	checkLookups (ks, removed);
+	succeed_if (opmphmIsBuild (ks->opmphm), "opmphm not rebuild");
+	succeed_if (!ks->opmphm->delta, "rebuild opmphm has delta");
+
+	// copies have the same delta
+	ksAppendKey (ks, keyNew ("/zzz", KEY_END));
+	KeySet * copy = ksDup (ks);
+	exit_if_fail (copy->opmphm && copy->opmphm->delta, "delta not copied");
+	succeed_if (copy->opmphm->delta->insertedSize == 1, "wrong delta copied");
+	checkLookups (copy, removed);
+
+	ksDel (copy);
+	ksDel (removed);
+	ksDel (ks);
+}
+
+void test_Index (void)
+{
+	char name[64];
+	const size_t size = ELEKTRA_KS_INDEX_MIN_SIZE + 100;
+	KeySet * ks = ksNew (size, KS_END);
+	for (size_t i = 0; i < size; ++i)
+	{
+		// names of different length to test the prefix of the nodes
+		snprintf (name, sizeof (name), "user/tests/index/%zu/%s", i % 1000, i % 3 ? "k" : "longer/name");
+		ksAppendKey (ks, keyNew (name, KEY_END));
+		snprintf (name, sizeof (name), "user/tests/index/%zu", i);
+		ksAppendKey (ks, keyNew (name, KEY_END));
+	}
+	exit_if_fail ((size_t) ksGetSize (ks) >= size, "keys missing");
+
+	// build index
+	size_t i = 0;
+	while (!elektraKsIndexIsBuild (ks->index))
+	{
+		Key * found = ksLookup (ks, ks->array[i % ks->size], KDB_O_BINSEARCH);
+		succeed_if (found == ks->array[i % ks->size], "key not found");
+		exit_if_fail (++i < ks->size, "index not build");
+	}
+	succeed_if (ks->index->commonSize == sizeof ("user/tests/index"), "wrong common prefix");
+
+	for (i = 0; i < ks->size; ++i)
+	{
+		Key * found = ksLookup (ks, ks->array[i], KDB_O_BINSEARCH);
+		succeed_if (found == ks->array[i], "key not found");
+		succeed_if (ksGetCursor (ks) == (cursor_t) i, "wrong cursor");
+	}
+
+	const char * missing[] = { "user/tests/index",	"user/tests/index/0/a",	    "user/tests/index/0/longer",
+				   "user/tests/index/99999", "user/tests/index/999/z", "user/tests/inde",
+				   "user/tests",	     "user/tests/other/1",     "system/tests/index/1",
+				   "/tests/index/1",	     "user/tests/index/1/k/x", "user/tests/index/1/longer/name/x" };
+	for (i = 0; i < sizeof (missing) / sizeof (missing[0]); ++i)
+	{
+		Key * search = keyNew (missing[i], KEY_END);
+		succeed_if (!ksLookup (ks, search, KDB_O_BINSEARCH | KDB_O_NOCASCADING), "found key not in KeySet");
+		keyDel (search);
+	}
+
+	// changes invalidate the index
+	Key * popped = ksLookupByName (ks, "user/tests/index/42", KDB_O_BINSEARCH | KDB_O_POP);
+	succeed_if (popped && !strcmp (keyName (popped), "user/tests/index/42"), "wrong key popped");
+	succeed_if (!elektraKsIndexIsBuild (ks->index), "index not invalidated");
+	succeed_if (!ksLookupByName (ks, "user/tests/index/42", KDB_O_BINSEARCH), "popped key found");
+	ksAppendKey (ks, popped);
+	succeed_if (ksLookupByName (ks, "user/tests/index/42", KDB_O_BINSEARCH) == popped, "appended key not found");
+
+	KeySet * dup = ksDup (ks);
+	succeed_if (!dup->index, "index copied");
+	ksDel (dup);
+
+	ksDel (ks);
+}
+
 int main (int argc, char ** argv)
 {
 	printf ("KS OPMPHM      TESTS\n");
@@ -358,6 +501,8 @@ int main (int argc, char ** argv)
 	test_keyNotFound ();
 	test_Copy ();
 	test_Invalidate ();
+	test_Delta ();
+	test_Index ();
 
 	print_result ("test_ks_opmphm");
 
@@ -266,6 +266,124 @@ static void test_metaKeySet (void)
 	keyDel (key);
 }
 
+static void test_metaInterned (void)
+{
+	printf ("test interned metadata\n");
+
+	size_t interned = elektraMetaInternSize ();
+	Key * k1 = keyNew ("user/tests/interned/1", KEY_META, "type", "string", KEY_END);
+	Key * k2 = keyNew ("user/tests/interned/2", KEY_END);
+	succeed_if (keySetMeta (k2, "type", "string") == sizeof ("string"), "could not set meta");
+	succeed_if (elektraMetaInternSize () == interned + 1, "name and value should be interned once");
+
+	const Key * m1 = keyGetMeta (k1, "type");
+	const Key * m2 = keyGetMeta (k2, "type");
+	exit_if_fail (m1 && m2, "metadata not found");
+	succeed_if (m1 != m2, "metakeys must not be shared");
+	succeed_if (keyName (m1) == keyName (m2), "same name should be interned");
+	succeed_if (keyString (m1) == keyString (m2), "same value should be interned");
+	succeed_if (test_bit (m1->flags, KEY_FLAG_INTERNED), "metakey not marked as interned");
+	succeed_if (keySetString ((Key *) m1, "other") == -1, "interned metakey must be read only");
+
+	succeed_if (keySetMeta (k2, "type", "long") == sizeof ("long"), "could not set meta");
+	succeed_if_same_string (keyString (keyGetMeta (k1, "type")), "string");
+	succeed_if_same_string (keyString (keyGetMeta (k2, "type")), "long");
+
+	Key * dup = elektraMetaKeyDup (m1);
+	keyDel (k1);
+	succeed_if_same_string (keyName (dup), "type");
+	succeed_if_same_string (keyString (dup), "string");
+	keyDel (dup);
+	keyDel (k2);
+	succeed_if (elektraMetaInternSize () == interned, "unused names and values should be freed");
+
+	char * value = elektraMalloc (1000);
+	memset (value, 'x', 999);
+	value[999] = '\0';
+	k1 = keyNew ("user/tests/interned/1", KEY_META, "comment", value, KEY_END);
+	k2 = keyNew ("user/tests/interned/2", KEY_META, "comment", value, KEY_END);
+	succeed_if (!test_bit (keyGetMeta (k1, "comment")->flags, KEY_FLAG_INTERNED), "long values must not be interned");
+	succeed_if (keyGetMeta (k1, "comment") != keyGetMeta (k2, "comment"), "long values must not be shared");
+	succeed_if_same_string (keyString (keyGetMeta (k2, "comment")), value);
+	keyDel (k1);
+	keyDel (k2);
+	elektraFree (value);
+}
+
+static void test_metaShared (void)
+{
+	printf ("test shared metadata\n");
+
+	Key * key = keyNew ("user/tests/shared", KEY_META, "a", "1", KEY_META, "b", "2", KEY_END);
+	Key * dup = keyDup (key);
+	succeed_if (dup->meta == key->meta, "dup should share metadata");
+	succeed_if (key->meta->metaShares == 1, "wrong number of shares");
+	succeed_if (keyCompareMeta (key, dup) == 0, "shared metadata should be equal");
+
+	// reading keeps sharing, every key has its own cursor
+	keyRewindMeta (key);
+	keyRewindMeta (dup);
+	succeed_if_same_string (keyName (keyNextMeta (key)), "a");
+	succeed_if_same_string (keyName (keyNextMeta (key)), "b");
+	succeed_if_same_string (keyName (keyNextMeta (dup)), "a");
+	succeed_if_same_string (keyName (keyCurrentMeta (key)), "b");
+	succeed_if_same_string (keyString (keyGetMeta (key, "b")), "2");
+	succeed_if_same_string (keyName (keyCurrentMeta (dup)), "a");
+	succeed_if (keyNextMeta (key) == 0, "iteration should end");
+	succeed_if (keyCurrentMeta (key) == 0, "iteration should end");
+	keyGetMeta (key, "a");
+	succeed_if_same_string (keyName (keyNextMeta (key)), "b");
+	succeed_if_same_string (keyName (keyCurrentMeta (dup)), "a");
+	succeed_if (dup->meta == key->meta, "reading should keep sharing");
+
+	// modification unshares
+	succeed_if (keySetMeta (dup, "c", "3") == sizeof ("3"), "could not set meta");
+	succeed_if (dup->meta != key->meta, "modified metadata must not be shared anymore");
+	succeed_if (key->meta->metaShares == 0, "wrong number of shares");
+	succeed_if (keyGetRef (keyGetMeta (key, "a")) == 1, "unsharing must not reference the shared metakeys");
+	succeed_if (keyGetMeta (key, "c") == 0, "modification visible in other key");
+	succeed_if_same_string (keyString (keyGetMeta (dup, "a")), "1");
+	succeed_if (keyCompareMeta (dup, key) == KEY_META, "metadata should differ");
+
+	// removal unshares
+	Key * copy = keyNew ("user/tests/shared/copy", KEY_END);
+	succeed_if (keyCopyAllMeta (copy, key) == 1, "could not copy meta");
+	succeed_if (copy->meta == key->meta, "keyCopyAllMeta should share metadata");
+	succeed_if (keySetMeta (key, "does/not/exist", 0) == 0, "could not remove meta");
+	succeed_if (copy->meta == key->meta, "removing missing metadata should keep sharing");
+	succeed_if (keySetMeta (key, "a", 0) == 0, "could not remove meta");
+	succeed_if (keyGetMeta (key, "a") == 0, "meta not removed");
+	succeed_if_same_string (keyString (keyGetMeta (copy, "a")), "1");
+
+	// keyMeta returns a modifiable KeySet
+	keyCopyAllMeta (copy, dup);
+	succeed_if_same_string (keyString (keyGetMeta (copy, "c")), "3");
+	succeed_if (keyGetMeta (copy, "c") == keyGetMeta (dup, "c"), "keyCopyAllMeta should reference the metakeys");
+	Key * other = keyDup (copy);
+	// metakeys of shared metadata are only referenced by it, so other threads may release them
+	succeed_if (keyGetRef (keyGetMeta (copy, "c")) == 1, "shared metakey referenced by another key");
+	succeed_if (keyGetRef (keyGetMeta (dup, "c")) == 1, "shared metakey referenced by another key");
+	Key * single = keyNew ("user/tests/shared/single", KEY_END);
+	succeed_if (keyCopyMeta (single, copy, "c") == 1, "could not copy meta");
+	succeed_if (keyGetRef (keyGetMeta (copy, "c")) == 1, "shared metakey referenced by another key");
+	succeed_if_same_string (keyString (keyGetMeta (single, "c")), "3");
+	keyDel (single);
+	ksClear (keyMeta (other));
+	succeed_if (keyGetMeta (other, "a") == 0, "meta not cleared");
+	succeed_if_same_string (keyString (keyGetMeta (copy, "a")), "1");
+
+	// deleting the original keeps the metadata of the duplicate
+	Key * last = keyDup (dup);
+	keyDel (dup);
+	succeed_if_same_string (keyString (keyGetMeta (last, "c")), "3");
+	succeed_if (last->meta->metaShares == 0, "wrong number of shares");
+
+	keyDel (last);
+	keyDel (other);
+	keyDel (copy);
+	keyDel (key);
+}
+
 static void test_metaArrayToKS (void)
 {
 	Key * test = keyNew ("/a", KEY_META, "dep", "#1", KEY_META, "dep/#0", "/b", KEY_META, "dep/#1", "/c", KEY_END);
@@ -521,6 +639,8 @@ int main (int argc, char ** argv)
 	test_owner ();
 	test_mode ();
 	test_metaKeySet ();
+	test_metaInterned ();
+	test_metaShared ();
 
 	test_metaArrayToKS ();
 	test_top ();
@@ -380,6 +380,90 @@ static void test_cmp (void)
 	keyDel (k2);
 }
 
+static int unescapedCmp (const Key * k1, const Key * k2)
+{
+	size_t common = k1->keyUSize < k2->keyUSize ? k1->keyUSize : k2->keyUSize;
+	int ret = memcmp (k1->key + k1->keySize, k2->key + k2->keySize, common);
+	if (ret == 0 && k1->keyUSize != k2->keyUSize) ret = k1->keyUSize < k2->keyUSize ? -1 : 1;
+	return ret < 0 ? -1 : ret > 0;
+}
+
+static void test_cmpPrefix (void)
+{
+	printf ("Compare keys by name prefix\n");
+
+	const char * names[] = { "/",
+				 "/a",
+				 "/a/b",
+				 "/ab",
+				 "spec",
+				 "dir",
+				 "proc/x",
+				 "user",
+				 "user/a",
+				 "user/a/b",
+				 "user/ab",
+				 "user/abc",
+				 "user/abcd",
+				 "user/abc/d",
+				 "user/abcd/e",
+				 "user/tests/order/a",
+				 "user/tests/order/a/b",
+				 "user/tests/order/b",
+				 "user/tests/order/\\/x",
+				 "user/tests/order/averyveryverylongkeyname/a",
+				 "user/tests/order/averyveryverylongkeyname/b",
+				 "user/tests/order/averyveryverylongkeyname/ab",
+				 "user/tests/order/averyveryverylongkeyname/a/b",
+				 "system/tests/order/a",
+				 "system/tests/order/averyveryverylongkeyname/a",
+				 "system/tests/order/averyveryverylongkeyname" };
+	const size_t count = sizeof (names) / sizeof (names[0]);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		Key * k1 = keyNew (names[i], KEY_END);
+		for (size_t j = 0; j < count; ++j)
+		{
+			Key * k2 = keyNew (names[j], KEY_END);
+			int ret = keyCmp (k1, k2);
+			succeed_if ((ret < 0 ? -1 : ret > 0) == unescapedCmp (k1, k2), "keyCmp differs from comparing unescaped names");
+			succeed_if ((ret == 0) == (i == j), "only same names should be equal");
+			keyDel (k2);
+		}
+		keyDel (k1);
+	}
+
+	// prefix follows name changes
+	Key * k1 = keyNew ("user/tests/order/a", KEY_END);
+	Key * k2 = keyNew ("system/tests/order/a", KEY_END);
+	succeed_if (keyCmp (k1, k2) > 0, "user should be after system");
+	keySetName (k2, "user/tests/order");
+	succeed_if (keyCmp (k1, k2) > 0, "child should be after parent");
+	keyAddBaseName (k2, "b");
+	succeed_if (keyCmp (k1, k2) < 0, "a should be before b");
+	keySetBaseName (k2, "a");
+	succeed_if (keyCmp (k1, k2) == 0, "names should be same");
+	keySetName (k2, "/tests");
+	succeed_if (keyCmp (k1, k2) > 0, "cascading should be first");
+	keyCopy (k2, k1);
+	succeed_if (keyCmp (k1, k2) == 0, "copy should be same");
+	keySetName (k1, "");
+	succeed_if (k1->namePrefix == 0, "prefix not cleared");
+
+	// cascading lookup restores the name
+	KeySet * ks = ksNew (2, keyNew ("user/tests/order/a", KEY_END), keyNew ("system/tests/order/b", KEY_END), KS_END);
+	keySetName (k1, "/tests/order/b");
+	uint64_t prefix = k1->namePrefix;
+	succeed_if (ksLookup (ks, k1, 0) == ks->array[0], "cascading lookup failed");
+	succeed_if (k1->namePrefix == prefix, "prefix not restored");
+	succeed_if (keyCmp (k1, k2) < 0, "cascading should be first");
+
+	ksDel (ks);
+	keyDel (k1);
+	keyDel (k2);
+}
+
 static void test_appendowner (void)
 {
 	Key *key, *s1, *s2, *s3;
@@ -463,6 +547,7 @@ int main (int argc, char ** argv)
 	test_append ();
 	test_equal ();
 	test_cmp ();
+	test_cmpPrefix ();
 	test_appendowner ();
 	test_ksLookupOwner ();
 
@@ -496,6 +496,70 @@ static void test_three (void)
 	kdb_close (handle);
 }
 
+static void test_prepareShares (void)
+{
+	printf ("Test copy-on-write keys of prepare\n");
+
+	KDB * handle = kdb_open ();
+
+	succeed_if (mountOpen (handle, set_three (), handle->modules, 0) == 0, "could not open mountpoints");
+	succeed_if (mountDefault (handle, handle->modules, 1, 0) == 0, "could not open default backend");
+
+	KeySet * ks = ksNew (18, keyNew ("system/valid", KEY_END), keyNew ("system/valid/key1", KEY_VALUE, "value1", KEY_META, "meta", "a", KEY_END),
+			     keyNew ("system/valid/key2", KEY_VALUE, "value2", KEY_END), KS_END);
+	Key * key1 = ksLookupByName (ks, "system/valid/key1", 0);
+	Key * key2 = ksLookupByName (ks, "system/valid/key2", 0);
+
+	Split * split = splitNew ();
+	succeed_if (splitBuildup (split, handle, 0) == 1, "should need sync");
+	succeed_if (splitDivide (split, handle, ks) == 1, "should need sync");
+	splitPrepare (split);
+	succeed_if (split->size == 1, "only the system part needs to be synced");
+
+	Key * copy1 = ksLookupByName (split->keysets[0], "system/valid/key1", 0);
+	Key * copy2 = ksLookupByName (split->keysets[0], "system/valid/key2", 0);
+	exit_if_fail (copy1 && copy2, "keys are missing in the split");
+	succeed_if (copy1 != key1 && copy2 != key2, "plugins must get duplicates");
+	succeed_if (keyName (copy1) == keyName (key1), "name should be shared");
+	succeed_if (keyString (copy1) == keyString (key1), "value should be shared");
+	succeed_if (keyNeedSync (copy1), "sync flag should be taken from the key");
+
+	// a plugin only reading the metadata, e.g. to write it out
+	KeySet * keys = split->keysets[0];
+	Key * cur;
+	ksRewind (keys);
+	while ((cur = ksNext (keys)) != 0)
+	{
+		keyRewindMeta (cur);
+		while (keyNextMeta (cur) != 0)
+		{
+			succeed_if (keyString (keyGetMeta (cur, keyName (keyCurrentMeta (cur)))) != 0, "could not read metadata");
+		}
+	}
+	succeed_if (copy1->meta == key1->meta, "reading the metadata should keep it shared");
+	succeed_if (key1->meta->metaShares == 1, "wrong number of shares");
+
+	keySetString (copy1, "changed");
+	keySetMeta (copy1, "meta", "b");
+	succeed_if_same_string (keyString (copy1), "changed");
+	succeed_if_same_string (keyString (key1), "value1");
+	succeed_if_same_string (keyString (keyGetMeta (copy1, "meta")), "b");
+	succeed_if_same_string (keyString (keyGetMeta (key1, "meta")), "a");
+
+	// a plugin keeps a key beyond kdbSet()
+	keyIncRef (copy2);
+	splitDel (split);
+	succeed_if (keyName (copy2) != keyName (key2), "kept key still shares its name");
+	succeed_if (keyString (copy2) != keyString (key2), "kept key still shares its value");
+	ksDel (ks);
+	succeed_if_same_string (keyName (copy2), "system/valid/key2");
+	succeed_if_same_string (keyString (copy2), "value2");
+	keyDecRef (copy2);
+	keyDel (copy2);
+
+	kdb_close (handle);
+}
+
 static void test_userremove (void)
 {
 	printf ("Test user removing\n");
@@ -1144,6 +1208,78 @@ static void test_realworld (void)
 }
 
 
+static void test_ranges (void)
+{
+	printf ("Test dividing ranges of keys\n");
+
+	KDB * handle = kdb_open ();
+	succeed_if (mountOpen (handle, set_realworld (), handle->modules, 0) == 0, "could not open mountpoints");
+	succeed_if (mountDefault (handle, handle->modules, 1, 0) == 0, "could not open default backend");
+
+	const char * names[] = { "/cascading/key",
+				 "dir/testD",
+				 "proc/key",
+				 "spec/testS",
+				 "system/elektra/mountpoints/new",
+				 "system/elektraX",
+				 "system/groups",
+				 "system/groups/wheel",
+				 "system/hosts",
+				 "system/hosts/markusbyte",
+				 "system/hostsX",
+				 "system/users/markus",
+				 "user/outside",
+				 "user/sw/apps/app1",
+				 "user/sw/apps/app1/default",
+				 "user/sw/apps/app1/default/keys/a",
+				 "user/sw/apps/app1/defaultX",
+				 "user/sw/apps/app10/default",
+				 "user/sw/apps/app2",
+				 "user/sw/apps/app2/below/deep",
+				 "user/sw/apps/app3",
+				 "user/sw/kde/default/colors",
+				 "user/sw/kde/other",
+				 0 };
+	KeySet * ks = ksNew (0, KS_END);
+	for (size_t i = 0; names[i]; ++i)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			Key * key = keyNew (names[i], KEY_END);
+			if (k > 0) keyAddBaseName (key, k == 1 ? "a" : "z");
+			ksAppendKey (ks, key);
+		}
+	}
+
+	Split * split = splitNew ();
+	succeed_if (splitBuildup (split, handle, 0) == 1, "should need sync");
+	succeed_if (splitDivide (split, handle, ks) == 1, "should need sync");
+
+	// every key must be where a lookup of its backend would put it
+	ssize_t divided = 0;
+	for (size_t i = 0; i < split->size; ++i)
+	{
+		divided += ksGetSize (split->keysets[i]);
+	}
+
+	ssize_t relevant = 0;
+	for (cursor_t it = 0; it < ksGetSize (ks); ++it)
+	{
+		Key * key = ksAtCursor (ks, it);
+		ssize_t found = splitSearchBackend (split, mountGetBackend (handle, key), key);
+		if (found == -1) continue;
+		++relevant;
+		succeed_if (ksLookup (split->keysets[found], key, 0) == key, "key not in the split of its backend");
+	}
+	succeed_if (divided == relevant, "keys divided to wrong backends");
+	succeed_if (relevant == ksGetSize (ks) - 6, "only the cascading and proc keys are not relevant");
+
+	splitDel (split);
+	ksDel (ks);
+	kdb_close (handle);
+}
+
+
 static void test_emptysplit (void)
 {
 	printf ("Test empty split\n");
@@ -1294,10 +1430,12 @@ int main (int argc, char ** argv)
 	test_easyparent ();
 	test_optimize ();
 	test_three ();
+	test_prepareShares ();
 	test_userremove ();
 	test_systemremove ();
 	test_emptyremove ();
 	test_realworld ();
+	test_ranges ();
 	test_emptysplit ();
 	test_nothingsync ();
 	test_state ();
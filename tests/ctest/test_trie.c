@@ -94,15 +94,13 @@ static void test_simple (void)
 
 static void collect_mountpoints (Trie * trie, KeySet * mountpoints)
 {
-	int i;
-	for (i = 0; i < KDB_MAX_UCHAR; ++i)
+	if (trie->value)
 	{
-		if (trie->value[i]) ksAppendKey (mountpoints, ((Backend *) trie->value[i])->mountpoint);
-		if (trie->children[i]) collect_mountpoints (trie->children[i], mountpoints);
+		ksAppendKey (mountpoints, ((Backend *) trie->value)->mountpoint);
 	}
-	if (trie->empty_value)
+	for (size_t i = 0; i < trie->alloc; ++i)
 	{
-		ksAppendKey (mountpoints, ((Backend *) trie->empty_value)->mountpoint);
+		if (trie->children[i]) collect_mountpoints (trie->children[i], mountpoints);
 	}
 }
 
@@ -785,6 +783,48 @@ static void test_emptyvalues (void)
 	trieClose (trie, 0);
 }
 
+static void test_nodesizes (void)
+{
+	printf ("Test growing nodes in trie\n");
+
+	const char * chars = "zyxwvutsrqponmlkjihgfedcbaZYXWVUTSRQPONMLKJIHGFEDCBA9876543210";
+	const size_t count = strlen (chars);
+	char name[64];
+
+	Trie * trie = test_insert (0, "user/tests/", "root");
+	Key * searchKey = keyNew ("", KEY_END);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		snprintf (name, sizeof (name), "user/tests/%cmount/", chars[i]);
+		trie = test_insert (trie, name, name);
+
+		// every mountpoint must be found while the node grows from 4 to 256 children
+		for (size_t j = 0; j <= i; ++j)
+		{
+			snprintf (name, sizeof (name), "user/tests/%cmount/below", chars[j]);
+			keySetName (searchKey, name);
+			Backend * backend = trieLookup (trie, searchKey);
+			exit_if_fail (backend, "there should be a backend");
+			name[strlen (name) - strlen ("below")] = '\0';
+			succeed_if_same_string (keyString (backend->mountpoint), name);
+		}
+	}
+
+	keySetName (searchKey, "user/tests/_mount/below");
+	succeed_if_same_string (keyString (trieLookup (trie, searchKey)->mountpoint), "root");
+	keySetName (searchKey, "user/tests/amounts");
+	succeed_if_same_string (keyString (trieLookup (trie, searchKey)->mountpoint), "root");
+
+	KeySet * mps = ksNew (0, KS_END);
+	collect_mountpoints (trie, mps);
+	succeed_if (ksGetSize (mps) == (ssize_t) count + 1, "not all mountpoints collected");
+	ksDel (mps);
+
+	trieClose (trie, 0);
+	keyDel (searchKey);
+}
+
 
 int main (int argc, char ** argv)
 {
@@ -804,6 +844,7 @@ int main (int argc, char ** argv)
 	test_root ();
 	test_double ();
 	test_emptyvalues ();
+	test_nodesizes ();
 
 	printf ("\ntest_trie RESULTS: %d test(s) done. %d error(s).\n", nbTest, nbError);
 
@@ -0,0 +1,591 @@
+/**
+ * @file
+ *
+ * @brief Tests for threads sharing a KDB handle in concurrent mode
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ *
+ */
+
+#include <gtest/gtest-elektra.h>
+#include <kdb.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class Concurrent : public ::testing::Test
+{
+protected:
+	static const char * testRoot;
+	static const char * configFileRoot;
+	static const char * mountpoints[];
+	static const int nrKeys = 20;
+
+	testing::Namespaces namespaces;
+	std::vector<std::unique_ptr<testing::Mountpoint>> mps;
+
+	virtual void SetUp () override
+	{
+		using namespace kdb;
+
+		for (size_t i = 0; mountpoints[i]; ++i)
+		{
+			std::string mp = std::string (testRoot) + "/" + mountpoints[i];
+			mps.emplace_back (new testing::Mountpoint (mp, std::string (mountpoints[i]) + configFileRoot));
+		}
+
+		KDB kdb;
+		KeySet ks;
+		kdb.get (ks, testRoot);
+		for (size_t i = 0; mountpoints[i]; ++i)
+		{
+			for (int k = 0; k < nrKeys; ++k)
+			{
+				ks.append (Key (keyName (i, k), KEY_VALUE, "0", KEY_META, "order", std::to_string (k).c_str (), KEY_END));
+			}
+		}
+		kdb.set (ks, testRoot);
+	}
+
+	virtual void TearDown () override
+	{
+		mps.clear ();
+	}
+
+	static std::string keyName (size_t mountpoint, int k)
+	{
+		return std::string ("user") + testRoot + "/" + mountpoints[mountpoint] + "/key" + std::to_string (k);
+	}
+
+	static void ensureConcurrent (kdb::KDB & kdb, const char * value)
+	{
+		using namespace kdb;
+		KeySet contract;
+		contract.append (Key ("system/elektra/ensure/get/concurrent", KEY_VALUE, value, KEY_END));
+		Key root (testRoot, KEY_END);
+		EXPECT_EQ (kdb.ensure (contract, root), 0) << "concurrent mode could not be enabled";
+	}
+
+	static void ensureGroup (kdb::KDB & kdb, const char * window)
+	{
+		using namespace kdb;
+		KeySet contract;
+		contract.append (Key ("system/elektra/ensure/set/group", KEY_VALUE, window, KEY_END));
+		Key root (testRoot, KEY_END);
+		EXPECT_EQ (kdb.ensure (contract, root), 0) << "group commit could not be enabled";
+	}
+};
+
+const char * Concurrent::testRoot = "/tests/kdb/concurrent";
+const char * Concurrent::configFileRoot = "kdbFileConcurrent.dump";
+const char * Concurrent::mountpoints[] = { "a", "b", "c", nullptr };
+
+TEST_F (Concurrent, SameKeys)
+{
+	using namespace kdb;
+
+	KeySet single;
+	{
+		KDB kdb;
+		kdb.get (single, testRoot);
+	}
+
+	KDB kdb;
+	ensureConcurrent (kdb, "1");
+	for (int i = 0; i < 2; ++i)
+	{
+		KeySet concurrent;
+		EXPECT_EQ (kdb.get (concurrent, testRoot), 1);
+
+		ASSERT_EQ (single.size (), concurrent.size ());
+		ASSERT_EQ (concurrent.size (), 3 * nrKeys);
+		for (ssize_t k = 0; k < single.size (); ++k)
+		{
+			Key s = single.at (k);
+			Key c = concurrent.at (k);
+			EXPECT_EQ (s.getName (), c.getName ());
+			EXPECT_EQ (s.getString (), c.getString ());
+			EXPECT_EQ (s.getMeta<std::string> ("order"), c.getMeta<std::string> ("order"));
+			EXPECT_FALSE (c.needSync ()) << "keys returned by kdbGet are not changed";
+		}
+	}
+}
+
+TEST_F (Concurrent, SetPublishes)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureConcurrent (kdb, "1");
+
+	KeySet first;
+	KeySet second;
+	kdb.get (first, testRoot);
+	kdb.get (second, testRoot);
+
+	first.lookup (keyName (1, 3)).setString ("changed");
+	first.append (Key (keyName (1, nrKeys), KEY_VALUE, "new", KEY_END));
+	first.lookup (keyName (2, 5), KDB_O_POP);
+	EXPECT_EQ (kdb.set (first, testRoot), 1);
+
+	EXPECT_EQ (second.lookup (keyName (1, 3)).getString (), "0") << "other KeySets are not changed by kdbSet";
+
+	EXPECT_EQ (kdb.get (second, testRoot), 1);
+	EXPECT_EQ (second.lookup (keyName (1, 3)).getString (), "changed");
+	EXPECT_EQ (second.lookup (keyName (1, nrKeys)).getString (), "new");
+	EXPECT_FALSE (second.lookup (keyName (2, 5)));
+	EXPECT_EQ (second.size (), 3 * nrKeys);
+
+	KDB other;
+	KeySet otherKs;
+	other.get (otherKs, testRoot);
+	EXPECT_EQ (otherKs.lookup (keyName (1, 3)).getString (), "changed");
+	EXPECT_EQ (otherKs.size (), 3 * nrKeys);
+}
+
+TEST_F (Concurrent, ExternalChange)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureConcurrent (kdb, "1");
+	KeySet ks;
+	kdb.get (ks, testRoot);
+
+	{
+		KDB other;
+		KeySet otherKs;
+		other.get (otherKs, testRoot);
+		otherKs.lookup (keyName (0, 7)).setString ("external");
+		other.set (otherKs, testRoot);
+	}
+
+	kdb.get (ks, testRoot);
+	EXPECT_EQ (ks.lookup (keyName (0, 7)).getString (), "external");
+}
+
+TEST_F (Concurrent, StaleWriter)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureConcurrent (kdb, "1");
+
+	KeySet stale;
+	KeySet other;
+	kdb.get (stale, testRoot);
+	kdb.get (other, std::string (testRoot) + "/b");
+
+	std::thread writer ([&] {
+		KeySet ks;
+		Key root (std::string (testRoot) + "/a", KEY_END);
+		kdb.get (ks, root);
+		ks.lookup (keyName (0, 1)).setString ("writer");
+		EXPECT_EQ (kdb.set (ks, root), 1);
+	});
+	writer.join ();
+
+	// the keys of a changed since stale was read
+	stale.lookup (keyName (0, 2)).setString ("stale");
+	Key root (testRoot, KEY_END);
+	EXPECT_THROW (kdb.set (stale, root), KDBException);
+	EXPECT_EQ (root.getMeta<std::string> ("error/number"), "C02000");
+
+	// the keys of b did not change
+	other.lookup (keyName (1, 2)).setString ("other");
+	EXPECT_EQ (kdb.set (other, std::string (testRoot) + "/b"), 1);
+
+	// after kdbGet the changes of the other threads are kept
+	EXPECT_EQ (kdb.get (stale, testRoot), 1);
+	EXPECT_EQ (stale.lookup (keyName (0, 1)).getString (), "writer");
+	EXPECT_EQ (stale.lookup (keyName (1, 2)).getString (), "other");
+	stale.lookup (keyName (0, 2)).setString ("stale");
+	EXPECT_EQ (kdb.set (stale, testRoot), 1);
+	stale.lookup (keyName (0, 3)).setString ("again");
+	EXPECT_EQ (kdb.set (stale, testRoot), 1) << "own changes do not conflict";
+
+	KDB single;
+	KeySet singleKs;
+	single.get (singleKs, testRoot);
+	EXPECT_EQ (singleKs.lookup (keyName (0, 1)).getString (), "writer");
+	EXPECT_EQ (singleKs.lookup (keyName (0, 2)).getString (), "stale");
+	EXPECT_EQ (singleKs.lookup (keyName (0, 3)).getString (), "again");
+	EXPECT_EQ (singleKs.lookup (keyName (1, 2)).getString (), "other");
+}
+
+TEST_F (Concurrent, Threads)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureConcurrent (kdb, "1");
+
+	const int nrReaders = 4;
+	const int nrWrites = 20;
+	std::atomic<bool> done (false);
+	std::atomic<int> failures (0);
+
+	std::vector<std::thread> readers;
+	for (int t = 0; t < nrReaders; ++t)
+	{
+		readers.emplace_back ([&] {
+			int last = 0;
+			while (!done)
+			{
+				KeySet ks;
+				Key root (testRoot, KEY_END);
+				if (kdb.get (ks, root) != 1 || ks.size () != 3 * nrKeys)
+				{
+					++failures;
+					continue;
+				}
+
+				// all keys are written together, so a snapshot never mixes generations
+				int value = std::stoi (ks.lookup (keyName (0, 0)).getString ());
+				for (size_t m = 0; mountpoints[m]; ++m)
+				{
+					for (int k = 0; k < nrKeys; ++k)
+					{
+						Key key = ks.lookup (keyName (m, k));
+						if (!key || std::stoi (key.getString ()) != value || key.getMeta<int> ("order") != k)
+						{
+							++failures;
+						}
+					}
+				}
+				if (value < last) ++failures;
+				last = value;
+			}
+		});
+	}
+
+	KeySet ks;
+	kdb.get (ks, testRoot);
+	for (int i = 1; i <= nrWrites; ++i)
+	{
+		for (size_t m = 0; mountpoints[m]; ++m)
+		{
+			for (int k = 0; k < nrKeys; ++k)
+			{
+				ks.lookup (keyName (m, k)).setString (std::to_string (i));
+			}
+		}
+		EXPECT_EQ (kdb.set (ks, testRoot), 1);
+	}
+
+	done = true;
+	for (auto & reader : readers)
+	{
+		reader.join ();
+	}
+	EXPECT_EQ (failures, 0);
+
+	KeySet last;
+	kdb.get (last, testRoot);
+	EXPECT_EQ (last.lookup (keyName (2, nrKeys - 1)).getString (), std::to_string (nrWrites));
+}
+
+TEST_F (Concurrent, Contract)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	KeySet contract;
+	contract.append (Key ("system/elektra/ensure/get/concurrent", KEY_VALUE, "yes", KEY_END));
+	Key root (testRoot, KEY_END);
+	EXPECT_THROW (kdb.ensure (contract, root), KDBException);
+
+	ensureConcurrent (kdb, "1");
+	KeySet ks;
+	kdb.get (ks, testRoot);
+	ensureConcurrent (kdb, "0");
+	EXPECT_EQ (kdb.get (ks, testRoot), 0) << "the handle is used by a single thread again";
+	EXPECT_EQ (ks.size (), 3 * nrKeys);
+}
+
+TEST_F (Concurrent, GroupCommit)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureGroup (kdb, "20000");
+
+	const int nrWriters = 3;
+	const int nrWrites = 5;
+	std::atomic<int> failures (0);
+
+	std::vector<std::thread> writers;
+	for (int t = 0; t < nrWriters; ++t)
+	{
+		writers.emplace_back ([&] {
+			KeySet ks;
+			Key root (testRoot, KEY_END);
+			kdb.get (ks, root);
+			for (int i = 1; i <= nrWrites; ++i)
+			{
+				// all threads write the same keys, so a call conflicts if another one was committed since kdbGet
+				for (int attempt = 0; attempt < 100; ++attempt)
+				{
+					for (size_t m = 0; mountpoints[m]; ++m)
+					{
+						for (int k = 0; k < nrKeys; ++k)
+						{
+							ks.lookup (keyName (m, k)).setString (std::to_string (i));
+						}
+					}
+					try
+					{
+						if (kdb.set (ks, root) != 1) ++failures;
+						break;
+					}
+					catch (KDBException const &)
+					{
+						kdb.get (ks, root);
+					}
+				}
+			}
+		});
+	}
+	for (auto & writer : writers)
+	{
+		writer.join ();
+	}
+	EXPECT_EQ (failures, 0);
+
+	KDB other;
+	KeySet otherKs;
+	other.get (otherKs, testRoot);
+	EXPECT_EQ (otherKs.size (), 3 * nrKeys);
+	for (size_t m = 0; mountpoints[m]; ++m)
+	{
+		for (int k = 0; k < nrKeys; ++k)
+		{
+			EXPECT_EQ (otherKs.lookup (keyName (m, k)).getString (), std::to_string (nrWrites));
+		}
+	}
+}
+
+TEST_F (Concurrent, GroupCommitParents)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureGroup (kdb, "20000");
+
+	// every thread writes its own mountpoint, so all calls must be kept
+	std::atomic<int> failures (0);
+	std::vector<std::thread> writers;
+	for (size_t t = 0; mountpoints[t]; ++t)
+	{
+		writers.emplace_back ([&, t] {
+			KeySet ks;
+			Key root (std::string (testRoot) + "/" + mountpoints[t], KEY_END);
+			kdb.get (ks, root);
+			for (int k = 0; k < nrKeys; ++k)
+			{
+				ks.lookup (keyName (t, k)).setString (mountpoints[t]);
+			}
+			if (kdb.set (ks, root) != 1) ++failures;
+		});
+	}
+	for (auto & writer : writers)
+	{
+		writer.join ();
+	}
+	EXPECT_EQ (failures, 0);
+
+	KeySet last;
+	kdb.get (last, testRoot);
+	KDB other;
+	KeySet otherKs;
+	other.get (otherKs, testRoot);
+	EXPECT_EQ (last.size (), 3 * nrKeys);
+	for (size_t m = 0; mountpoints[m]; ++m)
+	{
+		for (int k = 0; k < nrKeys; ++k)
+		{
+			EXPECT_EQ (last.lookup (keyName (m, k)).getString (), mountpoints[m]);
+			EXPECT_EQ (otherKs.lookup (keyName (m, k)).getString (), mountpoints[m]);
+		}
+	}
+}
+
+TEST_F (Concurrent, GroupCommitDifferentKeys)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureGroup (kdb, "100000");
+
+	// every thread changes another key of the same mountpoint, so no change may be lost
+	const int nrWriters = 3;
+	std::atomic<int> failures (0);
+	std::atomic<int> ready (0);
+	std::vector<std::thread> writers;
+	for (int t = 0; t < nrWriters; ++t)
+	{
+		writers.emplace_back ([&, t] {
+			KeySet ks;
+			Key root (testRoot, KEY_END);
+			kdb.get (ks, root);
+			++ready;
+			while (ready < nrWriters)
+			{
+				std::this_thread::yield ();
+			}
+
+			// a call committed in a later group is stale and must retrieve the keys again
+			for (int attempt = 0; attempt < 100; ++attempt)
+			{
+				ks.lookup (keyName (0, t)).setString ("writer" + std::to_string (t));
+				try
+				{
+					if (kdb.set (ks, root) != 1) ++failures;
+					break;
+				}
+				catch (KDBException const &)
+				{
+					kdb.get (ks, root);
+				}
+			}
+		});
+	}
+	for (auto & writer : writers)
+	{
+		writer.join ();
+	}
+	EXPECT_EQ (failures, 0);
+
+	KDB other;
+	KeySet otherKs;
+	other.get (otherKs, testRoot);
+	EXPECT_EQ (otherKs.size (), 3 * nrKeys);
+	for (int t = 0; t < nrWriters; ++t)
+	{
+		EXPECT_EQ (otherKs.lookup (keyName (0, t)).getString (), "writer" + std::to_string (t));
+	}
+	EXPECT_EQ (otherKs.lookup (keyName (0, nrWriters)).getString (), "0");
+}
+
+TEST_F (Concurrent, GroupCommitSameKey)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureGroup (kdb, "100000");
+
+	// both threads read the key before either writes it, so exactly one of them must get a conflict
+	const int nrWriters = 2;
+	std::atomic<int> ready (0);
+	std::atomic<int> conflicts (0);
+	std::atomic<int> winner (-1);
+	std::vector<std::thread> writers;
+	for (int t = 0; t < nrWriters; ++t)
+	{
+		writers.emplace_back ([&, t] {
+			KeySet ks;
+			Key root (testRoot, KEY_END);
+			kdb.get (ks, root);
+			++ready;
+			while (ready < nrWriters)
+			{
+				std::this_thread::yield ();
+			}
+
+			ks.lookup (keyName (1, 0)).setString ("writer" + std::to_string (t));
+			try
+			{
+				if (kdb.set (ks, root) == 1) winner = t;
+			}
+			catch (KDBException const &)
+			{
+				++conflicts;
+				EXPECT_EQ (root.getMeta<std::string> ("error/number"), "C02000");
+			}
+		});
+	}
+	for (auto & writer : writers)
+	{
+		writer.join ();
+	}
+	EXPECT_EQ (conflicts, 1);
+	ASSERT_NE (winner, -1);
+
+	KDB other;
+	KeySet otherKs;
+	other.get (otherKs, testRoot);
+	EXPECT_EQ (otherKs.lookup (keyName (1, 0)).getString (), "writer" + std::to_string (winner));
+}
+
+TEST_F (Concurrent, GroupCommitConflict)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureGroup (kdb, "20000");
+	KeySet ks;
+	kdb.get (ks, testRoot);
+
+	{
+		KDB other;
+		KeySet otherKs;
+		other.get (otherKs, testRoot);
+		otherKs.lookup (keyName (0, 7)).setString ("external");
+		other.set (otherKs, testRoot);
+	}
+
+	// every call gets its own conflict
+	std::atomic<int> conflicts (0);
+	std::vector<std::thread> writers;
+	for (int t = 0; t < 2; ++t)
+	{
+		writers.emplace_back ([&, t] {
+			KeySet own = ks.dup ();
+			own.lookup (keyName (0, t)).setString ("conflict");
+			Key root (testRoot, KEY_END);
+			try
+			{
+				kdb.set (own, root);
+			}
+			catch (KDBException const &)
+			{
+				++conflicts;
+			}
+		});
+	}
+	for (auto & writer : writers)
+	{
+		writer.join ();
+	}
+	EXPECT_EQ (conflicts, 2);
+
+	kdb.get (ks, testRoot);
+	EXPECT_EQ (ks.lookup (keyName (0, 7)).getString (), "external");
+	EXPECT_EQ (ks.lookup (keyName (0, 0)).getString (), "0");
+}
+
+TEST_F (Concurrent, GroupCommitContract)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	KeySet contract;
+	contract.append (Key ("system/elektra/ensure/set/group", KEY_VALUE, "-1", KEY_END));
+	Key root (testRoot, KEY_END);
+	EXPECT_THROW (kdb.ensure (contract, root), KDBException);
+
+	ensureGroup (kdb, "1000");
+	KeySet ks;
+	EXPECT_EQ (kdb.get (ks, testRoot), 1) << "group commit enables the concurrent mode";
+	ks.lookup (keyName (1, 1)).setString ("single");
+	EXPECT_EQ (kdb.set (ks, testRoot), 1);
+
+	ensureGroup (kdb, "0");
+	ks.lookup (keyName (1, 2)).setString ("direct");
+	EXPECT_EQ (kdb.set (ks, testRoot), 1);
+	EXPECT_EQ (kdb.get (ks, testRoot), 1) << "the concurrent mode is kept";
+	EXPECT_EQ (ks.lookup (keyName (1, 1)).getString (), "single");
+	EXPECT_EQ (ks.lookup (keyName (1, 2)).getString (), "direct");
+}
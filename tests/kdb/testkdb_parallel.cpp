@@ -0,0 +1,172 @@
+/**
+ * @file
+ *
+ * @brief Tests for kdbGet() loading backends in parallel
+ *
+ * @copyright BSD License (see LICENSE.md or https://www.libelektra.org)
+ *
+ */
+
+#include <gtest/gtest-elektra.h>
+#include <kdb.hpp>
+
+#include <fstream>
+#include <memory>
+#include <vector>
+
+class Parallel : public ::testing::Test
+{
+protected:
+	static const char * testRoot;
+	static const char * configFileRoot;
+	static const char * mountpoints[];
+
+	testing::Namespaces namespaces;
+	std::vector<std::unique_ptr<testing::Mountpoint>> mps;
+
+	virtual void SetUp () override
+	{
+		using namespace kdb;
+
+		for (size_t i = 0; mountpoints[i]; ++i)
+		{
+			std::string mp = std::string (testRoot) + "/" + mountpoints[i];
+			mps.emplace_back (new testing::Mountpoint (mp, std::string (mountpoints[i]) + configFileRoot));
+		}
+
+		KDB kdb;
+		KeySet ks;
+		kdb.get (ks, testRoot);
+		for (size_t i = 0; mountpoints[i]; ++i)
+		{
+			for (int k = 0; k < 20; ++k)
+			{
+				std::string name = std::string ("user") + testRoot + "/" + mountpoints[i] + "/key" + std::to_string (k);
+				ks.append (Key (name, KEY_VALUE, std::to_string (k).c_str (), KEY_META, "order", std::to_string (k).c_str (),
+						KEY_END));
+			}
+		}
+		kdb.set (ks, testRoot);
+	}
+
+	virtual void TearDown () override
+	{
+		mps.clear ();
+	}
+
+	static void ensureParallel (kdb::KDB & kdb, const char * threads)
+	{
+		using namespace kdb;
+		KeySet contract;
+		contract.append (Key ("system/elektra/ensure/get/parallel", KEY_VALUE, threads, KEY_END));
+		Key root (testRoot, KEY_END);
+		EXPECT_EQ (kdb.ensure (contract, root), 0) << "parallel kdbGet could not be enabled";
+	}
+
+	void breakConfigFile (size_t i)
+	{
+		std::ofstream file (mps[i]->userConfigFile);
+		file << "kdbOpen 2" << std::endl;
+	}
+};
+
+const char * Parallel::testRoot = "/tests/kdb/parallel";
+const char * Parallel::configFileRoot = "kdbFileParallel.dump";
+const char * Parallel::mountpoints[] = { "a", "b", "c", "d", "e", nullptr };
+
+TEST_F (Parallel, SameKeys)
+{
+	using namespace kdb;
+
+	KeySet serial;
+	{
+		KDB kdb;
+		kdb.get (serial, testRoot);
+	}
+
+	KeySet parallel;
+	{
+		KDB kdb;
+		ensureParallel (kdb, "4");
+		kdb.get (parallel, testRoot);
+	}
+
+	ASSERT_EQ (serial.size (), parallel.size ());
+	ASSERT_EQ (parallel.size (), 5 * 20);
+	for (ssize_t i = 0; i < serial.size (); ++i)
+	{
+		Key s = serial.at (i);
+		Key p = parallel.at (i);
+		EXPECT_EQ (s.getName (), p.getName ());
+		EXPECT_EQ (s.getString (), p.getString ());
+		EXPECT_EQ (s.getMeta<std::string> ("order"), p.getMeta<std::string> ("order"));
+	}
+}
+
+TEST_F (Parallel, Update)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	ensureParallel (kdb, "3");
+	KeySet ks;
+	EXPECT_EQ (kdb.get (ks, testRoot), 1);
+	EXPECT_EQ (kdb.get (ks, testRoot), 0) << "nothing changed";
+
+	ks.lookup (std::string ("user") + testRoot + "/c/key3").setString ("changed");
+	kdb.set (ks, testRoot);
+
+	KDB other;
+	ensureParallel (other, "3");
+	KeySet otherKs;
+	other.get (otherKs, testRoot);
+	EXPECT_EQ (otherKs.lookup (std::string ("user") + testRoot + "/c/key3").getString (), "changed");
+	EXPECT_EQ (otherKs.size (), 5 * 20);
+}
+
+TEST_F (Parallel, FirstError)
+{
+	using namespace kdb;
+
+	breakConfigFile (3);
+	breakConfigFile (1);
+
+	Key serialRoot (testRoot, KEY_END);
+	{
+		KDB kdb;
+		KeySet ks;
+		EXPECT_THROW (kdb.get (ks, serialRoot), KDBException);
+	}
+	ASSERT_TRUE (serialRoot.hasMeta ("error"));
+
+	for (int i = 0; i < 10; ++i)
+	{
+		Key root (testRoot, KEY_END);
+		KDB kdb;
+		ensureParallel (kdb, "4");
+		KeySet ks;
+		EXPECT_THROW (kdb.get (ks, root), KDBException);
+		EXPECT_EQ (ks.size (), 0) << "keyset must not be changed on error";
+		EXPECT_EQ (root.getMeta<std::string> ("error/number"), serialRoot.getMeta<std::string> ("error/number"));
+		EXPECT_EQ (root.getMeta<std::string> ("error/mountpoint"), serialRoot.getMeta<std::string> ("error/mountpoint"))
+			<< "the error of the first backend must be reported";
+		EXPECT_EQ (root.getMeta<std::string> ("error/reason"), serialRoot.getMeta<std::string> ("error/reason"));
+		EXPECT_EQ (root.hasMeta ("warnings"), serialRoot.hasMeta ("warnings"));
+	}
+}
+
+TEST_F (Parallel, Contract)
+{
+	using namespace kdb;
+
+	KDB kdb;
+	KeySet contract;
+	contract.append (Key ("system/elektra/ensure/get/parallel", KEY_VALUE, "many", KEY_END));
+	Key root (testRoot, KEY_END);
+	EXPECT_THROW (kdb.ensure (contract, root), KDBException);
+
+	ensureParallel (kdb, "0");
+	KeySet ks;
+	kdb.get (ks, testRoot);
+	EXPECT_EQ (ks.size (), 5 * 20);
+}